@@ -95,12 +95,22 @@ local function EventHelpers(domoticz, mainMethod)
 	function self.getStorageContext(storageDef, module)
 
 		local storageContext = {}
-		local fileStorage, value, ok
+		local fileStorage, value, ok, native
 		
 		if (storageDef ~= nil) then
-			-- load the datafile for this module
-			ok, fileStorage = pcall(require, module)
-			package.loaded[module] = nil -- no caching
+			-- load the datafile for this module, from the domoticz storage when available
+			if (_G.dzStorage ~= nil) then
+				native, fileStorage = _G.dzStorage.load(_G.dataFolderPath .. '/' .. module .. '.lua')
+			end
+			if (native ~= nil) then
+				ok = native
+				if (not ok) then
+					fileStorage = {}
+				end
+			else
+				ok, fileStorage = pcall(require, module)
+				package.loaded[module] = nil -- no caching
+			end
 			if (ok) then
 				-- only transfer data as defined in storageDef
 				for _var, _def in pairs(storageDef) do
@@ -195,7 +205,11 @@ local function EventHelpers(domoticz, mainMethod)
 					end
 				end
 			end
-			local ok, err = pcall(persistence.store, dataFilePath, data)
+			local ok, err = true, nil
+			-- the domoticz storage refuses what it cannot store as is, that is written here like before
+			if (_G.dzStorage == nil or not _G.dzStorage.store(dataFilePath, data)) then
+				ok, err = pcall(persistence.store, dataFilePath, data)
+			end
 
 			-- make sure there is no cache for this 'data' module
 			package.loaded[dataFileModuleName] = nil
@@ -348,6 +362,19 @@ local function EventHelpers(domoticz, mainMethod)
 		self.domoticz.globalData = nil
 	end
 
+	-- lets require use the chunk domoticz compiled for this script, but only when require would load that same file
+	function self.usePrecompiled(script)
+		if (script.chunk == nil or package.preload[script.name] ~= nil) then
+			return
+		end
+		local found = package.searchpath(script.name, package.path)
+		if (found ~= nil and found:gsub('\\', '/') == script.path:gsub('\\', '/')) then
+			package.preload[script.name] = function()
+				return script.chunk(script.name, script.path)
+			end
+		end
+	end
+
 	function self.scandir(directory, type)
 		local pos, len
 		local i, t, popen = 0, {}, io.popen
@@ -358,6 +385,21 @@ local function EventHelpers(domoticz, mainMethod)
 			return {}
 		end
 
+		if (_G.scriptManifest ~= nil) then
+			-- the folders are listed (and the scripts compiled) by domoticz
+			for i, script in ipairs(_G.scriptManifest) do
+				if (script.type == type) then
+					table.insert(t, {
+						['type'] = type,
+						['name'] = script.name
+					})
+					namesLookup[script.name] = true
+					self.usePrecompiled(script)
+				end
+			end
+			return t, namesLookup
+		end
+
 		if (sep == '/') then
 			cmd = 'ls -a "' .. directory .. '"'
 		else
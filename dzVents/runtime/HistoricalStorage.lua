@@ -57,6 +57,55 @@ local function setIterators(object, collection)
 	end
 end
 
+-- stored samples only get a Time object when a script asks for item.time
+local sampleMeta = {
+	__index = function(item, key)
+		if (key == 'time') then
+			local t = Time(rawget(item, '_raw'), true) -- UTC
+			rawset(item, 'time', t)
+			return t
+		end
+	end
+}
+
+local function parseDate(sDate)
+	return string.match(sDate, "(%d+)%-(%d+)%-(%d+)[%sT]+(%d+):(%d+):([0-9%.]+)")
+end
+
+local function parseSecs(s)
+	local secs, ms = string.match(s, '^(%d+)%.?(%d*)$')
+	if (secs == nil) then return nil, 0 end
+	return tonumber(secs), tonumber(ms) or 0
+end
+
+-- the milliseconds of the current event time, like Time uses them
+local function getCurrentMS()
+	if (globalvariables == nil or globalvariables.currentTime == nil) then return 0 end
+	local s = select(6, parseDate(globalvariables.currentTime))
+	local secs, ms = parseSecs(s or '')
+	return ms
+end
+
+-- secondsAgo and minutesAgo as Time(sDate, true) calculates them, nil when only Time can tell
+local function getAgo(sDate, tToday, currentMS)
+	local y, mon, d, h, min, s = parseDate(sDate)
+	if not(y and mon and d and h and min and s) then return nil end
+	local secs, ms = parseSecs(s)
+	if (secs == nil) then return nil end
+
+	local secDiff = os.difftime(tToday, os.time{year=y,month=mon,day=d,hour=h,min=min,sec=secs })
+	local msDiff = (secDiff * 1000) - ms + currentMS
+	if (math.abs(msDiff) < 1000) then
+		secDiff = 0
+	end
+	local secondsAgo = math.floor(math.abs(secDiff))
+	local minutesAgo = math.floor(math.abs(secDiff / 60))
+	if (msDiff < 0) then
+		return -secondsAgo, -minutesAgo
+	end
+	return secondsAgo, minutesAgo
+end
+
 local function HistoricalStorage(data, maxItems, maxHours, maxMinutes, getData)
 	-- IMPORTANT: data must be time-stamped in UTC format
 
@@ -86,18 +135,29 @@ local function HistoricalStorage(data, maxItems, maxHours, maxMinutes, getData)
 		-- that way we can easily prune or ditch based
 		-- on maxItems and/or maxHours
 		local count = 0
+		local now = os.date('!*t')
+		local tToday = os.time{ day = now.day, year = now.year, month = now.month, hour = now.hour, min = now.min, sec = now.sec }
+		local currentMS = getCurrentMS()
 		for i, sample in ipairs(data) do
-			local t = Time(sample.time, true) -- UTC
+			if (count >= maxItems) then break end
 
-			if (count < maxItems) then
-				local add = true
-				if (maxMinutes > 0 and t.minutesAgo > maxMinutes) then
-					add = false
-				end
-				if (add) then
-					table.insert(self.storage, { time = t, data = sample.data })
-					count = count + 1
-				end
+			local item
+			local secondsAgo, minutesAgo
+			if (type(sample.time) == 'string') then
+				secondsAgo, minutesAgo = getAgo(sample.time, tToday, currentMS)
+			end
+			-- samples of the last seconds are left to Time, the clock may have ticked in between
+			if (secondsAgo ~= nil and math.abs(secondsAgo) >= 2) then
+				item = setmetatable({ data = sample.data, _raw = sample.time, _secondsAgo = secondsAgo }, sampleMeta)
+			else
+				local t = Time(sample.time, true) -- UTC
+				item = { time = t, data = sample.data }
+				minutesAgo = t.minutesAgo
+			end
+
+			if (maxMinutes <= 0 or minutesAgo <= maxMinutes) then
+				table.insert(self.storage, item)
+				count = count + 1
 			end
 		end
 		self.size = count
@@ -114,6 +174,11 @@ local function HistoricalStorage(data, maxItems, maxHours, maxMinutes, getData)
 		return hoursAgo*3600 + minsAgo*60 + secsAgo
 	end
 
+	local function getItemSecondsAgo(item)
+		local t = rawget(item, 'time')
+		return t ~= nil and t.secondsAgo or item._secondsAgo
+	end
+
 	function self.subset(from, to, _setIterators)
 		local res = {}
 		local skip = false
@@ -143,7 +208,7 @@ local function HistoricalStorage(data, maxItems, maxHours, maxMinutes, getData)
 		local len = 0
 
 		for i = 1, self.size do
-			if (self.storage[i].time.secondsAgo<=totalSecsAgo) then
+			if (getItemSecondsAgo(self.storage[i]) <= totalSecsAgo) then
 				table.insert(res, self.storage[i])
 				len = len + 1
 			end
@@ -162,7 +227,7 @@ local function HistoricalStorage(data, maxItems, maxHours, maxMinutes, getData)
 
 		self.forEach(function(item)
 			table.insert(res,{
-				time = item.time.raw,
+				time = rawget(item, 'time') ~= nil and item.time.raw or item._raw,
 				data = item.data
 			})
 		end)
@@ -213,11 +278,11 @@ local function HistoricalStorage(data, maxItems, maxHours, maxMinutes, getData)
 		local res = {}
 
 		for i = 1, self.size do
-			if (self.storage[i].time.secondsAgo > totalSecsAgo) then
+			if (getItemSecondsAgo(self.storage[i]) > totalSecsAgo) then
 
 				if (i>1) then
-					local deltaWithPrevious = totalSecsAgo - self.storage[i-1].time.secondsAgo
-					local deltaWithCurrent = self.storage[i].time.secondsAgo - totalSecsAgo
+					local deltaWithPrevious = totalSecsAgo - getItemSecondsAgo(self.storage[i-1])
+					local deltaWithCurrent = getItemSecondsAgo(self.storage[i]) - totalSecsAgo
 
 					if (deltaWithPrevious < deltaWithCurrent) then
 						-- the previous one was closer to the time we were looking for
@@ -272,6 +337,41 @@ local function HistoricalStorage(data, maxItems, maxHours, maxMinutes, getData)
 		end
 	end
 
+	-- storage indexes of subset(from, to), nil when it is empty
+	local function getRange(from, to)
+		if (from == nil or from < 1) then from = 1 end
+		if (to == nil or to > self.size) then to = self.size end
+		from, to = math.tointeger(from), math.tointeger(to)
+		if (from == nil or to == nil or from > to) then return nil end
+		return from, to
+	end
+
+	-- storage indexes of subsetSince(timeAgo), nil when it is empty or not one block
+	local function getRangeSince(timeAgo)
+		local totalSecsAgo = getSecondsAgo(timeAgo)
+		local from, to
+		for i = 1, self.size do
+			if (getItemSecondsAgo(self.storage[i]) <= totalSecsAgo) then
+				if (from == nil) then
+					from = i
+				elseif (to ~= i - 1) then
+					return nil
+				end
+				to = i
+			end
+		end
+		return from, to
+	end
+
+	-- sum, count, minimum item and maximum item of storage[from..to] done by domoticz,
+	-- nil when it has to be done here (custom getData, no numbers)
+	local function _aggregate(from, to)
+		if (from == nil or getData ~= nil or _G.dzStorage == nil) then return nil end
+		local sum, count, minIndex, maxIndex = _G.dzStorage.aggregate(self.storage, from, to)
+		if (sum == nil) then return nil end
+		return sum, count, self.storage[minIndex], self.storage[maxIndex]
+	end
+
 	local function _sum(items)
 		local count = 0
 
@@ -290,6 +390,9 @@ local function HistoricalStorage(data, maxItems, maxHours, maxMinutes, getData)
 	end
 
 	function self.avg(from, to, default)
+		local sum, count = _aggregate(getRange(from, to))
+		if (sum ~= nil) then return sum/count end
+
 		local subset, length = self.subset(from, to)
 
 		if (length == 0) then
@@ -300,6 +403,9 @@ local function HistoricalStorage(data, maxItems, maxHours, maxMinutes, getData)
 	end
 
 	function self.avgSince(timeAgo, default)
+		local sum, count = _aggregate(getRangeSince(timeAgo))
+		if (sum ~= nil) then return sum/count end
+
 		local subset, length = self.subsetSince(timeAgo)
 		if (length == 0) then
 			return default or 0
@@ -357,6 +463,9 @@ local function HistoricalStorage(data, maxItems, maxHours, maxMinutes, getData)
 	end
 
 	function self.min(from, to)
+		local sum, count, minItem = _aggregate(getRange(from, to))
+		if (sum ~= nil) then return minItem.data, minItem end
+
 		local subset, length = self.subset(from, to)
 		if (length == 0) then
 			return nil, nil
@@ -366,6 +475,9 @@ local function HistoricalStorage(data, maxItems, maxHours, maxMinutes, getData)
 	end
 
 	function self.minSince(timeAgo)
+		local sum, count, minItem = _aggregate(getRangeSince(timeAgo))
+		if (sum ~= nil) then return minItem.data, minItem end
+
 		local subset, length = self.subsetSince(timeAgo)
 		if (length==0) then
 			return nil, nil
@@ -395,6 +507,9 @@ local function HistoricalStorage(data, maxItems, maxHours, maxMinutes, getData)
 	end
 
 	function self.max(from, to)
+		local sum, count, minItem, maxItem = _aggregate(getRange(from, to))
+		if (sum ~= nil) then return maxItem.data, maxItem end
+
 		local subset, length = self.subset(from, to)
 		if (length==0) then
 			return nil, nil
@@ -404,6 +519,9 @@ local function HistoricalStorage(data, maxItems, maxHours, maxMinutes, getData)
 	end
 
 	function self.maxSince(timeAgo)
+		local sum, count, minItem, maxItem = _aggregate(getRangeSince(timeAgo))
+		if (sum ~= nil) then return maxItem.data, maxItem end
+
 		local subset, length = self.subsetSince(timeAgo)
 		if (length==0) then
 			return nil, nil
@@ -413,6 +531,9 @@ local function HistoricalStorage(data, maxItems, maxHours, maxMinutes, getData)
 	end
 
 	function self.sum(from, to)
+		local sum, count = _aggregate(getRange(from, to))
+		if (sum ~= nil) then return sum, count end
+
 		local subset, length = self.subset(from, to)
 		if (length==0) then
 			return 0
@@ -422,6 +543,9 @@ local function HistoricalStorage(data, maxItems, maxHours, maxMinutes, getData)
 	end
 
 	function self.sumSince(timeAgo)
+		local sum, count = _aggregate(getRangeSince(timeAgo))
+		if (sum ~= nil) then return sum, count end
+
 		local subset, length = self.subsetSince(timeAgo)
 		if (length==0) then
 			return 0
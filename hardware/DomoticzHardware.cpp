@@ -116,7 +116,7 @@ void CDomoticzHardwareBase::Log(const _eLogLevel level, const std::string& sLogl
 	if (!(m_LogLevelEnabled & (uint32_t)level))
 		return; //this type of log is disabled
 
-	_log.Log(level, "%s: %s", m_Name.c_str(), sLogline.c_str());
+	_log.LogHardware(level, m_HwdID, "%s: %s", m_Name.c_str(), sLogline.c_str());
 }
 
 void CDomoticzHardwareBase::Log(const _eLogLevel level, const char* logline, ...)
@@ -129,22 +129,26 @@ void CDomoticzHardwareBase::Log(const _eLogLevel level, const char* logline, ...
 	va_start(argList, logline);
 	vsnprintf(cbuffer, sizeof(cbuffer), logline, argList);
 	va_end(argList);
-	_log.Log(level, "%s: %s", m_Name.c_str(), cbuffer);
+	_log.LogHardware(level, m_HwdID, "%s: %s", m_Name.c_str(), cbuffer);
 }
 
 void CDomoticzHardwareBase::Debug(const _eDebugLevel level, const std::string& sLogline)
 {
-	_log.Debug(level, "%s: %s", m_Name.c_str(), sLogline.c_str());
+	if (!_log.IsDebugLevelEnabled(level))
+		return;
+	_log.LogHardware(LOG_DEBUG_INT, m_HwdID, "%s: %s", m_Name.c_str(), sLogline.c_str());
 }
 
 void CDomoticzHardwareBase::Debug(const _eDebugLevel level, const char* logline, ...)
 {
+	if (!_log.IsDebugLevelEnabled(level))
+		return;
 	va_list argList;
 	char cbuffer[MAX_LOG_LINE_LENGTH];
 	va_start(argList, logline);
 	vsnprintf(cbuffer, sizeof(cbuffer), logline, argList);
 	va_end(argList);
-	_log.Debug(level, "%s: %s", m_Name.c_str(), cbuffer);
+	_log.LogHardware(LOG_DEBUG_INT, m_HwdID, "%s: %s", m_Name.c_str(), cbuffer);
 }
 
 //Sensor Helpers
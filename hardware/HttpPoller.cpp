@@ -36,6 +36,7 @@ m_refresh(refresh)
 	}
 
 	m_HwdID=ID;
+	m_luaHandler = std::make_shared<CLuaHandler>(ID);
 	Init();
 }
 
@@ -140,6 +141,5 @@ void CHttpPoller::GetScript()
 	}
 
 	// Got some data, send them to the lua parsers for processing
-	CLuaHandler luaScript(m_HwdID);
-	luaScript.executeLuaScript(m_script, sResult);
+	m_luaHandler->executeLuaScript(m_script, sResult);
 }
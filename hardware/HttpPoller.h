@@ -7,6 +7,8 @@ namespace Json
 	class Value;
 } // namespace Json
 
+class CLuaHandler;
+
 class CHttpPoller : public CDomoticzHardwareBase
 {
       public:
@@ -32,4 +34,5 @@ class CHttpPoller : public CDomoticzHardwareBase
 	unsigned short m_method;
 	unsigned short m_refresh;
 	std::shared_ptr<std::thread> m_thread;
+	std::shared_ptr<CLuaHandler> m_luaHandler;
 };
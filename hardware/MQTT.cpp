@@ -96,7 +96,6 @@ bool MQTT::StartHardware()
 	m_IsConnected = false;
 	m_bIsStarted = true;
 
-	m_LastUpdatedDeviceRowIdx = 0;
 	m_LastUpdatedSceneRowIdx = 0;
 
 	// Start worker thread
@@ -172,7 +171,16 @@ void MQTT::on_connect(int rc)
 			Log(LOG_STATUS, "Connected to: %s:%d", m_szIPAddress.c_str(), m_usIPPort);
 			m_IsConnected = true;
 			sOnConnected(this);
-			m_sDeviceReceivedConnection = m_mainworker.sOnDeviceReceived.connect([this](auto id, auto idx, auto &&name, auto cmd) { SendDeviceInfo(id, idx, name, cmd); });
+			if (m_sDeviceReceivedConnection.connected())
+				m_sDeviceReceivedConnection.disconnect();
+			m_sDeviceReceivedConnection = m_mainworker.m_deviceEventBus.Subscribe(std_format("MQTT_%d", m_HwdID), CDeviceEventBus::_eQueuePolicy::ALL_EVENTS, 4096, true, [this](const auto &event) {
+				if (event.type != CDeviceEventBus::_tDeviceEvent::_eType::RECEIVED)
+					return;
+				// an update we caused ourselves (udevice, switchlight...), do not send it back
+				if (m_bPreventLoop && (event.OriginHwdID == m_HwdID))
+					return;
+				SendDeviceInfo(event.HwdID, event.DeviceRowIdx, &event);
+			});
 			m_sSwitchSceneConnection = m_mainworker.sOnSwitchScene.connect([this](auto scene, auto &&name) { SendSceneInfo(scene, name); });
 		}
 		if (!m_TopicIn.empty())
@@ -298,7 +306,7 @@ void MQTT::on_message(const struct mosquitto_message *message)
 			}
 
 			// Prevent MQTT update being send to client after next update
-			m_LastUpdatedDeviceRowIdx = idx;
+			m_mainworker.m_deviceEventBus.SetOrigin(idx, m_HwdID);
 
 			if (!m_mainworker.UpdateDevice(HardwareID, OrgHardwareID, DeviceID, unit, devType, subType, nvalue, svalue, m_Name, signallevel, batterylevel, bParseTrigger))
 			{
@@ -325,7 +333,7 @@ void MQTT::on_message(const struct mosquitto_message *message)
 			}
 
 			// Prevent MQTT update being send to client after next update
-			m_LastUpdatedDeviceRowIdx = idx;
+			m_mainworker.m_deviceEventBus.SetOrigin(idx, m_HwdID);
 			const bool bIsOOC = atoi(onlyonchange.c_str()) != 0;
 
 			if (m_mainworker.SwitchLight(idx, switchcmd, level, NoColor, bIsOOC, 0, "MQTT") == MainWorker::SL_ERROR)
@@ -448,7 +456,7 @@ void MQTT::on_message(const struct mosquitto_message *message)
 			Log(LOG_STATUS, "setcolbrightnessvalue: ID: %" PRIx64 ", bri: %d, color: '%s'", idx, ival, color.toString().c_str());
 
 			// Prevent MQTT update being send to client after next update
-			m_LastUpdatedDeviceRowIdx = idx;
+			m_mainworker.m_deviceEventBus.SetOrigin(idx, m_HwdID);
 
 			if (m_mainworker.SwitchLight(idx, "Set Color", ival, color, false, 0, "MQTT") == MainWorker::SL_ERROR)
 			{
@@ -550,7 +558,7 @@ void MQTT::on_message(const struct mosquitto_message *message)
 		else if (szCommand == "getdeviceinfo")
 		{
 			int HardwareID = atoi(result[0][0].c_str());
-			SendDeviceInfo(HardwareID, idx, "request device", nullptr);
+			SendDeviceInfo(HardwareID, idx, nullptr);
 		}
 		else if (szCommand == "getsceneinfo")
 		{
@@ -741,7 +749,7 @@ void MQTT::WriteInt(const std::string &sendStr)
 	SendMessage(m_TopicOut, sMessage);
 }
 
-void MQTT::SendDeviceInfo(const int HwdID, const uint64_t DeviceRowIdx, const std::string & /*DeviceName*/, const unsigned char * /*pRXCommand*/)
+void MQTT::SendDeviceInfo(const int HwdID, const uint64_t DeviceRowIdx, const CDeviceEventBus::_tDeviceEvent *pEvent)
 {
 	if (!m_IsConnected)
 		return;
@@ -749,13 +757,6 @@ void MQTT::SendDeviceInfo(const int HwdID, const uint64_t DeviceRowIdx, const st
 	if (m_TopicOut.empty())
 		return;
 
-	if (m_bPreventLoop && (DeviceRowIdx == m_LastUpdatedDeviceRowIdx))
-	{
-		// we should ignore this now
-		m_LastUpdatedDeviceRowIdx = 0;
-		return;
-	}
-
 	std::lock_guard<std::mutex> l(m_mutex);
 	if (!m_shared_devices.empty())
 	{
@@ -797,6 +798,17 @@ void MQTT::SendDeviceInfo(const int HwdID, const uint64_t DeviceRowIdx, const st
 		int LastLevel = atoi(sd[iIndex++].c_str());
 		std::string sColor = sd[iIndex++];
 		std::string sLastUpdate = sd[iIndex++];
+		if ((pEvent != nullptr) && (pEvent->bHaveValue))
+		{
+			// the value of the update, the row may already hold a newer one
+			nvalue = pEvent->value.nValue;
+			svalue = pEvent->value.sValue;
+			RSSI = pEvent->value.SignalLevel;
+			BatteryLevel = pEvent->value.BatteryLevel;
+			LastLevel = pEvent->value.LastLevel;
+			sColor = pEvent->value.Color;
+			sLastUpdate = pEvent->value.LastUpdate;
+		}
 
 		Json::Value root;
 
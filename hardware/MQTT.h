@@ -4,6 +4,7 @@
 #include "hardwaretypes.h"
 #include "MySensorsBase.h"
 #include "../main/mosquitto_helper.h"
+#include "../main/DeviceEventBus.h"
 
 class MQTT : public MySensorsBase, mosqdz::mosquittodz
 {
@@ -70,7 +71,8 @@ protected:
 private:
 	bool ConnectInt();
 	bool ConnectIntEx();
-	void SendDeviceInfo(int HwdID, uint64_t DeviceRowIdx, const std::string& DeviceName, const unsigned char* pRXCommand);
+	// pEvent is nullptr when the device info was requested, the current row is sent then
+	void SendDeviceInfo(int HwdID, uint64_t DeviceRowIdx, const CDeviceEventBus::_tDeviceEvent *pEvent);
 	void SendSceneInfo(uint64_t SceneIdx, const std::string& SceneName);
 	void StopMQTT();
 	void Do_Work();
@@ -78,12 +80,11 @@ private:
 	virtual void SendHeartbeat();
 	void WriteInt(const std::string& sendStr) override;
 	std::shared_ptr<std::thread> m_thread;
-	boost::signals2::connection m_sDeviceReceivedConnection;
+	CDeviceEventBus::subscription m_sDeviceReceivedConnection;
 	boost::signals2::connection m_sSwitchSceneConnection;
 	_ePublishTopics m_publish_scheme;
 	bool m_bPreventLoop = false;
 	bool m_bRetain = false;
-	uint64_t m_LastUpdatedDeviceRowIdx = 0;
 	uint64_t m_LastUpdatedSceneRowIdx = 0;
 	std::mutex m_mutex;
 	std::map<uint64_t, bool> m_shared_devices;
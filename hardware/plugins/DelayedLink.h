@@ -97,6 +97,7 @@ namespace Plugins {
 		DECLARE_PYTHON_SYMBOL(int, PyDict_DelItemString, PyObject *COMMA const char *);
 		DECLARE_PYTHON_SYMBOL(int, PyDict_Next, PyObject *COMMA Py_ssize_t *COMMA PyObject **COMMA PyObject **);
 		DECLARE_PYTHON_SYMBOL(PyObject*, PyDict_Items, PyObject*);
+		DECLARE_PYTHON_SYMBOL(PyObject*, PyDict_Copy, PyObject*);
 		DECLARE_PYTHON_SYMBOL(PyObject*, PyList_New, Py_ssize_t);
 		DECLARE_PYTHON_SYMBOL(Py_ssize_t, PyList_Size, PyObject*);
 		DECLARE_PYTHON_SYMBOL(Py_ssize_t, PyTuple_Size, PyObject*);
@@ -228,6 +229,7 @@ namespace Plugins {
 					RESOLVE_PYTHON_SYMBOL(PyDict_DelItemString);
 					RESOLVE_PYTHON_SYMBOL(PyDict_Next);
 					RESOLVE_PYTHON_SYMBOL(PyDict_Items);
+					RESOLVE_PYTHON_SYMBOL(PyDict_Copy);
 					RESOLVE_PYTHON_SYMBOL(PyList_New);
 					RESOLVE_PYTHON_SYMBOL(PyList_Size);
 					RESOLVE_PYTHON_SYMBOL(PyTuple_Size);
@@ -452,6 +454,7 @@ extern	SharedLibraryProxy* pythonLib;
 #define PyDict_DelItemString	pythonLib->PyDict_DelItemString
 #define PyDict_Next				pythonLib->PyDict_Next
 #define PyDict_Items			pythonLib->PyDict_Items
+#define PyDict_Copy				pythonLib->PyDict_Copy
 #define PyList_New				pythonLib->PyList_New
 #define PyList_Size				pythonLib->PyList_Size
 #define PyTuple_Size			pythonLib->PyTuple_Size
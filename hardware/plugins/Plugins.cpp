@@ -15,6 +15,7 @@
 
 #include "../../main/Helper.h"
 #include "../../main/Logger.h"
+#include "../../main/Metrics.h"
 #include "../../main/SQLHelper.h"
 #include "../../main/mainworker.h"
 #include "../../tinyxpath/tinyxml.h"
@@ -759,6 +760,7 @@ namespace Plugins
 		m_bIsStarted = false;
 		m_bIsStarting = false;
 		m_bTracing = false;
+		m_pQueueDepthMetric = &metrics::Registry().Gauge("domoticz_plugin_queue_depth", "Messages waiting in the queue of a Python plugin", "hardware").Get(std::to_string(HwdID));
 	}
 
 	CPlugin::~CPlugin()
@@ -924,6 +926,7 @@ namespace Plugins
 			{
 				m_MessageQueue.pop_front();
 			}
+			m_pQueueDepthMetric->Set(0);
 		}
 
 		// Start worker thread
@@ -1057,6 +1060,7 @@ namespace Plugins
 						// Message is for sometime in the future so requeue it (this happens when the 'Delay' parameter is used on a Send)
 						m_MessageQueue.push_back(FrontMessage);
 					}
+					m_pQueueDepthMetric->Set(m_MessageQueue.size());
 				}
 
 				if (Message)
@@ -1964,6 +1968,7 @@ namespace Plugins
 		// Add message to queue
 		std::lock_guard<std::mutex> l(m_QueueMutex);
 		m_MessageQueue.push_back(pMessage);
+		m_pQueueDepthMetric->Set(m_MessageQueue.size());
 	}
 
 	void CPlugin::DeviceAdded(const std::string DeviceID, int Unit)
@@ -2345,6 +2350,7 @@ namespace Plugins
 			{
 				m_MessageQueue.pop_front();
 			}
+			m_pQueueDepthMetric->Set(0);
 		}
 
 		m_bIsStopped = true;
@@ -12,6 +12,11 @@
 typedef unsigned char byte;
 #endif
 
+namespace metrics
+{
+	class CGauge;
+} // namespace metrics
+
 namespace Plugins {
 
 	// forward declarations
@@ -56,6 +61,7 @@ namespace Plugins {
 		std::vector<CPluginTransport*>	m_Transports;
 		std::mutex m_QueueMutex; // controls access to the message queue
 		std::deque<CPluginMessageBase *> m_MessageQueue;
+		metrics::CGauge *m_pQueueDepthMetric;
 
 		std::shared_ptr<std::thread> m_thread;
 
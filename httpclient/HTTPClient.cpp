@@ -67,6 +67,15 @@ size_t write_curl_data_single_line(void *contents, size_t size, size_t nmemb, vo
 	return realsize;
 }
 
+size_t write_curl_data_stream(void *contents, size_t size, size_t nmemb, void *userp)
+{
+	size_t realsize = size * nmemb;
+	const HTTPClient::stream_callback_t *pCallback = (const HTTPClient::stream_callback_t *)userp;
+	if (!(*pCallback)((const unsigned char *)contents, realsize))
+		return 0; // aborts the transfer
+	return realsize;
+}
+
 
 /************************************************************************
  *									*
@@ -337,6 +346,7 @@ bool HTTPClient::POSTBinary(const std::string &url, const std::string &postdata,
 		}
 
 		curl_easy_setopt(curl, CURLOPT_POSTFIELDS, postdata.c_str());
+		curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, (long)postdata.size()); // body can be binary (gzip)
 		res = curl_easy_perform(curl);
 
 		if (res != CURLE_OK)
@@ -841,3 +851,66 @@ bool HTTPClient::GETBinaryToFile(const std::string &url, const std::string &outp
 		return false;
 	}
 }
+
+bool HTTPClient::GETStream(const std::string &url, const std::vector<std::string> &ExtraHeaders, std::vector<std::string> &vHeaderData, const stream_callback_t &callback,
+			   const long StallTimeOut)
+{
+	try
+	{
+		if (!CheckIfGlobalInitDone())
+			return false;
+		CURL *curl = curl_easy_init();
+		if (!curl)
+			return false;
+
+		CURLcode res;
+		SetGlobalOptions(curl);
+		// the response does not end, only a stalled connection times out
+		curl_easy_setopt(curl, CURLOPT_TIMEOUT, 0L);
+		curl_easy_setopt(curl, CURLOPT_LOW_SPEED_LIMIT, 1L);
+		curl_easy_setopt(curl, CURLOPT_LOW_SPEED_TIME, StallTimeOut);
+
+		struct curl_slist *headers = nullptr;
+		if (!ExtraHeaders.empty())
+		{
+			for (const auto &header : ExtraHeaders)
+			{
+				headers = curl_slist_append(headers, header.c_str());
+			}
+			curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+		}
+
+		curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, write_curl_headerdata);
+		curl_easy_setopt(curl, CURLOPT_HEADERDATA, &vHeaderData);
+		curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_curl_data_stream);
+		curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *)&callback);
+		curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+		res = curl_easy_perform(curl);
+
+		bool bOK = false;
+		if ((res == CURLE_OK) || (res == CURLE_WRITE_ERROR))
+		{
+			// a write error is the callback closing the stream
+			long http_code = 0;
+			curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
+
+			bOK = ((http_code) && (http_code < 400));
+			if (!bOK)
+			{
+				LogError(http_code);
+			}
+		}
+
+		curl_easy_cleanup(curl);
+
+		if (headers != nullptr)
+		{
+			curl_slist_free_all(headers); /* free the header list */
+		}
+		return bOK;
+	}
+	catch (...)
+	{
+		return false;
+	}
+}
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <functional>
+
 class HTTPClient
 {
 	// give MainWorker acces to the protected Cleanup() function
@@ -111,6 +113,18 @@ class HTTPClient
 	static bool PatchBinary(const std::string& url, const std::string& putdata, const std::vector<std::string>& ExtraHeaders, std::vector<unsigned char>& response,
 		std::vector<std::string>& vHeaderData, long TimeOut = -1);
 
+	/************************************************************************
+	 *									*
+	 * streaming method							*
+	 *   - for responses that do not end, e.g. MJPEG camera streams	*
+	 *   - the callback gets the data as it arrives, return false to stop	*
+	 *									*
+	 ************************************************************************/
+
+	typedef std::function<bool(const unsigned char *pData, size_t len)> stream_callback_t;
+	static bool GETStream(const std::string &url, const std::vector<std::string> &ExtraHeaders, std::vector<std::string> &vHeaderData, const stream_callback_t &callback,
+			      long StallTimeOut = 10);
+
       private:
 	static void SetGlobalOptions(void *curlobj);
 	static bool CheckIfGlobalInitDone();
@@ -2408,7 +2408,6 @@ bool CWebServer::CheckDeviceAccess(const WebEmSession& session, const std::vecto
 
 		// Build IN clause for SQL query
 		std::stringstream ss;
-		ss << "SELECT COUNT(*) FROM SharedDevices WHERE (SharedUserID == '" << m_users[iUser].ID << "') AND DeviceRowID IN (";
 		bool first = true;
 		for (uint64_t device_id : unique_devices)
 		{
@@ -2416,9 +2415,8 @@ bool CWebServer::CheckDeviceAccess(const WebEmSession& session, const std::vecto
 			ss << device_id;
 			first = false;
 		}
-		ss << ")";
 
-		std::vector<std::vector<std::string>> result = m_sql.safe_query(ss.str().c_str());
+		std::vector<std::vector<std::string>> result = m_sql.safe_query("SELECT COUNT(*) FROM SharedDevices WHERE (SharedUserID == '%lu') AND DeviceRowID IN (%s)", m_users[iUser].ID, ss.str().c_str());
 		// User must have access to ALL unique devices
 		return (!result.empty() && atoi(result[0][0].c_str()) == (int)unique_devices.size());
 	}
@@ -0,0 +1,210 @@
+#include "stdafx.h"
+#include "CalendarRollup.h"
+#include <sqlite3.h>
+
+namespace calendar_rollup
+{
+	namespace
+	{
+		constexpr const char *szCalendarTables[] = {
+			"Rain_Calendar", "Temperature_Calendar", "UV_Calendar", "Wind_Calendar", "Meter_Calendar", "MultiMeter_Calendar", "Percentage_Calendar", "Fan_Calendar",
+		};
+
+		// Count of a month that has to be recomputed
+		constexpr int64_t iDirty = -1;
+
+		// marks the month of a changed calendar row dirty for every field that has rollups for this device
+		std::string MarkDirtySQL(const std::string &table, const char *szRow)
+		{
+			return "INSERT OR REPLACE INTO Calendar_Rollup (SourceTable, DeviceRowID, Field, Period, Count) "
+			       "SELECT DISTINCT '" + table + "', " + szRow + ".DeviceRowID, Field, substr(" + szRow + ".Date,1,7), " + std::to_string(iDirty) +
+			       " FROM Calendar_Rollup WHERE (SourceTable='" + table + "') AND (DeviceRowID=" + szRow + ".DeviceRowID);";
+		}
+
+		std::string NextPeriod(const int year, const int month)
+		{
+			char szPeriod[20];
+			snprintf(szPeriod, sizeof(szPeriod), "%04d-%02d", (month == 12) ? year + 1 : year, (month == 12) ? 1 : month + 1);
+			return szPeriod;
+		}
+
+		bool ParsePeriod(const char *szPeriod, _tMonth &month)
+		{
+			return (szPeriod != nullptr) && (sscanf(szPeriod, "%d-%d", &month.year, &month.month) == 2);
+		}
+
+		// aggregates the calendar rows of [szFrom, szTo) per month, empty bounds are open
+		bool Aggregate(sqlite3 *db, const std::string &table, const uint64_t idx, const std::string &field, const std::string &szFrom, const std::string &szTo,
+			       std::vector<_tMonth> &months)
+		{
+			std::string szQuery = "SELECT substr(Date,1,7) AS p, MIN(" + field + "), MAX(" + field + "), SUM(" + field + "), COUNT(" + field + ") FROM " + table +
+					      " WHERE (DeviceRowID=?1)";
+			if (!szFrom.empty())
+				szQuery += " AND (Date>=?2)";
+			if (!szTo.empty())
+				szQuery += " AND (Date<?3)";
+			szQuery += " GROUP BY p ORDER BY p";
+
+			sqlite3_stmt *statement;
+			if (sqlite3_prepare_v2(db, szQuery.c_str(), -1, &statement, nullptr) != SQLITE_OK)
+				return false;
+			sqlite3_bind_int64(statement, 1, static_cast<sqlite3_int64>(idx));
+			if (!szFrom.empty())
+				sqlite3_bind_text(statement, 2, szFrom.c_str(), -1, SQLITE_TRANSIENT);
+			if (!szTo.empty())
+				sqlite3_bind_text(statement, 3, szTo.c_str(), -1, SQLITE_TRANSIENT);
+			int rc;
+			while ((rc = sqlite3_step(statement)) == SQLITE_ROW)
+			{
+				_tMonth month;
+				if (!ParsePeriod((const char *)sqlite3_column_text(statement, 0), month))
+					continue;
+				month.min = sqlite3_column_double(statement, 1);
+				month.max = sqlite3_column_double(statement, 2);
+				month.sum = sqlite3_column_double(statement, 3);
+				month.count = sqlite3_column_int64(statement, 4);
+				months.push_back(month);
+			}
+			sqlite3_finalize(statement);
+			return rc == SQLITE_DONE;
+		}
+
+		bool Store(sqlite3 *db, const std::string &table, const uint64_t idx, const std::string &field, const std::vector<_tMonth> &months)
+		{
+			sqlite3_stmt *statement;
+			if (sqlite3_prepare_v2(db, "INSERT OR REPLACE INTO Calendar_Rollup (SourceTable, DeviceRowID, Field, Period, Min, Max, Sum, Count) VALUES (?1,?2,?3,?4,?5,?6,?7,?8)", -1,
+					       &statement, nullptr) != SQLITE_OK)
+				return false;
+			bool bOK = true;
+			for (const auto &month : months)
+			{
+				char szPeriod[20];
+				snprintf(szPeriod, sizeof(szPeriod), "%04d-%02d", month.year, month.month);
+				sqlite3_bind_text(statement, 1, table.c_str(), -1, SQLITE_TRANSIENT);
+				sqlite3_bind_int64(statement, 2, static_cast<sqlite3_int64>(idx));
+				sqlite3_bind_text(statement, 3, field.c_str(), -1, SQLITE_TRANSIENT);
+				sqlite3_bind_text(statement, 4, szPeriod, -1, SQLITE_TRANSIENT);
+				sqlite3_bind_double(statement, 5, month.min);
+				sqlite3_bind_double(statement, 6, month.max);
+				sqlite3_bind_double(statement, 7, month.sum);
+				sqlite3_bind_int64(statement, 8, month.count);
+				if (sqlite3_step(statement) != SQLITE_DONE)
+					bOK = false;
+				sqlite3_reset(statement);
+			}
+			sqlite3_finalize(statement);
+			return bOK;
+		}
+
+		bool Remove(sqlite3 *db, const std::string &table, const uint64_t idx, const std::string &field, const std::string &szPeriod)
+		{
+			sqlite3_stmt *statement;
+			if (sqlite3_prepare_v2(db, "DELETE FROM Calendar_Rollup WHERE (SourceTable=?1) AND (DeviceRowID=?2) AND (Field=?3) AND (Period=?4)", -1, &statement, nullptr) != SQLITE_OK)
+				return false;
+			sqlite3_bind_text(statement, 1, table.c_str(), -1, SQLITE_TRANSIENT);
+			sqlite3_bind_int64(statement, 2, static_cast<sqlite3_int64>(idx));
+			sqlite3_bind_text(statement, 3, field.c_str(), -1, SQLITE_TRANSIENT);
+			sqlite3_bind_text(statement, 4, szPeriod.c_str(), -1, SQLITE_TRANSIENT);
+			bool bOK = (sqlite3_step(statement) == SQLITE_DONE);
+			sqlite3_finalize(statement);
+			return bOK;
+		}
+	} // namespace
+
+	std::vector<std::string> GetSchema()
+	{
+		std::vector<std::string> schema;
+		schema.emplace_back("CREATE TABLE IF NOT EXISTS [Calendar_Rollup] ("
+				    "[SourceTable] VARCHAR(30) NOT NULL, "
+				    "[DeviceRowID] BIGINT NOT NULL, "
+				    "[Field] VARCHAR(30) NOT NULL, "
+				    "[Period] CHAR(7) NOT NULL, "
+				    "[Min] FLOAT, "
+				    "[Max] FLOAT, "
+				    "[Sum] FLOAT, "
+				    "[Count] INTEGER DEFAULT 0, "
+				    "PRIMARY KEY (SourceTable, DeviceRowID, Field, Period));");
+		for (const std::string table : szCalendarTables)
+		{
+			schema.push_back("CREATE TRIGGER IF NOT EXISTS " + table + "_rollup_insert AFTER INSERT ON " + table + "\nBEGIN\n" + MarkDirtySQL(table, "NEW") + "\nEND;\n");
+			schema.push_back("CREATE TRIGGER IF NOT EXISTS " + table + "_rollup_update AFTER UPDATE ON " + table + "\nBEGIN\n" + MarkDirtySQL(table, "OLD") + "\n" +
+					 MarkDirtySQL(table, "NEW") + "\nEND;\n");
+			schema.push_back("CREATE TRIGGER IF NOT EXISTS " + table + "_rollup_delete AFTER DELETE ON " + table + "\nBEGIN\n" + MarkDirtySQL(table, "OLD") + "\nEND;\n");
+		}
+		return schema;
+	}
+
+	bool GetMonths(sqlite3 *db, const std::string &table, const uint64_t idx, const std::string &field, std::vector<_tMonth> &months)
+	{
+		months.clear();
+
+		sqlite3_stmt *statement;
+		if (sqlite3_prepare_v2(db, "SELECT Period, Min, Max, Sum, Count FROM Calendar_Rollup WHERE (SourceTable=?1) AND (DeviceRowID=?2) AND (Field=?3) ORDER BY Period", -1,
+				       &statement, nullptr) != SQLITE_OK)
+			return false;
+		sqlite3_bind_text(statement, 1, table.c_str(), -1, SQLITE_TRANSIENT);
+		sqlite3_bind_int64(statement, 2, static_cast<sqlite3_int64>(idx));
+		sqlite3_bind_text(statement, 3, field.c_str(), -1, SQLITE_TRANSIENT);
+		std::vector<_tMonth> stored;
+		while (sqlite3_step(statement) == SQLITE_ROW)
+		{
+			_tMonth month;
+			if (!ParsePeriod((const char *)sqlite3_column_text(statement, 0), month))
+				continue;
+			month.min = sqlite3_column_double(statement, 1);
+			month.max = sqlite3_column_double(statement, 2);
+			month.sum = sqlite3_column_double(statement, 3);
+			month.count = sqlite3_column_int64(statement, 4);
+			stored.push_back(month);
+		}
+		sqlite3_finalize(statement);
+
+		if (stored.empty())
+		{
+			// first request for this field, build all months at once
+			if (!Aggregate(db, table, idx, field, "", "", months))
+				return false;
+			if (months.empty())
+				return true;
+			sqlite3_exec(db, "SAVEPOINT calendar_rollup", nullptr, nullptr, nullptr);
+			bool bOK = Store(db, table, idx, field, months);
+			sqlite3_exec(db, "RELEASE calendar_rollup", nullptr, nullptr, nullptr);
+			return bOK;
+		}
+
+		bool bInSavepoint = false;
+		bool bOK = true;
+		for (auto &month : stored)
+		{
+			if (month.count != iDirty)
+			{
+				months.push_back(month);
+				continue;
+			}
+			if (!bInSavepoint)
+			{
+				sqlite3_exec(db, "SAVEPOINT calendar_rollup", nullptr, nullptr, nullptr);
+				bInSavepoint = true;
+			}
+			char szPeriod[20];
+			snprintf(szPeriod, sizeof(szPeriod), "%04d-%02d", month.year, month.month);
+			std::vector<_tMonth> fresh;
+			if (!Aggregate(db, table, idx, field, szPeriod, NextPeriod(month.year, month.month), fresh))
+			{
+				bOK = false;
+				break;
+			}
+			if (fresh.empty())
+			{
+				// all rows of this month were removed
+				bOK = Remove(db, table, idx, field, szPeriod) && bOK;
+				continue;
+			}
+			bOK = Store(db, table, idx, field, fresh) && bOK;
+			months.insert(months.end(), fresh.begin(), fresh.end());
+		}
+		if (bInSavepoint)
+			sqlite3_exec(db, "RELEASE calendar_rollup", nullptr, nullptr, nullptr);
+		return bOK;
+	}
+} // namespace calendar_rollup
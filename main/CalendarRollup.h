@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct sqlite3;
+
+// Monthly aggregates of the daily *_Calendar tables, kept in Calendar_Rollup.
+//
+// Rows are filled on first use per (table, device, field) and dropped again by triggers
+// whenever a calendar row of that month is inserted, changed or deleted, so a stale month
+// is recomputed (with an indexed range scan) on the next read.
+namespace calendar_rollup
+{
+	struct _tMonth
+	{
+		int year = 0;
+		int month = 0;
+		double min = 0;
+		double max = 0;
+		double sum = 0;
+		int64_t count = 0; // number of non NULL values
+	};
+
+	// Table and trigger definitions, executed at database open
+	std::vector<std::string> GetSchema();
+
+	// Fills months (ordered by date) for one field of a calendar table, caller has to serialize access to db
+	bool GetMonths(sqlite3 *db, const std::string &table, uint64_t idx, const std::string &field, std::vector<_tMonth> &months);
+} // namespace calendar_rollup
@@ -25,8 +25,16 @@ CCameraHandler::CCameraHandler()
 void CCameraHandler::ReloadCameras()
 {
 	std::vector<std::string> _AddedCameras;
+	// the feeds are stopped outside the lock, their relay threads may take a moment to end
+	std::map<uint64_t, std::shared_ptr<CCameraFeed>> oldFeeds;
 	std::lock_guard<std::mutex> l(m_mutex);
 	m_cameradevices.clear();
+	oldFeeds.swap(m_feeds);
+	m_iSnapshotMaxAge = 1000;
+	m_sql.GetPreferencesVar("CameraSnapshotMaxAge", m_iSnapshotMaxAge);
+	int nValue = 0;
+	m_sql.GetPreferencesVar("CameraRelay", nValue);
+	m_bRelay = (nValue != 0);
 	std::vector<std::vector<std::string> > result;
 
 	result = m_sql.safe_query("SELECT ID, Name, Address, Port, Username, Password, ImageURL, Protocol, AspectRatio FROM Cameras WHERE (Enabled == 1) ORDER BY ID");
@@ -164,10 +172,9 @@ int CCameraHandler::GetCameraAspectRatio(const uint64_t &CamID)
 
 bool CCameraHandler::TakeSnapshot(const std::string &CamID, std::vector<unsigned char> &camimage)
 {
-	if (is_number(CamID))
-		return TakeSnapshot(std::stoull(CamID), camimage);
-	else
-		return TakeSnapshot(CamID, camimage);
+	if (!is_number(CamID))
+		return false;
+	return TakeSnapshot(std::stoull(CamID), camimage);
 }
 
 bool CCameraHandler::TakeRaspberrySnapshotRaspiStill(std::vector<unsigned char>& camimage)
@@ -310,24 +317,85 @@ bool CCameraHandler::TakeUVCSnapshot(const std::string &device, std::vector<unsi
 
 bool CCameraHandler::TakeSnapshot(const uint64_t CamID, std::vector<unsigned char> &camimage)
 {
-	std::lock_guard<std::mutex> l(m_mutex);
-
-	cameraDevice *pCamera = GetCamera(CamID);
-	if (pCamera == nullptr)
+	CCameraFeed::frame_t frame = GetSnapshot(CamID);
+	if (!frame)
 		return false;
+	camimage = *frame;
+	return true;
+}
 
-	std::string szURL = GetCameraURL(pCamera);
-	szURL += "/" + pCamera->ImageURL;
-	stdreplace(szURL, "#USERNAME", pCamera->Username);
-	stdreplace(szURL, "#PASSWORD", pCamera->Password);
+CCameraFeed::frame_t CCameraHandler::GetSnapshot(const std::string &CamID)
+{
+	if (!is_number(CamID))
+		return nullptr;
+	return GetSnapshot(std::stoull(CamID));
+}
 
-	if (pCamera->ImageURL == "raspberry.cgi")
-		return TakeRaspberrySnapshot(camimage);
-	if (pCamera->ImageURL == "uvccapture.cgi")
-		return TakeUVCSnapshot(pCamera->Username, camimage);
+CCameraFeed::frame_t CCameraHandler::GetSnapshot(const uint64_t CamID)
+{
+	std::shared_ptr<CCameraFeed> pFeed;
+	int iMaxAge;
+	bool bRelay;
+	{
+		std::lock_guard<std::mutex> l(m_mutex);
+		auto itt = m_feeds.find(CamID);
+		if (itt != m_feeds.end())
+			pFeed = itt->second;
+		else
+		{
+			cameraDevice *pCamera = GetCamera(CamID);
+			if (pCamera == nullptr)
+				return nullptr;
+
+			std::string szURL = GetCameraURL(pCamera);
+			szURL += "/" + pCamera->ImageURL;
+			stdreplace(szURL, "#USERNAME", pCamera->Username);
+			stdreplace(szURL, "#PASSWORD", pCamera->Password);
+
+			// the camera is only asked by the feed, and without holding m_mutex
+			std::string szStreamURL;
+			CCameraFeed::fetch_t fetch;
+			if (pCamera->ImageURL == "raspberry.cgi")
+			{
+				fetch = [this](std::vector<unsigned char> &camimage) {
+					std::lock_guard<std::mutex> l(m_captureMutex);
+					return TakeRaspberrySnapshot(camimage);
+				};
+			}
+			else if (pCamera->ImageURL == "uvccapture.cgi")
+			{
+				std::string device = pCamera->Username;
+				fetch = [this, device](std::vector<unsigned char> &camimage) {
+					std::lock_guard<std::mutex> l(m_captureMutex);
+					return TakeUVCSnapshot(device, camimage);
+				};
+			}
+			else
+			{
+				szStreamURL = szURL;
+				fetch = [szURL](std::vector<unsigned char> &camimage) {
+					std::vector<std::string> ExtraHeaders;
+					return HTTPClient::GETBinary(szURL, ExtraHeaders, camimage, 5);
+				};
+			}
+			pFeed = std::make_shared<CCameraFeed>(pCamera->Name, fetch, szStreamURL);
+			m_feeds[CamID] = pFeed;
+		}
+		iMaxAge = m_iSnapshotMaxAge;
+		bRelay = m_bRelay;
+	}
+	return pFeed->GetFrame(iMaxAge, bRelay);
+}
 
-	std::vector<std::string> ExtraHeaders;
-	return HTTPClient::GETBinary(szURL, ExtraHeaders, camimage, 5);
+void CCameraHandler::StopRelays()
+{
+	std::map<uint64_t, std::shared_ptr<CCameraFeed>> feeds;
+	{
+		std::lock_guard<std::mutex> l(m_mutex);
+		feeds.swap(m_feeds);
+	}
+	for (auto &feed : feeds)
+		feed.second->StopRelay();
 }
 
 std::string WrapBase64(const std::string &szSource, const size_t lsize = 72)
@@ -517,16 +585,16 @@ namespace http {
 
 		void CWebServer::GetCameraSnapshot(WebEmSession & session, const request& req, reply & rep)
 		{
-			std::vector<unsigned char> camimage;
 			std::string idx = request::findValue(&req, "idx");
 			if (idx.empty())
 			{
 				return;
 			}
-			if (!m_mainworker.m_cameras.TakeSnapshot(idx, camimage)) {
+			CCameraFeed::frame_t camimage = m_mainworker.m_cameras.GetSnapshot(idx);
+			if (!camimage) {
 				return;
 			}
-			reply::set_content(&rep, camimage.begin(), camimage.end());
+			reply::set_content(&rep, camimage->begin(), camimage->end());
 			reply::add_header_attachment(&rep, "snapshot.jpg");
 		}
 
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include "CameraFeed.h"
 
 class CCameraHandler
 {
@@ -37,6 +38,11 @@ public:
 
   void ReloadCameras();
 
+  // cached/relayed snapshot, shared with the other viewers of the camera
+  CCameraFeed::frame_t GetSnapshot(const uint64_t CamID);
+  CCameraFeed::frame_t GetSnapshot(const std::string &CamID);
+  void StopRelays();
+
   bool TakeSnapshot(const uint64_t CamID, std::vector<unsigned char> &camimage);
   bool TakeSnapshot(const std::string &CamID, std::vector<unsigned char> &camimage);
   bool TakeRaspberrySnapshot(std::vector<unsigned char> &camimage);
@@ -61,5 +67,10 @@ private:
 	std::mutex m_mutex;
 	unsigned char m_seconds_counter;
 	std::vector<cameraDevice> m_cameradevices;
+	std::map<uint64_t, std::shared_ptr<CCameraFeed>> m_feeds;
+	int m_iSnapshotMaxAge = 1000; // ms
+	bool m_bRelay = false;
+	// raspistill/uvccapture share a temporary file
+	std::mutex m_captureMutex;
 };
 
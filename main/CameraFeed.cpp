@@ -0,0 +1,272 @@
+#include "stdafx.h"
+#include "CameraFeed.h"
+#include "Logger.h"
+#include "Helper.h"
+#include "../httpclient/HTTPClient.h"
+
+// how long a request waits for a snapshot that another request or the relay is getting
+#define SNAPSHOT_WAIT_TIMEOUT 10
+// the relay closes the stream when the camera has not been viewed for this long
+#define RELAY_IDLE_TIMEOUT 30
+#define RELAY_RETRY_DELAY 5
+#define MAX_FRAME_SIZE (16 * 1024 * 1024)
+
+CCameraFeed::CCameraFeed(const std::string &szName, const fetch_t &fetch, const std::string &szStreamURL)
+	: m_szName(szName)
+	, m_fetch(fetch)
+	, m_szStreamURL(szStreamURL)
+{
+}
+
+CCameraFeed::~CCameraFeed()
+{
+	StopRelay();
+}
+
+CCameraFeed::frame_t CCameraFeed::GetFrame(const int iMaxAgeMs, const bool bRelay)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	const auto tNow = std::chrono::steady_clock::now();
+	m_tLastRequest = tNow;
+	if (bRelay)
+		StartRelay();
+
+	if ((m_frame) && (tNow - m_tFrame <= std::chrono::milliseconds(iMaxAgeMs)))
+		return m_frame;
+
+	// share the snapshot that is already being fetched, or the next frame of the stream
+	if ((m_bFetching) || (m_bRelayStreaming))
+	{
+		const uint64_t iGeneration = m_iGeneration;
+		const bool bSharedFetch = m_bFetching;
+		m_cond.wait_for(lock, std::chrono::seconds(SNAPSHOT_WAIT_TIMEOUT),
+				[&] { return (m_iGeneration != iGeneration) || ((!m_bFetching) && (!m_bRelayStreaming)); });
+		if (m_iGeneration != iGeneration)
+			return m_frame;
+		if ((m_bFetching) || (m_bRelayStreaming) || (bSharedFetch))
+			return nullptr; // timed out, or the fetch failed
+		// the stream was lost, fetch a snapshot instead
+	}
+
+	m_bFetching = true;
+	lock.unlock();
+	std::vector<unsigned char> camimage;
+	bool bOK = m_fetch(camimage) && (!camimage.empty());
+	frame_t frame;
+	if (bOK)
+		frame = std::make_shared<const std::vector<unsigned char>>(std::move(camimage));
+	lock.lock();
+	m_bFetching = false;
+	if (bOK)
+	{
+		m_frame = frame;
+		m_tFrame = std::chrono::steady_clock::now();
+		m_iGeneration++;
+	}
+	m_cond.notify_all();
+	return frame;
+}
+
+void CCameraFeed::Publish(const frame_t &frame)
+{
+	std::lock_guard<std::mutex> l(m_mutex);
+	m_frame = frame;
+	m_tFrame = std::chrono::steady_clock::now();
+	m_iGeneration++;
+	m_cond.notify_all();
+}
+
+// m_mutex is held by the caller
+void CCameraFeed::StartRelay()
+{
+	if ((m_bRelayRunning) || (m_bRelayUnsupported) || (m_bStopRelay) || (m_szStreamURL.empty()))
+		return;
+	if (m_thread)
+	{
+		// ended after the camera was idle, it does not need the mutex anymore
+		m_thread->join();
+		m_thread.reset();
+	}
+	m_bRelayRunning = true;
+	m_bRelayStreaming = true;
+	m_thread = std::make_shared<std::thread>([this] { RelayThread(); });
+	SetThreadName(m_thread->native_handle(), "CameraRelay");
+}
+
+void CCameraFeed::StopRelay()
+{
+	{
+		std::lock_guard<std::mutex> l(m_mutex);
+		m_bStopRelay = true;
+		m_cond.notify_all();
+	}
+	if (m_thread)
+	{
+		m_thread->join();
+		m_thread.reset();
+	}
+}
+
+bool CCameraFeed::IsRelayIdle()
+{
+	std::lock_guard<std::mutex> l(m_mutex);
+	return (m_bStopRelay) || (std::chrono::steady_clock::now() - m_tLastRequest > std::chrono::seconds(RELAY_IDLE_TIMEOUT));
+}
+
+void CCameraFeed::RelayThread()
+{
+	_log.Log(LOG_STATUS, "Camera: %s, relay started", m_szName.c_str());
+	while (!IsRelayIdle())
+	{
+		{
+			std::lock_guard<std::mutex> l(m_mutex);
+			m_bRelayStreaming = true;
+		}
+		std::vector<std::string> ExtraHeaders;
+		std::vector<std::string> vHeaderData;
+		std::shared_ptr<CMultipartParser> parser;
+		bool bSingleImage = false;
+		std::vector<unsigned char> camimage;
+		bool bOK = HTTPClient::GETStream(m_szStreamURL, ExtraHeaders, vHeaderData, [&](const unsigned char *pData, size_t len) {
+			if ((!parser) && (!bSingleImage))
+			{
+				// the last Content-Type is the one of this response, earlier ones belong to redirects
+				std::string szContentType;
+				for (const auto &header : vHeaderData)
+				{
+					std::string szName = header.substr(0, 13);
+					stdlower(szName);
+					if (szName == "content-type:")
+					{
+						szContentType = header.substr(13);
+						stdstring_trim(szContentType);
+					}
+				}
+				std::string szBoundary = CMultipartParser::GetBoundary(szContentType);
+				if (szBoundary.empty())
+					bSingleImage = true;
+				else
+					parser = std::make_shared<CMultipartParser>(szBoundary);
+			}
+			if (bSingleImage)
+			{
+				camimage.insert(camimage.end(), pData, pData + len);
+				return (camimage.size() <= MAX_FRAME_SIZE);
+			}
+			if (!parser->Parse(pData, len, [this](const unsigned char *pPart, size_t partLen) {
+				    Publish(std::make_shared<const std::vector<unsigned char>>(pPart, pPart + partLen));
+			    }))
+			{
+				_log.Log(LOG_ERROR, "Camera: %s, invalid MJPEG stream", m_szName.c_str());
+				return false;
+			}
+			return !IsRelayIdle();
+		});
+		if ((bSingleImage) && (bOK) && (!camimage.empty()))
+			Publish(std::make_shared<const std::vector<unsigned char>>(std::move(camimage)));
+		{
+			std::lock_guard<std::mutex> l(m_mutex);
+			m_bRelayStreaming = false;
+			// a camera that only serves snapshots, these are fetched on request
+			m_bRelayUnsupported = bSingleImage;
+			m_cond.notify_all();
+		}
+		if (bSingleImage)
+		{
+			_log.Log(LOG_STATUS, "Camera: %s does not send an MJPEG stream, relay disabled", m_szName.c_str());
+			break;
+		}
+		if (IsRelayIdle())
+			break;
+		_log.Log(LOG_ERROR, "Camera: %s, relay stream lost, reconnecting in %d seconds", m_szName.c_str(), RELAY_RETRY_DELAY);
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_cond.wait_for(lock, std::chrono::seconds(RELAY_RETRY_DELAY), [this] { return m_bStopRelay; });
+	}
+	_log.Log(LOG_STATUS, "Camera: %s, relay stopped", m_szName.c_str());
+	std::lock_guard<std::mutex> l(m_mutex);
+	m_bRelayRunning = false;
+	m_bRelayStreaming = false;
+	m_cond.notify_all();
+}
+
+CMultipartParser::CMultipartParser(const std::string &szBoundary)
+{
+	// some cameras already put the leading dashes in the boundary parameter
+	m_szDelimiter = (szBoundary.compare(0, 2, "--") == 0) ? szBoundary : "--" + szBoundary;
+}
+
+std::string CMultipartParser::GetBoundary(const std::string &szContentType)
+{
+	std::string szLower = szContentType;
+	stdlower(szLower);
+	if (szLower.compare(0, 10, "multipart/") != 0)
+		return "";
+	size_t pos = szLower.find("boundary=");
+	if (pos == std::string::npos)
+		return "";
+	std::string szBoundary = szContentType.substr(pos + 9);
+	pos = szBoundary.find(';');
+	if (pos != std::string::npos)
+		szBoundary = szBoundary.substr(0, pos);
+	stdstring_trim(szBoundary);
+	if ((szBoundary.size() >= 2) && (szBoundary.front() == '"') && (szBoundary.back() == '"'))
+		szBoundary = szBoundary.substr(1, szBoundary.size() - 2);
+	return szBoundary;
+}
+
+bool CMultipartParser::Parse(const unsigned char *pData, const size_t len, const std::function<void(const unsigned char *pPart, size_t partLen)> &onPart)
+{
+	static const unsigned char szHeadersEnd[] = { '\r', '\n', '\r', '\n' };
+	m_buffer.insert(m_buffer.end(), pData, pData + len);
+	while (true)
+	{
+		if (m_iPartStart == std::string::npos)
+		{
+			// delimiter line, part headers and an empty line
+			auto itDelimiter = std::search(m_buffer.begin(), m_buffer.end(), m_szDelimiter.begin(), m_szDelimiter.end());
+			if (itDelimiter == m_buffer.end())
+				break;
+			auto itHeadersEnd = std::search(itDelimiter, m_buffer.end(), szHeadersEnd, szHeadersEnd + sizeof(szHeadersEnd));
+			if (itHeadersEnd == m_buffer.end())
+				break;
+			std::string szHeaders(itDelimiter + m_szDelimiter.size(), itHeadersEnd);
+			stdlower(szHeaders);
+			m_iPartLength = std::string::npos;
+			size_t pos = szHeaders.find("content-length:");
+			if (pos != std::string::npos)
+			{
+				long iLength = atol(szHeaders.c_str() + pos + 15);
+				if ((iLength < 0) || (iLength > MAX_FRAME_SIZE))
+					return false;
+				m_iPartLength = static_cast<size_t>(iLength);
+			}
+			m_iPartStart = (itHeadersEnd - m_buffer.begin()) + sizeof(szHeadersEnd);
+		}
+
+		size_t iPartEnd;
+		size_t iNext;
+		if (m_iPartLength != std::string::npos)
+		{
+			if (m_buffer.size() < m_iPartStart + m_iPartLength)
+				break;
+			iPartEnd = m_iPartStart + m_iPartLength;
+			iNext = iPartEnd;
+		}
+		else
+		{
+			// without a length the part ends at the next delimiter
+			auto itNext = std::search(m_buffer.begin() + m_iPartStart, m_buffer.end(), m_szDelimiter.begin(), m_szDelimiter.end());
+			if (itNext == m_buffer.end())
+				break;
+			iNext = itNext - m_buffer.begin();
+			iPartEnd = iNext;
+			if ((iPartEnd >= m_iPartStart + 2) && (m_buffer[iPartEnd - 2] == '\r') && (m_buffer[iPartEnd - 1] == '\n'))
+				iPartEnd -= 2;
+		}
+		if (iPartEnd > m_iPartStart)
+			onPart(&m_buffer[m_iPartStart], iPartEnd - m_iPartStart);
+		m_buffer.erase(m_buffer.begin(), m_buffer.begin() + iNext);
+		m_iPartStart = std::string::npos;
+	}
+	return (m_buffer.size() <= MAX_FRAME_SIZE);
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Snapshots of one camera, shared by everyone that views it
+//
+// A snapshot younger than the max age is served from the cache. When a new one is needed the first
+// request fetches it, concurrent requests wait for that fetch instead of asking the camera again.
+// In relay mode one stream (MJPEG, multipart/x-mixed-replace) is kept open to the camera while it is
+// being viewed, every frame of it replaces the cached snapshot. Frames are immutable and handed out
+// by pointer, so any number of viewers share the same buffer.
+class CCameraFeed
+{
+public:
+	typedef std::shared_ptr<const std::vector<unsigned char>> frame_t;
+	typedef std::function<bool(std::vector<unsigned char> &)> fetch_t;
+
+	// szStreamURL is empty for cameras that cannot be relayed (raspberry, uvc)
+	CCameraFeed(const std::string &szName, const fetch_t &fetch, const std::string &szStreamURL);
+	~CCameraFeed();
+	CCameraFeed(const CCameraFeed &) = delete;
+	CCameraFeed &operator=(const CCameraFeed &) = delete;
+
+	// nullptr when the camera did not deliver a snapshot
+	frame_t GetFrame(int iMaxAgeMs, bool bRelay);
+	void StopRelay();
+
+private:
+	void Publish(const frame_t &frame);
+	void StartRelay();
+	bool IsRelayIdle();
+	void RelayThread();
+
+	std::string m_szName;
+	fetch_t m_fetch;
+	std::string m_szStreamURL;
+
+	std::mutex m_mutex;
+	std::condition_variable m_cond;
+	frame_t m_frame;
+	std::chrono::steady_clock::time_point m_tFrame;
+	uint64_t m_iGeneration = 0;
+	bool m_bFetching = false;
+
+	std::shared_ptr<std::thread> m_thread;
+	std::chrono::steady_clock::time_point m_tLastRequest;
+	bool m_bRelayRunning = false;
+	bool m_bRelayStreaming = false;
+	bool m_bRelayUnsupported = false;
+	bool m_bStopRelay = false;
+};
+
+// Splits a multipart/x-mixed-replace stream into its parts
+class CMultipartParser
+{
+public:
+	explicit CMultipartParser(const std::string &szBoundary);
+	// onPart is called for every complete part, returns false when the stream is not valid
+	bool Parse(const unsigned char *pData, size_t len, const std::function<void(const unsigned char *pPart, size_t partLen)> &onPart);
+
+	// boundary of a multipart Content-Type, empty for any other content
+	static std::string GetBoundary(const std::string &szContentType);
+
+private:
+	std::string m_szDelimiter;
+	std::vector<unsigned char> m_buffer;
+	size_t m_iPartStart = std::string::npos;
+	size_t m_iPartLength = std::string::npos;
+};
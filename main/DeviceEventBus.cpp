@@ -0,0 +1,288 @@
+#include "stdafx.h"
+#include "DeviceEventBus.h"
+#include "Helper.h"
+#include "Logger.h"
+#include "Metrics.h"
+
+struct CDeviceEventBus::_tSubscriber
+{
+	std::string name;
+	_eQueuePolicy policy;
+	size_t capacity;
+	bool bWantsValue;
+	handler_t handler;
+	std::thread thread;
+
+	std::mutex mutex;
+	std::condition_variable cv;
+	bool bStop = false;
+	std::deque<_tDeviceEvent> queue;			     // ALL_EVENTS
+	std::deque<uint64_t> order;				     // LATEST_PER_DEVICE, devices in the order they were queued
+	std::unordered_map<uint64_t, _tDeviceEvent> latest; // LATEST_PER_DEVICE, queued event per device
+	std::chrono::steady_clock::time_point tLastDropLog;
+
+	size_t maxDepth = 0;
+	uint64_t published = 0;
+	uint64_t processed = 0;
+	uint64_t coalesced = 0;
+	uint64_t dropped = 0;
+	uint64_t lastLagUs = 0;
+	uint64_t totalLagUs = 0;
+	uint64_t maxLagUs = 0;
+	uint64_t totalHandlerUs = 0;
+	uint64_t maxHandlerUs = 0;
+
+	metrics::CGauge *pDepthMetric = nullptr;
+	metrics::CHistogram *pLagMetric = nullptr;
+
+	size_t Depth() const
+	{
+		return (policy == _eQueuePolicy::ALL_EVENTS) ? queue.size() : order.size();
+	}
+};
+
+CDeviceEventBus::subscription::subscription(subscription &&other) noexcept
+	: m_pBus(other.m_pBus)
+	, m_pSubscriber(std::move(other.m_pSubscriber))
+{
+	other.m_pBus = nullptr;
+}
+
+CDeviceEventBus::subscription &CDeviceEventBus::subscription::operator=(subscription &&other) noexcept
+{
+	if (this != &other)
+	{
+		m_pBus = other.m_pBus;
+		m_pSubscriber = std::move(other.m_pSubscriber);
+		other.m_pBus = nullptr;
+	}
+	return *this;
+}
+
+bool CDeviceEventBus::subscription::connected() const
+{
+	return (m_pSubscriber != nullptr);
+}
+
+void CDeviceEventBus::subscription::disconnect()
+{
+	if ((m_pBus == nullptr) || (m_pSubscriber == nullptr))
+		return;
+	m_pBus->Unsubscribe(m_pSubscriber);
+	m_pSubscriber.reset();
+	m_pBus = nullptr;
+}
+
+CDeviceEventBus::~CDeviceEventBus()
+{
+	std::vector<std::shared_ptr<_tSubscriber>> subscribers;
+	{
+		std::lock_guard<std::mutex> l(m_mutex);
+		subscribers = m_subscribers;
+	}
+	for (const auto &pSubscriber : subscribers)
+		Unsubscribe(pSubscriber);
+}
+
+CDeviceEventBus::subscription CDeviceEventBus::Subscribe(const std::string &name, const _eQueuePolicy policy, const size_t capacity, const bool bWantsValue, handler_t handler)
+{
+	auto pSubscriber = std::make_shared<_tSubscriber>();
+	pSubscriber->name = name;
+	pSubscriber->policy = policy;
+	pSubscriber->capacity = (capacity > 0) ? capacity : 1;
+	pSubscriber->bWantsValue = bWantsValue;
+	pSubscriber->handler = std::move(handler);
+	pSubscriber->pDepthMetric = &metrics::Registry().Gauge("domoticz_subscriber_queue_depth", "Device events waiting for a subscriber (push, websocket, MQTT)", "subscriber").Get(name);
+	pSubscriber->pLagMetric = &metrics::Registry().Histogram("domoticz_subscriber_lag_seconds", "Time between publishing a device event and a subscriber handling it", "subscriber").Get(name);
+	// the thread keeps its own reference, it may outlive the subscription when it unsubscribes itself
+	pSubscriber->thread = std::thread([pSubscriber] { Do_Work(pSubscriber.get()); });
+	SetThreadName(pSubscriber->thread.native_handle(), ("Bus_" + name).substr(0, 15).c_str());
+	{
+		std::lock_guard<std::mutex> l(m_mutex);
+		m_subscribers.push_back(pSubscriber);
+		if (bWantsValue)
+			m_iValueSubscribers++;
+	}
+
+	subscription result;
+	result.m_pBus = this;
+	result.m_pSubscriber = pSubscriber;
+	return result;
+}
+
+void CDeviceEventBus::Unsubscribe(const std::shared_ptr<_tSubscriber> &pSubscriber)
+{
+	{
+		std::lock_guard<std::mutex> l(m_mutex);
+		auto itt = std::find(m_subscribers.begin(), m_subscribers.end(), pSubscriber);
+		if (itt == m_subscribers.end())
+			return;
+		m_subscribers.erase(itt);
+		if (pSubscriber->bWantsValue)
+			m_iValueSubscribers--;
+	}
+	{
+		std::lock_guard<std::mutex> l(pSubscriber->mutex);
+		pSubscriber->bStop = true;
+	}
+	pSubscriber->cv.notify_one();
+	if (pSubscriber->thread.get_id() == std::this_thread::get_id())
+		pSubscriber->thread.detach();
+	else if (pSubscriber->thread.joinable())
+		pSubscriber->thread.join();
+}
+
+void CDeviceEventBus::SetOrigin(const uint64_t DeviceRowIdx, const int OriginHwdID)
+{
+	std::lock_guard<std::mutex> l(m_mutex);
+	m_origins[DeviceRowIdx] = OriginHwdID;
+}
+
+void CDeviceEventBus::Publish(_tDeviceEvent event)
+{
+	event.tPublished = std::chrono::steady_clock::now();
+	event.trace = tracer::Link();
+
+	std::lock_guard<std::mutex> l(m_mutex);
+	if ((event.type == _tDeviceEvent::_eType::RECEIVED) && (!m_origins.empty()))
+	{
+		auto itt = m_origins.find(event.DeviceRowIdx);
+		if (itt != m_origins.end())
+		{
+			event.OriginHwdID = itt->second;
+			m_origins.erase(itt);
+		}
+	}
+	for (const auto &pSubscriber : m_subscribers)
+	{
+		if (Enqueue(pSubscriber.get(), event))
+			pSubscriber->cv.notify_one();
+	}
+}
+
+bool CDeviceEventBus::Enqueue(_tSubscriber *pSubscriber, const _tDeviceEvent &event)
+{
+	std::lock_guard<std::mutex> l(pSubscriber->mutex);
+	pSubscriber->published++;
+
+	if (pSubscriber->policy == _eQueuePolicy::LATEST_PER_DEVICE)
+	{
+		auto itt = pSubscriber->latest.find(event.DeviceRowIdx);
+		if (itt != pSubscriber->latest.end())
+		{
+			// keep the time of the queued event so the lag shows how long the device has been waiting
+			auto tPublished = itt->second.tPublished;
+			itt->second = event;
+			itt->second.tPublished = tPublished;
+			pSubscriber->coalesced++;
+			return false;
+		}
+	}
+
+	if (pSubscriber->Depth() >= pSubscriber->capacity)
+	{
+		pSubscriber->dropped++;
+		if (event.tPublished - pSubscriber->tLastDropLog > std::chrono::minutes(1))
+		{
+			pSubscriber->tLastDropLog = event.tPublished;
+			_log.Log(LOG_ERROR, "DeviceEventBus: Queue of %s is full (%d), dropping device updates!", pSubscriber->name.c_str(), static_cast<int>(pSubscriber->capacity));
+		}
+		return false;
+	}
+
+	if (pSubscriber->policy == _eQueuePolicy::LATEST_PER_DEVICE)
+	{
+		pSubscriber->order.push_back(event.DeviceRowIdx);
+		pSubscriber->latest[event.DeviceRowIdx] = event;
+	}
+	else
+		pSubscriber->queue.push_back(event);
+	pSubscriber->maxDepth = std::max(pSubscriber->maxDepth, pSubscriber->Depth());
+	pSubscriber->pDepthMetric->Set(pSubscriber->Depth());
+	return true;
+}
+
+void CDeviceEventBus::Do_Work(_tSubscriber *pSubscriber)
+{
+	std::unique_lock<std::mutex> lock(pSubscriber->mutex);
+	while (true)
+	{
+		pSubscriber->cv.wait(lock, [pSubscriber] { return pSubscriber->bStop || (pSubscriber->Depth() != 0); });
+		if (pSubscriber->bStop)
+			break;
+
+		_tDeviceEvent event;
+		if (pSubscriber->policy == _eQueuePolicy::LATEST_PER_DEVICE)
+		{
+			auto itt = pSubscriber->latest.find(pSubscriber->order.front());
+			event = std::move(itt->second);
+			pSubscriber->latest.erase(itt);
+			pSubscriber->order.pop_front();
+		}
+		else
+		{
+			event = std::move(pSubscriber->queue.front());
+			pSubscriber->queue.pop_front();
+		}
+		pSubscriber->pDepthMetric->Set(pSubscriber->Depth());
+		lock.unlock();
+
+		tracer::CContext traceContext(event.trace, "bus queue");
+		tracer::CSpan span("push", pSubscriber->name.c_str());
+		auto tStart = std::chrono::steady_clock::now();
+		try
+		{
+			pSubscriber->handler(event);
+		}
+		catch (const std::exception &e)
+		{
+			_log.Log(LOG_ERROR, "DeviceEventBus: %s: %s", pSubscriber->name.c_str(), e.what());
+		}
+		auto tEnd = std::chrono::steady_clock::now();
+
+		lock.lock();
+		uint64_t lagUs = std::chrono::duration_cast<std::chrono::microseconds>(tStart - event.tPublished).count();
+		uint64_t handlerUs = std::chrono::duration_cast<std::chrono::microseconds>(tEnd - tStart).count();
+		pSubscriber->processed++;
+		pSubscriber->lastLagUs = lagUs;
+		pSubscriber->totalLagUs += lagUs;
+		pSubscriber->maxLagUs = std::max(pSubscriber->maxLagUs, lagUs);
+		pSubscriber->totalHandlerUs += handlerUs;
+		pSubscriber->maxHandlerUs = std::max(pSubscriber->maxHandlerUs, handlerUs);
+		pSubscriber->pLagMetric->Observe(lagUs);
+	}
+}
+
+std::vector<CDeviceEventBus::_tSubscriberStats> CDeviceEventBus::GetStats()
+{
+	std::vector<std::shared_ptr<_tSubscriber>> subscribers;
+	{
+		std::lock_guard<std::mutex> l(m_mutex);
+		subscribers = m_subscribers;
+	}
+	std::vector<_tSubscriberStats> result;
+	for (const auto &pSubscriber : subscribers)
+	{
+		std::lock_guard<std::mutex> l(pSubscriber->mutex);
+		_tSubscriberStats stats;
+		stats.name = pSubscriber->name;
+		stats.policy = pSubscriber->policy;
+		stats.capacity = pSubscriber->capacity;
+		stats.depth = pSubscriber->Depth();
+		stats.maxDepth = pSubscriber->maxDepth;
+		stats.published = pSubscriber->published;
+		stats.processed = pSubscriber->processed;
+		stats.coalesced = pSubscriber->coalesced;
+		stats.dropped = pSubscriber->dropped;
+		stats.lastLagUs = pSubscriber->lastLagUs;
+		if (pSubscriber->processed != 0)
+		{
+			stats.avgLagUs = pSubscriber->totalLagUs / pSubscriber->processed;
+			stats.avgHandlerUs = pSubscriber->totalHandlerUs / pSubscriber->processed;
+		}
+		stats.maxLagUs = pSubscriber->maxLagUs;
+		stats.maxHandlerUs = pSubscriber->maxHandlerUs;
+		result.push_back(stats);
+	}
+	return result;
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <ctime>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "Trace.h"
+
+// Device update notifications for the exporters (websocket, MQTT, push links)
+//
+// Publish only queues the event. Every subscriber has its own bounded queue and thread, so a slow
+// subscriber (a blocked MQTT publish, a websocket write) no longer holds up the RX thread or the other
+// subscribers. When a queue is full new events for that subscriber are dropped and counted.
+class CDeviceEventBus
+{
+public:
+	enum class _eQueuePolicy
+	{
+		ALL_EVENTS,	   // every event is handled
+		LATEST_PER_DEVICE, // a device that is already queued is not queued again (for subscribers that read the current state)
+	};
+	// DeviceStatus row right after the update. Subscribers run later, by then the row can hold a newer value
+	struct _tDeviceValue
+	{
+		std::string Name;
+		int devType = 0;
+		int devSubType = 0;
+		int SwitchType = 0;
+		int nValue = 0;
+		std::string sValue;
+		int LastLevel = 0;
+		std::string Color;
+		int SignalLevel = 0;
+		int BatteryLevel = 0;
+		std::string LastUpdate;
+		time_t tLastUpdate = 0;
+	};
+	struct _tDeviceEvent
+	{
+		enum class _eType
+		{
+			RECEIVED, // MainWorker::sOnDeviceReceived
+			UPDATED,  // MainWorker::sOnDeviceUpdate
+		};
+		_eType type;
+		int HwdID;
+		uint64_t DeviceRowIdx;
+		std::string DeviceName;
+		bool bHaveValue = false; // RECEIVED events, when a subscriber wants the value (see Subscribe)
+		_tDeviceValue value;
+		int OriginHwdID = -1; // hardware that caused the update by a command it received, see SetOrigin
+		std::chrono::steady_clock::time_point tPublished;
+		tracer::_tLink trace;
+	};
+	struct _tSubscriberStats
+	{
+		std::string name;
+		_eQueuePolicy policy;
+		size_t capacity = 0;
+		size_t depth = 0;
+		size_t maxDepth = 0;
+		uint64_t published = 0;
+		uint64_t processed = 0;
+		uint64_t coalesced = 0;
+		uint64_t dropped = 0;
+		uint64_t lastLagUs = 0; // time between publish and the start of the handler
+		uint64_t avgLagUs = 0;
+		uint64_t maxLagUs = 0;
+		uint64_t avgHandlerUs = 0;
+		uint64_t maxHandlerUs = 0;
+	};
+	typedef std::function<void(const _tDeviceEvent &event)> handler_t;
+
+	struct _tSubscriber;
+
+	// Like a signals2 connection it does not disconnect when it goes out of scope, the bus stops the remaining subscribers when it is destroyed
+	class subscription
+	{
+	public:
+		subscription() = default;
+		subscription(subscription &&other) noexcept;
+		subscription &operator=(subscription &&other) noexcept;
+		subscription(const subscription &) = delete;
+		subscription &operator=(const subscription &) = delete;
+
+		bool connected() const;
+		// Waits until the handler is no longer running, so do not call it while holding a lock the handler takes
+		void disconnect();
+
+	private:
+		friend class CDeviceEventBus;
+		CDeviceEventBus *m_pBus = nullptr;
+		std::shared_ptr<_tSubscriber> m_pSubscriber;
+	};
+
+	CDeviceEventBus() = default;
+	~CDeviceEventBus();
+	CDeviceEventBus(const CDeviceEventBus &) = delete;
+	CDeviceEventBus &operator=(const CDeviceEventBus &) = delete;
+
+	// bWantsValue: the subscriber uses _tDeviceEvent::value, without such a subscriber RECEIVED events are published
+	// without reading the row
+	subscription Subscribe(const std::string &name, _eQueuePolicy policy, size_t capacity, bool bWantsValue, handler_t handler);
+	bool WantsValue() const
+	{
+		return m_iValueSubscribers > 0;
+	}
+	void Publish(_tDeviceEvent event);
+	// the next RECEIVED event of this device is caused by this hardware (MQTT), so it can skip sending it back
+	void SetOrigin(uint64_t DeviceRowIdx, int OriginHwdID);
+	std::vector<_tSubscriberStats> GetStats();
+
+private:
+	void Unsubscribe(const std::shared_ptr<_tSubscriber> &pSubscriber);
+	static void Do_Work(_tSubscriber *pSubscriber);
+	static bool Enqueue(_tSubscriber *pSubscriber, const _tDeviceEvent &event);
+
+	std::mutex m_mutex;
+	std::vector<std::shared_ptr<_tSubscriber>> m_subscribers;
+	std::unordered_map<uint64_t, int> m_origins;
+	std::atomic<int> m_iValueSubscribers{ 0 };
+};
@@ -7,6 +7,7 @@
 #include "HTMLSanitizer.h"
 #include "SQLHelper.h"
 #include "Logger.h"
+#include "Metrics.h"
 #include "../hardware/hardwaretypes.h"
 #include "../hardware/Kodi.h"
 #include "../hardware/LogitechMediaServer.h"
@@ -121,9 +122,27 @@ const CEventSystem::_tJsonMap CEventSystem::JsonMap[] = {
 	{ nullptr, nullptr, JTYPE_STRING },
 };
 
+// Script file without its folder, or the name of a database event
+static const char *ScriptName(const std::string &filename)
+{
+	size_t pos = filename.find_last_of("/\\");
+	return (pos == std::string::npos) ? filename.c_str() : filename.c_str() + pos + 1;
+}
+
+// Run time per script file or database event, dzVents runs all its scripts as one dzVents.lua run
+static metrics::CHistogram &ScriptMetric(const std::string &filename)
+{
+	static auto &family = metrics::Registry().Histogram("domoticz_script_seconds", "Time spent running an event script", "script");
+	return family.Get(ScriptName(filename));
+}
+
 CEventSystem::CEventSystem()
 {
 	m_bEnabled = false;
+	metrics::Registry().AddCollector([this] {
+		static auto &depth = metrics::Registry().Gauge("domoticz_event_queue_depth", "Events waiting to be evaluated by the event system", "queue").Get("events");
+		depth.Set(m_eventqueue.size());
+	});
 }
 
 CEventSystem::~CEventSystem()
@@ -176,6 +195,7 @@ void CEventSystem::StopEventSystem()
 		m_thread->join();
 		m_thread.reset();
 	}
+	CdzVents::GetInstance()->m_storage.Flush(true);
 
 #ifdef ENABLE_PYTHON
 	Plugins::PythonEventsStop();
@@ -211,6 +231,7 @@ void CEventSystem::LoadEvents()
 	dzvents->m_dataDir = szUserDataFolder + "scripts/dzVents/data/";
 	dzvents->m_runtimeDir = szStartupFolder + "dzVents/runtime/";
 #endif
+	dzvents->m_generatedScriptsDir = dzv_Dir;
 	if (!mkdir_deep(m_lua_Dir.c_str(), 0755))
 	{
 		_log.Log(LOG_NORM, "%s: Created directory %s", __func__, m_lua_Dir.c_str());
@@ -303,6 +324,8 @@ void CEventSystem::LoadEvents()
 			}
 		}
 	}
+	dzvents->InvalidateScriptManifest();
+	dzvents->m_storage.Open(dzvents->m_dataDir);
 	m_mainworker.m_notificationsystem.Notify(Notification::DZ_ALLEVENTRESET, Notification::STATUS_INFO);
 	_log.Debug(DEBUG_EVENTSYSTEM, "EventSystem: Events (re)loaded");
 }
@@ -405,22 +428,19 @@ void CEventSystem::UpdateJsonMap(_tDeviceStatus &item, const uint64_t ulDevID)
 				switch (JsonMap[index].eType)
 				{
 				case JTYPE_STRING:
-					item.JsonMapString[index] = value;
+					item.JsonMapString.emplace_back(index, value);
 					break;
 				case JTYPE_FLOAT:
-					item.JsonMapFloat[index] = static_cast<float>(atof(value.c_str()));
+					item.JsonMapFloat.emplace_back(index, static_cast<float>(atof(value.c_str())));
 					break;
 				case JTYPE_INT:
-					item.JsonMapInt[index] = atoi(value.c_str());
+					item.JsonMapInt.emplace_back(index, atoi(value.c_str()));
 					break;
 				case JTYPE_BOOL:
-					if (value == "true")
-						item.JsonMapBool[index] = true;
-					else
-						item.JsonMapBool[index] = false;
+					item.JsonMapBool.emplace_back(index, (value == "true"));
 					break;
 				default:
-					item.JsonMapString[index] = "unknown_type";
+					item.JsonMapString.emplace_back(index, "unknown_type");
 					break;
 				}
 			}
@@ -429,6 +449,89 @@ void CEventSystem::UpdateJsonMap(_tDeviceStatus &item, const uint64_t ulDevID)
 	}
 }
 
+// Caller holds m_devicestatesMutex
+CEventSystem::_tDeviceStatus *CEventSystem::FindDeviceState(const uint64_t ulDevID)
+{
+	auto itt = m_deviceSlots.find(ulDevID);
+	if (itt == m_deviceSlots.end())
+		return nullptr;
+	return &m_devicestates[itt->second];
+}
+
+// Caller holds m_devicestatesMutex
+CEventSystem::_tDeviceStatus *CEventSystem::FindDeviceState(const std::string &devname)
+{
+	auto itt = m_deviceNameSlots.find(devname);
+	if (itt == m_deviceNameSlots.end())
+		return nullptr;
+	return &m_devicestates[itt->second];
+}
+
+// Caller holds m_devicestatesMutex (unique), returns the existing state when the device is already known
+CEventSystem::_tDeviceStatus &CEventSystem::InsertDeviceState(const uint64_t ulDevID, const std::string &devname)
+{
+	_tDeviceStatus *pItem = FindDeviceState(ulDevID);
+	if (pItem != nullptr)
+		return *pItem;
+
+	// new devices get the highest ID, so this is nearly always an append
+	auto itt = std::lower_bound(m_devicestates.begin(), m_devicestates.end(), ulDevID, [](const _tDeviceStatus &a, const uint64_t ID) { return a.ID < ID; });
+	bool bAppend = (itt == m_devicestates.end());
+	itt = m_devicestates.emplace(itt);
+	itt->ID = ulDevID;
+	itt->deviceName = devname;
+	if (bAppend)
+	{
+		m_deviceSlots[ulDevID] = static_cast<uint32_t>(m_devicestates.size() - 1);
+		m_deviceNameSlots[devname] = static_cast<uint32_t>(m_devicestates.size() - 1);
+	}
+	else
+		RebuildDeviceSlots();
+	return *itt;
+}
+
+// Caller holds m_devicestatesMutex (unique)
+void CEventSystem::EraseDeviceState(const uint64_t ulDevID)
+{
+	auto itt = m_deviceSlots.find(ulDevID);
+	if (itt == m_deviceSlots.end())
+		return;
+	m_devicestates.erase(m_devicestates.begin() + itt->second);
+	RebuildDeviceSlots();
+}
+
+// Caller holds m_devicestatesMutex (unique)
+void CEventSystem::RenameDeviceState(_tDeviceStatus &item, const std::string &devname)
+{
+	if (item.deviceName == devname)
+		return;
+	item.deviceName = devname;
+	RebuildDeviceSlots();
+}
+
+// Caller holds m_devicestatesMutex (unique)
+void CEventSystem::RebuildDeviceSlots()
+{
+	m_deviceSlots.clear();
+	m_deviceNameSlots.clear();
+	m_deviceSlots.reserve(m_devicestates.size());
+	m_deviceNameSlots.reserve(m_devicestates.size());
+	for (uint32_t slot = 0; slot < static_cast<uint32_t>(m_devicestates.size()); slot++)
+	{
+		m_deviceSlots[m_devicestates[slot].ID] = slot;
+		m_deviceNameSlots[m_devicestates[slot].deviceName] = slot;
+	}
+}
+
+// Caller holds m_measurementStatesMutex
+const CEventSystem::_tMeasurementState *CEventSystem::FindMeasurementState(const uint64_t ulDevID) const
+{
+	auto itt = std::lower_bound(m_measurementstates.begin(), m_measurementstates.end(), ulDevID, [](const _tMeasurementState &a, const uint64_t ID) { return a.ID < ID; });
+	if ((itt == m_measurementstates.end()) || (itt->ID != ulDevID))
+		return nullptr;
+	return &(*itt);
+}
+
 void CEventSystem::GetCurrentStates()
 {
 	std::vector<std::vector<std::string> > result;
@@ -437,6 +540,8 @@ void CEventSystem::GetCurrentStates()
 
 	_log.Log(LOG_STATUS, "EventSystem: reset all device statuses...");
 	m_devicestates.clear();
+	m_deviceSlots.clear();
+	m_deviceNameSlots.clear();
 
 	result = m_sql.safe_query(
 		"SELECT A.HardwareID, A.ID, A.Name, A.nValue, A.sValue, A.Type, A.SubType, A.SwitchType, A.LastUpdate, A.LastLevel, A.Options, A.Description, A.BatteryLevel, A.SignalLevel, A.Unit, A.DeviceID, A.Protected, A.AddjValue, A.AddjMulti, A.AddjValue2, A.AddjMulti2 "
@@ -444,22 +549,14 @@ void CEventSystem::GetCurrentStates()
 		"WHERE (A.Used = '1') AND (B.ID == A.HardwareID) AND (B.Enabled == 1)");
 	if (!result.empty())
 	{
-		std::map<uint64_t, _tDeviceStatus> m_devicestates_temp;
+		m_devicestates.reserve(result.size());
 		for (auto &sd : result)
 		{
 			_tDeviceStatus sitem;
 
-			// Fix string capacity to avoid map entry resizing
-			std::string l_deviceName;		l_deviceName.reserve(100);
-			std::string l_sValue;			l_sValue.reserve(200);
-			std::string l_nValueWording;	l_nValueWording.reserve(20);
-			std::string l_lastUpdate;		l_lastUpdate.reserve(30);
-			std::string l_description;		l_description.reserve(200);
-			std::string l_deviceID;			l_deviceID.reserve(25);
-
 			sitem.hardwareID = atoi(sd[0].c_str());
 			sitem.ID = std::stoull(sd[1]);
-			sitem.deviceName = l_deviceName.assign(sd[2]);
+			sitem.deviceName = sd[2];
 
 			sitem.devType = atoi(sd[5].c_str());
 			sitem.subType = atoi(sd[6].c_str());
@@ -488,19 +585,20 @@ void CEventSystem::GetCurrentStates()
 				}
 
 				sitem.nValue = atoi(sd[3].c_str());
-				sitem.sValue = l_sValue.assign(sd[4]);
+				sitem.sValue = sd[4];
+				StringSplitNumbers(sitem.sValue, ";", sitem.sValueNumbers);
 
 				sitem.switchtype = atoi(sd[7].c_str());
 				_eSwitchType switchtype = (_eSwitchType)sitem.switchtype;
 				std::map<std::string, std::string> options = m_sql.BuildDeviceOptions(sd[10]);
-				sitem.nValueWording = l_nValueWording.assign(nValueToWording(sitem.devType, sitem.subType, switchtype, sitem.nValue, sitem.sValue, options));
-				sitem.lastUpdate = l_lastUpdate.assign(sd[8]);
+				sitem.nValueWording = nValueToWording(sitem.devType, sitem.subType, switchtype, sitem.nValue, sitem.sValue, options);
+				sitem.lastUpdate = sd[8];
 				sitem.lastLevel = atoi(sd[9].c_str());
-				sitem.description = l_description.assign(sd[11]);
+				sitem.description = sd[11];
 				sitem.batteryLevel = atoi(sd[12].c_str());
 				sitem.signalLevel = atoi(sd[13].c_str());
 				sitem.unit = atoi(sd[14].c_str());
-				sitem.deviceID = l_deviceID.assign(sd[15]);
+				sitem.deviceID = sd[15];
 				sitem.protection = atoi(sd[16].c_str());
 				sitem.AddjValue = std::stof(sd[17]);
 				sitem.AddjMulti = std::stof(sd[18]);
@@ -511,15 +609,20 @@ void CEventSystem::GetCurrentStates()
 				{
 					UpdateJsonMap(sitem, sitem.ID);
 				}
-				m_devicestates_temp[sitem.ID] = sitem;
+				m_devicestates.push_back(std::move(sitem));
 			}
 			catch (const std::exception& e)
 			{
-				_log.Log(LOG_ERROR, "EventSystem: Exception in GetCurrentStates, probably invalid device data! (Device: %s): %s", l_deviceName.c_str(), e.what());
+				_log.Log(LOG_ERROR, "EventSystem: Exception in GetCurrentStates, probably invalid device data! (Device: %s): %s", sd[2].c_str(), e.what());
 			}
 		}
-		m_devicestates = m_devicestates_temp;
+		std::sort(m_devicestates.begin(), m_devicestates.end(), [](const _tDeviceStatus &a, const _tDeviceStatus &b) { return a.ID < b.ID; });
+		RebuildDeviceSlots();
 	}
+#ifdef ENABLE_PYTHON
+	m_bPythonResetDevices = true;
+	m_pythonDirtyDevices.clear();
+#endif
 	m_mainworker.m_notificationsystem.Notify(Notification::DZ_ALLDEVICESTATUSRESET, Notification::STATUS_INFO);
 }
 
@@ -544,6 +647,10 @@ void CEventSystem::GetCurrentUserVariables()
 			m_uservariables[uvitem.ID] = uvitem;
 		}
 	}
+#ifdef ENABLE_PYTHON
+	m_bPythonResetVariables = true;
+	m_pythonDirtyVariables.clear();
+#endif
 }
 
 void CEventSystem::GetCurrentScenesGroups()
@@ -588,46 +695,23 @@ void CEventSystem::GetCurrentScenesGroups()
 	}
 }
 
+// Caller holds m_measurementStatesMutex and m_devicestatesMutex
 void CEventSystem::GetCurrentMeasurementStates()
 {
-	m_tempValuesByName.clear();
-	m_dewValuesByName.clear();
-	m_humValuesByName.clear();
-	m_baroValuesByName.clear();
-	m_utilityValuesByName.clear();
-	m_rainValuesByName.clear();
-	m_rainLastHourValuesByName.clear();
-	m_uvValuesByName.clear();
-	m_weatherValuesByName.clear();
-	m_winddirValuesByName.clear();
-	m_windspeedValuesByName.clear();
-	m_windgustValuesByName.clear();
-
-	m_tempValuesByID.clear();
-	m_dewValuesByID.clear();
-	m_humValuesByID.clear();
-	m_baroValuesByID.clear();
-	m_utilityValuesByID.clear();
-	m_rainValuesByID.clear();
-	m_rainLastHourValuesByID.clear();
-	m_uvValuesByID.clear();
-	m_weatherValuesByID.clear();
-	m_winddirValuesByID.clear();
-	m_windspeedValuesByID.clear();
-	m_windgustValuesByID.clear();
-
-	boost::shared_lock<boost::shared_mutex> devicestatesMutexLock(m_devicestatesMutex);
+	m_measurementstates.clear();
+	std::fill(std::begin(m_measurementCount), std::end(m_measurementCount), 0);
 
 	//char szTmp[300];
 
-	for (const auto &state : m_devicestates)
+	for (uint32_t slot = 0; slot < static_cast<uint32_t>(m_devicestates.size()); slot++)
 	{
-		_tDeviceStatus sitem = state.second;
-		std::vector<std::string> splitresults;
-		StringSplit(sitem.sValue, ";", splitresults);
+		const _tDeviceStatus &sitem = m_devicestates[slot];
+		// sValue is split and converted when the state is updated, no need to parse it again for every device on every event
+		const std::vector<double> &values = sitem.sValueNumbers;
+		size_t nValues = values.size();
 
-		if ((state.second.devType == pTypeGeneral) && (state.second.subType == sTypeCounterIncremental))
-			splitresults.clear();
+		if ((sitem.devType == pTypeGeneral) && (sitem.subType == sTypeCounterIncremental))
+			nValues = 0;
 
 		float temp = 0;
 		int humidity = 0;
@@ -659,34 +743,34 @@ void CEventSystem::GetCurrentMeasurementStates()
 		{
 		case pTypeRego6XXTemp:
 		case pTypeTEMP:
-			if (!splitresults.empty())
+			if (nValues != 0)
 			{
-				temp = static_cast<float>(atof(splitresults[0].c_str()));
+				temp = static_cast<float>(values[0]);
 				isTemp = true;
 			}
 			break;
 		case pTypeSetpoint:
 			if (sitem.subType == sTypeThermTemperature)
 			{
-				if (!splitresults.empty())
+				if (nValues != 0)
 				{
-					temp = static_cast<float>(atof(splitresults[0].c_str()));
+					temp = static_cast<float>(values[0]);
 					isTemp = true;
 				}
 			}
 			else
 			{
-				if (!splitresults.empty())
+				if (nValues != 0)
 				{
-					utilityval = static_cast<float>(atof(splitresults[0].c_str()));
+					utilityval = static_cast<float>(values[0]);
 					isUtility = true;
 				}
 			}
 			break;
 		case pTypeThermostat1:
-			if (!splitresults.empty())
+			if (nValues != 0)
 			{
-				temp = static_cast<float>(atof(splitresults[0].c_str()));
+				temp = static_cast<float>(values[0]);
 				isTemp = true;
 			}
 			break;
@@ -695,10 +779,10 @@ void CEventSystem::GetCurrentMeasurementStates()
 			isHum = true;
 			break;
 		case pTypeTEMP_HUM:
-			if (splitresults.size() > 1)
+			if (nValues > 1)
 			{
-				temp = static_cast<float>(atof(splitresults[0].c_str()));
-				humidity = ground(atof(splitresults[1].c_str()));
+				temp = static_cast<float>(values[0]);
+				humidity = ground(values[1]);
 				dewpoint = (float)CalculateDewPoint(temp, humidity);
 				isTemp = true;
 				isHum = true;
@@ -706,13 +790,13 @@ void CEventSystem::GetCurrentMeasurementStates()
 			}
 			break;
 		case pTypeTEMP_HUM_BARO:
-			if (splitresults.size() < 5) {
+			if (nValues < 5) {
 				_log.Log(LOG_ERROR, "EventSystem: TEMP_HUM_BARO missing values : ID=%" PRIu64 ", sValue=%s", sitem.ID, sitem.sValue.c_str());
 				continue;
 			}
-			temp = static_cast<float>(atof(splitresults[0].c_str()));
-			humidity = ground(atof(splitresults[1].c_str()));
-			barometer = static_cast<float>(atof(splitresults[3].c_str()));
+			temp = static_cast<float>(values[0]);
+			humidity = ground(values[1]);
+			barometer = static_cast<float>(values[3]);
 			dewpoint = (float)CalculateDewPoint(temp, humidity);
 			isTemp = true;
 			isHum = true;
@@ -720,17 +804,20 @@ void CEventSystem::GetCurrentMeasurementStates()
 			isDew = true;
 			break;
 		case pTypeTEMP_BARO:
-			if (splitresults.size() > 1)
+			if (nValues > 1)
 			{
-				temp = static_cast<float>(atof(splitresults[0].c_str()));
-				barometer = static_cast<float>(atof(splitresults[1].c_str()));
+				temp = static_cast<float>(values[0]);
+				barometer = static_cast<float>(values[1]);
 				isTemp = true;
 				isBaro = true;
 			}
 			break;
 		case pTypeBARO:
-			barometer = static_cast<float>(atof(splitresults[0].c_str()));
-			isBaro = true;
+			if (nValues != 0)
+			{
+				barometer = static_cast<float>(values[0]);
+				isBaro = true;
+			}
 			break;
 		case pTypeRadiator1:
 			if (sitem.subType == sTypeSmartwares)
@@ -740,34 +827,34 @@ void CEventSystem::GetCurrentMeasurementStates()
 			}
 			break;
 		case pTypeUV:
-			if (splitresults.size() == 2)
+			if (nValues == 2)
 			{
-				uv = static_cast<float>(atof(splitresults[0].c_str()));
+				uv = static_cast<float>(values[0]);
 				isUV = true;
 				weatherval = uv;
 				isWeather = true;
 
 				if (sitem.subType == sTypeUV3)
 				{
-					temp = static_cast<float>(atof(splitresults[1].c_str()));
+					temp = static_cast<float>(values[1]);
 					isTemp = true;
 				}
 			}
 			break;
 		case pTypeWIND:
-			if (splitresults.size() == 6)
+			if (nValues == 6)
 			{
-				winddir = static_cast<float>(atof(splitresults[0].c_str()));
+				winddir = static_cast<float>(values[0]);
 				isWindDir = true;
 
 				if (sitem.subType != sTypeWIND5)
 				{
-					int intSpeed = atoi(splitresults[2].c_str());
+					int intSpeed = static_cast<int>(values[2]);
 					windspeed = float(intSpeed) * 0.1F; // m/s
 					isWindSpeed = true;
 				}
 
-				int intGust = atoi(splitresults[3].c_str());
+				int intGust = static_cast<int>(values[3]);
 				windgust = float(intGust) * 0.1F; // m/s
 				isWindGust = true;
 				if ((windgust == 0) && (windspeed != 0))
@@ -782,8 +869,8 @@ void CEventSystem::GetCurrentMeasurementStates()
 				}
 				if ((sitem.subType == sTypeWIND4) || (sitem.subType == sTypeWINDNoTemp))
 				{
-					temp = static_cast<float>(atof(splitresults[4].c_str()));
-					//chill = static_cast<float>(atof(splitresults[5].c_str()));
+					temp = static_cast<float>(values[4]);
+					//chill = static_cast<float>(values[5]);
 					isTemp = true;
 				}
 			}
@@ -791,9 +878,9 @@ void CEventSystem::GetCurrentMeasurementStates()
 		case pTypeRFXSensor:
 			if (sitem.subType == sTypeRFXSensorTemp)
 			{
-				if (!splitresults.empty())
+				if (nValues != 0)
 				{
-					temp = static_cast<float>(atof(splitresults[0].c_str()));
+					temp = static_cast<float>(values[0]);
 					isTemp = true;
 				}
 			}
@@ -808,57 +895,57 @@ void CEventSystem::GetCurrentMeasurementStates()
 			isUtility = true;
 			break;
 		case pTypeENERGY:
-			if (!splitresults.empty())
+			if (nValues != 0)
 			{
-				if (splitresults.size() == 2)
-					utilityval = static_cast<float>(atof(splitresults[1].c_str()));
+				if (nValues == 2)
+					utilityval = static_cast<float>(values[1]);
 				else
-					utilityval = static_cast<float>(atof(splitresults[0].c_str()));
+					utilityval = static_cast<float>(values[0]);
 				isUtility = true;
 			}
 			break;
 		case pTypePOWER:
-			if (!splitresults.empty())
+			if (nValues != 0)
 			{
-				utilityval = static_cast<float>(atof(splitresults[0].c_str()));
+				utilityval = static_cast<float>(values[0]);
 				isUtility = true;
 			}
 			break;
 		case pTypeUsage:
-			if (!splitresults.empty())
+			if (nValues != 0)
 			{
-				utilityval = static_cast<float>(atof(splitresults[0].c_str()));
+				utilityval = static_cast<float>(values[0]);
 				isUtility = true;
 			}
 			break;
 		case pTypeP1Power:
-			if (splitresults.size() == 6)
+			if (nValues == 6)
 			{
-				utilityval = static_cast<float>(atof(splitresults[4].c_str()));
+				utilityval = static_cast<float>(values[4]);
 				isUtility = true;
 			}
 			break;
 		case pTypeLux:
-			if (!splitresults.empty())
+			if (nValues != 0)
 			{
-				utilityval = static_cast<float>(atof(splitresults[0].c_str()));
+				utilityval = static_cast<float>(values[0]);
 				isUtility = true;
 			}
 			break;
 		case pTypeGeneral:
 		{
-			if (!splitresults.empty())
+			if (nValues != 0)
 			{
 				if ((sitem.subType == sTypeVisibility) || (sitem.subType == sTypeSolarRadiation))
 				{
-					utilityval = static_cast<float>(atof(splitresults[0].c_str()));
+					utilityval = static_cast<float>(values[0]);
 					isUtility = true;
 					weatherval = utilityval;
 					isWeather = true;
 				}
 				else if (sitem.subType == sTypeBaro)
 				{
-					barometer = static_cast<float>(atof(splitresults[0].c_str()));
+					barometer = static_cast<float>(values[0]);
 					isBaro = true;
 				}
 				else if ((sitem.subType == sTypeAlert)
@@ -873,7 +960,7 @@ void CEventSystem::GetCurrentMeasurementStates()
 					|| (sitem.subType == sTypeSoundLevel)
 					)
 				{
-					utilityval = static_cast<float>(atof(splitresults[0].c_str()));
+					utilityval = static_cast<float>(values[0]);
 					isUtility = true;
 				}
 			}
@@ -909,8 +996,8 @@ void CEventSystem::GetCurrentMeasurementStates()
 
 					float divider = m_sql.GetCounterDivider(int(metertype), int(sitem.devType), float(sitem.AddjValue2));
 
-					if (splitresults.size() > 1) {
-						float usage = std::stof(splitresults[1]);
+					if (nValues > 1) {
+						float usage = static_cast<float>(values[1]);
 						if (usage < 0.0) {
 							usage = 0.0;
 						}
@@ -923,10 +1010,10 @@ void CEventSystem::GetCurrentMeasurementStates()
 		}
 		break;
 		case pTypeRAIN:
-			if (splitresults.size() == 2)
+			if (nValues == 2)
 			{
 				rainmm = 0;
-				rainmmlasthour = static_cast<float>(atof(splitresults[0].c_str())) / 100.0F;
+				rainmmlasthour = static_cast<float>(values[0]) / 100.0F;
 				isRain = true;
 				weatherval = rainmmlasthour;
 				isWeather = true;
@@ -959,7 +1046,7 @@ void CEventSystem::GetCurrentMeasurementStates()
 					else
 					{
 						float total_min = static_cast<float>(atof(sd2[0].c_str()));
-						float total_max = static_cast<float>(atof(splitresults[1].c_str()));
+						float total_max = static_cast<float>(values[1]);
 						total_real = total_max - total_min;
 					}
 					rainmm = float(total_real);
@@ -1020,54 +1107,79 @@ void CEventSystem::GetCurrentMeasurementStates()
 			continue;
 		}
 
-		if (isTemp) {
-			m_tempValuesByName[sitem.deviceName] = temp;
-			m_tempValuesByID[sitem.ID] = temp;
-		}
-		if (isDew) {
-			m_dewValuesByName[sitem.deviceName] = dewpoint;
-			m_dewValuesByID[sitem.ID] = dewpoint;
-		}
-		if (isHum) {
-			m_humValuesByName[sitem.deviceName] = humidity;
-			m_humValuesByID[sitem.ID] = humidity;
-		}
-		if (isBaro) {
-			m_baroValuesByName[sitem.deviceName] = barometer;
-			m_baroValuesByID[sitem.ID] = barometer;
-		}
+		_tMeasurementState mstate;
+		mstate.ID = sitem.ID;
+		mstate.slot = slot;
+		mstate.fields = 0;
+		auto setValue = [&mstate, this](const _tMeasurementState::_eField field, const float value) {
+			mstate.fields |= (1 << field);
+			mstate.values[field] = value;
+			m_measurementCount[field]++;
+		};
+		if (isTemp)
+			setValue(_tMeasurementState::MS_TEMP, temp);
+		if (isDew)
+			setValue(_tMeasurementState::MS_DEW, dewpoint);
+		if (isHum)
+			setValue(_tMeasurementState::MS_HUM, static_cast<float>(humidity));
+		if (isBaro)
+			setValue(_tMeasurementState::MS_BARO, barometer);
 		if (isUtility)
+			setValue(_tMeasurementState::MS_UTILITY, utilityval);
+		if (isRain)
 		{
-			m_utilityValuesByName[sitem.deviceName] = utilityval;
-			m_utilityValuesByID[sitem.ID] = utilityval;
-		}
-		if (isRain) {
-			m_rainValuesByName[sitem.deviceName] = rainmm;
-			m_rainValuesByID[sitem.ID] = rainmm;
-			m_rainLastHourValuesByName[sitem.deviceName] = rainmmlasthour;
-			m_rainLastHourValuesByID[sitem.ID] = rainmmlasthour;
+			setValue(_tMeasurementState::MS_RAIN, rainmm);
+			setValue(_tMeasurementState::MS_RAINLASTHOUR, rainmmlasthour);
 		}
 		if (isWeather)
+			setValue(_tMeasurementState::MS_WEATHER, weatherval);
+		if (isUV)
+			setValue(_tMeasurementState::MS_UV, uv);
+		if (isWindDir)
+			setValue(_tMeasurementState::MS_WINDDIR, winddir);
+		if (isWindSpeed)
+			setValue(_tMeasurementState::MS_WINDSPEED, windspeed);
+		if (isWindGust)
+			setValue(_tMeasurementState::MS_WINDGUST, windgust);
+		if (mstate.fields != 0)
+			m_measurementstates.push_back(mstate);
+	}
+}
+
+// Lua table names of the measurement fields, by idx (Blockly) and by device name (Lua)
+static const char *szMeasurementTables[][2] = {
+	{ "temperaturedevice", "otherdevices_temperature" },
+	{ "dewpointdevice", "otherdevices_dewpoint" },
+	{ "humiditydevice", "otherdevices_humidity" },
+	{ "barometerdevice", "otherdevices_barometer" },
+	{ "utilitydevice", "otherdevices_utility" },
+	{ "raindevice", "otherdevices_rain" },
+	{ "rainlasthourdevice", "otherdevices_rain_lasthour" },
+	{ "uvdevice", "otherdevices_uv" },
+	{ "weatherdevice", "otherdevices_weather" },
+	{ "winddirdevice", "otherdevices_winddir" },
+	{ "windspeeddevice", "otherdevices_windspeed" },
+	{ "windgustdevice", "otherdevices_windgust" },
+};
+
+// Caller holds m_measurementStatesMutex and m_devicestatesMutex, exports the tables of the current measurement states by device name (Lua) or idx (Blockly)
+void CEventSystem::ExportMeasurementStatesToLua(lua_State *lua_state, const bool bByName)
+{
+	for (int field = 0; field < _tMeasurementState::MS_COUNT; field++)
+	{
+		if (m_measurementCount[field] == 0)
+			continue;
+		CLuaTable luaTable(lua_state, szMeasurementTables[field][bByName ? 1 : 0], (int)m_measurementCount[field], 0);
+		for (const auto &mstate : m_measurementstates)
 		{
-			m_weatherValuesByName[sitem.deviceName] = weatherval;
-			m_weatherValuesByID[sitem.ID] = weatherval;
-		}
-		if (isUV) {
-			m_uvValuesByName[sitem.deviceName] = uv;
-			m_uvValuesByID[sitem.ID] = uv;
-		}
-		if (isWindDir) {
-			m_winddirValuesByName[sitem.deviceName] = winddir;
-			m_winddirValuesByID[sitem.ID] = winddir;
-		}
-		if (isWindSpeed) {
-			m_windspeedValuesByName[sitem.deviceName] = windspeed;
-			m_windspeedValuesByID[sitem.ID] = windspeed;
-		}
-		if (isWindGust) {
-			m_windgustValuesByName[sitem.deviceName] = windgust;
-			m_windgustValuesByID[sitem.ID] = windgust;
+			if (!mstate.Has((_tMeasurementState::_eField)field))
+				continue;
+			if (bByName)
+				luaTable.AddNumber(m_devicestates[mstate.slot].deviceName, mstate.values[field]);
+			else
+				luaTable.AddNumber(mstate.ID, mstate.values[field]);
 		}
+		luaTable.Publish();
 	}
 }
 
@@ -1079,7 +1191,10 @@ void CEventSystem::RemoveSingleState(const uint64_t ulDevID, const _eReason reas
 	if (reason == REASON_DEVICE)
 	{
 		boost::unique_lock<boost::shared_mutex> devicestatesMutexLock(m_devicestatesMutex);
-		m_devicestates.erase(ulDevID);
+		EraseDeviceState(ulDevID);
+#ifdef ENABLE_PYTHON
+		m_pythonDirtyDevices.insert(ulDevID);
+#endif
 	}
 	else if (reason == REASON_SCENEGROUP)
 	{
@@ -1093,18 +1208,17 @@ void CEventSystem::WWWUpdateSingleState(const uint64_t ulDevID, const std::strin
 	if (!m_bEnabled)
 		return;
 
-	std::string l_deviceName;		l_deviceName.reserve(100);		l_deviceName.assign(devname);
-
 	if (reason == REASON_DEVICE)
 	{
 		boost::unique_lock<boost::shared_mutex> devicestatesMutexLock(m_devicestatesMutex);
 
-		auto itt = m_devicestates.find(ulDevID);
-		if (itt != m_devicestates.end())
+		_tDeviceStatus *pItem = FindDeviceState(ulDevID);
+		if (pItem != nullptr)
 		{
-			_tDeviceStatus replaceitem = itt->second;
-			replaceitem.deviceName = l_deviceName;
-			itt->second = replaceitem;
+			RenameDeviceState(*pItem, devname);
+#ifdef ENABLE_PYTHON
+			m_pythonDirtyDevices.insert(ulDevID);
+#endif
 		}
 	}
 	else if (reason == REASON_SCENEGROUP)
@@ -1113,9 +1227,7 @@ void CEventSystem::WWWUpdateSingleState(const uint64_t ulDevID, const std::strin
 		auto itt = m_scenesgroups.find(ulDevID);
 		if (itt != m_scenesgroups.end())
 		{
-			_tScenesGroups replaceitem = itt->second;
-			replaceitem.scenesgroupName = l_deviceName;
-			itt->second = replaceitem;
+			itt->second.scenesgroupName = devname;
 		}
 	}
 }
@@ -1298,6 +1410,9 @@ void CEventSystem::UpdateUserVariable(const uint64_t ulDevID, const std::string&
 
 	replaceitem.lastUpdate = lastUpdate;
 	itt->second = replaceitem;
+#ifdef ENABLE_PYTHON
+	m_pythonDirtyVariables.insert(ulDevID);
+#endif
 }
 
 void CEventSystem::UpdateBatteryLevel(const uint64_t ulDevID, const unsigned char batteryLevel)
@@ -1306,14 +1421,9 @@ void CEventSystem::UpdateBatteryLevel(const uint64_t ulDevID, const unsigned cha
 		return;
 
 	boost::unique_lock<boost::shared_mutex> devicestatesMutexLock(m_devicestatesMutex);
-	auto itt = m_devicestates.find(ulDevID);
-
-	if (itt != m_devicestates.end())
-	{
-		_tDeviceStatus replaceitem = itt->second;
-		replaceitem.batteryLevel = batteryLevel;
-		itt->second = replaceitem;
-	}
+	_tDeviceStatus *pItem = FindDeviceState(ulDevID);
+	if (pItem != nullptr)
+		pItem->batteryLevel = batteryLevel;
 }
 
 
@@ -1331,28 +1441,25 @@ std::string CEventSystem::UpdateSingleState(
 {
 	std::string nValueWording = nValueToWording(devType, subType, switchType, nValue, sValue, options);
 
-	// Fix string capacity to avoid map entry resizing
-	std::string l_deviceName;		l_deviceName.reserve(100);		l_deviceName.assign(devname);
-	std::string l_sValue;			l_sValue.reserve(200);			l_sValue.assign(sValue);
-	std::string l_nValueWording;	l_nValueWording.reserve(20);	l_nValueWording.assign(nValueWording);
-	std::string l_lastUpdate;		l_lastUpdate.reserve(30);		l_lastUpdate.assign(lastUpdate);
-
 	boost::unique_lock<boost::shared_mutex> devicestatesMutexLock(m_devicestatesMutex);
 
-	auto itt = m_devicestates.find(ulDevID);
-	if (itt != m_devicestates.end())
+	_tDeviceStatus *pItem = FindDeviceState(ulDevID);
+	if (pItem != nullptr)
 	{
-		_tDeviceStatus replaceitem = itt->second;
-		replaceitem.deviceName = l_deviceName;
+		_tDeviceStatus &replaceitem = *pItem;
+		RenameDeviceState(replaceitem, devname);
 		//replaceitem.batteryLevel = batteryLevel;
 		if (nValue != -1)
 			replaceitem.nValue = nValue;
 		if (!sValue.empty())
-			replaceitem.sValue = l_sValue;
-		if (!l_nValueWording.empty() || l_nValueWording != "-1")
-			replaceitem.nValueWording = l_nValueWording;
+		{
+			replaceitem.sValue = sValue;
+			StringSplitNumbers(replaceitem.sValue, ";", replaceitem.sValueNumbers);
+		}
+		if (!nValueWording.empty() || nValueWording != "-1")
+			replaceitem.nValueWording = nValueWording;
 		if (!lastUpdate.empty())
-			replaceitem.lastUpdate = l_lastUpdate;
+			replaceitem.lastUpdate = lastUpdate;
 		if (lastLevel != 255)
 			replaceitem.lastLevel = lastLevel;
 
@@ -1360,20 +1467,18 @@ std::string CEventSystem::UpdateSingleState(
 		{
 			UpdateJsonMap(replaceitem, ulDevID);
 		}
-		itt->second = replaceitem;
 	}
 	else
 	{
-		_tDeviceStatus newitem;
+		_tDeviceStatus &newitem = InsertDeviceState(ulDevID, devname);
 		newitem.devType = devType;
 		newitem.subType = subType;
 		newitem.switchtype = switchType;
-		newitem.ID = ulDevID;
-		newitem.deviceName = l_deviceName;
 		newitem.nValue = nValue;
-		newitem.sValue = l_sValue;
-		newitem.nValueWording = l_nValueWording;
-		newitem.lastUpdate = l_lastUpdate;
+		newitem.sValue = sValue;
+		StringSplitNumbers(newitem.sValue, ";", newitem.sValueNumbers);
+		newitem.nValueWording = nValueWording;
+		newitem.lastUpdate = lastUpdate;
 		newitem.lastLevel = lastLevel;
 		//newitem.batteryLevel = batteryLevel;
 
@@ -1381,8 +1486,10 @@ std::string CEventSystem::UpdateSingleState(
 		{
 			UpdateJsonMap(newitem, ulDevID);
 		}
-		m_devicestates[newitem.ID] = newitem;
 	}
+#ifdef ENABLE_PYTHON
+	m_pythonDirtyDevices.insert(ulDevID);
+#endif
 	return nValueWording;
 }
 
@@ -1444,6 +1551,9 @@ void CEventSystem::ProcessDevice(
 	if (!m_bEnabled)
 		return;
 
+	rxcapture::CStageTimer eventTimer(rxcapture::STAGE_EVENT);
+	tracer::CSpan span("ProcessDevice");
+
 	std::vector<std::vector<std::string> > result;
 	result = m_sql.safe_query("SELECT SwitchType, LastUpdate, LastLevel, Options, Name FROM DeviceStatus WHERE (ID==%" PRIu64 ")", ulDevID);
 	if (result.empty())
@@ -1495,22 +1605,20 @@ void CEventSystem::ProcessDevice(
 
 		item.nValueWording = UpdateSingleState(ulDevID, devname, nValue, osValue, devType, subType, switchType, "", 255, batterylevel, options);
 		boost::unique_lock<boost::shared_mutex> devicestatesMutexLock(m_devicestatesMutex);
-		auto itt = m_devicestates.find(ulDevID);
-		if (itt != m_devicestates.end())
+		_tDeviceStatus *pItem = FindDeviceState(ulDevID);
+		if (pItem != nullptr)
 		{
-			item.lastLevel = itt->second.lastLevel;
-			item.lastUpdate = itt->second.lastUpdate;
+			item.lastLevel = pItem->lastLevel;
+			item.lastUpdate = pItem->lastUpdate;
 			if (!m_sql.m_bDisableDzVentsSystem)
 			{
-				item.JsonMapString = itt->second.JsonMapString;
-				item.JsonMapInt = itt->second.JsonMapInt;
-				item.JsonMapFloat = itt->second.JsonMapFloat;
-				item.JsonMapBool = itt->second.JsonMapBool;
+				item.JsonMapString = pItem->JsonMapString;
+				item.JsonMapInt = pItem->JsonMapInt;
+				item.JsonMapFloat = pItem->JsonMapFloat;
+				item.JsonMapBool = pItem->JsonMapBool;
 			}
-			_tDeviceStatus replaceitem = itt->second;
-			replaceitem.lastUpdate = lastUpdate;
-			replaceitem.lastLevel = lastLevel;
-			itt->second = replaceitem;
+			pItem->lastUpdate = lastUpdate;
+			pItem->lastLevel = lastLevel;
 		}
 		m_eventqueue.push(item);
 	}
@@ -1524,6 +1632,8 @@ void CEventSystem::ProcessMinute()
 	item.reason = REASON_TIME;
 	item.id = 0;
 	m_eventqueue.push(item);
+
+	CdzVents::GetInstance()->m_storage.Flush(false);
 }
 
 void CEventSystem::EvaluateEvent(const std::vector<_tEventQueue> &items)
@@ -1531,6 +1641,10 @@ void CEventSystem::EvaluateEvent(const std::vector<_tEventQueue> &items)
 	if (!m_bEnabled)
 		return;
 
+	// a batch is traced as its first event
+	tracer::CContext traceContext(items.front().trace, "event queue");
+	tracer::CSpan span("EvaluateEvent");
+
 	std::vector<std::string> FileEntries;
 #ifdef ENABLE_PYTHON
 	std::vector<std::string> FileEntriesPython;
@@ -1574,7 +1688,7 @@ void CEventSystem::EvaluateEvent(const std::vector<_tEventQueue> &items)
 					boost::shared_lock<boost::shared_mutex> devicestatesMutexLock(m_devicestatesMutex);
 					for (const auto &state : m_devicestates)
 					{
-						std::string deviceName = SpaceToUnderscore(LowerCase(state.second.deviceName));
+						std::string deviceName = SpaceToUnderscore(LowerCase(state.deviceName));
 						if (filename.find("_device_" + deviceName + ".lua") != std::string::npos)
 						{
 							bDeviceFileFound = true;
@@ -1603,7 +1717,6 @@ void CEventSystem::EvaluateEvent(const std::vector<_tEventQueue> &items)
 		}
 
 #ifdef ENABLE_PYTHON
-		boost::unique_lock<boost::shared_mutex> uservariablesMutexLock(m_uservariablesMutex);
 		try
 		{
 			for (const auto &filename : FileEntriesPython)
@@ -1625,7 +1738,6 @@ void CEventSystem::EvaluateEvent(const std::vector<_tEventQueue> &items)
 		catch (...)
 		{
 		}
-		uservariablesMutexLock.unlock();
 
 		// Notify plugin system of security events if a plugin owns a Security Panel
 		if (item.reason == REASON_SECURITY)
@@ -1679,10 +1791,7 @@ lua_State *CEventSystem::CreateBlocklyLuaState()
 	CLuaTable luaTable(lua_state, "device", (int)m_devicestates.size(), 0);
 
 	for (const auto &state : m_devicestates)
-	{
-		_tDeviceStatus sitem = state.second;
-		luaTable.AddString(sitem.ID, sitem. nValueWording);
-	}
+		luaTable.AddString(state.ID, state.nValueWording);
 	luaTable.Publish();
 	devicestatesMutexLock.unlock();
 
@@ -1710,114 +1819,10 @@ lua_State *CEventSystem::CreateBlocklyLuaState()
 	uservariablesMutexLock.unlock();
 
 	std::lock_guard<std::mutex> measurementStatesMutexLock(m_measurementStatesMutex);
+	devicestatesMutexLock.lock();
 	GetCurrentMeasurementStates();
-
-	if (!m_tempValuesByID.empty())
-	{
-		luaTable.InitTable(lua_state, "temperaturedevice", (int)m_tempValuesByID.size(), 0);
-		for (const auto &temp : m_tempValuesByID)
-			luaTable.AddNumber(temp.first, temp.second);
-		luaTable.Publish();
-	}
-	if (!m_dewValuesByID.empty())
-	{
-		luaTable.InitTable(lua_state, "dewpointdevice", (int)m_dewValuesByID.size(), 0);
-		for (const auto &dew : m_dewValuesByID)
-		{
-			luaTable.AddNumber(dew.first, dew.second);
-		}
-		luaTable.Publish();
-	}
-	if (!m_humValuesByID.empty())
-	{
-		luaTable.InitTable(lua_state, "humiditydevice", (int)m_humValuesByID.size(), 0);
-		for (const auto &hum : m_humValuesByID)
-		{
-			luaTable.AddNumber(hum.first, hum.second);
-		}
-		luaTable.Publish();
-	}
-	if (!m_baroValuesByID.empty())
-	{
-		luaTable.InitTable(lua_state, "barometerdevice", (int)m_baroValuesByID.size(), 0);
-		for (const auto &baro : m_baroValuesByID)
-		{
-			luaTable.AddNumber(baro.first, baro.second);
-		}
-		luaTable.Publish();
-	}
-	if (!m_utilityValuesByID.empty())
-	{
-		luaTable.InitTable(lua_state, "utilitydevice", (int)m_utilityValuesByID.size(), 0);
-		for (const auto &utility : m_utilityValuesByID)
-		{
-			luaTable.AddNumber(utility.first, utility.second);
-		}
-		luaTable.Publish();
-	}
-	if (!m_weatherValuesByID.empty())
-	{
-		luaTable.InitTable(lua_state, "weatherdevice", (int)m_weatherValuesByID.size(), 0);
-		for (const auto &weather : m_weatherValuesByID)
-		{
-			luaTable.AddNumber(weather.first, weather.second);
-		}
-		luaTable.Publish();
-	}
-	if (!m_rainValuesByID.empty())
-	{
-		luaTable.InitTable(lua_state, "raindevice", (int)m_rainValuesByID.size(), 0);
-		for (const auto &rain : m_rainValuesByID)
-		{
-			luaTable.AddNumber(rain.first, rain.second);
-		}
-		luaTable.Publish();
-	}
-	if (!m_rainLastHourValuesByID.empty())
-	{
-		luaTable.InitTable(lua_state, "rainlasthourdevice", (int)m_rainLastHourValuesByID.size(), 0);
-		for (const auto &rainlh : m_rainLastHourValuesByID)
-		{
-			luaTable.AddNumber(rainlh.first, rainlh.second);
-		}
-		luaTable.Publish();
-	}
-	if (!m_uvValuesByID.empty())
-	{
-		luaTable.InitTable(lua_state, "uvdevice", (int)m_uvValuesByID.size(), 0);
-		for (const auto &uv : m_uvValuesByID)
-		{
-			luaTable.AddNumber(uv.first, uv.second);
-		}
-		luaTable.Publish();
-	}
-	if (!m_winddirValuesByID.empty())
-	{
-		luaTable.InitTable(lua_state, "winddirdevice", (int)m_winddirValuesByID.size(), 0);
-		for (const auto &winddir : m_winddirValuesByID)
-		{
-			luaTable.AddNumber(winddir.first, winddir.second);
-		}
-		luaTable.Publish();
-	}
-	if (!m_windspeedValuesByID.empty())
-	{
-		luaTable.InitTable(lua_state, "windspeeddevice", (int)m_windspeedValuesByID.size(), 0);
-		for (const auto &windspeed : m_windspeedValuesByID)
-		{
-			luaTable.AddNumber(windspeed.first, windspeed.second);
-		}
-		luaTable.Publish();
-	}
-	if (!m_windgustValuesByID.empty())
-	{
-		luaTable.InitTable(lua_state, "windgustdevice", (int)m_windgustValuesByID.size(), 0);
-		for (const auto &windgust : m_windgustValuesByID)
-		{
-			luaTable.AddNumber(windgust.first, windgust.second);
-		}
-		luaTable.Publish();
-	}
+	ExportMeasurementStatesToLua(lua_state, false);
+	devicestatesMutexLock.unlock();
 
 	lua_pushnumber(lua_state, (lua_Number)m_SecStatus);
 	lua_setglobal(lua_state, "securitystatus");
@@ -1917,7 +1922,6 @@ void CEventSystem::EvaluateDatabaseEvents(const _tEventQueue &item)
 				else if (event.Interpreter == "Python")
 				{
 #ifdef ENABLE_PYTHON
-					boost::unique_lock<boost::shared_mutex> uservariablesMutexLock(m_uservariablesMutex);
 					EvaluatePython(item, event.Name, event.Actions);
 #else
 					_log.Log(LOG_ERROR, "EventSystem: Error processing database scripts, Python not enabled");
@@ -1955,133 +1959,29 @@ std::string CEventSystem::ProcessVariableArgument(const std::string &Argument)
 	if (dindex == -1)
 		return ret;
 
-	if (Argument.find("temperaturedevice") == 0)
-	{
-		auto itt = m_tempValuesByID.find(dindex);
-		if (itt != m_tempValuesByID.end())
-		{
-			std::stringstream sstr;
-			sstr << itt->second;
-			return sstr.str();
-		}
-	}
-	else if (Argument.find("dewpointdevice") == 0)
-	{
-		auto itt = m_dewValuesByID.find(dindex);
-		if (itt != m_dewValuesByID.end())
-		{
-			std::stringstream sstr;
-			sstr << itt->second;
-			return sstr.str();
-		}
-	}
-	else if (Argument.find("humiditydevice") == 0)
+	if (Argument.find("variable") == 0)
 	{
-		auto itt = m_humValuesByID.find(dindex);
-		if (itt != m_humValuesByID.end())
-		{
-			std::stringstream sstr;
-			sstr << itt->second;
-			return sstr.str();
-		}
-	}
-	else if (Argument.find("barometerdevice") == 0)
-	{
-		auto itt = m_baroValuesByID.find(dindex);
-		if (itt != m_baroValuesByID.end())
-		{
-			std::stringstream sstr;
-			sstr << itt->second;
-			return sstr.str();
-		}
-	}
-	else if (Argument.find("utilitydevice") == 0)
-	{
-		auto itt = m_utilityValuesByID.find(dindex);
-		if (itt != m_utilityValuesByID.end())
-		{
-			std::stringstream sstr;
-			sstr << itt->second;
-			return sstr.str();
-		}
-	}
-	else if (Argument.find("weatherdevice") == 0)
-	{
-		auto itt = m_weatherValuesByID.find(dindex);
-		if (itt != m_weatherValuesByID.end())
-		{
-			std::stringstream sstr;
-			sstr << itt->second;
-			return sstr.str();
-		}
-	}
-	else if (Argument.find("raindevice") == 0)
-	{
-		auto itt = m_rainValuesByID.find(dindex);
-		if (itt != m_rainValuesByID.end())
-		{
-			std::stringstream sstr;
-			sstr << itt->second;
-			return sstr.str();
-		}
-	}
-	else if (Argument.find("rainlasthourdevice") == 0)
-	{
-		auto itt = m_rainLastHourValuesByID.find(dindex);
-		if (itt != m_rainLastHourValuesByID.end())
-		{
-			std::stringstream sstr;
-			sstr << itt->second;
-			return sstr.str();
-		}
-	}
-	else if (Argument.find("uvdevice") == 0)
-	{
-		auto itt = m_uvValuesByID.find(dindex);
-		if (itt != m_uvValuesByID.end())
-		{
-			std::stringstream sstr;
-			sstr << itt->second;
-			return sstr.str();
-		}
-	}
-	else if (Argument.find("winddirdevice") == 0)
-	{
-		auto itt = m_winddirValuesByID.find(dindex);
-		if (itt != m_winddirValuesByID.end())
-		{
-			std::stringstream sstr;
-			sstr << itt->second;
-			return sstr.str();
-		}
-	}
-	else if (Argument.find("windspeeddevice") == 0)
-	{
-		auto itt = m_windspeedValuesByID.find(dindex);
-		if (itt != m_windspeedValuesByID.end())
+		auto itt = m_uservariables.find(dindex);
+		if (itt != m_uservariables.end())
 		{
-			std::stringstream sstr;
-			sstr << itt->second;
-			return sstr.str();
+			return itt->second.variableValue;
 		}
+		return ret;
 	}
-	else if (Argument.find("windgustdevice") == 0)
+
+	std::lock_guard<std::mutex> measurementStatesMutexLock(m_measurementStatesMutex);
+	for (int field = 0; field < _tMeasurementState::MS_COUNT; field++)
 	{
-		auto itt = m_windgustValuesByID.find(dindex);
-		if (itt != m_windgustValuesByID.end())
+		if (Argument.find(szMeasurementTables[field][0]) != 0)
+			continue;
+		const _tMeasurementState *pState = FindMeasurementState(dindex);
+		if ((pState != nullptr) && pState->Has((_tMeasurementState::_eField)field))
 		{
 			std::stringstream sstr;
-			sstr << itt->second;
+			sstr << pState->values[field];
 			return sstr.str();
 		}
-	}
-	else if (Argument.find("variable") == 0)
-	{
-		auto itt = m_uservariables.find(dindex);
-		if (itt != m_uservariables.end())
-		{
-			return itt->second.variableValue;
-		}
+		break;
 	}
 
 	return ret;
@@ -2161,7 +2061,7 @@ bool CEventSystem::parseBlocklyActions(const _tEventItem &item)
 		if (deviceNo)
 		{
 			boost::shared_lock<boost::shared_mutex> devicestatesMutexLock(m_devicestatesMutex);
-			if (m_devicestates.count(deviceNo)) {
+			if (m_deviceSlots.count(deviceNo)) {
 				devicestatesMutexLock.unlock(); // Unlock to avoid recursive lock (because the ScheduleEvent function locks again)
 				if (ScheduleEvent(deviceNo, doWhat, false, item.Name, 0)) {
 					actionsDone = true;
@@ -2584,10 +2484,71 @@ bool CEventSystem::PythonScheduleEvent(const std::string &ID, const std::string
 
 void CEventSystem::EvaluatePython(const _tEventQueue &item, const std::string &filename, const std::string &PyString)
 {
-	Plugins::PythonEventsProcessPython(m_szReason[item.reason], filename, PyString, item.id, m_devicestates, m_uservariables, getSunRiseSunSetMinutes("Sunrise"),
-		getSunRiseSunSetMinutes("Sunset"));
+	metrics::CScopeTimer timer(ScriptMetric(filename));
+	tracer::CSpan span("python", ScriptName(filename));
+	std::lock_guard<std::mutex> pythonLock(m_pythonMutex);
+	// Only hand over what changed since the previous run, the Python side keeps its objects alive between runs
+	Plugins::_tPythonEventsDelta delta;
+	{
+		boost::unique_lock<boost::shared_mutex> devicestatesMutexLock(m_devicestatesMutex);
+		delta.bResetDevices = m_bPythonResetDevices;
+		if (m_bPythonResetDevices)
+		{
+			delta.devices = m_devicestates;
+		}
+		else
+		{
+			for (const auto &ID : m_pythonDirtyDevices)
+			{
+				const _tDeviceStatus *pItem = FindDeviceState(ID);
+				if (pItem != nullptr)
+					delta.devices.push_back(*pItem);
+				else
+					delta.removedDevices.push_back(ID);
+			}
+		}
+		const _tDeviceStatus *pItem = FindDeviceState(item.id);
+		if (pItem != nullptr)
+			delta.changedDeviceName = pItem->deviceName;
+		m_pythonDirtyDevices.clear();
+		m_bPythonResetDevices = false;
+	}
+
+	{
+		boost::unique_lock<boost::shared_mutex> uservariablesMutexLock(m_uservariablesMutex);
+		delta.bResetVariables = m_bPythonResetVariables;
+		if (m_bPythonResetVariables)
+		{
+			for (const auto &variable : m_uservariables)
+				delta.variables.push_back(variable.second);
+		}
+		else
+		{
+			for (const auto &ID : m_pythonDirtyVariables)
+			{
+				auto itt = m_uservariables.find(ID);
+				if (itt != m_uservariables.end())
+					delta.variables.push_back(itt->second);
+				else
+					delta.removedVariables.push_back(ID);
+			}
+		}
+		m_pythonDirtyVariables.clear();
+		m_bPythonResetVariables = false;
+	}
 
-	//Py_Finalize();
+	// the script runs without the states mutexes, it works on the copies in delta
+	if (!Plugins::PythonEventsProcessPython(m_szReason[item.reason], filename, PyString, item.id, delta, getSunRiseSunSetMinutes("Sunrise"),
+		getSunRiseSunSetMinutes("Sunset")))
+	{
+		// Changes were not applied, send the complete state with the next run
+		{
+			boost::unique_lock<boost::shared_mutex> devicestatesMutexLock(m_devicestatesMutex);
+			m_bPythonResetDevices = true;
+		}
+		boost::unique_lock<boost::shared_mutex> uservariablesMutexLock(m_uservariablesMutex);
+		m_bPythonResetVariables = true;
+	}
 }
 
 #endif // ENABLE_PYTHON
@@ -2596,44 +2557,38 @@ void CEventSystem::ExportDeviceStatesToLua(lua_State *lua_state, const _tEventQu
 {
 	boost::shared_lock<boost::shared_mutex> devicestatesMutexLock(m_devicestatesMutex);
 
-	CLuaTable luaTable(lua_state, "otherdevices", (int)m_devicestates.size(), 0);
-	for (const auto &state : m_devicestates)
+	// the triggering device gets the values of the event instead of its current state
+	const _tDeviceStatus *pChanged = nullptr;
+	if (item.reason == REASON_DEVICE)
 	{
-		luaTable.AddString(state.second.deviceName, (state.first == item.id && item.reason == REASON_DEVICE)
-								    ? item.nValueWording
-								    : state.second.nValueWording);
+		auto itt = m_deviceSlots.find(item.id);
+		if (itt != m_deviceSlots.end())
+			pChanged = &m_devicestates[itt->second];
 	}
+
+	CLuaTable luaTable(lua_state, "otherdevices", (int)m_devicestates.size(), 0);
+	for (const auto &state : m_devicestates)
+		luaTable.AddString(state.deviceName, (&state == pChanged) ? item.nValueWording : state.nValueWording);
 	luaTable.Publish();
 
 	luaTable.InitTable(lua_state, "otherdevices_lastupdate", (int)m_devicestates.size(), 0);
 	for (const auto &state : m_devicestates)
-	{
-		luaTable.AddString(state.second.deviceName,
-				   (state.first == item.id && item.reason == REASON_DEVICE) ? item.lastUpdate : state.second.lastUpdate);
-	}
+		luaTable.AddString(state.deviceName, (&state == pChanged) ? item.lastUpdate : state.lastUpdate);
 	luaTable.Publish();
 
 	luaTable.InitTable(lua_state, "otherdevices_svalues", (int)m_devicestates.size(), 0);
 	for (const auto &state : m_devicestates)
-	{
-		luaTable.AddString(state.second.deviceName,
-				   (state.first == item.id && item.reason == REASON_DEVICE) ? item.sValue : state.second.sValue);
-	}
+		luaTable.AddString(state.deviceName, (&state == pChanged) ? item.sValue : state.sValue);
 	luaTable.Publish();
 
 	luaTable.InitTable(lua_state, "otherdevices_idx", (int)m_devicestates.size(), 0);
 	for (const auto &state : m_devicestates)
-	{
-		luaTable.AddInteger(state.second.deviceName, state.second.ID);
-	}
+		luaTable.AddInteger(state.deviceName, state.ID);
 	luaTable.Publish();
 
 	luaTable.InitTable(lua_state, "otherdevices_lastlevel", (int)m_devicestates.size(), 0);
 	for (const auto &state : m_devicestates)
-	{
-		luaTable.AddNumber(state.second.deviceName,
-				   (state.first == item.id && item.reason == REASON_DEVICE) ? item.lastLevel : state.second.lastLevel);
-	}
+		luaTable.AddNumber(state.deviceName, (&state == pChanged) ? item.lastLevel : state.lastLevel);
 	luaTable.Publish();
 }
 
@@ -2646,7 +2601,9 @@ void CEventSystem::EvaluateLuaClassic(lua_State *lua_state, const _tEventQueue &
 
 	{
 		std::lock_guard<std::mutex> measurementStatesMutexLock(m_measurementStatesMutex);
+		boost::shared_lock<boost::shared_mutex> devicestatesMutexLock(m_devicestatesMutex);
 		GetCurrentMeasurementStates();
+		ExportMeasurementStatesToLua(lua_state, true);
 
 		float thisDeviceTemp = 0;
 		float thisDeviceDew = 0;
@@ -2656,164 +2613,24 @@ void CEventSystem::EvaluateLuaClassic(lua_State *lua_state, const _tEventQueue &
 		unsigned char thisDeviceHum = 0;
 		float thisDeviceBaro = 0;
 		float thisDeviceUtility = 0;
-		//float thisDeviceWindDir = 0;
-		//float thisDeviceWindSpeed = 0;
-		//float thisDeviceWindGust = 0;
 		float thisDeviceWeather = 0;
 
-		if (!m_tempValuesByName.empty())
-		{
-			CLuaTable luaTable(lua_state, "otherdevices_temperature", (int)m_tempValuesByName.size(), 0);
-			for (const auto &temp : m_tempValuesByName)
-			{
-				luaTable.AddNumber(temp.first, temp.second);
-				if (temp.first == item.devname)
-				{
-					thisDeviceTemp = temp.second;
-				}
-			}
-			luaTable.Publish();
-		}
-		if (!m_dewValuesByName.empty())
-		{
-			CLuaTable luaTable(lua_state, "otherdevices_dewpoint", (int)m_dewValuesByName.size(), 0);
-			for (const auto &dew : m_dewValuesByName)
-			{
-				luaTable.AddNumber(dew.first, dew.second);
-				if (dew.first == item.devname)
-				{
-					thisDeviceDew = dew.second;
-				}
-			}
-			luaTable.Publish();
-		}
-		if (!m_humValuesByName.empty())
-		{
-			CLuaTable luaTable(lua_state, "otherdevices_humidity", (int)m_humValuesByName.size(), 0);
-			for (const auto &hum : m_humValuesByName)
-			{
-				luaTable.AddNumber(hum.first, hum.second);
-				if (hum.first == item.devname)
-				{
-					thisDeviceHum = hum.second;
-				}
-			}
-			luaTable.Publish();
-		}
-		if (!m_baroValuesByName.empty())
-		{
-			CLuaTable luaTable(lua_state, "otherdevices_barometer", (int)m_baroValuesByName.size(), 0);
-			for (const auto &baro : m_baroValuesByName)
-			{
-				luaTable.AddNumber(baro.first, baro.second);
-				if (baro.first == item.devname)
-				{
-					thisDeviceBaro = (float)baro.second;
-				}
-			}
-			luaTable.Publish();
-		}
-		if (!m_utilityValuesByName.empty())
-		{
-			CLuaTable luaTable(lua_state, "otherdevices_utility", (int)m_utilityValuesByName.size(), 0);
-			for (const auto &utility : m_utilityValuesByName)
-			{
-				luaTable.AddNumber(utility.first, utility.second);
-				if (utility.first == item.devname)
-				{
-					thisDeviceUtility = utility.second;
-				}
-			}
-			luaTable.Publish();
-		}
-		if (!m_rainValuesByName.empty())
-		{
-			CLuaTable luaTable(lua_state, "otherdevices_rain", (int)m_rainValuesByName.size(), 0);
-			for (const auto &rain : m_rainValuesByName)
-			{
-				luaTable.AddNumber(rain.first, rain.second);
-				if (rain.first == item.devname)
-				{
-					thisDeviceRain = rain.second;
-				}
-			}
-			luaTable.Publish();
-		}
-		if (!m_rainLastHourValuesByName.empty())
-		{
-			CLuaTable luaTable(lua_state, "otherdevices_rain_lasthour", (int)m_rainLastHourValuesByName.size(), 0);
-			for (const auto &rainlh : m_rainLastHourValuesByName)
-			{
-				luaTable.AddNumber(rainlh.first, rainlh.second);
-				if (rainlh.first == item.devname)
-				{
-					thisDeviceRainLastHour = rainlh.second;
-				}
-			}
-			luaTable.Publish();
-		}
-		if (!m_uvValuesByName.empty())
-		{
-			CLuaTable luaTable(lua_state, "otherdevices_uv", (int)m_uvValuesByName.size(), 0);
-			for (const auto &uv : m_uvValuesByName)
-			{
-				luaTable.AddNumber(uv.first, uv.second);
-				if (uv.first == item.devname)
-				{
-					thisDeviceUV = uv.second;
-				}
-			}
-			luaTable.Publish();
-		}
-		if (!m_winddirValuesByName.empty())
-		{
-			CLuaTable luaTable(lua_state, "otherdevices_winddir", (int)m_winddirValuesByName.size(), 0);
-			for (const auto &winddir : m_winddirValuesByName)
-			{
-				luaTable.AddNumber(winddir.first, winddir.second);
-				// if (winddir.first == item.devname) {
-				// thisDeviceWindDir = winddir.second;
-				//}
-			}
-			luaTable.Publish();
-		}
-		if (!m_windspeedValuesByName.empty())
-		{
-			CLuaTable luaTable(lua_state, "otherdevices_windspeed", (int)m_windspeedValuesByName.size(), 0);
-			for (const auto &windspeed : m_windspeedValuesByName)
-			{
-				luaTable.AddNumber(windspeed.first, windspeed.second);
-				// if (windspeed.first == item.devname) {
-				// thisDeviceWindSpeed = windspeed.second;
-				//}
-			}
-			luaTable.Publish();
-		}
-		if (!m_windgustValuesByName.empty())
+		const _tDeviceStatus *pDevice = FindDeviceState(item.devname);
+		const _tMeasurementState *pState = (pDevice != nullptr) ? FindMeasurementState(pDevice->ID) : nullptr;
+		if (pState != nullptr)
 		{
-			CLuaTable luaTable(lua_state, "otherdevices_windgust", (int)m_windgustValuesByName.size(), 0);
-			for (const auto &windgust : m_windgustValuesByName)
-			{
-				luaTable.AddNumber(windgust.first, windgust.second);
-				// if (windgust.first == item.devname) {
-				// thisDeviceWindGust = windgust.second;
-				//}
-			}
-			luaTable.Publish();
-		}
-		if (!m_weatherValuesByName.empty())
-		{
-			CLuaTable luaTable(lua_state, "otherdevices_weather", (int)m_weatherValuesByName.size(), 0);
-			for (const auto &weather : m_weatherValuesByName)
-			{
-				luaTable.AddNumber(weather.first, weather.second);
-				if (weather.first == item.devname)
-				{
-					thisDeviceWeather = weather.second;
-				}
-			}
-			luaTable.Publish();
+			auto getValue = [pState](const _tMeasurementState::_eField field) { return pState->Has(field) ? pState->values[field] : 0.0F; };
+			thisDeviceTemp = getValue(_tMeasurementState::MS_TEMP);
+			thisDeviceDew = getValue(_tMeasurementState::MS_DEW);
+			thisDeviceRain = getValue(_tMeasurementState::MS_RAIN);
+			thisDeviceRainLastHour = getValue(_tMeasurementState::MS_RAINLASTHOUR);
+			thisDeviceUV = getValue(_tMeasurementState::MS_UV);
+			thisDeviceHum = static_cast<unsigned char>(getValue(_tMeasurementState::MS_HUM));
+			thisDeviceBaro = getValue(_tMeasurementState::MS_BARO);
+			thisDeviceUtility = getValue(_tMeasurementState::MS_UTILITY);
+			thisDeviceWeather = getValue(_tMeasurementState::MS_WEATHER);
 		}
+		devicestatesMutexLock.unlock();
 
 		if (item.reason == REASON_DEVICE)
 		{
@@ -2972,6 +2789,8 @@ void CEventSystem::EvaluateLua(const _tEventQueue &item, const std::string &file
 void CEventSystem::EvaluateLua(const std::vector<_tEventQueue> &items, const std::string &filename, const std::string &LuaString)
 {
 	std::lock_guard<std::mutex> l(luaMutex);
+	metrics::CScopeTimer timer(ScriptMetric(filename));
+	tracer::CSpan span("lua", ScriptName(filename));
 
 	lua_State *lua_state;
 	lua_state = luaL_newstate();
@@ -2989,11 +2808,7 @@ void CEventSystem::EvaluateLua(const std::vector<_tEventQueue> &items, const std
 		lua_settop(lua_state, 0);
 	}
 
-	lua_pushcfunction(lua_state, l_domoticz_applyJsonPath);
-	lua_setglobal(lua_state, "domoticz_applyJsonPath");
-
-	lua_pushcfunction(lua_state, l_domoticz_applyXPath);
-	lua_setglobal(lua_state, "domoticz_applyXPath");
+	RegisterDocumentFunctions(lua_state);
 
 	_log.Debug(DEBUG_EVENTSYSTEM, "EventSystem: script %s trigger (%s)", m_szReason[items[0].reason].c_str(), filename.c_str());
 
@@ -3410,21 +3225,25 @@ void CEventSystem::WriteToLog(const std::string &devNameNoQuotes, const std::str
 	else if (devNameNoQuotes == "WriteToLogDeviceVariable")
 	{
 		boost::shared_lock<boost::shared_mutex> devicestatesMutexLock(m_devicestatesMutex);
-		int devIdx = atoi(doWhat.c_str());
-		if (m_devicestates[devIdx].devType == pTypeHUM)
+		const _tDeviceStatus *pItem = FindDeviceState(static_cast<uint64_t>(atoi(doWhat.c_str())));
+		if (pItem == nullptr)
+			return;
+		if (pItem->devType == pTypeHUM)
 		{
 			//nValue devices
-			_log.Log(LOG_STATUS, "%d", m_devicestates[devIdx].nValue);
+			_log.Log(LOG_STATUS, "%d", pItem->nValue);
 		}
 		else
 		{
-			_log.Log(LOG_STATUS, "%s", m_devicestates[devIdx].sValue.c_str());
+			_log.Log(LOG_STATUS, "%s", pItem->sValue.c_str());
 		}
 	}
 	else if (devNameNoQuotes == "WriteToLogSwitch")
 	{
 		boost::shared_lock<boost::shared_mutex> devicestatesMutexLock(m_devicestatesMutex);
-		_log.Log(LOG_STATUS, "%s", m_devicestates[atoi(doWhat.c_str())].nValueWording.c_str());
+		const _tDeviceStatus *pItem = FindDeviceState(static_cast<uint64_t>(atoi(doWhat.c_str())));
+		if (pItem != nullptr)
+			_log.Log(LOG_STATUS, "%s", pItem->nValueWording.c_str());
 	}
 }
 
@@ -3486,8 +3305,9 @@ bool CEventSystem::ScheduleEvent(std::string deviceName, const std::string &Acti
 bool CEventSystem::ScheduleEvent(int deviceID, const std::string &Action, bool isScene, const std::string &eventName, int sceneType)
 {
 	boost::shared_lock<boost::shared_mutex> devicestatesMutexLock(m_devicestatesMutex);
-	std::string previousState = m_devicestates[deviceID].nValueWording;
-	int previousLevel = calculateDimLevel(deviceID, m_devicestates[deviceID].lastLevel);
+	const _tDeviceStatus *pItem = FindDeviceState(static_cast<uint64_t>(deviceID));
+	std::string previousState = (pItem != nullptr) ? pItem->nValueWording : "";
+	int previousLevel = calculateDimLevel(deviceID, (pItem != nullptr) ? pItem->lastLevel : 0);
 	int level = 0;
 	devicestatesMutexLock.unlock();
 
@@ -3905,9 +3725,7 @@ void CEventSystem::WWWGetItemStates(std::vector<_tDeviceStatus> &iStates)
 
 	boost::shared_lock<boost::shared_mutex> devicestatesMutexLock(m_devicestatesMutex);
 
-	iStates.clear();
-	std::transform(m_devicestates.begin(), m_devicestates.end(), std::back_inserter(iStates),
-		[](const std::pair<const uint64_t, CEventSystem::_tDeviceStatus> &m) { return m.second; });
+	iStates = m_devicestates;
 }
 
 int CEventSystem::getSunRiseSunSetMinutes(const std::string &what)
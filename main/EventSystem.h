@@ -1,12 +1,15 @@
 #pragma once
 
 #include <string>
+#include <set>
+#include <unordered_map>
 #include <boost/thread/shared_mutex.hpp>
 
 #include "../httpclient/HTTPClient.h"
 
 #include "LuaCommon.h"
 #include "NotificationObserver.h"
+#include "Trace.h"
 
 class CEventSystem : public CLuaCommon, StoppableTask, CNotificationObserver
 {
@@ -50,20 +53,24 @@ public:
 		REASON_SHELLCOMMAND  // 7
 	};
 
+	// dzVents fields taken from the device json (see JsonMap), kept sorted by JsonMap index
+	typedef std::vector<std::pair<uint8_t, int>> _tJsonMapInt;
+	typedef std::vector<std::pair<uint8_t, float>> _tJsonMapFloat;
+	typedef std::vector<std::pair<uint8_t, bool>> _tJsonMapBool;
+	typedef std::vector<std::pair<uint8_t, std::string>> _tJsonMapString;
+
 	struct _tDeviceStatus
 	{
 		uint64_t ID;
 		std::string deviceName;
-		int nValue;
 		std::string sValue;
-		uint8_t devType;
-		uint8_t subType;
+		std::vector<double> sValueNumbers; // sValue fields converted once per update (StringSplitNumbers)
 		std::string nValueWording;
 		std::string lastUpdate;
-		uint8_t lastLevel;
-		uint8_t switchtype;
 		std::string description;
 		std::string deviceID;
+		std::string image;
+		int nValue;
 		int batteryLevel;
 		int protection;
 		int signalLevel;
@@ -73,12 +80,15 @@ public:
 		float AddjMulti;
 		float AddjValue2;
 		float AddjMulti2;
+		uint8_t devType;
+		uint8_t subType;
+		uint8_t lastLevel;
+		uint8_t switchtype;
 		uint8_t customImage;
-		std::string image;
-		std::map<uint8_t, int> JsonMapInt;
-		std::map<uint8_t, float> JsonMapFloat;
-		std::map<uint8_t, bool> JsonMapBool;
-		std::map<uint8_t, std::string> JsonMapString;
+		_tJsonMapInt JsonMapInt;
+		_tJsonMapFloat JsonMapFloat;
+		_tJsonMapBool JsonMapBool;
+		_tJsonMapString JsonMapString;
 	};
 
 	struct _tUserVariable
@@ -155,6 +165,36 @@ private:
 		time_t timestamp;
 	};
 
+	// Sensor values of one device as exported to the Lua tables, built by GetCurrentMeasurementStates
+	struct _tMeasurementState
+	{
+		enum _eField
+		{
+			MS_TEMP = 0,
+			MS_DEW,
+			MS_HUM,
+			MS_BARO,
+			MS_UTILITY,
+			MS_RAIN,
+			MS_RAINLASTHOUR,
+			MS_UV,
+			MS_WEATHER,
+			MS_WINDDIR,
+			MS_WINDSPEED,
+			MS_WINDGUST,
+			MS_COUNT
+		};
+		uint64_t ID;
+		uint32_t slot; // index in m_devicestates
+		uint16_t fields; // bit per _eField that has a value
+		float values[MS_COUNT];
+
+		bool Has(const _eField field) const
+		{
+			return (fields & (1 << field)) != 0;
+		}
+	};
+
 	struct _tEventQueue
 	{
 		_eReason reason;
@@ -168,16 +208,19 @@ private:
 		bool timeoutOccurred;
 		uint8_t lastLevel;
 		std::vector<std::string> vData;
-		std::map<uint8_t, int> JsonMapInt;
-		std::map<uint8_t, float> JsonMapFloat;
-		std::map<uint8_t, bool> JsonMapBool;
-		std::map<uint8_t, std::string> JsonMapString;
+		_tJsonMapInt JsonMapInt;
+		_tJsonMapFloat JsonMapFloat;
+		_tJsonMapBool JsonMapBool;
+		_tJsonMapString JsonMapString;
 		queue_element_trigger* trigger = nullptr;
+		tracer::_tLink trace = tracer::Link(); // trace of the thread that queued the event
 	};
 	concurrent_queue<_tEventQueue> m_eventqueue;
 
 	std::vector<_tEventTrigger> m_eventtrigger;
 	bool m_bEnabled;
+	// m_devicestatesMutex and m_uservariablesMutex are never held at the same time, code that needs both
+	// copies what it needs under the first one and releases it before taking the second
 	boost::shared_mutex m_devicestatesMutex;
 	boost::shared_mutex m_eventsMutex;
 	boost::shared_mutex m_uservariablesMutex;
@@ -208,6 +251,13 @@ private:
 	std::string ProcessVariableArgument(const std::string &Argument);
 #ifdef ENABLE_PYTHON
 	std::string m_python_Dir;
+	// Devices/variables changed since the last Python script run (protected by their states mutex)
+	std::set<uint64_t> m_pythonDirtyDevices;
+	std::set<uint64_t> m_pythonDirtyVariables;
+	bool m_bPythonResetDevices = true;
+	bool m_bPythonResetVariables = true;
+	// one script run at a time, so the changes reach the Python side in order. Taken before the states mutexes
+	std::mutex m_pythonMutex;
 	void EvaluatePython(const _tEventQueue &item, const std::string &filename, const std::string &PyString);
 #endif
 	void EvaluateLua(const _tEventQueue &item, const std::string &filename, const std::string &LuaString);
@@ -234,34 +284,25 @@ private:
 	std::vector<_tEventItem> m_events;
 
 
-	std::map<uint64_t, _tDeviceStatus> m_devicestates;
+	// Device states ordered by ID in one contiguous table, found by ID or name through the slot indexes (protected by m_devicestatesMutex)
+	std::vector<_tDeviceStatus> m_devicestates;
+	std::unordered_map<uint64_t, uint32_t> m_deviceSlots;
+	std::unordered_map<std::string, uint32_t> m_deviceNameSlots; // a name used more than once points to the highest ID, like in the otherdevices tables
 	std::map<uint64_t, _tUserVariable> m_uservariables;
 	std::map<uint64_t, _tScenesGroups> m_scenesgroups;
-	std::map<std::string, float> m_tempValuesByName;
-	std::map<std::string, float> m_dewValuesByName;
-	std::map<std::string, float> m_rainValuesByName;
-	std::map<std::string, float> m_rainLastHourValuesByName;
-	std::map<std::string, float> m_uvValuesByName;
-	std::map<std::string, float> m_weatherValuesByName;
-	std::map<std::string, int>	 m_humValuesByName;
-	std::map<std::string, float> m_baroValuesByName;
-	std::map<std::string, float> m_utilityValuesByName;
-	std::map<std::string, float> m_winddirValuesByName;
-	std::map<std::string, float> m_windspeedValuesByName;
-	std::map<std::string, float> m_windgustValuesByName;
-
-	std::map<uint64_t, float> m_tempValuesByID;
-	std::map<uint64_t, float> m_dewValuesByID;
-	std::map<uint64_t, float> m_rainValuesByID;
-	std::map<uint64_t, float> m_rainLastHourValuesByID;
-	std::map<uint64_t, float> m_uvValuesByID;
-	std::map<uint64_t, float> m_weatherValuesByID;
-	std::map<uint64_t, int>	m_humValuesByID;
-	std::map<uint64_t, float> m_baroValuesByID;
-	std::map<uint64_t, float> m_utilityValuesByID;
-	std::map<uint64_t, float> m_winddirValuesByID;
-	std::map<uint64_t, float> m_windspeedValuesByID;
-	std::map<uint64_t, float> m_windgustValuesByID;
+
+	// Devices with sensor values ordered by ID, the device names are taken from m_devicestates (protected by m_measurementStatesMutex)
+	std::vector<_tMeasurementState> m_measurementstates;
+	uint32_t m_measurementCount[_tMeasurementState::MS_COUNT] = {};
+
+	_tDeviceStatus *FindDeviceState(uint64_t ulDevID);
+	_tDeviceStatus *FindDeviceState(const std::string &devname);
+	_tDeviceStatus &InsertDeviceState(uint64_t ulDevID, const std::string &devname);
+	void EraseDeviceState(uint64_t ulDevID);
+	void RenameDeviceState(_tDeviceStatus &item, const std::string &devname);
+	void RebuildDeviceSlots();
+	const _tMeasurementState *FindMeasurementState(uint64_t ulDevID) const;
+	void ExportMeasurementStatesToLua(lua_State *lua_state, bool bByName);
 
 	void reportMissingDevice(int deviceID, const _tEventItem &item);
 	int getSunRiseSunSetMinutes(const std::string &what);
@@ -116,6 +116,28 @@
 	      return 0;
       }
 
+      static void PDevice_ReplaceString(PyObject **pField, const std::string &sValue)
+      {
+	      PyObject *tmp = *pField;
+	      *pField = PyUnicode_FromString(sValue.c_str());
+	      Py_XDECREF(tmp);
+      }
+
+      // Refresh an existing (cached) device object in place with the latest state
+      void
+      PDevice_Update(PDevice *self, const CEventSystem::_tDeviceStatus &status)
+      {
+	      self->id = static_cast<int>(status.ID);
+	      self->type = status.devType;
+	      self->sub_type = status.subType;
+	      self->switch_type = status.switchtype;
+	      self->n_value = status.nValue;
+	      PDevice_ReplaceString(&self->name, status.deviceName);
+	      PDevice_ReplaceString(&self->s_value, status.sValue);
+	      PDevice_ReplaceString(&self->n_value_string, status.nValueWording);
+	      PDevice_ReplaceString(&self->last_update_string, status.lastUpdate);
+      }
+
       PyObject *
       PDevice_Describe(PDevice* self)
       {
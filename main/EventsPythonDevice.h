@@ -26,17 +26,19 @@
       void PDevice_dealloc(PDevice* self);
       int PDevice_init(PDevice *self, PyObject *args, PyObject *kwds);
       PyObject * PDevice_new(PyTypeObject *type, PyObject *args, PyObject *kwds);
+      void PDevice_Update(PDevice *self, const CEventSystem::_tDeviceStatus &status);
 
+      // read-only: the objects are kept between script runs, a change made by one script would show in the next
       static PyMemberDef PDevice_members[] = {
-	      { "name", T_OBJECT_EX, offsetof(PDevice, name), 0, "Device name" },
-	      { "last_update_string", T_OBJECT_EX, offsetof(PDevice, last_update_string), 0, "Device last Update" },
-	      { "n_value", T_INT, offsetof(PDevice, n_value), 0, "Device n_value" },
-	      { "n_value_string", T_OBJECT_EX, offsetof(PDevice, n_value_string), 0, "Device n_value_string" },
-	      { "s_value", T_OBJECT_EX, offsetof(PDevice, s_value), 0, "Device s_value" },
-	      { "id", T_INT, offsetof(PDevice, id), 0, "Device id" },
-	      { "type", T_INT, offsetof(PDevice, type), 0, "Device type" },
-	      { "sub_type", T_INT, offsetof(PDevice, sub_type), 0, "Device subType" },
-	      { "switch_type", T_INT, offsetof(PDevice, switch_type), 0, "Device switchType" },
+	      { "name", T_OBJECT_EX, offsetof(PDevice, name), READONLY, "Device name" },
+	      { "last_update_string", T_OBJECT_EX, offsetof(PDevice, last_update_string), READONLY, "Device last Update" },
+	      { "n_value", T_INT, offsetof(PDevice, n_value), READONLY, "Device n_value" },
+	      { "n_value_string", T_OBJECT_EX, offsetof(PDevice, n_value_string), READONLY, "Device n_value_string" },
+	      { "s_value", T_OBJECT_EX, offsetof(PDevice, s_value), READONLY, "Device s_value" },
+	      { "id", T_INT, offsetof(PDevice, id), READONLY, "Device id" },
+	      { "type", T_INT, offsetof(PDevice, type), READONLY, "Device type" },
+	      { "sub_type", T_INT, offsetof(PDevice, sub_type), READONLY, "Device subType" },
+	      { "switch_type", T_INT, offsetof(PDevice, switch_type), READONLY, "Device switchType" },
 	      { nullptr } /* Sentinel */
       };
 
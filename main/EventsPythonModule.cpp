@@ -8,6 +8,7 @@
 #include "../hardware/plugins/Plugins.h"
 
 #include <fstream>
+#include <set>
 
 #ifdef ENABLE_PYTHON
 
@@ -19,6 +20,18 @@ namespace Plugins
     bool			m_ModuleInitialized = false;
 	PyObject*		pDeviceType;
 
+	// Event context that persists between script runs, only changed items are refreshed
+	struct _tPyDeviceEntry
+	{
+		PyObject *pDevice;
+		std::string deviceName;
+	};
+	std::map<uint64_t, _tPyDeviceEntry> m_DeviceObjects;
+	std::map<std::string, std::set<uint64_t>> m_DeviceNameIDs; // devices can share a name
+	std::map<uint64_t, std::string> m_VariableNames;
+	PyObject *m_pDeviceDict = nullptr;
+	PyObject *m_pUserVariablesDict = nullptr;
+
     struct eventModule_state {
 		PyObject*	error;
     };
@@ -202,11 +215,28 @@ namespace Plugins
             return true;
 	}
 
+	static void ClearEventContext(const bool bRelease)
+	{
+		if (bRelease)
+		{
+			for (auto &entry : m_DeviceObjects)
+				Py_XDECREF(entry.second.pDevice);
+			Py_XDECREF(m_pDeviceDict);
+			Py_XDECREF(m_pUserVariablesDict);
+		}
+		m_DeviceObjects.clear();
+		m_DeviceNameIDs.clear();
+		m_VariableNames.clear();
+		m_pDeviceDict = nullptr;
+		m_pUserVariablesDict = nullptr;
+	}
+
 	bool PythonEventsStop()
 	{
 		if (m_PyInterpreter)
 		{
 			PyEval_RestoreThread((PyThreadState *)m_PyInterpreter);
+			ClearEventContext(Plugins::Py_IsInitialized());
 			if (Plugins::Py_IsInitialized())
 				Py_EndInterpreter((PyThreadState *)m_PyInterpreter);
 			m_PyInterpreter = nullptr;
@@ -305,19 +335,133 @@ namespace Plugins
 		PyErr_Clear();
 	}
 
-	void PythonEventsProcessPython(const std::string& reason, const std::string& filename, const std::string& PyString,
-		const uint64_t DeviceID, std::map<uint64_t, CEventSystem::_tDeviceStatus> deviceStates,
-		std::map<uint64_t, CEventSystem::_tUserVariable> userVariables, int intSunRise, int intSunSet)
+	// Point the dictionary key of a name at its device. When devices share a name the one with the highest ID
+	// gets the key, as it did when the dictionary was filled in ID order for every run
+	static void SetDeviceKey(const std::string &deviceName)
 	{
-		if (!m_ModuleInitialized)
+		PyNewRef pKey = PyUnicode_FromString(deviceName.c_str());
+		auto itt = m_DeviceNameIDs.find(deviceName);
+		if (itt == m_DeviceNameIDs.end())
 		{
+			if (PyDict_GetItem(m_pDeviceDict, pKey))
+				PyDict_DelItem(m_pDeviceDict, pKey);
 			return;
 		}
+		if (PyDict_SetItem(m_pDeviceDict, pKey, m_DeviceObjects[*itt->second.rbegin()].pDevice) == -1)
+		{
+			_log.Log(LOG_ERROR, "Python EventSystem: Failed to add device '%s' to device dictionary.", deviceName.c_str());
+		}
+	}
+
+	static void RemoveDeviceName(const uint64_t ID, const std::string &deviceName)
+	{
+		auto itt = m_DeviceNameIDs.find(deviceName);
+		if (itt != m_DeviceNameIDs.end())
+		{
+			itt->second.erase(ID);
+			if (itt->second.empty())
+				m_DeviceNameIDs.erase(itt);
+		}
+		SetDeviceKey(deviceName);
+	}
+
+	static bool SyncEventContext(const _tPythonEventsDelta &delta)
+	{
+		if ((!m_pDeviceDict && !delta.bResetDevices) || (!m_pUserVariablesDict && !delta.bResetVariables))
+		{
+			// Context was lost, the caller has to send a full state
+			return false;
+		}
+
+		if (delta.bResetDevices)
+		{
+			for (auto &entry : m_DeviceObjects)
+				Py_XDECREF(entry.second.pDevice);
+			m_DeviceObjects.clear();
+			m_DeviceNameIDs.clear();
+			Py_XDECREF(m_pDeviceDict);
+			m_pDeviceDict = PyDict_New();
+		}
+		for (const auto &ID : delta.removedDevices)
+		{
+			auto itt = m_DeviceObjects.find(ID);
+			if (itt == m_DeviceObjects.end())
+				continue;
+			PyObject *pDevice = itt->second.pDevice;
+			std::string deviceName = itt->second.deviceName;
+			m_DeviceObjects.erase(itt);
+			RemoveDeviceName(ID, deviceName);
+			Py_XDECREF(pDevice);
+		}
+		for (const auto &sitem : delta.devices)
+		{
+			auto itt = m_DeviceObjects.find(sitem.ID);
+			if (itt == m_DeviceObjects.end())
+			{
+				PyObject *pDevice = PyObject_CallObject((PyObject *)pDeviceType, nullptr);
+				if (!pDevice)
+				{
+					_log.Log(LOG_ERROR, "Python EventSystem: Event Device object creation failed for key %s.", sitem.deviceName.c_str());
+					PyErr_Clear();
+					continue;
+				}
+				itt = m_DeviceObjects.insert(std::make_pair(sitem.ID, _tPyDeviceEntry{ pDevice, sitem.deviceName })).first;
+			}
+			else if (itt->second.deviceName != sitem.deviceName)
+			{
+				std::string oldName = itt->second.deviceName;
+				itt->second.deviceName = sitem.deviceName;
+				RemoveDeviceName(sitem.ID, oldName);
+			}
+			PDevice_Update((PDevice *)itt->second.pDevice, sitem);
+
+			m_DeviceNameIDs[sitem.deviceName].insert(sitem.ID);
+			SetDeviceKey(sitem.deviceName);
+		}
+
+		if (delta.bResetVariables)
+		{
+			m_VariableNames.clear();
+			Py_XDECREF(m_pUserVariablesDict);
+			m_pUserVariablesDict = PyDict_New();
+		}
+		for (const auto &ID : delta.removedVariables)
+		{
+			auto itt = m_VariableNames.find(ID);
+			if (itt == m_VariableNames.end())
+				continue;
+			if (PyDict_GetItemString(m_pUserVariablesDict, itt->second.c_str()))
+				PyDict_DelItemString(m_pUserVariablesDict, itt->second.c_str());
+			m_VariableNames.erase(itt);
+		}
+		for (const auto &uvitem : delta.variables)
+		{
+			auto itt = m_VariableNames.find(uvitem.ID);
+			if ((itt != m_VariableNames.end()) && (itt->second != uvitem.variableName))
+			{
+				if (PyDict_GetItemString(m_pUserVariablesDict, itt->second.c_str()))
+					PyDict_DelItemString(m_pUserVariablesDict, itt->second.c_str());
+			}
+			m_VariableNames[uvitem.ID] = uvitem.variableName;
+
+			PyNewRef pValue = PyUnicode_FromString(uvitem.variableValue.c_str());
+			PyDict_SetItemString(m_pUserVariablesDict, uvitem.variableName.c_str(), pValue);
+		}
+		return true;
+	}
+
+	bool PythonEventsProcessPython(const std::string& reason, const std::string& filename, const std::string& PyString,
+		const uint64_t DeviceID, const _tPythonEventsDelta &delta, int intSunRise, int intSunSet)
+	{
+		if (!m_ModuleInitialized)
+		{
+			return false;
+		}
 
 		if (!Py_IsInitialized())
 		{
 			_log.Log(LOG_ERROR, "EventSystem: Python not Initialized");
-			return;
+			return false;
 		}
 
 		if (m_PyInterpreter)
@@ -331,7 +475,7 @@ namespace Plugins
 			{
 				_log.Log(LOG_ERROR, "Python EventSystem: Failed to open module dictionary.");
 				PyEval_SaveThread();
-				return;
+				return false;
 			}
 
 			if (!Py_None)
@@ -347,61 +491,36 @@ namespace Plugins
 			}
 
 
-			PyNewRef	pStrVal = PyUnicode_FromString(deviceStates[DeviceID].deviceName.c_str());
+			if (!SyncEventContext(delta))
+			{
+				_log.Debug(DEBUG_EVENTSYSTEM, "Python EventSystem: Device and variable context out of sync, requesting full reload.");
+				PyEval_SaveThread();
+				return false;
+			}
+
+			PyNewRef	pStrVal = PyUnicode_FromString(delta.changedDeviceName.c_str());
 			if (PyDict_SetItemString(pModuleDict, "changed_device_name", pStrVal) == -1)
 			{
 				_log.Log(LOG_ERROR, "Python EventSystem: Failed to set changed_device_name.");
-				return;
+				PyEval_SaveThread();
+				return true;
 			}
 
-			PyNewRef	pDeviceDict = PyDict_New();
-			if (PyDict_SetItemString(pModuleDict, "Devices", pDeviceDict) == -1)
+			// the scripts get copies of the dictionaries, what a script adds or deletes is gone with the next run
+			PyNewRef pDeviceDict = PyDict_Copy(m_pDeviceDict);
+			if ((!pDeviceDict) || (PyDict_SetItemString(pModuleDict, "Devices", pDeviceDict) == -1))
 			{
 				_log.Log(LOG_ERROR, "Python EventSystem: Failed to add Device dictionary.");
 				PyEval_SaveThread();
-				return;
+				return true;
 			}
 
-			for (auto it_type = deviceStates.begin(); it_type != deviceStates.end(); ++it_type)
+			auto itt = m_DeviceObjects.find(DeviceID);
+			if (itt != m_DeviceObjects.end())
 			{
-				CEventSystem::_tDeviceStatus sitem = it_type->second;
-
-				PyNewRef nrArgList = Py_BuildValue("(isiiisiss)", static_cast<int>(sitem.ID),
-					sitem.deviceName.c_str(),
-					sitem.devType,
-					sitem.subType,
-					sitem.switchtype,
-					sitem.sValue.c_str(),
-					sitem.nValue,
-					sitem.nValueWording.c_str(),
-					sitem.lastUpdate.c_str());
-				if (!nrArgList)
+				if (PyDict_SetItemString(pModuleDict, "changed_device", itt->second.pDevice) == -1)
 				{
-					_log.Log(LOG_ERROR, "Python EventSystem: Building device argument list failed for key %s.", sitem.deviceName.c_str());
-					continue;
-				}
-				PyNewRef pDevice = PyObject_CallObject((PyObject*)pDeviceType, nrArgList);
-				if (!pDevice)
-				{
-					_log.Log(LOG_ERROR, "Python EventSystem: Event Device object creation failed for key %s.", sitem.deviceName.c_str());
-					continue;
-				}
-
-				if (sitem.ID == DeviceID)
-				{
-					if (PyDict_SetItemString(pModuleDict, "changed_device", (PyObject*)pDevice) == -1)
-					{
-						_log.Log(LOG_ERROR,
-							"Python EventSystem: Failed to add device '%s' as changed_device.",
-							sitem.deviceName.c_str());
-					}
-				}
-
-				PyNewRef	pKey = PyUnicode_FromString(sitem.deviceName.c_str());
-				if (PyDict_SetItem(pDeviceDict, pKey, (PyObject*)pDevice) == -1)
-				{
-					_log.Log(LOG_ERROR, "Python EventSystem: Failed to add device '%s' to device dictionary.",
-						sitem.deviceName.c_str());
+					_log.Log(LOG_ERROR, "Python EventSystem: Failed to add device '%s' as changed_device.", itt->second.deviceName.c_str());
 				}
 			}
 
@@ -456,19 +575,12 @@ namespace Plugins
 			}
 
 			// UserVariables
-			PyNewRef	userVariablesDict = PyDict_New();
-			if (PyDict_SetItemString(pModuleDict, "user_variables", userVariablesDict) == -1)
+			PyNewRef pUserVariablesDict = PyDict_Copy(m_pUserVariablesDict);
+			if ((!pUserVariablesDict) || (PyDict_SetItemString(pModuleDict, "user_variables", pUserVariablesDict) == -1))
 			{
 				_log.Log(LOG_ERROR, "Python EventSystem: Failed to add uservariables dictionary.");
 				PyEval_SaveThread();
-				return;
-			}
-
-			for (auto it_var = userVariables.begin(); it_var != userVariables.end(); ++it_var)
-			{
-				CEventSystem::_tUserVariable uvitem = it_var->second;
-				PyDict_SetItemString(userVariablesDict, uvitem.variableName.c_str(),
-					PyUnicode_FromString(uvitem.variableValue.c_str()));
+				return true;
 			}
 
 			// Add __main__ module
@@ -577,22 +689,16 @@ namespace Plugins
 				}
 			}
 
-			// Empty dictionaries to free memory
-			if (pDeviceDict.IsDict())
-			{
-				PyDict_Clear(pDeviceDict);
-			}
-			if (userVariablesDict.IsDict())
-			{
-				PyDict_Clear(userVariablesDict);
-			}
 		}
 		else
 		{
 			_log.Log(LOG_ERROR, "Python EventSystem: Module not available to events");
+			PyEval_SaveThread();
+			return false;
 		}
 
 		PyEval_SaveThread();
+		return true;
 	}
 } // namespace Plugins
 #endif
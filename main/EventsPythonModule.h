@@ -12,11 +12,22 @@
         static PyObject*    PyDomoticz_EventsLog(PyObject *self, PyObject *args);
         static PyObject*	PyDomoticz_EventsCommand(PyObject *self, PyObject *args);
 
+	// Changes to apply to the persistent 'Devices' and 'user_variables' dictionaries before running a script
+	struct _tPythonEventsDelta
+	{
+		bool bResetDevices = false;
+		std::vector<CEventSystem::_tDeviceStatus> devices;
+		std::vector<uint64_t> removedDevices;
+		bool bResetVariables = false;
+		std::vector<CEventSystem::_tUserVariable> variables;
+		std::vector<uint64_t> removedVariables;
+		std::string changedDeviceName;
+	};
+
 	PyObject *PythonEventsGetModule();
 	bool PythonEventsInitialize(const std::string &szUserDataFolder);
 	bool PythonEventsStop();
-	void PythonEventsProcessPython(const std::string &reason, const std::string &filename, const std::string &PyString, uint64_t DeviceID,
-				       std::map<uint64_t, CEventSystem::_tDeviceStatus> m_devicestates, std::map<uint64_t, CEventSystem::_tUserVariable> m_uservariables, int intSunRise,
-				       int intSunSet);
+	bool PythonEventsProcessPython(const std::string &reason, const std::string &filename, const std::string &PyString, uint64_t DeviceID,
+				       const _tPythonEventsDelta &delta, int intSunRise, int intSunSet);
     } // namespace Plugins
 #endif
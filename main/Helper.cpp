@@ -23,6 +23,7 @@
 #include <openssl/err.h>
 
 #include <chrono>
+#include <charconv>
 #include <limits.h>
 #include <cstring>
 #include <stdarg.h>
@@ -179,16 +180,107 @@ uint8_t Crc8_strMQ(uint8_t crc, const uint8_t* buf, size_t size)
 
 void StringSplit(std::string str, const std::string& delim, std::vector<std::string>& results)
 {
+	// str is a copy, callers may split one of the results into the same vector
 	results.clear();
+	size_t start = 0;
 	size_t cutAt;
-	while ((cutAt = str.find(delim)) != std::string::npos)
+	while (!delim.empty() && ((cutAt = str.find(delim, start)) != std::string::npos))
 	{
-		results.push_back(str.substr(0, cutAt));
-		str = str.substr(cutAt + delim.size());
+		results.emplace_back(str, start, cutAt - start);
+		start = cutAt + delim.size();
 	}
-	if (!str.empty())
+	if (start < str.size())
 	{
-		results.push_back(str);
+		results.emplace_back(str, start);
+	}
+}
+
+void StringSplit(std::string_view str, std::string_view delim, std::vector<std::string_view>& results)
+{
+	results.clear();
+	size_t start = 0;
+	size_t cutAt;
+	while (!delim.empty() && ((cutAt = str.find(delim, start)) != std::string_view::npos))
+	{
+		results.push_back(str.substr(start, cutAt - start));
+		start = cutAt + delim.size();
+	}
+	if (start < str.size())
+	{
+		results.push_back(str.substr(start));
+	}
+}
+
+namespace
+{
+	// strips what atof/atoi skip before the number (from_chars does not)
+	std::string_view NumberStart(std::string_view str)
+	{
+		size_t pos = 0;
+		while ((pos < str.size()) && isspace(static_cast<unsigned char>(str[pos])))
+			pos++;
+		if ((pos + 1 < str.size()) && (str[pos] == '+') && (str[pos + 1] != '-'))
+			pos++;
+		return str.substr(pos);
+	}
+
+	bool StrtodCopy(std::string_view str, double& value)
+	{
+		char szTmp[80];
+		size_t len = std::min(str.size(), sizeof(szTmp) - 1);
+		memcpy(szTmp, str.data(), len);
+		szTmp[len] = 0;
+		char* pEnd;
+		value = strtod(szTmp, &pEnd);
+		return pEnd != szTmp;
+	}
+} // namespace
+
+bool StringToDouble(std::string_view str, double& value)
+{
+	str = NumberStart(str);
+#if defined(__cpp_lib_to_chars)
+	auto result = std::from_chars(str.data(), str.data() + str.size(), value);
+	if (result.ec == std::errc())
+		return true;
+	if (result.ec == std::errc::invalid_argument)
+	{
+		value = 0;
+		return false;
+	}
+	// out of range, let strtod decide between HUGE_VAL and 0
+#endif
+	return StrtodCopy(str, value);
+}
+
+bool StringToInt(std::string_view str, int& value)
+{
+	str = NumberStart(str);
+	auto result = std::from_chars(str.data(), str.data() + str.size(), value);
+	if (result.ec != std::errc())
+	{
+		value = 0;
+		return false;
+	}
+	return true;
+}
+
+void StringSplitNumbers(std::string_view str, std::string_view delim, std::vector<double>& values)
+{
+	values.clear();
+	size_t start = 0;
+	size_t cutAt;
+	double value;
+	while (!delim.empty() && ((cutAt = str.find(delim, start)) != std::string_view::npos))
+	{
+		StringToDouble(str.substr(start, cutAt - start), value);
+		values.push_back(value);
+		start = cutAt + delim.size();
+	}
+	if (start < str.size())
+	{
+		StringToDouble(str.substr(start), value);
+		values.push_back(value);
 	}
 }
 
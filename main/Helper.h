@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <map>
 
 #define ground(a) (int)(a + .5)
@@ -19,6 +20,13 @@ unsigned int Crc32(unsigned int crc, const uint8_t* buf, size_t size);
 uint64_t Crc64(const uint8_t* buf, size_t size);
 uint8_t Crc8_strMQ(uint8_t crc, const uint8_t* buf, size_t size);
 void StringSplit(std::string str, const std::string& delim, std::vector<std::string>& results);
+// Same as above without copying, the results point into str
+void StringSplit(std::string_view str, std::string_view delim, std::vector<std::string_view>& results);
+// Parses like atof/atoi (leading white space and trailing text allowed), returns false when no number was found
+bool StringToDouble(std::string_view str, double& value);
+bool StringToInt(std::string_view str, int& value);
+// Splits a value string like "21.3;55;1" straight into numbers (fields as with StringSplit, converted like atof)
+void StringSplitNumbers(std::string_view str, std::string_view delim, std::vector<double>& values);
 uint64_t hexstrtoui64(const std::string& str);
 std::string ToHexString(const uint8_t* pSource, size_t length);
 std::vector<char> HexToBytes(const std::string& hex);
@@ -6,6 +6,7 @@
 #include <algorithm>
 #include "Helper.h"
 #include "mainworker.h"
+#include "mpsc_queue.h"
 
 #ifndef WIN32
 #include <syslog.h>
@@ -15,10 +16,16 @@
 #include "SQLHelper.h"
 
 #define MAX_LOG_LINE_BUFFER 100
+#define DEFAULT_LOG_RING_SIZE 10000
 #define MAX_LOG_LINE_LENGTH (2048 * 3)
 
 #define MAX_ACLFLOG_LINES 100000
 
+#define MAX_ASYNC_LOG_QUEUE 8192
+#define MAX_ASYNC_LOG_BATCH 512
+#define MAX_ASYNC_LOG_FULL_WAIT_MS 250
+#define MAX_WEB_LOG_LINES_PER_SECOND 100
+
 extern bool g_bRunAsDaemon;
 extern bool g_bUseSyslog;
 
@@ -32,19 +39,31 @@ CLogger::_tLogLineStruct::_tLogLineStruct(const _eLogLevel nlevel, const std::st
 	logmessage = nlogmessage;
 }
 
+struct CLogger::_tAsyncQueue
+{
+	mpsc_queue<_tLogQueueItem> queue{ MAX_ASYNC_LOG_QUEUE };
+};
+
+thread_local bool CLogger::m_bInSequenceMode = false;
+thread_local std::stringstream CLogger::m_sequencestring;
+
+// set on the thread that writes the queued lines, a line it logs itself is written directly
+static thread_local bool tl_bWritingQueue = false;
+
 CLogger::CLogger()
 {
-	m_bInSequenceMode = false;
 	m_bEnableLogThreadIDs = false;
 	m_bEnableLogTimestamps = true;
 	m_bEnableErrorsToNotificationSystem = false;
 	m_LastLogNotificationsSend = 0;
+	m_logring_size = DEFAULT_LOG_RING_SIZE;
 	SetLogFlags(LOG_NORM | LOG_STATUS | LOG_ERROR);
 	SetDebugFlags(DEBUG_NORM);
 }
 
 CLogger::~CLogger()
 {
+	StopAsyncWriter();
 	if (m_outputfile.is_open())
 		m_outputfile.close();
 }
@@ -179,6 +198,8 @@ void CLogger::SetOutputFile(const char *OutputFile)
 	std::unique_lock<std::mutex> lock(m_mutex);
 	if (m_outputfile.is_open())
 		m_outputfile.close();
+	m_outputfilename.clear();
+	m_outputfilesize = 0;
 
 	if (OutputFile == nullptr)
 		return;
@@ -192,6 +213,10 @@ void CLogger::SetOutputFile(const char *OutputFile)
 #else
 		m_outputfile.open(OutputFile, std::ios::out | std::ios::app);
 #endif
+		m_outputfilename = OutputFile;
+		m_outputfile.seekp(0, std::ios::end);
+		std::streamoff fsize = m_outputfile.tellp();
+		m_outputfilesize = (fsize > 0) ? static_cast<uint64_t>(fsize) : 0;
 	}
 	catch (...)
 	{
@@ -199,6 +224,38 @@ void CLogger::SetOutputFile(const char *OutputFile)
 	}
 }
 
+void CLogger::SetOutputFileRotation(const uint64_t maxSize, const int maxFiles)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_outputfilemaxsize = maxSize;
+	m_outputfilemaxfiles = maxFiles;
+}
+
+// m_mutex should be locked
+void CLogger::RotateOutputFile()
+{
+	m_outputfile.close();
+	if (m_outputfilemaxfiles > 0)
+	{
+		for (int ii = m_outputfilemaxfiles; ii > 0; ii--)
+		{
+			std::string szFrom = (ii == 1) ? m_outputfilename : m_outputfilename + "." + std::to_string(ii - 1);
+			std::string szTo = m_outputfilename + "." + std::to_string(ii);
+			std::remove(szTo.c_str());
+			std::rename(szFrom.c_str(), szTo.c_str());
+		}
+	}
+	try
+	{
+		m_outputfile.open(m_outputfilename, std::ios::out | std::ios::trunc);
+	}
+	catch (...)
+	{
+		std::cerr << "Error opening output log file..." << std::endl;
+	}
+	m_outputfilesize = 0;
+}
+
 void CLogger::SetACLFOutputFile(const char *OutputFile)
 {
 	std::string sLogFile = OutputFile;
@@ -259,53 +316,139 @@ void CLogger::Log(const _eLogLevel level, const char *logline, ...)
 		return; // This log level is not enabled!
 
 	va_list argList;
-	char cbuffer[MAX_LOG_LINE_LENGTH];
 	va_start(argList, logline);
-	vsnprintf(cbuffer, sizeof(cbuffer), logline, argList);
+	LogInt(level, -1, logline, argList);
 	va_end(argList);
+}
 
-#ifndef WIN32
-	if (g_bUseSyslog)
-	{
-		int sLogLevel = LOG_INFO;
-		if (level & LOG_ERROR)
-			sLogLevel = LOG_ERR;
-		else if (level & LOG_STATUS)
-			sLogLevel = LOG_NOTICE;
-		syslog(sLogLevel, "%s", cbuffer);
-	}
-#endif
+void CLogger::LogHardware(const _eLogLevel level, const int hardwareID, const char *logline, ...)
+{
+	if (!(m_log_flags & level))
+		return; // This log level is not enabled!
+
+	va_list argList;
+	va_start(argList, logline);
+	LogInt(level, hardwareID, logline, argList);
+	va_end(argList);
+}
+
+void CLogger::LogInt(const _eLogLevel level, const int hardwareID, const char *logline, va_list argList)
+{
+	char cbuffer[MAX_LOG_LINE_LENGTH];
+	vsnprintf(cbuffer, sizeof(cbuffer), logline, argList);
 
-	std::stringstream sstr;
+	_tLogQueueItem item;
+	item.level = level;
+	item.hardwareID = hardwareID;
+	item.logline.reserve(64 + strlen(cbuffer));
 
 	if (m_bEnableLogTimestamps)
-		sstr << TimeToString(nullptr, TF_DateTimeMs) << "  ";
+	{
+		item.logline = TimeToString(nullptr, TF_DateTimeMs);
+		item.logline += "  ";
+	}
 
 	if ((m_log_flags & LOG_DEBUG_INT) && (m_debug_flags & DEBUG_THREADIDS))
 	{
+		char szThreadID[40];
 #ifdef WIN32
-		sstr << "[" << std::setfill('0') << std::setw(4) << std::hex << ::GetCurrentThreadId() << "] ";
+		snprintf(szThreadID, sizeof(szThreadID), "[%04lx] ", (unsigned long)::GetCurrentThreadId());
 #else
-		sstr << "[" << std::setfill('0') << std::setw(4) << std::hex << pthread_self() << "] ";
+		snprintf(szThreadID, sizeof(szThreadID), "[%04lx] ", (unsigned long)(uintptr_t)pthread_self());
 #endif
+		item.logline += szThreadID;
 	}
 
 	if (level & LOG_STATUS)
-		sstr << "Status: " << cbuffer;
+		item.logline += "Status: ";
 	else if (level & LOG_ERROR)
-		sstr << "Error: " << cbuffer;
+		item.logline += "Error: ";
 	else if (level & LOG_DEBUG_INT)
-		sstr << "Debug: " << cbuffer;
-	else
-		sstr << cbuffer;
+		item.logline += "Debug: ";
+	item.messageOffset = item.logline.size();
+	item.logline += cbuffer;
 
-	std::string szIntLog = sstr.str();
+	if (PushAsync(item))
+		return;
+
+	// Synchronous (writer not running, crash path or writer stalled on a full queue)
+	std::vector<_tLogQueueItem> items;
+	items.push_back(std::move(item));
+	WriteLines(items, false);
+}
+
+bool CLogger::PushAsync(_tLogQueueItem &item)
+{
+	if ((!m_bAsync) || (tl_bWritingQueue))
+		return false;
+
+	// StopAsyncWriter clears m_bAsync and writes the leftovers under the unique lock, so a line is either queued
+	// before the final drain or written directly after it
+	std::shared_lock<std::shared_mutex> l(m_asyncstop_mutex);
+	if (!m_bAsync)
+		return false;
+	// queue full: give the writer a moment, a line written directly would end up before the queued ones
+	for (int ii = 0; ii < MAX_ASYNC_LOG_FULL_WAIT_MS; ii++)
+	{
+		if (m_asyncqueue->queue.try_push(item))
+			return true;
+		sleep_milliseconds(1);
+	}
+	return m_asyncqueue->queue.try_push(item);
+}
+
+void CLogger::WriteLines(std::vector<_tLogQueueItem> &items, const bool bRateLimitWeb)
+{
+#ifndef WIN32
+	if (g_bUseSyslog)
+	{
+		for (const auto &item : items)
+		{
+			int sLogLevel = LOG_INFO;
+			if (item.level & LOG_ERROR)
+				sLogLevel = LOG_ERR;
+			else if (item.level & LOG_STATUS)
+				sLogLevel = LOG_NOTICE;
+			syslog(sLogLevel, "%s", item.logline.c_str() + item.messageOffset);
+		}
+	}
+#endif
 
-	sOnLogMessage(level, szIntLog);
+	// Web clients, a burst of (debug) lines should not flood the browsers
+	for (const auto &item : items)
+	{
+		if (bRateLimitWeb)
+		{
+			time_t now = mytime(nullptr);
+			if (now != m_webratesecond)
+			{
+				if (m_websuppressed > 0)
+				{
+					std::string szLine = "Status: Logger: " + std::to_string(m_websuppressed) + " log lines were not sent to the web clients (rate limit)";
+					if (m_bEnableLogTimestamps)
+						szLine = TimeToString(nullptr, TF_DateTimeMs) + "  " + szLine;
+					sOnLogMessage(LOG_STATUS, szLine);
+				}
+				m_webratesecond = now;
+				m_webratecount = 0;
+				m_websuppressed = 0;
+			}
+			if (m_webratecount >= MAX_WEB_LOG_LINES_PER_SECOND)
+			{
+				m_websuppressed++;
+				continue;
+			}
+			m_webratecount++;
+		}
+		sOnLogMessage(item.level, item.logline);
+	}
 
+	// Locked region to allow multiple threads to print at the same time
+	std::unique_lock<std::mutex> lock(m_mutex);
+	for (auto &item : items)
 	{
-		// Locked region to allow multiple threads to print at the same time
-		std::unique_lock<std::mutex> lock(m_mutex);
+		const _eLogLevel level = item.level;
+		const std::string &szIntLog = item.logline;
 
 		if ((level & LOG_ERROR) && (m_bEnableErrorsToNotificationSystem))
 		{
@@ -324,27 +467,102 @@ void CLogger::Log(const _eLogLevel level, const char *logline, ...)
 #ifndef WIN32
 			if (level != LOG_ERROR)
 #endif
-				std::cout << szIntLog << std::endl;
+				std::cout << szIntLog << '\n';
 #ifndef WIN32
 			else // print text in red color
-				std::cout << szIntLog.substr(0, 25) << "\033[1;31m" << szIntLog.substr(25) << "\033[0;0m" << std::endl;
+				std::cout << szIntLog.substr(0, 25) << "\033[1;31m" << szIntLog.substr(25) << "\033[0;0m" << '\n';
 #endif
 		}
 
 		if (m_outputfile.is_open())
 		{
 			// output to file
-			m_outputfile << szIntLog << std::endl;
-			m_outputfile.flush();
+			m_outputfile << szIntLog << '\n';
+			m_outputfilesize += szIntLog.size() + 1;
 		}
+	}
+	if (!g_bRunAsDaemon)
+		std::cout.flush();
+	if (m_outputfile.is_open())
+	{
+		m_outputfile.flush();
+		if ((m_outputfilemaxsize > 0) && (m_outputfilesize >= m_outputfilemaxsize))
+			RotateOutputFile();
+	}
+	lock.unlock();
+
+	// In-memory ring, slots (and their string buffers) are reused
+	std::unique_lock<std::shared_mutex> ringlock(m_logring_mutex);
+	if (m_logring.size() != m_logring_size)
+		m_logring.resize(m_logring_size);
+	time_t now = mytime(nullptr);
+	for (const auto &item : items)
+	{
+		auto &line = m_logring[m_logring_next % m_logring_size];
+		line.logtime = now;
+		line.level = item.level;
+		line.hardwareID = item.hardwareID;
+		line.line_counter = m_logring_next++;
+		line.logmessage.assign(item.logline);
+	}
+}
+
+void CLogger::StartAsyncWriter()
+{
+	if (m_asyncthread)
+		return;
+	if (!m_asyncqueue)
+		m_asyncqueue = std::make_unique<_tAsyncQueue>();
+	m_bStopAsync = false;
+	m_asyncthread = std::make_shared<std::thread>([this] { Do_Work(); });
+	SetThreadName(m_asyncthread->native_handle(), "Logger");
+	m_bAsync = true;
+}
+
+void CLogger::StopAsyncWriter()
+{
+	// waits for the threads that are pushing, other threads wait in PushAsync until the queue is written
+	std::unique_lock<std::shared_mutex> l(m_asyncstop_mutex);
+	m_bAsync = false;
+	if (!m_asyncthread)
+		return;
+	m_bStopAsync = true;
+	m_asyncthread->join();
+	m_asyncthread.reset();
+
+	// lines that were queued while stopping
+	tl_bWritingQueue = true;
+	std::vector<_tLogQueueItem> items;
+	_tLogQueueItem item;
+	while (m_asyncqueue->queue.try_pop(item))
+		items.push_back(std::move(item));
+	if (!items.empty())
+		WriteLines(items, false);
+	tl_bWritingQueue = false;
+}
 
-		auto itt = m_lastlog.find(level);
-		if (itt != m_lastlog.end())
+void CLogger::SetSynchronous()
+{
+	m_bAsync = false;
+}
+
+void CLogger::Do_Work()
+{
+	tl_bWritingQueue = true;
+	std::vector<_tLogQueueItem> items;
+	_tLogQueueItem item;
+	while (true)
+	{
+		if (m_asyncqueue->queue.timed_wait_and_pop(item, std::chrono::milliseconds(100)))
 		{
-			if (m_lastlog[level].size() >= MAX_LOG_LINE_BUFFER)
-				m_lastlog[level].erase(m_lastlog[level].begin());
+			items.push_back(std::move(item));
+			while ((items.size() < MAX_ASYNC_LOG_BATCH) && (m_asyncqueue->queue.try_pop(item)))
+				items.push_back(std::move(item));
+			WriteLines(items, true);
+			items.clear();
 		}
-		m_lastlog[level].push_back(_tLogLineStruct(level, szIntLog));
+		else if (m_bStopAsync)
+			break;
 	}
 }
 
@@ -464,42 +682,83 @@ bool CLogger::IsLogTimestampsEnabled()
 	return (m_bEnableLogTimestamps && !g_bUseSyslog);
 }
 
-bool compareLogByTime(const CLogger::_tLogLineStruct &a, const CLogger::_tLogLineStruct &b)
+void CLogger::SetLogBufferSize(const size_t lines)
 {
-	if (a.logtime < b.logtime)
-		return true;
-	if (a.logtime > b.logtime)
-		return false;
-	return (a.line_counter < b.line_counter);
+	std::unique_lock<std::shared_mutex> lock(m_logring_mutex);
+	size_t newsize = std::max<size_t>(lines, MAX_LOG_LINE_BUFFER);
+	if (!m_logring.empty())
+	{
+		// keep the most recent lines
+		std::vector<_tLogLineStruct> newring(newsize);
+		uint64_t first = std::max<uint64_t>(OldestLogCursor(), (m_logring_next > newsize) ? m_logring_next - newsize : 1);
+		for (uint64_t seq = first; seq < m_logring_next; seq++)
+			newring[seq % newsize] = std::move(m_logring[seq % m_logring.size()]);
+		m_logring.swap(newring);
+		m_logring_first = first;
+	}
+	m_logring_size = newsize;
 }
 
-std::list<CLogger::_tLogLineStruct> CLogger::GetLog(const _eLogLevel level, const time_t lastlogtime)
+// m_logring_mutex should be locked
+uint64_t CLogger::OldestLogCursor()
 {
-	std::unique_lock<std::mutex> lock(m_mutex);
-	std::list<_tLogLineStruct> mlist;
+	uint64_t oldest = (m_logring_next > m_logring.size()) ? m_logring_next - m_logring.size() : 1;
+	return std::max(oldest, m_logring_first);
+}
 
-	if (level != LOG_ALL)
+uint64_t CLogger::ForEachLogLine(uint64_t cursor, const uint32_t levelMask, const int hardwareID, const size_t maxLines, const std::function<void(const _tLogLineStruct &)> &fn)
+{
+	std::shared_lock<std::shared_mutex> lock(m_logring_mutex);
+	cursor = std::max(cursor, OldestLogCursor());
+	size_t nLines = 0;
+	while ((cursor < m_logring_next) && (nLines < maxLines))
 	{
-		if (m_lastlog.find(level) == m_lastlog.end())
-			return mlist;
+		const auto &line = m_logring[cursor % m_logring.size()];
+		cursor++;
+		if (!(line.level & levelMask))
+			continue;
+		if ((hardwareID != -1) && (line.hardwareID != hardwareID))
+			continue;
+		fn(line);
+		nLines++;
+	}
+	return cursor;
+}
 
-		std::copy_if(std::begin(m_lastlog[level]), std::end(m_lastlog[level]), std::back_inserter(mlist), [lastlogtime](const _tLogLineStruct& l) { return l.logtime > lastlogtime; });
+uint64_t CLogger::FindLogCursor(const time_t logtime)
+{
+	std::shared_lock<std::shared_mutex> lock(m_logring_mutex);
+	// lines are stored in time order
+	uint64_t low = OldestLogCursor();
+	uint64_t high = m_logring_next;
+	while (low < high)
+	{
+		uint64_t mid = low + (high - low) / 2;
+		if (m_logring[mid % m_logring.size()].logtime < logtime)
+			low = mid + 1;
+		else
+			high = mid;
 	}
-	else
-		for (const auto& l : m_lastlog)
-			std::copy_if(l.second.begin(), l.second.end(), std::back_inserter(mlist), [lastlogtime](const _tLogLineStruct& l2)
-				{
-					return l2.logtime > lastlogtime;
-				});
+	return low;
+}
 
-	mlist.sort(compareLogByTime);
+uint64_t CLogger::GetNextLogCursor()
+{
+	std::shared_lock<std::shared_mutex> lock(m_logring_mutex);
+	return m_logring_next;
+}
+
+std::list<CLogger::_tLogLineStruct> CLogger::GetLog(const _eLogLevel level, const time_t lastlogtime)
+{
+	std::list<_tLogLineStruct> mlist;
+	ForEachLogLine(FindLogCursor(lastlogtime + 1), level, -1, SIZE_MAX, [&](const _tLogLineStruct &line) { mlist.push_back(line); });
 	return mlist;
 }
 
 void CLogger::ClearLog()
 {
-	std::unique_lock<std::mutex> lock(m_mutex);
-	m_lastlog.clear();
+	std::unique_lock<std::shared_mutex> lock(m_logring_mutex);
+	m_logring_first = m_logring_next;
 }
 
 std::list<CLogger::_tLogLineStruct> CLogger::GetNotificationLogs()
@@ -1,9 +1,16 @@
 #pragma once
 
+#include <atomic>
+#include <cstdarg>
 #include <deque>
+#include <functional>
 #include <list>
+#include <memory>
+#include <shared_mutex>
 #include <string>
 #include <fstream>
+#include <thread>
+#include <vector>
 #include "lsignal.h"
 
 enum _eLogLevel : uint32_t
@@ -45,6 +52,8 @@ public:
 		_eLogLevel level;
 		std::string logmessage;
 		uint64_t line_counter;
+		int hardwareID = -1;
+		_tLogLineStruct() = default;
 		_tLogLineStruct(_eLogLevel nlevel, const std::string& nlogmessage);
 	};
 
@@ -63,11 +72,19 @@ public:
 	bool IsACLFlogEnabled();
 
 	void SetOutputFile(const char* OutputFile);
+	// rotate the output file when it grows beyond maxSize bytes (0 = never), keeping maxFiles old files (.1 .. .n)
+	void SetOutputFileRotation(const uint64_t maxSize, const int maxFiles);
 	void SetACLFOutputFile(const char* OutputFile);
 	void OpenACLFOutputFile();
 
 	void Log(_eLogLevel level, const std::string& sLogline);
 	void Log(_eLogLevel level, const char* logline, ...);
+	// same as Log, the line is tagged with the hardware id so it can be filtered
+	void LogHardware(_eLogLevel level, int hardwareID, const char* logline, ...)
+#ifdef __GNUC__
+		__attribute__((format(printf, 4, 5)))
+#endif
+		;
 
 	lsignal::signal<void(const _eLogLevel, const std::string& sLogline)> sOnLogMessage;
 
@@ -93,13 +110,47 @@ public:
 
 	void ForwardErrorsToNotificationSystem(bool bDoForward);
 
+	// Lines are formatted by the calling thread and written (console, file, syslog, web clients) by a writer thread
+	void StartAsyncWriter();
+	// Writes all pending lines and stops the writer thread
+	void StopAsyncWriter();
+	// For crash paths: lines are written directly by the calling thread from now on
+	void SetSynchronous();
+
 	std::list<_tLogLineStruct> GetLog(_eLogLevel level, time_t lastlogtime = 0);
 	void ClearLog();
 
+	// In-memory log ring, every line gets a sequence number (cursor) that keeps increasing
+	void SetLogBufferSize(size_t lines);
+	// Calls fn (without copying) for the lines from cursor on that match levelMask and hardwareID (-1 = all),
+	// starts at the oldest line when cursor is no longer in the ring. Returns the cursor to continue from.
+	uint64_t ForEachLogLine(uint64_t cursor, uint32_t levelMask, int hardwareID, size_t maxLines, const std::function<void(const _tLogLineStruct &)> &fn);
+	// cursor of the first line logged at or after logtime
+	uint64_t FindLogCursor(time_t logtime);
+	// cursor of the line that will be logged next
+	uint64_t GetNextLogCursor();
+
 	std::list<_tLogLineStruct> GetNotificationLogs();
 	bool NotificationLogsEnabled();
 
 private:
+	struct _tLogQueueItem
+	{
+		_eLogLevel level = LOG_NORM;
+		int hardwareID = -1;
+		std::string logline;
+		size_t messageOffset = 0; // start of the message without timestamp/thread id (for syslog)
+	};
+	struct _tAsyncQueue;
+
+	void LogInt(_eLogLevel level, int hardwareID, const char* logline, va_list argList);
+	// false when the line has to be written by the calling thread
+	bool PushAsync(_tLogQueueItem &item);
+	void WriteLines(std::vector<_tLogQueueItem> &items, bool bRateLimitWeb);
+	uint64_t OldestLogCursor();
+	void RotateOutputFile();
+	void Do_Work();
+
 	uint32_t m_log_flags = 0;
 	uint32_t m_debug_flags = 0;
 	uint8_t m_aclf_flags = 0;
@@ -107,15 +158,32 @@ private:
 
 	std::mutex m_mutex;
 	std::ofstream m_outputfile;
+	std::string m_outputfilename;
+	uint64_t m_outputfilesize = 0;
+	uint64_t m_outputfilemaxsize = 0;
+	int m_outputfilemaxfiles = 0;
 	const char* m_aclflogfile = nullptr;
 	std::ofstream m_aclfoutputfile;
-	std::map<_eLogLevel, std::deque<_tLogLineStruct>> m_lastlog;
+	std::shared_mutex m_logring_mutex;
+	std::vector<_tLogLineStruct> m_logring; // line with sequence n is at n % size
+	size_t m_logring_size;
+	uint64_t m_logring_next = 1;  // sequence of the next line
+	uint64_t m_logring_first = 1; // lines before this one were cleared
 	std::deque<_tLogLineStruct> m_notification_log;
-	bool m_bInSequenceMode;
+	static thread_local bool m_bInSequenceMode;
 	bool m_bEnableLogTimestamps;
 	bool m_bEnableLogThreadIDs;
 	bool m_bEnableErrorsToNotificationSystem;
 	time_t m_LastLogNotificationsSend;
-	std::stringstream m_sequencestring;
+
+	std::unique_ptr<_tAsyncQueue> m_asyncqueue;
+	std::shared_ptr<std::thread> m_asyncthread;
+	std::atomic<bool> m_bAsync{ false };
+	std::atomic<bool> m_bStopAsync{ false };
+	std::shared_mutex m_asyncstop_mutex; // shared while pushing, unique while stopping the writer
+	time_t m_webratesecond = 0;
+	int m_webratecount = 0;
+	int m_websuppressed = 0;
+	static thread_local std::stringstream m_sequencestring; // per thread, RX messages are decoded in parallel
 };
 extern CLogger _log;
@@ -19,20 +19,171 @@ extern "C" {
 
 extern std::string szUserDataFolder;
 
+#define LUA_JSON_DOCUMENT "domoticz.JsonDocument"
+#define LUA_XML_DOCUMENT "domoticz.XmlDocument"
+
+// Documents are parsed once and kept in a Lua userdata, so a script can query the same
+// (large) content many times. A plain string argument is parsed once as well, the last
+// parsed string of each type is remembered in the Lua registry.
+
+static void* NewDocument(lua_State* lua_state, const char* szType)
+{
+	void* pDoc;
+	if (strcmp(szType, LUA_JSON_DOCUMENT) == 0)
+		pDoc = new (lua_newuserdata(lua_state, sizeof(Json::Value))) Json::Value();
+	else
+		pDoc = new (lua_newuserdata(lua_state, sizeof(TiXmlDocument))) TiXmlDocument();
+	luaL_setmetatable(lua_state, szType);
+	return pDoc;
+}
+
+static bool ParseDocument(void* pDoc, const char* szType, const std::string& buffer)
+{
+	if (strcmp(szType, LUA_JSON_DOCUMENT) == 0)
+		return ParseJSon(buffer, *static_cast<Json::Value*>(pDoc));
+
+	TiXmlDocument* pXmlDoc = static_cast<TiXmlDocument*>(pDoc);
+	pXmlDoc->Parse(buffer.c_str(), nullptr, TIXML_ENCODING_UTF8);
+	return (pXmlDoc->RootElement() != nullptr);
+}
+
+int CLuaCommon::l_domoticz_documentGC(lua_State* lua_state)
+{
+	if (void* pDoc = luaL_testudata(lua_state, 1, LUA_JSON_DOCUMENT))
+		static_cast<Json::Value*>(pDoc)->~Value();
+	else if (void* pDoc = luaL_testudata(lua_state, 1, LUA_XML_DOCUMENT))
+		static_cast<TiXmlDocument*>(pDoc)->~TiXmlDocument();
+	return 0;
+}
+
+void CLuaCommon::RegisterDocumentFunctions(lua_State* lua_state)
+{
+	static const char* szTypes[] = { LUA_JSON_DOCUMENT, LUA_XML_DOCUMENT };
+	for (const auto szType : szTypes)
+	{
+		luaL_newmetatable(lua_state, szType);
+		lua_pushcfunction(lua_state, l_domoticz_documentGC);
+		lua_setfield(lua_state, -2, "__gc");
+		// doc:path('.name') / doc:xpath('//name/text()')
+		lua_createtable(lua_state, 0, 1);
+		if (strcmp(szType, LUA_JSON_DOCUMENT) == 0)
+		{
+			lua_pushcfunction(lua_state, l_domoticz_applyJsonPath);
+			lua_setfield(lua_state, -2, "path");
+		}
+		else
+		{
+			lua_pushcfunction(lua_state, l_domoticz_applyXPath);
+			lua_setfield(lua_state, -2, "xpath");
+		}
+		lua_setfield(lua_state, -2, "__index");
+		lua_pop(lua_state, 1);
+	}
+
+	lua_pushcfunction(lua_state, l_domoticz_applyJsonPath);
+	lua_setglobal(lua_state, "domoticz_applyJsonPath");
+
+	lua_pushcfunction(lua_state, l_domoticz_applyXPath);
+	lua_setglobal(lua_state, "domoticz_applyXPath");
+
+	lua_pushcfunction(lua_state, l_domoticz_parseJson);
+	lua_setglobal(lua_state, "domoticz_parseJson");
+
+	lua_pushcfunction(lua_state, l_domoticz_parseXml);
+	lua_setglobal(lua_state, "domoticz_parseXml");
+}
+
+void CLuaCommon::ClearDocumentCache(lua_State* lua_state)
+{
+	lua_pushnil(lua_state);
+	lua_setfield(lua_state, LUA_REGISTRYINDEX, LUA_JSON_DOCUMENT);
+	lua_pushnil(lua_state);
+	lua_setfield(lua_state, LUA_REGISTRYINDEX, LUA_XML_DOCUMENT);
+}
+
+// Returns the document for argument 1, either a document handle or a string that
+// is parsed (once) and cached in the registry as { source, document }
+void* CLuaCommon::GetDocument(lua_State* lua_state, const char* szType)
+{
+	if (lua_type(lua_state, 1) == LUA_TUSERDATA)
+		return luaL_testudata(lua_state, 1, szType);
+	if (!lua_isstring(lua_state, 1))
+		return nullptr;
+
+	void* pDoc = nullptr;
+	lua_getfield(lua_state, LUA_REGISTRYINDEX, szType);
+	if (lua_istable(lua_state, -1))
+	{
+		lua_rawgeti(lua_state, -1, 1);
+		if (lua_rawequal(lua_state, -1, 1))
+		{
+			lua_rawgeti(lua_state, -2, 2);
+			pDoc = lua_touserdata(lua_state, -1);
+			lua_pop(lua_state, 1);
+		}
+		lua_pop(lua_state, 1);
+	}
+	lua_pop(lua_state, 1);
+	if (pDoc)
+		return pDoc;
+
+	lua_createtable(lua_state, 2, 0);
+	lua_pushvalue(lua_state, 1);
+	lua_rawseti(lua_state, -2, 1);
+	pDoc = NewDocument(lua_state, szType);
+	if (!ParseDocument(pDoc, szType, lua_tostring(lua_state, 1)))
+	{
+		lua_pop(lua_state, 2);
+		return nullptr;
+	}
+	lua_rawseti(lua_state, -2, 2);
+	lua_setfield(lua_state, LUA_REGISTRYINDEX, szType);
+	return pDoc;
+}
+
+int CLuaCommon::l_domoticz_parseJson(lua_State* lua_state)
+{
+	if ((lua_gettop(lua_state) < 1) || !lua_isstring(lua_state, 1))
+	{
+		_log.Log(LOG_ERROR, "CLuaHandler (parseJson from LUA) : Incorrect parameters type");
+		return 0;
+	}
+	void* pDoc = NewDocument(lua_state, LUA_JSON_DOCUMENT);
+	if (!ParseDocument(pDoc, LUA_JSON_DOCUMENT, lua_tostring(lua_state, 1)))
+	{
+		_log.Log(LOG_ERROR, "CLuaHandler (parseJson from LUA) : Invalid Json data received");
+		lua_pushnil(lua_state);
+	}
+	return 1;
+}
+
+int CLuaCommon::l_domoticz_parseXml(lua_State* lua_state)
+{
+	if ((lua_gettop(lua_state) < 1) || !lua_isstring(lua_state, 1))
+	{
+		_log.Log(LOG_ERROR, "CLuaHandler (parseXml from LUA) : Incorrect parameters type");
+		return 0;
+	}
+	void* pDoc = NewDocument(lua_state, LUA_XML_DOCUMENT);
+	if (!ParseDocument(pDoc, LUA_XML_DOCUMENT, lua_tostring(lua_state, 1)))
+	{
+		_log.Log(LOG_ERROR, "CLuaHandler (parseXml from LUA) : Invalid data received!");
+		lua_pushnil(lua_state);
+	}
+	return 1;
+}
+
 int CLuaCommon::l_domoticz_applyXPath(lua_State* lua_state)
 {
 	int nargs = lua_gettop(lua_state);
 	if (nargs >= 2)
 	{
-		if (lua_isstring(lua_state, 1) && lua_isstring(lua_state, 2))
+		if ((lua_isstring(lua_state, 1) || lua_isuserdata(lua_state, 1)) && lua_isstring(lua_state, 2))
 		{
-			std::string buffer = lua_tostring(lua_state, 1);
 			std::string xpath = lua_tostring(lua_state, 2);
 
-			TiXmlDocument doc;
-			doc.Parse(buffer.c_str(), nullptr, TIXML_ENCODING_UTF8);
-
-			TiXmlElement* root = doc.RootElement();
+			TiXmlDocument* pDoc = static_cast<TiXmlDocument*>(GetDocument(lua_state, LUA_XML_DOCUMENT));
+			TiXmlElement* root = (pDoc) ? pDoc->RootElement() : nullptr;
 			if (!root)
 			{
 				_log.Log(LOG_ERROR, "CLuaHandler (applyXPath from LUA) : Invalid data received!");
@@ -61,14 +212,12 @@ int CLuaCommon::l_domoticz_applyJsonPath(lua_State* lua_state)
 	int nargs = lua_gettop(lua_state);
 	if (nargs >= 2)
 	{
-		if (lua_isstring(lua_state, 1) && lua_isstring(lua_state, 2))
+		if ((lua_isstring(lua_state, 1) || lua_isuserdata(lua_state, 1)) && lua_isstring(lua_state, 2))
 		{
-			std::string buffer = lua_tostring(lua_state, 1);
 			std::string jsonpath = lua_tostring(lua_state, 2);
 
-			Json::Value root;
-			bool bRet = ParseJSon(buffer, root);
-			if (!bRet)
+			Json::Value* pRoot = static_cast<Json::Value*>(GetDocument(lua_state, LUA_JSON_DOCUMENT));
+			if (!pRoot)
 			{
 				_log.Log(LOG_ERROR, "CLuaHandler (applyJsonPath from LUA) : Invalid Json data received");
 				return 0;
@@ -117,7 +266,7 @@ int CLuaCommon::l_domoticz_applyJsonPath(lua_State* lua_state)
 						{
 							if (lua_isstring(lua_state, 6))
 							{
-								arg2 = Json::PathArgument(lua_tostring(lua_state, 6));
+								arg4 = Json::PathArgument(lua_tostring(lua_state, 6));
 							}
 							else
 							{
@@ -145,7 +294,7 @@ int CLuaCommon::l_domoticz_applyJsonPath(lua_State* lua_state)
 			{
 				// Apply the JsonPath to the Json
 				Json::Path path(jsonpath, arg1, arg2, arg3, arg4, arg5);
-				Json::Value& node = path.make(root);
+				const Json::Value& node = path.resolve(*pRoot);
 
 				// Check if some data has been found
 				if (!node.isNull())
@@ -12,4 +12,15 @@ public:
 protected:
 	static int l_domoticz_applyJsonPath(lua_State* lua_state);
 	static int l_domoticz_applyXPath(lua_State* lua_state);
+	static int l_domoticz_parseJson(lua_State* lua_state);
+	static int l_domoticz_parseXml(lua_State* lua_state);
+
+	// Registers the document parse/query functions above as globals
+	static void RegisterDocumentFunctions(lua_State* lua_state);
+	// Drops the documents that were parsed implicitly by applyJsonPath/applyXPath
+	static void ClearDocumentCache(lua_State* lua_state);
+
+private:
+	static void* GetDocument(lua_State* lua_state, const char* szType);
+	static int l_domoticz_documentGC(lua_State* lua_state);
 };
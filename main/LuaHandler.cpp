@@ -86,18 +86,96 @@ int CLuaHandler::l_domoticz_print(lua_State* lua_state)
 	return 0;
 }
 
+#define LUA_HANDLER_ENV "domoticz.LuaHandlerEnv"
+
+// Globals that are only exported (through the environment __index) when a script uses them
+static const char *szDeviceStateTables[] = {
+	"otherdevices", "otherdevices_lastupdate", "otherdevices_svalues", "otherdevices_idx", "otherdevices_lastlevel", nullptr,
+};
+
+int CLuaHandler::l_domoticz_index(lua_State* lua_state)
+{
+	// Shared globals first (libraries and domoticz_ functions)
+	lua_pushglobaltable(lua_state);
+	lua_pushvalue(lua_state, 2);
+	if (lua_rawget(lua_state, -2) != LUA_TNIL)
+		return 1;
+	lua_pop(lua_state, 2);
+
+	const char *szKey = (lua_type(lua_state, 2) == LUA_TSTRING) ? lua_tostring(lua_state, 2) : nullptr;
+	bool bDeviceStates = false;
+	for (int ii = 0; szKey && szDeviceStateTables[ii]; ii++)
+		bDeviceStates |= (strcmp(szKey, szDeviceStateTables[ii]) == 0);
+	if (!bDeviceStates)
+	{
+		lua_pushnil(lua_state);
+		return 1;
+	}
+
+	CEventSystem::_tEventQueue item;
+	item.reason = CEventSystem::REASON_DEVICE;
+	item.id = 0;
+	m_mainworker.m_eventsystem.ExportDeviceStatesToLua(lua_state, item);
+
+	// Move the exported tables from the shared globals into this run's environment
+	for (int ii = 0; szDeviceStateTables[ii]; ii++)
+	{
+		lua_getglobal(lua_state, szDeviceStateTables[ii]);
+		lua_setfield(lua_state, 1, szDeviceStateTables[ii]);
+		lua_pushnil(lua_state);
+		lua_setglobal(lua_state, szDeviceStateTables[ii]);
+	}
+	lua_getfield(lua_state, 1, szKey);
+	return 1;
+}
+
 CLuaHandler::CLuaHandler(int hwdID)
 {
 	m_HwdID = hwdID;
 }
 
-void CLuaHandler::luaThread(lua_State *lua_state, const std::string &filename)
+CLuaHandler::~CLuaHandler()
+{
+	if (m_lua_state)
+		lua_close(m_lua_state);
+}
+
+lua_State *CLuaHandler::GetLuaState()
+{
+	if (m_lua_state)
+		return m_lua_state;
+
+	m_lua_state = luaL_newstate();
+
+	luaL_openlibs(m_lua_state);
+	lua_pushcfunction(m_lua_state, l_domoticz_print);
+	lua_setglobal(m_lua_state, "print");
+
+	lua_pushcfunction(m_lua_state, l_domoticz_updateDevice);
+	lua_setglobal(m_lua_state, "domoticz_updateDevice");
+
+	RegisterDocumentFunctions(m_lua_state);
+
+	luaL_newmetatable(m_lua_state, LUA_HANDLER_ENV);
+	lua_pushcfunction(m_lua_state, l_domoticz_index);
+	lua_setfield(m_lua_state, -2, "__index");
+	lua_pop(m_lua_state, 1);
+
+	return m_lua_state;
+}
+
+void CLuaHandler::luaThread(lua_State *lua_state, const std::string &filename, const std::shared_ptr<std::atomic<bool>> &pDone)
 {
 	int status;
 
 	status = lua_pcall(lua_state, 0, LUA_MULTRET, 0);
 	report_errors(lua_state, status);
-	lua_close(lua_state);
+	lua_settop(lua_state, 0);
+	ClearDocumentCache(lua_state);
+
+	// The handler gave up waiting on us, the state is ours to close
+	if (pDone->exchange(true))
+		lua_close(lua_state);
 }
 
 void CLuaHandler::luaStop(lua_State *L, lua_Debug *ar)
@@ -107,7 +185,6 @@ void CLuaHandler::luaStop(lua_State *L, lua_Debug *ar)
 		(void)ar;  /* unused arg. */
 		lua_sethook(L, nullptr, 0, 0);
 		luaL_error(L, "LuaHandler: Lua script execution exceeds maximum number of lines");
-		lua_close(L);
 	}
 }
 
@@ -135,34 +212,27 @@ bool CLuaHandler::executeLuaScript(const std::string &script, const std::string
 #endif
 	std::string lua_Dir = lua_DirT.str();
 
-	lua_State *lua_state;
-	lua_state = luaL_newstate();
-
-	luaL_openlibs(lua_state);
-	lua_pushcfunction(lua_state, l_domoticz_print);
-	lua_setglobal(lua_state, "print");
-
-	lua_pushcfunction(lua_state, l_domoticz_updateDevice);
-	lua_setglobal(lua_state, "domoticz_updateDevice");
+	lua_State *lua_state = GetLuaState();
 
-	lua_pushcfunction(lua_state, l_domoticz_applyJsonPath);
-	lua_setglobal(lua_state, "domoticz_applyJsonPath");
+	std::string fullfilename = lua_Dir + script;
+	int status = luaL_loadfile(lua_state, fullfilename.c_str());
+	if (status != 0)
+	{
+		report_errors(lua_state, status);
+		return false;
+	}
 
-	lua_pushcfunction(lua_state, l_domoticz_applyXPath);
-	lua_setglobal(lua_state, "domoticz_applyXPath");
+	// Fresh environment for this run, unknown names are looked up in the shared globals
+	lua_createtable(lua_state, 0, 3);
 
 	lua_pushinteger(lua_state, m_HwdID);
-	lua_setglobal(lua_state, "hwdId");
+	lua_setfield(lua_state, -2, "hwdId");
 
 	lua_createtable(lua_state, 1, 0);
 	lua_pushstring(lua_state, "content");
-	lua_pushstring(lua_state, content.c_str());
+	lua_pushlstring(lua_state, content.c_str(), content.size());
 	lua_rawset(lua_state, -3);
-	lua_setglobal(lua_state, "request");
-
-	CEventSystem::_tEventQueue item;
-	item.id = 0;
-	m_mainworker.m_eventsystem.ExportDeviceStatesToLua(lua_state, item);
+	lua_setfield(lua_state, -2, "request");
 
 	// Push all url parameters as a map indexed by the parameter name
 	// Each entry will be uri[<param name>] = <param value>
@@ -179,19 +249,20 @@ bool CLuaHandler::executeLuaScript(const std::string &script, const std::string
 			lua_rawset(lua_state, -3);
 		}
 	}
-	lua_setglobal(lua_state, "uri");
+	lua_setfield(lua_state, -2, "uri");
 
-	std::string fullfilename = lua_Dir + script;
-	int status = luaL_loadfile(lua_state, fullfilename.c_str());
-	if (status == 0)
+	luaL_setmetatable(lua_state, LUA_HANDLER_ENV);
+	lua_setupvalue(lua_state, -2, 1); // _ENV of the loaded chunk
+
+	lua_sethook(lua_state, luaStop, LUA_MASKCOUNT, 10000000);
+	auto pDone = std::make_shared<std::atomic<bool>>(false);
+	boost::thread aluaThread([lua_state, fullfilename, pDone] { luaThread(lua_state, fullfilename, pDone); });
+	SetThreadName(aluaThread.native_handle(), "aluaThread");
+	if (!aluaThread.timed_join(boost::posix_time::seconds(10)) && !pDone->exchange(true))
 	{
-		lua_sethook(lua_state, luaStop, LUA_MASKCOUNT, 10000000);
-		boost::thread aluaThread([this, lua_state, fullfilename] { luaThread(lua_state, fullfilename); });
-		SetThreadName(aluaThread.native_handle(), "aluaThread");
-		aluaThread.timed_join(boost::posix_time::seconds(10));
-		return true;
+		// Script is still running, leave the state to the thread and start over next time
+		_log.Log(LOG_ERROR, "CLuaHandler: script %s did not finish within 10 seconds", script.c_str());
+		m_lua_state = nullptr;
 	}
-	report_errors(lua_state, status);
-	lua_close(lua_state);
-	return false;
+	return true;
 }
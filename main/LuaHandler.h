@@ -3,24 +3,30 @@
 struct lua_State;
 struct lua_Debug;
 
+#include <atomic>
 #include "LuaCommon.h"
+#include "Noncopyable.h"
 
-class CLuaHandler : public CLuaCommon
+class CLuaHandler : public CLuaCommon, domoticz::noncopyable
 {
 public:
 	explicit CLuaHandler(int hwdID = 0);
+	~CLuaHandler();
 
 	bool executeLuaScript(const std::string &script, const std::string &content);
 	bool executeLuaScript(const std::string &script, const std::string &content, std::vector<std::string>& allParameters);
 
 private:
-	void luaThread(lua_State *lua_state, const std::string &filename);
+	lua_State *GetLuaState();
+	static void luaThread(lua_State *lua_state, const std::string &filename, const std::shared_ptr<std::atomic<bool>> &pDone);
 	static void luaStop(lua_State *L, lua_Debug *ar);
-	void report_errors(lua_State *L, int status);
+	static void report_errors(lua_State *L, int status);
 
 	static int l_domoticz_print(lua_State* lua_state);
 	static int l_domoticz_updateDevice(lua_State* lua_state);
+	static int l_domoticz_index(lua_State* lua_state);
 
 	int m_HwdID;
+	// Kept between script runs, every run gets its own global environment
+	lua_State *m_lua_state = nullptr;
 };
-
@@ -0,0 +1,381 @@
+#include "stdafx.h"
+#include "MeterStore.h"
+#include "../hardware/hardwaretypes.h"
+#include <sqlite3.h>
+#include <tuple>
+
+namespace meter_store
+{
+	namespace
+	{
+		constexpr const char *szSelectRow = "SELECT ID, Name, Used, SwitchType, nValue, sValue, LastUpdate, Options, SignalLevel, BatteryLevel FROM DeviceStatus "
+						    "WHERE (HardwareID=?1 AND OrgHardwareID=?2 AND DeviceID=?3 AND Unit=?4 AND Type=?5 AND SubType=?6)";
+		constexpr const char *szUpdateRow = "UPDATE DeviceStatus SET SignalLevel=?1, BatteryLevel=?2, nValue=?3, sValue=?4, LastUpdate=?5 WHERE (ID=?6)";
+		constexpr const char *szUpdateBatteryLevel = "UPDATE DeviceStatus SET BatteryLevel=?1 WHERE (ID=?2)";
+		constexpr const char *szUpdateName = "UPDATE DeviceStatus SET Name=?1 WHERE (ID=?2)";
+
+		// set while the store writes, the update hook ignores its own writes
+		thread_local bool tl_bWriting = false;
+
+		std::string ColumnText(sqlite3_stmt *stmt, const int iCol)
+		{
+			const unsigned char *szText = sqlite3_column_text(stmt, iCol);
+			return (szText != nullptr) ? reinterpret_cast<const char *>(szText) : "";
+		}
+	} // namespace
+
+	bool IsMeterType(const unsigned char devType, const unsigned char subType)
+	{
+		switch (devType)
+		{
+			case pTypeP1Power:
+			case pTypeP1Gas:
+			case pTypeRFXMeter:
+			case pTypeYouLess:
+			case pTypeENERGY:
+			case pTypePOWER:
+			case pTypeCURRENT:
+			case pTypeCURRENTENERGY:
+			case pTypeUsage:
+				return true;
+			case pTypeGeneral:
+				return (subType == sTypeKwh);
+			default:
+				return false;
+		}
+	}
+
+	CStatementCache::~CStatementCache()
+	{
+		Clear();
+	}
+
+	sqlite3_stmt *CStatementCache::Get(sqlite3 *db, const char *szSQL)
+	{
+		if (db != m_db)
+		{
+			Clear();
+			m_db = db;
+		}
+		auto itt = m_statements.find(szSQL);
+		if (itt != m_statements.end())
+		{
+			sqlite3_reset(itt->second);
+			sqlite3_clear_bindings(itt->second);
+			return itt->second;
+		}
+		sqlite3_stmt *stmt = nullptr;
+		if (sqlite3_prepare_v2(db, szSQL, -1, &stmt, nullptr) != SQLITE_OK)
+		{
+			sqlite3_finalize(stmt);
+			return nullptr;
+		}
+		m_statements[szSQL] = stmt;
+		return stmt;
+	}
+
+	void CStatementCache::Clear()
+	{
+		for (auto &itt : m_statements)
+			sqlite3_finalize(itt.second);
+		m_statements.clear();
+		m_db = nullptr;
+	}
+
+	bool _tMeterKey::operator<(const _tMeterKey &other) const
+	{
+		return std::tie(HardwareID, OrgHardwareID, DeviceID, Unit, Type, SubType) <
+		       std::tie(other.HardwareID, other.OrgHardwareID, other.DeviceID, other.Unit, other.Type, other.SubType);
+	}
+
+	void CMeterStore::SetWriteInterval(const int iSeconds)
+	{
+		m_iWriteInterval = (iSeconds > 0) ? iSeconds : 0;
+	}
+
+	int CMeterStore::GetWriteInterval() const
+	{
+		return m_iWriteInterval;
+	}
+
+	sqlite3_stmt *CMeterStore::GetStatement(sqlite3 *db, const char *szSQL)
+	{
+		return m_statements.Get(db, szSQL);
+	}
+
+	void CMeterStore::Invalidate(const uint64_t ID)
+	{
+		if (tl_bWriting)
+			return;
+		std::lock_guard<std::mutex> l(m_invalidMutex);
+		if (m_knownIDs.find(ID) != m_knownIDs.end())
+			m_invalidIDs.push_back(ID);
+	}
+
+	void CMeterStore::ApplyInvalidations()
+	{
+		std::vector<uint64_t> invalidIDs;
+		{
+			std::lock_guard<std::mutex> l(m_invalidMutex);
+			if (m_invalidIDs.empty())
+				return;
+			invalidIDs.swap(m_invalidIDs);
+		}
+		for (const auto ID : invalidIDs)
+		{
+			auto itt = m_keys.find(ID);
+			if (itt == m_keys.end())
+				continue;
+			auto ittEntry = m_entries.find(itt->second);
+			if (ittEntry != m_entries.end())
+				ittEntry->second.bStale = true;
+		}
+	}
+
+	bool CMeterStore::Read(sqlite3 *db, const _tMeterKey &key, _tMeterRow &row)
+	{
+		sqlite3_stmt *stmt = m_statements.Get(db, szSelectRow);
+		if (stmt == nullptr)
+			return false;
+		sqlite3_bind_int(stmt, 1, key.HardwareID);
+		sqlite3_bind_int(stmt, 2, key.OrgHardwareID);
+		sqlite3_bind_text(stmt, 3, key.DeviceID.c_str(), -1, SQLITE_TRANSIENT);
+		sqlite3_bind_int(stmt, 4, key.Unit);
+		sqlite3_bind_int(stmt, 5, key.Type);
+		sqlite3_bind_int(stmt, 6, key.SubType);
+		bool bFound = (sqlite3_step(stmt) == SQLITE_ROW);
+		if (bFound)
+		{
+			row.ID = static_cast<uint64_t>(sqlite3_column_int64(stmt, 0));
+			row.Name = ColumnText(stmt, 1);
+			row.bUsed = (sqlite3_column_int(stmt, 2) != 0);
+			row.SwitchType = sqlite3_column_int(stmt, 3);
+			row.nValue = sqlite3_column_int(stmt, 4);
+			row.sValue = ColumnText(stmt, 5);
+			row.LastUpdate = ColumnText(stmt, 6);
+			row.Options = ColumnText(stmt, 7);
+			row.SignalLevel = sqlite3_column_int(stmt, 8);
+			row.BatteryLevel = sqlite3_column_int(stmt, 9);
+		}
+		sqlite3_reset(stmt);
+		return bFound;
+	}
+
+	bool CMeterStore::Get(sqlite3 *db, const _tMeterKey &key, _tMeterRow &row)
+	{
+		ApplyInvalidations();
+		auto itt = m_entries.find(key);
+		if ((itt != m_entries.end()) && (!itt->second.bStale))
+		{
+			row = itt->second.row;
+			return true;
+		}
+
+		_tMeterRow dbRow;
+		if (!Read(db, key, dbRow))
+		{
+			// deleted, a pending write has nothing left to update
+			if (itt != m_entries.end())
+			{
+				m_keys.erase(itt->second.row.ID);
+				std::lock_guard<std::mutex> l(m_invalidMutex);
+				m_knownIDs.erase(itt->second.row.ID);
+				m_entries.erase(itt);
+			}
+			return false;
+		}
+
+		if (itt == m_entries.end())
+		{
+			itt = m_entries.emplace(key, _tEntry()).first;
+			itt->second.row = dbRow;
+		}
+		else
+		{
+			_tEntry &entry = itt->second;
+			m_keys.erase(entry.row.ID);
+			if ((entry.bDirty) && (dbRow.ID == entry.row.ID) && (dbRow.nValue == entry.nValueDB) && (dbRow.sValue == entry.sValueDB))
+			{
+				// only other columns were changed (name, options...), the pending value is still the newest
+				entry.row.Name = dbRow.Name;
+				entry.row.bUsed = dbRow.bUsed;
+				entry.row.SwitchType = dbRow.SwitchType;
+				entry.row.Options = dbRow.Options;
+			}
+			else
+			{
+				// the value was changed by someone else and wins over a pending one: a value that was set
+				// through the web or a script must not be overwritten by an older one held back here
+				entry.row = dbRow;
+				entry.bDirty = false;
+			}
+		}
+		itt->second.nValueDB = dbRow.nValue;
+		itt->second.sValueDB = dbRow.sValue;
+		itt->second.bStale = false;
+		m_keys[dbRow.ID] = key;
+		{
+			std::lock_guard<std::mutex> l(m_invalidMutex);
+			m_knownIDs.insert(dbRow.ID);
+		}
+		row = itt->second.row;
+		return true;
+	}
+
+	bool CMeterStore::GetPending(const uint64_t ID, _tMeterRow &row)
+	{
+		ApplyInvalidations();
+		_tEntry *pEntry = FindEntry(ID);
+		if ((pEntry == nullptr) || (!pEntry->bDirty) || (pEntry->bStale))
+			return false;
+		row = pEntry->row;
+		return true;
+	}
+
+	bool CMeterStore::Write(sqlite3 *db, _tEntry &entry, const time_t tNow)
+	{
+		sqlite3_stmt *stmt = m_statements.Get(db, szUpdateRow);
+		if (stmt == nullptr)
+			return false;
+		sqlite3_bind_int(stmt, 1, entry.row.SignalLevel);
+		sqlite3_bind_int(stmt, 2, entry.row.BatteryLevel);
+		sqlite3_bind_int(stmt, 3, entry.row.nValue);
+		sqlite3_bind_text(stmt, 4, entry.row.sValue.c_str(), -1, SQLITE_STATIC);
+		sqlite3_bind_text(stmt, 5, entry.row.LastUpdate.c_str(), -1, SQLITE_STATIC);
+		sqlite3_bind_int64(stmt, 6, static_cast<sqlite3_int64>(entry.row.ID));
+		tl_bWriting = true;
+		bool bOK = (sqlite3_step(stmt) == SQLITE_DONE);
+		tl_bWriting = false;
+		sqlite3_reset(stmt);
+		if (bOK)
+		{
+			entry.bDirty = false;
+			entry.tLastWrite = tNow;
+			entry.nValueDB = entry.row.nValue;
+			entry.sValueDB = entry.row.sValue;
+		}
+		return bOK;
+	}
+
+	CMeterStore::_tEntry *CMeterStore::FindEntry(const uint64_t ID)
+	{
+		auto itt = m_keys.find(ID);
+		if (itt == m_keys.end())
+			return nullptr;
+		auto ittEntry = m_entries.find(itt->second);
+		return (ittEntry != m_entries.end()) ? &ittEntry->second : nullptr;
+	}
+
+	bool CMeterStore::WriteColumn(sqlite3 *db, const char *szSQL, const uint64_t ID, const int iValue, const std::string *pText)
+	{
+		sqlite3_stmt *stmt = m_statements.Get(db, szSQL);
+		if (stmt == nullptr)
+			return false;
+		if (pText != nullptr)
+			sqlite3_bind_text(stmt, 1, pText->c_str(), -1, SQLITE_STATIC);
+		else
+			sqlite3_bind_int(stmt, 1, iValue);
+		sqlite3_bind_int64(stmt, 2, static_cast<sqlite3_int64>(ID));
+		tl_bWriting = true;
+		bool bOK = (sqlite3_step(stmt) == SQLITE_DONE);
+		tl_bWriting = false;
+		sqlite3_reset(stmt);
+		return bOK;
+	}
+
+	bool CMeterStore::WriteBatteryLevel(sqlite3 *db, const uint64_t ID, const int BatteryLevel)
+	{
+		if (!WriteColumn(db, szUpdateBatteryLevel, ID, BatteryLevel, nullptr))
+			return false;
+		_tEntry *pEntry = FindEntry(ID);
+		if (pEntry != nullptr)
+			pEntry->row.BatteryLevel = BatteryLevel;
+		return true;
+	}
+
+	bool CMeterStore::WriteName(sqlite3 *db, const uint64_t ID, const std::string &Name)
+	{
+		if (!WriteColumn(db, szUpdateName, ID, 0, &Name))
+			return false;
+		_tEntry *pEntry = FindEntry(ID);
+		if (pEntry != nullptr)
+			pEntry->row.Name = Name;
+		return true;
+	}
+
+	bool CMeterStore::Update(sqlite3 *db, const _tMeterKey &key, const int nValue, const std::string &sValue, const std::string &LastUpdate, const int SignalLevel,
+				 const int BatteryLevel)
+	{
+		auto itt = m_entries.find(key);
+		if (itt == m_entries.end())
+			return false;
+		_tEntry &entry = itt->second;
+		entry.row.nValue = nValue;
+		entry.row.sValue = sValue;
+		entry.row.LastUpdate = LastUpdate;
+		entry.row.SignalLevel = SignalLevel;
+		entry.row.BatteryLevel = BatteryLevel;
+		entry.bDirty = true;
+
+		time_t tNow = mytime(nullptr);
+		int iInterval = m_iWriteInterval;
+		if ((iInterval > 0) && (tNow - entry.tLastWrite < iInterval))
+			return true; // written by Flush when the interval has passed
+		return Write(db, entry, tNow);
+	}
+
+	int CMeterStore::Flush(sqlite3 *db, const bool bAll)
+	{
+		ApplyInvalidations();
+		// a row that was changed by someone else is read again first, its pending value is dropped when the
+		// value in the database was changed, see Get
+		std::vector<_tMeterKey> staleKeys;
+		for (const auto &itt : m_entries)
+		{
+			if ((itt.second.bDirty) && (itt.second.bStale))
+				staleKeys.push_back(itt.first);
+		}
+		for (const auto &key : staleKeys)
+		{
+			_tMeterRow row;
+			Get(db, key, row);
+		}
+
+		time_t tNow = mytime(nullptr);
+		int iInterval = m_iWriteInterval;
+		std::vector<_tEntry *> pending;
+		for (auto &itt : m_entries)
+		{
+			_tEntry &entry = itt.second;
+			if ((entry.bDirty) && ((bAll) || (tNow - entry.tLastWrite >= iInterval)))
+				pending.push_back(&entry);
+		}
+		if (pending.empty())
+			return 0;
+
+		// one transaction instead of one per row, unless the caller already has one open
+		bool bTransaction = (pending.size() > 1) && (sqlite3_get_autocommit(db) != 0) && (sqlite3_exec(db, "BEGIN TRANSACTION", nullptr, nullptr, nullptr) == SQLITE_OK);
+		int iWritten = 0;
+		bool bOK = true;
+		for (auto pEntry : pending)
+		{
+			if (Write(db, *pEntry, tNow))
+				iWritten++;
+			else
+				bOK = false;
+		}
+		if (bTransaction)
+			sqlite3_exec(db, "COMMIT", nullptr, nullptr, nullptr);
+		return (bOK) ? iWritten : -1;
+	}
+
+	void CMeterStore::Clear()
+	{
+		m_entries.clear();
+		m_keys.clear();
+		m_statements.Clear();
+		std::lock_guard<std::mutex> l(m_invalidMutex);
+		m_knownIDs.clear();
+		m_invalidIDs.clear();
+	}
+} // namespace meter_store
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <ctime>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+struct sqlite3;
+struct sqlite3_stmt;
+
+// DeviceStatus rows of the meters, kept in memory for the meter update path
+//
+// UpdateValueInt read the row of a meter for every update and wrote it back with a statement that was
+// formatted and compiled every time. The store reads a row once and writes it with a cached prepared
+// statement. With a write interval, the updates of a device within the interval only change the row in
+// memory, Flush writes the pending rows in one transaction.
+//
+// The caller serializes access to the database and the store (CSQLHelper holds m_sqlQueryMutex), except
+// for Invalidate, which is called by the update hook for DeviceStatus writes that are not done by the store.
+namespace meter_store
+{
+	// the device types that are updated through the store
+	bool IsMeterType(unsigned char devType, unsigned char subType);
+
+	// Prepared statements, keyed by their SQL text (a string literal, so by address)
+	class CStatementCache
+	{
+	public:
+		~CStatementCache();
+		// a reset statement without bindings, nullptr when it does not compile
+		sqlite3_stmt *Get(sqlite3 *db, const char *szSQL);
+		// finalizes all statements, has to be done before the database is closed
+		void Clear();
+
+	private:
+		sqlite3 *m_db = nullptr;
+		std::unordered_map<const char *, sqlite3_stmt *> m_statements;
+	};
+
+	struct _tMeterKey
+	{
+		int HardwareID = 0;
+		int OrgHardwareID = 0;
+		std::string DeviceID;
+		int Unit = 0;
+		int Type = 0;
+		int SubType = 0;
+		bool operator<(const _tMeterKey &other) const;
+	};
+
+	struct _tMeterRow
+	{
+		uint64_t ID = 0;
+		std::string Name;
+		bool bUsed = false;
+		int SwitchType = 0;
+		int nValue = 0;
+		std::string sValue;
+		std::string LastUpdate;
+		std::string Options;
+		int SignalLevel = 0;
+		int BatteryLevel = 0;
+	};
+
+	class CMeterStore
+	{
+	public:
+		// seconds in which the updates of a device are coalesced, 0 writes every update
+		void SetWriteInterval(int iSeconds);
+		int GetWriteInterval() const;
+
+		// the row of the device, read from DeviceStatus on first use; false when there is no such device
+		bool Get(sqlite3 *db, const _tMeterKey &key, _tMeterRow &row);
+		// stores the new value of a device read with Get, written right away when the interval since the
+		// last write has passed. False when the write failed
+		bool Update(sqlite3 *db, const _tMeterKey &key, int nValue, const std::string &sValue, const std::string &LastUpdate, int SignalLevel, int BatteryLevel);
+		// the row of a device whose value is held back by the write interval, false when nothing is pending
+		bool GetPending(uint64_t ID, _tMeterRow &row);
+		// write the battery level/name of any device without marking its row as changed by someone else,
+		// a cached row is updated as well. False when the write failed
+		bool WriteBatteryLevel(sqlite3 *db, uint64_t ID, int BatteryLevel);
+		bool WriteName(sqlite3 *db, uint64_t ID, const std::string &Name);
+		// writes the pending rows whose interval has passed, or all of them. Returns the number of rows
+		// written, -1 when a write failed
+		int Flush(sqlite3 *db, bool bAll);
+
+		// the DeviceStatus row was changed or deleted by someone else, it is read again on next use
+		void Invalidate(uint64_t ID);
+		// forgets all rows (pending writes included) and statements, before the database is closed or replaced
+		void Clear();
+
+		sqlite3_stmt *GetStatement(sqlite3 *db, const char *szSQL);
+
+	private:
+		struct _tEntry
+		{
+			_tMeterRow row;
+			bool bDirty = false;
+			bool bStale = false;
+			time_t tLastWrite = 0;
+			// the value in DeviceStatus as far as the store knows, a pending value is only dropped when
+			// someone else changed it
+			int nValueDB = 0;
+			std::string sValueDB;
+		};
+		void ApplyInvalidations();
+		_tEntry *FindEntry(uint64_t ID);
+		bool WriteColumn(sqlite3 *db, const char *szSQL, uint64_t ID, int iValue, const std::string *pText);
+		bool Read(sqlite3 *db, const _tMeterKey &key, _tMeterRow &row);
+		bool Write(sqlite3 *db, _tEntry &entry, time_t tNow);
+
+		std::atomic<int> m_iWriteInterval{ 0 };
+		CStatementCache m_statements;
+		std::map<_tMeterKey, _tEntry> m_entries;
+		std::unordered_map<uint64_t, _tMeterKey> m_keys;
+
+		// filled by Invalidate, which can run without the caller's lock
+		std::mutex m_invalidMutex;
+		std::unordered_set<uint64_t> m_knownIDs;
+		std::vector<uint64_t> m_invalidIDs;
+	};
+} // namespace meter_store
@@ -0,0 +1,158 @@
+#include "stdafx.h"
+#include "Metrics.h"
+
+namespace metrics
+{
+	namespace
+	{
+		template <class T> CFamily<T> &GetFamily(std::map<std::string, std::unique_ptr<CFamily<T>>> &families, const std::string &name, const std::string &help, const std::string &labelName)
+		{
+			auto &pFamily = families[name];
+			if (!pFamily)
+				pFamily = std::make_unique<CFamily<T>>(name, help, labelName);
+			return *pFamily;
+		}
+
+		void AppendLabel(std::string &out, const std::string &labelName, const std::string &labelValue)
+		{
+			out += labelName;
+			out += "=\"";
+			for (const char c : labelValue)
+			{
+				if (c == '\\')
+					out += "\\\\";
+				else if (c == '"')
+					out += "\\\"";
+				else if (c == '\n')
+					out += "\\n";
+				else
+					out += c;
+			}
+			out += '"';
+		}
+
+		void AppendHeader(std::string &out, const std::string &name, const std::string &help, const char *szType)
+		{
+			out += "# HELP " + name + " " + help + "\n";
+			out += "# TYPE " + name + " " + szType + "\n";
+		}
+
+		std::string SecondsString(const uint64_t us)
+		{
+			char szTmp[32];
+			snprintf(szTmp, sizeof(szTmp), "%.9g", static_cast<double>(us) / 1000000.0);
+			return szTmp;
+		}
+	} // namespace
+
+	void CHistogram::Observe(const uint64_t valueUs)
+	{
+		int bucket = 0;
+		uint64_t v = (valueUs > 0) ? valueUs - 1 : 0;
+		while ((v != 0) && (bucket < BUCKETS - 1))
+		{
+			v >>= 1;
+			bucket++;
+		}
+		m_buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+		m_sumUs.fetch_add(valueUs, std::memory_order_relaxed);
+	}
+
+	void CHistogram::Snapshot(uint64_t (&buckets)[BUCKETS], uint64_t &count, uint64_t &sumUs) const
+	{
+		for (int ii = 0; ii < BUCKETS; ii++)
+			buckets[ii] = m_buckets[ii].load(std::memory_order_relaxed);
+		sumUs = m_sumUs.load(std::memory_order_relaxed);
+		// the count is the sum of the buckets, so it always matches the +Inf bucket
+		count = 0;
+		for (const auto bucket : buckets)
+			count += bucket;
+	}
+
+	CFamily<CCounter> &CRegistry::Counter(const std::string &name, const std::string &help, const std::string &labelName)
+	{
+		std::lock_guard<std::mutex> l(m_mutex);
+		return GetFamily(m_counters, name, help, labelName);
+	}
+
+	CFamily<CGauge> &CRegistry::Gauge(const std::string &name, const std::string &help, const std::string &labelName)
+	{
+		std::lock_guard<std::mutex> l(m_mutex);
+		return GetFamily(m_gauges, name, help, labelName);
+	}
+
+	CFamily<CHistogram> &CRegistry::Histogram(const std::string &name, const std::string &help, const std::string &labelName)
+	{
+		std::lock_guard<std::mutex> l(m_mutex);
+		return GetFamily(m_histograms, name, help, labelName);
+	}
+
+	void CRegistry::AddCollector(const std::function<void()> &collector)
+	{
+		std::lock_guard<std::mutex> l(m_mutex);
+		m_collectors.push_back(collector);
+	}
+
+	std::string CRegistry::Render()
+	{
+		std::vector<std::function<void()>> collectors;
+		{
+			std::lock_guard<std::mutex> l(m_mutex);
+			collectors = m_collectors;
+		}
+		// collectors may create series, so they run without holding the registry lock
+		for (const auto &collector : collectors)
+			collector();
+
+		std::string out;
+		out.reserve(64 * 1024);
+
+		std::lock_guard<std::mutex> l(m_mutex);
+		for (const auto &family : m_counters)
+		{
+			AppendHeader(out, family.first, family.second->m_help, "counter");
+			family.second->ForEach([&](const std::string &labelValue, const CCounter &series) {
+				out += family.first + "{";
+				AppendLabel(out, family.second->m_labelName, labelValue);
+				out += "} " + std::to_string(series.Value()) + "\n";
+			});
+		}
+		for (const auto &family : m_gauges)
+		{
+			AppendHeader(out, family.first, family.second->m_help, "gauge");
+			family.second->ForEach([&](const std::string &labelValue, const CGauge &series) {
+				out += family.first + "{";
+				AppendLabel(out, family.second->m_labelName, labelValue);
+				out += "} " + std::to_string(series.Value()) + "\n";
+			});
+		}
+		for (const auto &family : m_histograms)
+		{
+			AppendHeader(out, family.first, family.second->m_help, "histogram");
+			family.second->ForEach([&](const std::string &labelValue, const CHistogram &series) {
+				uint64_t buckets[CHistogram::BUCKETS];
+				uint64_t count, sumUs;
+				series.Snapshot(buckets, count, sumUs);
+
+				std::string labels;
+				AppendLabel(labels, family.second->m_labelName, labelValue);
+				uint64_t cumulative = 0;
+				for (int ii = 0; ii < CHistogram::BUCKETS; ii++)
+				{
+					cumulative += buckets[ii];
+					std::string le = (ii < CHistogram::BUCKETS - 1) ? SecondsString(CHistogram::UpperBoundUs(ii)) : "+Inf";
+					out += family.first + "_bucket{" + labels + ",le=\"" + le + "\"} " + std::to_string(cumulative) + "\n";
+				}
+				out += family.first + "_sum{" + labels + "} " + SecondsString(sumUs) + "\n";
+				out += family.first + "_count{" + labels + "} " + std::to_string(count) + "\n";
+			});
+		}
+		return out;
+	}
+
+	CRegistry &Registry()
+	{
+		static CRegistry registry;
+		return registry;
+	}
+} // namespace metrics
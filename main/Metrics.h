@@ -0,0 +1,165 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+
+// Runtime metrics, served in the Prometheus text format at /metrics
+//
+// Counters, gauges and histograms only use relaxed atomics, so they can be updated from any thread on the
+// hot paths. Every metric family has one label (hardware, statement, script, ...), a series is created the
+// first time a label value is used and lives as long as the process. Keep the label values a bounded set.
+namespace metrics
+{
+	class CCounter
+	{
+	public:
+		void Inc(const uint64_t value = 1)
+		{
+			m_value.fetch_add(value, std::memory_order_relaxed);
+		}
+		uint64_t Value() const
+		{
+			return m_value.load(std::memory_order_relaxed);
+		}
+
+	private:
+		std::atomic<uint64_t> m_value{ 0 };
+	};
+
+	class CGauge
+	{
+	public:
+		void Set(const int64_t value)
+		{
+			m_value.store(value, std::memory_order_relaxed);
+		}
+		void Add(const int64_t value)
+		{
+			m_value.fetch_add(value, std::memory_order_relaxed);
+		}
+		int64_t Value() const
+		{
+			return m_value.load(std::memory_order_relaxed);
+		}
+
+	private:
+		std::atomic<int64_t> m_value{ 0 };
+	};
+
+	// Durations in microseconds, one bucket per power of two (1us .. 2^26us, about 67s) like a coarse HDR histogram
+	class CHistogram
+	{
+	public:
+		static constexpr int BUCKETS = 28; // the last one is +Inf
+
+		void Observe(uint64_t valueUs);
+		void ObserveSince(const std::chrono::steady_clock::time_point tStart)
+		{
+			Observe(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - tStart).count());
+		}
+		static uint64_t UpperBoundUs(int bucket)
+		{
+			return 1ULL << bucket;
+		}
+		void Snapshot(uint64_t (&buckets)[BUCKETS], uint64_t &count, uint64_t &sumUs) const;
+
+	private:
+		std::atomic<uint64_t> m_buckets[BUCKETS] = {};
+		std::atomic<uint64_t> m_sumUs{ 0 };
+	};
+
+	// Measures a scope into a histogram
+	class CScopeTimer
+	{
+	public:
+		explicit CScopeTimer(CHistogram &histogram)
+			: m_histogram(histogram)
+			, m_tStart(std::chrono::steady_clock::now())
+		{
+		}
+		~CScopeTimer()
+		{
+			m_histogram.ObserveSince(m_tStart);
+		}
+		CScopeTimer(const CScopeTimer &) = delete;
+		CScopeTimer &operator=(const CScopeTimer &) = delete;
+
+	private:
+		CHistogram &m_histogram;
+		std::chrono::steady_clock::time_point m_tStart;
+	};
+
+	template <class T> class CFamily
+	{
+	public:
+		CFamily(const std::string &name, const std::string &help, const std::string &labelName)
+			: m_name(name)
+			, m_help(help)
+			, m_labelName(labelName)
+		{
+		}
+
+		// the returned series stays valid for the lifetime of the process
+		T &Get(const std::string &labelValue)
+		{
+			{
+				std::shared_lock<std::shared_mutex> lock(m_mutex);
+				auto itt = m_series.find(labelValue);
+				if (itt != m_series.end())
+					return *itt->second;
+			}
+			std::unique_lock<std::shared_mutex> lock(m_mutex);
+			auto &pSeries = m_series[labelValue];
+			if (!pSeries)
+				pSeries = std::make_unique<T>();
+			return *pSeries;
+		}
+
+		void ForEach(const std::function<void(const std::string &labelValue, const T &series)> &fn)
+		{
+			std::shared_lock<std::shared_mutex> lock(m_mutex);
+			for (const auto &series : m_series)
+				fn(series.first, *series.second);
+		}
+
+		const std::string m_name;
+		const std::string m_help;
+		const std::string m_labelName;
+
+	private:
+		std::shared_mutex m_mutex;
+		std::map<std::string, std::unique_ptr<T>> m_series;
+	};
+
+	class CRegistry
+	{
+	public:
+		// families are created once (usually from a static), asking again for the same name returns the existing family
+		CFamily<CCounter> &Counter(const std::string &name, const std::string &help, const std::string &labelName);
+		CFamily<CGauge> &Gauge(const std::string &name, const std::string &help, const std::string &labelName);
+		CFamily<CHistogram> &Histogram(const std::string &name, const std::string &help, const std::string &labelName);
+
+		// called before every scrape, to set gauges from state that is already tracked elsewhere (queue sizes)
+		void AddCollector(const std::function<void()> &collector);
+
+		// Prometheus text exposition format 0.0.4
+		std::string Render();
+
+	private:
+		std::mutex m_mutex;
+		std::map<std::string, std::unique_ptr<CFamily<CCounter>>> m_counters;
+		std::map<std::string, std::unique_ptr<CFamily<CGauge>>> m_gauges;
+		std::map<std::string, std::unique_ptr<CFamily<CHistogram>>> m_histograms;
+		std::vector<std::function<void()>> m_collectors;
+	};
+
+	CRegistry &Registry();
+} // namespace metrics
@@ -5,6 +5,7 @@
 #include "../hardware/hardwaretypes.h"
 #include "Helper.h"
 #include "Logger.h"
+#include <unordered_map>
 
 typedef struct _STR_TABLE_SINGLE {
 	unsigned long    id;
@@ -48,6 +49,75 @@ const char* findTableID1ID2(const _STR_TABLE_ID1_ID2* t, const unsigned long id1
 	return "Unknown";
 }
 
+namespace
+{
+	// Id indexed lookup over a (static) STR_TABLE_SINGLE, built once on first use.
+	// Returns the same as findTableIDSingle1/2: the first matching entry up to the terminator.
+	class CTableIndexSingle
+	{
+	public:
+		CTableIndexSingle(const STR_TABLE_SINGLE* t, const bool bStr2)
+		{
+			for (; (bStr2 ? t->str2 : t->str1) != nullptr; t++)
+			{
+				const char* str = bStr2 ? t->str2 : t->str1;
+				if (t->id < iMaxDirectID)
+				{
+					if (t->id >= m_direct.size())
+						m_direct.resize(t->id + 1, nullptr);
+					if (m_direct[t->id] == nullptr)
+						m_direct[t->id] = str;
+				}
+				else
+					m_sparse.insert(std::make_pair(t->id, str));
+				m_names.insert(std::make_pair(std::string(str), t->id));
+			}
+		}
+		const char* Find(const unsigned long id) const
+		{
+			if (id < m_direct.size())
+				return (m_direct[id] != nullptr) ? m_direct[id] : "Unknown";
+			auto itt = m_sparse.find(id);
+			return (itt != m_sparse.end()) ? itt->second : "Unknown";
+		}
+		// first id with this name, -1 when unknown
+		int FindID(const std::string& name) const
+		{
+			auto itt = m_names.find(name);
+			return (itt != m_names.end()) ? static_cast<int>(itt->second) : -1;
+		}
+
+	private:
+		static constexpr unsigned long iMaxDirectID = 4096;
+		std::vector<const char*> m_direct;
+		std::unordered_map<unsigned long, const char*> m_sparse;
+		std::unordered_map<std::string, unsigned long> m_names;
+	};
+
+	// Same for STR_TABLE_ID1_ID2, keyed on both ids
+	class CTableIndexID1ID2
+	{
+	public:
+		explicit CTableIndexID1ID2(const STR_TABLE_ID1_ID2* t)
+		{
+			for (; t->str1 != nullptr; t++)
+				m_index.insert(std::make_pair(Key(t->id1, t->id2), t->str1));
+		}
+		const char* Find(const unsigned long id1, const unsigned long id2) const
+		{
+			auto itt = m_index.find(Key(id1, id2));
+			return (itt != m_index.end()) ? itt->second : "Unknown";
+		}
+
+	private:
+		static uint64_t Key(const unsigned long id1, const unsigned long id2)
+		{
+			return (static_cast<uint64_t>(id1) << 32) | static_cast<uint32_t>(id2);
+		}
+		std::unordered_map<uint64_t, const char*> m_index;
+	};
+} // namespace
+
 const char* RFX_Humidity_Status_Desc(const unsigned char status)
 {
 	static const STR_TABLE_SINGLE Table[] = {
@@ -136,7 +206,8 @@ const char* Timer_Type_Desc(const int tType)
 		{ TTYPE_AFTERASTTWEND, "After Astronomical Twilight End" },
 		{ 0, nullptr, nullptr },
 	};
-	return findTableIDSingle1(Table, tType);
+	static const CTableIndexSingle Index(Table, false);
+	return Index.Find(tType);
 }
 
 const char* Timer_Cmd_Desc(const int tType)
@@ -282,17 +353,29 @@ static const STR_TABLE_SINGLE HardwareTypeTable[] = {
 	{ 0, nullptr, nullptr },
 };
 
+static const CTableIndexSingle& HardwareTypeIndex()
+{
+	static const CTableIndexSingle Index(HardwareTypeTable, false);
+	return Index;
+}
+
 const char* Hardware_Type_Desc(int hType)
 {
-	return findTableIDSingle1(HardwareTypeTable, hType);
+	return HardwareTypeIndex().Find(hType);
 }
 
 const char* Hardware_Short_Desc(int hType)
 {
-	return findTableIDSingle2(HardwareTypeTable, hType);
+	static const CTableIndexSingle Index(HardwareTypeTable, true);
+	return Index.Find(hType);
 }
 
-const char* Switch_Type_Desc(const _eSwitchType sType)
+int Hardware_Type_FromDesc(const std::string& szDesc)
+{
+	return HardwareTypeIndex().FindID(szDesc);
+}
+
+static const CTableIndexSingle& SwitchTypeIndex()
 {
 	static const STR_TABLE_SINGLE Table[] = {
 		{ STYPE_OnOff, "On/Off" },
@@ -318,10 +401,21 @@ const char* Switch_Type_Desc(const _eSwitchType sType)
 		{ STYPE_BlindsWithStop, "Blinds + Stop" },
 		{ 0, nullptr, nullptr },
 	};
-	return findTableIDSingle1(Table, sType);
+	static const CTableIndexSingle Index(Table, false);
+	return Index;
 }
 
-const char* Meter_Type_Desc(const _eMeterType sType)
+const char* Switch_Type_Desc(const _eSwitchType sType)
+{
+	return SwitchTypeIndex().Find(sType);
+}
+
+int Switch_Type_FromDesc(const std::string& szDesc)
+{
+	return SwitchTypeIndex().FindID(szDesc);
+}
+
+static const CTableIndexSingle& MeterTypeIndex()
 {
 	static const STR_TABLE_SINGLE Table[] = {
 		{ MTYPE_ENERGY, "Energy" },
@@ -332,10 +426,21 @@ const char* Meter_Type_Desc(const _eMeterType sType)
 		{ MTYPE_TIME, "Time" },
 		{ 0, nullptr, nullptr },
 	};
-	return findTableIDSingle1(Table, sType);
+	static const CTableIndexSingle Index(Table, false);
+	return Index;
 }
 
-const char* Notification_Type_Desc(const int nType, const unsigned char snum)
+const char* Meter_Type_Desc(const _eMeterType sType)
+{
+	return MeterTypeIndex().Find(sType);
+}
+
+int Meter_Type_FromDesc(const std::string& szDesc)
+{
+	return MeterTypeIndex().FindID(szDesc);
+}
+
+static const CTableIndexSingle& NotificationTypeIndex(const unsigned char snum)
 {
 	static const STR_TABLE_SINGLE Table[] = {
 		{ NTYPE_TEMPERATURE, "Temperature", "T" },
@@ -369,9 +474,19 @@ const char* Notification_Type_Desc(const int nType, const unsigned char snum)
 		{ NTYPE_LASTUPDATE, "Last Update", "J" },
 		{ 0, nullptr, nullptr },
 	};
-	if (snum == 0)
-		return findTableIDSingle1(Table, nType);
-	return findTableIDSingle2(Table, nType);
+	static const CTableIndexSingle Index1(Table, false);
+	static const CTableIndexSingle Index2(Table, true);
+	return (snum == 0) ? Index1 : Index2;
+}
+
+const char* Notification_Type_Desc(const int nType, const unsigned char snum)
+{
+	return NotificationTypeIndex(snum).Find(nType);
+}
+
+int Notification_Type_FromDesc(const std::string& szDesc, const unsigned char snum)
+{
+	return NotificationTypeIndex(snum).FindID(szDesc);
 }
 
 const char* Notification_Type_Label(const int nType)
@@ -408,7 +523,8 @@ const char* Notification_Type_Label(const int nType)
 		{ NTYPE_LASTUPDATE, "minutes" },
 		{ 0, nullptr, nullptr },
 	};
-	return findTableIDSingle1(Table, nType);
+	static const CTableIndexSingle Index(Table, false);
+	return Index.Find(nType);
 }
 
 const char* RFX_Forecast_Desc(const unsigned char Forecast)
@@ -527,10 +643,12 @@ const char* RFX_Type_Desc(const unsigned char i, const unsigned char snum)
 		{ pTypeHoneywell_AL, "Honeywell", "doorbell" },
 		{ 0, nullptr, nullptr },
 	};
+	static const CTableIndexSingle Index1(Table, false);
+	static const CTableIndexSingle Index2(Table, true);
 	if (snum == 1)
-		return findTableIDSingle1(Table, i);
+		return Index1.Find(i);
 
-	return findTableIDSingle2(Table, i);
+	return Index2.Find(i);
 }
 
 const char* RFX_Type_SubType_Desc(const unsigned char dType, const unsigned char sType)
@@ -960,7 +1078,8 @@ const char* RFX_Type_SubType_Desc(const unsigned char dType, const unsigned char
 
 		{ 0, 0, nullptr },
 	};
-	return findTableID1ID2(Table, dType, sType);
+	static const CTableIndexID1ID2 Index(Table);
+	return Index.Find(dType, sType);
 }
 
 const char* Media_Player_States(const _eMediaStatus Status)
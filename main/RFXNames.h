@@ -282,6 +282,12 @@ const char* Get_Moisture_Desc(int moisture);
 const char* Get_Alert_Desc(int level);
 const char* Media_Player_States(_eMediaStatus Status);
 
+// Reverse lookups (description to type), -1 when unknown
+int Switch_Type_FromDesc(const std::string& szDesc);
+int Meter_Type_FromDesc(const std::string& szDesc);
+int Hardware_Type_FromDesc(const std::string& szDesc);
+int Notification_Type_FromDesc(const std::string& szDesc, unsigned char snum);
+
 void GetLightStatus(unsigned char dType, unsigned char dSubType, _eSwitchType switchtype, unsigned char nValue, const std::string& sValue, std::string& lstatus, int& llevel, bool& bHaveDimmer,
 	int& maxDimLevel, bool& bHaveGroupCmd);
 
@@ -0,0 +1,234 @@
+#include "stdafx.h"
+#include "RxCapture.h"
+#include "Logger.h"
+#include <inttypes.h>
+
+namespace rxcapture
+{
+	namespace
+	{
+		constexpr char szMagic[4] = { 'D', 'Z', 'R', 'X' };
+		constexpr uint8_t iVersion = 1;
+
+		std::atomic<uint64_t> g_stageNs[STAGE_COUNT];
+
+		thread_local bool tl_bProfiling = false;
+		thread_local int tl_stage = -1;
+		thread_local std::chrono::steady_clock::time_point tl_stageStart;
+
+		void AddStageTimeUntil(const int stage, const std::chrono::steady_clock::time_point &tNow)
+		{
+			if (stage < 0)
+				return;
+			g_stageNs[stage] += std::chrono::duration_cast<std::chrono::nanoseconds>(tNow - tl_stageStart).count();
+		}
+
+		template <typename T> void WriteLE(std::string &buffer, T value)
+		{
+			for (size_t ii = 0; ii < sizeof(T); ii++)
+				buffer += static_cast<char>((static_cast<uint64_t>(value) >> (ii * 8)) & 0xFF);
+		}
+
+		template <typename T> bool ReadLE(std::ifstream &file, T &value)
+		{
+			uint8_t bytes[sizeof(T)];
+			if (!file.read(reinterpret_cast<char *>(bytes), sizeof(T)))
+				return false;
+			uint64_t result = 0;
+			for (size_t ii = 0; ii < sizeof(T); ii++)
+				result |= static_cast<uint64_t>(bytes[ii]) << (ii * 8);
+			value = static_cast<T>(result);
+			return true;
+		}
+
+		void WriteShortString(std::string &buffer, const char *szValue)
+		{
+			size_t len = (szValue != nullptr) ? std::min<size_t>(strlen(szValue), 255) : 0;
+			buffer += static_cast<char>(len);
+			if (len > 0)
+				buffer.append(szValue, len);
+		}
+
+		bool ReadShortString(std::ifstream &file, std::string &value)
+		{
+			uint8_t len;
+			if (!ReadLE(file, len))
+				return false;
+			value.resize(len);
+			return (len == 0) || file.read(&value[0], len);
+		}
+	} // namespace
+
+	const char *szStageNames[STAGE_COUNT] = { "queue", "decode", "db", "event", "push" };
+
+	void ResetStageTimes()
+	{
+		for (auto &stage : g_stageNs)
+			stage = 0;
+	}
+
+	void GetStageTimes(uint64_t (&stageNs)[STAGE_COUNT])
+	{
+		for (int ii = 0; ii < STAGE_COUNT; ii++)
+			stageNs[ii] = g_stageNs[ii];
+	}
+
+	void AddStageTime(const _eStage stage, const uint64_t ns)
+	{
+		if (tl_bProfiling)
+			g_stageNs[stage] += ns;
+	}
+
+	CProfileScope::CProfileScope()
+		: m_bPrevProfiling(tl_bProfiling)
+	{
+		tl_bProfiling = true;
+	}
+
+	CProfileScope::~CProfileScope()
+	{
+		tl_bProfiling = m_bPrevProfiling;
+	}
+
+	CStageTimer::CStageTimer(const _eStage stage)
+	{
+		if (!tl_bProfiling)
+			return;
+		m_bActive = true;
+		auto tNow = std::chrono::steady_clock::now();
+		AddStageTimeUntil(tl_stage, tNow);
+		m_prevStage = tl_stage;
+		tl_stage = stage;
+		tl_stageStart = tNow;
+	}
+
+	CStageTimer::~CStageTimer()
+	{
+		if (!m_bActive)
+			return;
+		auto tNow = std::chrono::steady_clock::now();
+		AddStageTimeUntil(tl_stage, tNow);
+		tl_stage = m_prevStage;
+		tl_stageStart = tNow;
+	}
+
+	void CReplayStats::Add(const uint64_t queueNs, const uint64_t processNs)
+	{
+		std::lock_guard<std::mutex> l(m_mutex);
+		m_queueNs.push_back(queueNs);
+		m_processNs.push_back(processNs);
+	}
+
+	size_t CReplayStats::Count()
+	{
+		std::lock_guard<std::mutex> l(m_mutex);
+		return m_processNs.size();
+	}
+
+	void CReplayStats::Get(std::vector<uint64_t> &queueNs, std::vector<uint64_t> &processNs)
+	{
+		std::lock_guard<std::mutex> l(m_mutex);
+		queueNs = m_queueNs;
+		processNs = m_processNs;
+	}
+
+	CRxCaptureWriter::~CRxCaptureWriter()
+	{
+		Close();
+	}
+
+	bool CRxCaptureWriter::Open(const std::string &szFileName)
+	{
+		std::lock_guard<std::mutex> l(m_mutex);
+		if (m_file.is_open())
+			m_file.close();
+		m_file.open(szFileName, std::ios::out | std::ios::binary | std::ios::trunc);
+		if (!m_file.is_open())
+		{
+			_log.Log(LOG_ERROR, "RxCapture: cannot open capture file: %s", szFileName.c_str());
+			return false;
+		}
+		m_file.write(szMagic, sizeof(szMagic));
+		m_file.put(static_cast<char>(iVersion));
+		m_szFileName = szFileName;
+		m_tLast = std::chrono::steady_clock::now();
+		m_frames = 0;
+		m_bOpen = true;
+		_log.Log(LOG_STATUS, "RxCapture: recording received frames to %s", szFileName.c_str());
+		return true;
+	}
+
+	void CRxCaptureWriter::Close()
+	{
+		std::lock_guard<std::mutex> l(m_mutex);
+		if (!m_file.is_open())
+			return;
+		m_bOpen = false;
+		m_file.close();
+		_log.Log(LOG_STATUS, "RxCapture: %" PRIu64 " frames written to %s", m_frames, m_szFileName.c_str());
+	}
+
+	void CRxCaptureWriter::Record(const int hardwareId, const int hardwareType, const uint8_t *pRXCommand, const char *defaultName, const int BatteryLevel, const char *userName)
+	{
+		if ((!m_bOpen) || (pRXCommand == nullptr))
+			return;
+
+		std::string buffer;
+		buffer.reserve(32 + pRXCommand[0]);
+
+		std::lock_guard<std::mutex> l(m_mutex);
+		if (!m_file.is_open())
+			return;
+		auto tNow = std::chrono::steady_clock::now();
+		uint64_t deltaUs = std::chrono::duration_cast<std::chrono::microseconds>(tNow - m_tLast).count();
+		m_tLast = tNow;
+
+		WriteLE<uint32_t>(buffer, static_cast<uint32_t>(std::min<uint64_t>(deltaUs, UINT32_MAX)));
+		WriteLE<uint16_t>(buffer, static_cast<uint16_t>(hardwareType));
+		WriteLE<int32_t>(buffer, hardwareId);
+		WriteLE<int16_t>(buffer, static_cast<int16_t>(BatteryLevel));
+		WriteShortString(buffer, defaultName);
+		WriteShortString(buffer, userName);
+		buffer.append(reinterpret_cast<const char *>(pRXCommand), pRXCommand[0] + 1);
+		m_file.write(buffer.data(), buffer.size());
+		m_frames++;
+	}
+
+	bool LoadCaptureFile(const std::string &szFileName, std::vector<_tRxFrame> &frames)
+	{
+		frames.clear();
+		std::ifstream file(szFileName, std::ios::in | std::ios::binary);
+		if (!file.is_open())
+		{
+			_log.Log(LOG_ERROR, "RxReplay: cannot open capture file: %s", szFileName.c_str());
+			return false;
+		}
+		char magic[sizeof(szMagic)];
+		uint8_t version = 0;
+		if ((!file.read(magic, sizeof(magic))) || (memcmp(magic, szMagic, sizeof(szMagic)) != 0) || (!ReadLE(file, version)) || (version != iVersion))
+		{
+			_log.Log(LOG_ERROR, "RxReplay: %s is not a capture file (or unsupported version)", szFileName.c_str());
+			return false;
+		}
+		while (file.peek() != EOF)
+		{
+			_tRxFrame frame;
+			uint8_t len;
+			if ((!ReadLE(file, frame.deltaUs)) || (!ReadLE(file, frame.hardwareType)) || (!ReadLE(file, frame.hardwareId)) || (!ReadLE(file, frame.batteryLevel))
+				|| (!ReadShortString(file, frame.name)) || (!ReadShortString(file, frame.userName)) || (!ReadLE(file, len)))
+			{
+				_log.Log(LOG_ERROR, "RxReplay: truncated frame %d in %s", (int)frames.size(), szFileName.c_str());
+				break;
+			}
+			frame.rxCommand.resize(len + 1);
+			frame.rxCommand[0] = len;
+			if ((len > 0) && (!file.read(reinterpret_cast<char *>(&frame.rxCommand[1]), len)))
+			{
+				_log.Log(LOG_ERROR, "RxReplay: truncated frame %d in %s", (int)frames.size(), szFileName.c_str());
+				break;
+			}
+			frames.push_back(std::move(frame));
+		}
+		return true;
+	}
+} // namespace rxcapture
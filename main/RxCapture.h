@@ -0,0 +1,109 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Capture of raw RX frames (as passed to MainWorker::DecodeRXMessage) and replay support
+//
+// File layout (little endian):
+//	header	: "DZRX" + uint8 version
+//	frame	: uint32 delta_us (since previous frame) + uint16 hardware type + int32 hardware id + int16 battery level
+//		  + uint8 name length + name + uint8 username length + username + rx command (rxcommand[0] + 1 bytes)
+
+namespace rxcapture
+{
+	enum _eStage
+	{
+		STAGE_QUEUE = 0,
+		STAGE_DECODE,
+		STAGE_DB,
+		STAGE_EVENT,
+		STAGE_PUSH,
+		STAGE_COUNT
+	};
+	extern const char *szStageNames[STAGE_COUNT];
+
+	// Stage timings are only collected on a thread inside a CProfileScope (an RX thread decoding a replayed frame)
+	void ResetStageTimes();
+	void GetStageTimes(uint64_t (&stageNs)[STAGE_COUNT]);
+	void AddStageTime(_eStage stage, uint64_t ns);
+
+	class CProfileScope
+	{
+	public:
+		CProfileScope();
+		~CProfileScope();
+		CProfileScope(const CProfileScope &) = delete;
+		CProfileScope &operator=(const CProfileScope &) = delete;
+
+	private:
+		bool m_bPrevProfiling;
+	};
+
+	// Adds the time spent in its scope to a stage, nested stages are excluded from their parent
+	class CStageTimer
+	{
+	public:
+		explicit CStageTimer(_eStage stage);
+		~CStageTimer();
+		CStageTimer(const CStageTimer &) = delete;
+		CStageTimer &operator=(const CStageTimer &) = delete;
+
+	private:
+		bool m_bActive = false;
+		int m_prevStage = -1;
+	};
+
+	// Per frame timings of a replay, added by the RX threads that process the replayed frames
+	class CReplayStats
+	{
+	public:
+		void Add(uint64_t queueNs, uint64_t processNs);
+		size_t Count();
+		void Get(std::vector<uint64_t> &queueNs, std::vector<uint64_t> &processNs);
+
+	private:
+		std::mutex m_mutex;
+		std::vector<uint64_t> m_queueNs;
+		std::vector<uint64_t> m_processNs;
+	};
+
+	struct _tRxFrame
+	{
+		uint32_t deltaUs = 0;
+		uint16_t hardwareType = 0;
+		int32_t hardwareId = 0;
+		int16_t batteryLevel = -1;
+		std::string name;
+		std::string userName;
+		std::vector<uint8_t> rxCommand;
+	};
+
+	class CRxCaptureWriter
+	{
+	public:
+		~CRxCaptureWriter();
+		bool Open(const std::string &szFileName);
+		void Close();
+		bool IsOpen() const
+		{
+			return m_bOpen;
+		}
+		void Record(int hardwareId, int hardwareType, const uint8_t *pRXCommand, const char *defaultName, int BatteryLevel, const char *userName);
+
+	private:
+		std::atomic<bool> m_bOpen{ false };
+		std::mutex m_mutex;
+		std::ofstream m_file;
+		std::string m_szFileName;
+		std::chrono::steady_clock::time_point m_tLast;
+		uint64_t m_frames = 0;
+	};
+
+	bool LoadCaptureFile(const std::string &szFileName, std::vector<_tRxFrame> &frames);
+} // namespace rxcapture
@@ -13,6 +13,8 @@
 #include "RFXNames.h"
 #include "Helper.h"
 #include "Logger.h"
+#include "Metrics.h"
+#include "StartupProfile.h"
 #include "mainworker.h"
 #include "../main/json_helper.h"
 #include <sqlite3.h>
@@ -660,6 +662,47 @@ CSQLHelper::~CSQLHelper()
 	CloseDatabase();
 }
 
+namespace
+{
+	// keeps the scene index in sync with the scene tables and the meter store with the DeviceStatus rows it holds.
+	// An UPDATE of Scenes is left out, the status of a scene is written on every switch of one of its devices;
+	// the few places that change Activators or SceneType call InvalidateSceneIndex themselves
+	void SceneTablesUpdateHook(void *pUserData, int operation, const char * /*szDatabase*/, const char *szTable, sqlite3_int64 rowid)
+	{
+		if ((strcmp(szTable, "SceneDevices") == 0) || ((strcmp(szTable, "Scenes") == 0) && (operation != SQLITE_UPDATE)))
+			static_cast<CSQLHelper *>(pUserData)->InvalidateSceneIndex();
+		else if (strcmp(szTable, "DeviceStatus") == 0)
+			static_cast<CSQLHelper *>(pUserData)->InvalidateMeterRow(static_cast<uint64_t>(rowid));
+	}
+
+	// Latency per call site. The statement template (the printf format) identifies the call site, it has to
+	// be a string literal: the series is cached by its address, the label is the start of the template.
+	// Statements that are built at run time go through safe_query_label or unsafe_query (not timed).
+	metrics::CHistogram &StatementMetric(const char *fmt)
+	{
+		static auto &family = metrics::Registry().Histogram("domoticz_sql_query_seconds", "Time spent in a SQL statement, including waiting for the database lock", "statement");
+		static std::shared_mutex cacheMutex;
+		static std::unordered_map<const char *, metrics::CHistogram *> cache;
+		{
+			std::shared_lock<std::shared_mutex> lock(cacheMutex);
+			auto itt = cache.find(fmt);
+			if (itt != cache.end())
+				return *itt->second;
+		}
+		std::string label;
+		for (const char *p = fmt; (*p != 0) && (label.size() < 80); p++)
+		{
+			const char c = ((*p == '\n') || (*p == '\r') || (*p == '\t')) ? ' ' : *p;
+			if ((c != ' ') || (!label.empty() && (label.back() != ' ')))
+				label += c;
+		}
+		metrics::CHistogram &series = family.Get(label);
+		std::unique_lock<std::shared_mutex> lock(cacheMutex);
+		cache[fmt] = &series;
+		return series;
+	}
+} // namespace
+
 bool CSQLHelper::OpenDatabase()
 {
 	//Open Database
@@ -670,12 +713,15 @@ bool CSQLHelper::OpenDatabase()
 		sqlite3_close(m_dbase);
 		return false;
 	}
+	sqlite3_update_hook(m_dbase, SceneTablesUpdateHook, this);
+	InvalidateSceneIndex();
 	std::string pragma_journal_mode = "PRAGMA journal_mode = " + m_journal_mode;
 	sqlite3_exec(m_dbase, pragma_journal_mode.c_str(), nullptr, nullptr, nullptr);
 	sqlite3_exec(m_dbase, "PRAGMA synchronous = NORMAL", nullptr, nullptr, nullptr);
 	sqlite3_exec(m_dbase, "PRAGMA foreign_keys = ON", nullptr, nullptr, nullptr);
 	sqlite3_exec(m_dbase, "PRAGMA busy_timeout = 1000", nullptr, nullptr, nullptr);
 
+	startup::CPhase phase("db schema", 1);
 	std::vector<std::vector<std::string> > result = query("SELECT name FROM sqlite_master WHERE type='table' AND name='DeviceStatus'");
 	bool bNewInstall = (result.empty());
 	int dbversion = 0;
@@ -755,6 +801,8 @@ bool CSQLHelper::OpenDatabase()
 	query(sqlCreateUserSessions);
 	query(sqlCreateMobileDevices);
 	query(sqlCreateApplications);
+	for (const auto &sqlRollup : calendar_rollup::GetSchema())
+		query(sqlRollup);
 	//Add indexes to log tables
 	query("create index if not exists ds_hduts_idx	on DeviceStatus(HardwareID, DeviceID, Unit, Type, SubType);");
 	query("create index if not exists f_id_idx		on Fan(DeviceRowID);");
@@ -795,6 +843,7 @@ bool CSQLHelper::OpenDatabase()
 	query("create index if not exists wc_id_date_idx  on Wind_Calendar(DeviceRowID, Date);");
 	sqlite3_exec(m_dbase, "END TRANSACTION;", nullptr, nullptr, nullptr);
 
+	phase.Next("db upgrade");
 	if ((!bNewInstall) && (dbversion < DB_VERSION))
 	{
 		//Post-SQL Patches
@@ -1535,6 +1584,7 @@ bool CSQLHelper::OpenDatabase()
 					}
 					safe_query("UPDATE Scenes SET Activators='%q' WHERE (ID==%q)", Activator.c_str(), sd[0].c_str());
 				}
+				InvalidateSceneIndex();
 			}
 			//create a backup
 			query("ALTER TABLE Scenes RENAME TO tmp_Scenes");
@@ -1708,21 +1758,21 @@ bool CSQLHelper::OpenDatabase()
 			szQuery.clear();
 			szQuery.str("");
 			szQuery << "ALTER TABLE " << tableName << " RENAME TO _" << tableName << "_old";
-			safe_query(szQuery.str().c_str());
+			unsafe_query(szQuery.str());
 			// Create new table
 			safe_query(sqlCreateDeviceStatus);
 			// Restore all table rows
 			szQuery.clear();
 			szQuery.str("");
 			szQuery << "INSERT INTO " << tableName << " (" << fieldList << ") SELECT " << fieldList << " FROM _" << tableName << "_old";
-			safe_query(szQuery.str().c_str());
+			unsafe_query(szQuery.str());
 			// Restore indexes and triggers
 			safe_query(sqlCreateDeviceStatusTrigger);
 			// Delete old table
 			szQuery.clear();
 			szQuery.str("");
 			szQuery << "DROP TABLE IF EXISTS _" << tableName << "_old";
-			safe_query(szQuery.str().c_str());
+			unsafe_query(szQuery.str());
 
 			sqlite3_exec(m_dbase, "END TRANSACTION", nullptr, nullptr, nullptr);
 			sqlite3_exec(m_dbase, "PRAGMA foreign_keys=on", nullptr, nullptr, nullptr);
@@ -2088,16 +2138,12 @@ bool CSQLHelper::OpenDatabase()
 			result = safe_query("SELECT ID, Extra FROM Hardware WHERE Type=%d", HTYPE_HTTPPOLLER);
 			if (!result.empty())
 			{
-				std::stringstream szQuery2;
 				for (const auto &sd : result)
 				{
 					std::string id = sd[0];
 					std::string extra = sd[1];
 					std::string extraBase64 = base64_encode(extra);
-					szQuery2.clear();
-					szQuery2.str("");
-					szQuery2 << "UPDATE Hardware SET Mode1=0, Extra='%s' WHERE (ID=" << id << ")";
-					safe_query(szQuery2.str().c_str(), extraBase64.c_str());
+					safe_query("UPDATE Hardware SET Mode1=0, Extra='%q' WHERE (ID=%q)", extraBase64.c_str(), id.c_str());
 				}
 			}
 		}
@@ -3300,6 +3346,7 @@ bool CSQLHelper::OpenDatabase()
 	}
 	UpdatePreferencesVar("DB_Version", DB_VERSION);
 
+	phase.Next("db preferences");
 	//Check preferences table for extreme sized sValues
 	result = safe_query("SELECT Key FROM Preferences WHERE LENGTH(sValue) > 1000");
 	if (!result.empty())
@@ -3544,6 +3591,14 @@ bool CSQLHelper::OpenDatabase()
 	{
 		UpdatePreferencesVar("RaspCamParams", "-w 800 -h 600 -t 1"); //width/height/time2wait
 	}
+	if (!GetPreferencesVar("CameraSnapshotMaxAge", nValue))
+	{
+		UpdatePreferencesVar("CameraSnapshotMaxAge", 1000);
+	}
+	if (!GetPreferencesVar("CameraRelay", nValue))
+	{
+		UpdatePreferencesVar("CameraRelay", 0);
+	}
 	if ((!GetPreferencesVar("UVCParams", sValue)) || (sValue.empty()))
 	{
 		UpdatePreferencesVar("UVCParams", "-S80 -B128 -C128 -G80 -x800 -y600 -q100"); //width/height/time2wait
@@ -3707,6 +3762,12 @@ bool CSQLHelper::OpenDatabase()
 		UpdatePreferencesVar("ShortLogAddOnlyNewValues", nValue);
 	}
 	m_bShortLogAddOnlyNewValues = (nValue != 0);
+	nValue = 0;
+	if (!GetPreferencesVar("MeterWriteInterval", nValue))
+	{
+		UpdatePreferencesVar("MeterWriteInterval", nValue);
+	}
+	SetMeterWriteInterval(nValue);
 
 	if (!GetPreferencesVar("SendErrorsAsNotification", nValue))
 	{
@@ -3756,9 +3817,15 @@ bool CSQLHelper::OpenDatabase()
 	//Update version in database
 	UpdatePreferencesVar("Domoticz_Version", szAppVersion);
 
+	phase.Next("db device states");
 	CorrectOffDelaySwitchStates();
 
-	RefreshActualPrices();
+	// prices are only shown, they do not have to be there before the hardware starts
+	startup::Defer("actual prices", [this] { RefreshActualPrices(); });
+
+	phase.Next("db short log store");
+	if ((!m_shortlog_store_path.empty()) && (m_shortlogStore.Open(m_shortlog_store_path)) && (m_shortlogStore.IsEmpty()))
+		ImportShortLogStore();
 
 	//Start background thread
 	if (!StartThread())
@@ -3768,7 +3835,9 @@ bool CSQLHelper::OpenDatabase()
 
 void CSQLHelper::CloseDatabase()
 {
+	FlushMeters(true);
 	std::lock_guard<std::mutex> l(m_sqlQueryMutex);
+	m_meterStore.Clear();
 	if (m_dbase != nullptr)
 	{
 		OptimizeDatabase(m_dbase);
@@ -4206,6 +4275,7 @@ void CSQLHelper::PerformThreadedAction(const _tTaskItem &tItem)
 
 void CSQLHelper::Do_Work()
 {
+	time_t tLastMeterFlush = 0;
 	while (!IsStopRequested(static_cast<const long>(1000.0F / timer_resolution_hz)))
 	{
 		std::vector<_tTaskItem> _items2do;
@@ -4258,6 +4328,17 @@ void CSQLHelper::Do_Work()
 			}
 		}
 
+		if (m_meterStore.GetWriteInterval() > 0)
+		{
+			// held back meter values, checked once a second
+			time_t tNow = mytime(nullptr);
+			if (tNow != tLastMeterFlush)
+			{
+				tLastMeterFlush = tNow;
+				FlushMeters(false);
+			}
+		}
+
 		if (_items2do.empty())
 		{
 			continue;
@@ -4265,6 +4346,8 @@ void CSQLHelper::Do_Work()
 
 		for (const auto &itt : _items2do)
 		{
+			tracer::CContext traceContext(itt._trace, "sql task queue");
+			tracer::CSpan span("sql task");
 			_log.Debug(DEBUG_NORM, "SQLH: Do Task ItemType: %d Cmd: %s Value: %s", itt._ItemType, itt._command.c_str(), itt._sValue.c_str());
 
 			if (itt._ItemType == TITEM_SWITCHCMD)
@@ -4456,11 +4539,21 @@ void CSQLHelper::SetDatabaseName(const std::string& DBName)
 	m_dbase_name = DBName;
 }
 
+const std::string &CSQLHelper::GetDatabaseName() const
+{
+	return m_dbase_name;
+}
+
 void CSQLHelper::SetJournalMode(const std::string& mode)
 {
 	m_journal_mode = mode;
 }
 
+void CSQLHelper::SetShortLogStorePath(const std::string& szPath)
+{
+	m_shortlog_store_path = szPath;
+}
+
 bool CSQLHelper::DoesColumnExistsInTable(const std::string& columnname, const std::string& tablename)
 {
 	if (!m_dbase)
@@ -4484,6 +4577,7 @@ void CSQLHelper::safe_exec_no_return(const char* fmt, ...)
 {
 	if (!m_dbase)
 		return;
+	metrics::CScopeTimer timer(StatementMetric(fmt));
 
 	va_list args;
 	va_start(args, fmt);
@@ -4528,14 +4622,31 @@ bool CSQLHelper::safe_UpdateBlobInTableWithID(const std::string& Table, const st
 }
 
 std::vector<std::vector<std::string>> CSQLHelper::safe_query(const char *fmt, ...)
+{
+	metrics::CScopeTimer timer(StatementMetric(fmt));
+	va_list args;
+	va_start(args, fmt);
+	std::vector<std::vector<std::string>> results = safe_vquery(fmt, args);
+	va_end(args);
+	return results;
+}
+
+std::vector<std::vector<std::string>> CSQLHelper::safe_query_label(const char *szLabel, const char *fmt, ...)
+{
+	metrics::CScopeTimer timer(StatementMetric(szLabel));
+	va_list args;
+	va_start(args, fmt);
+	std::vector<std::vector<std::string>> results = safe_vquery(fmt, args);
+	va_end(args);
+	return results;
+}
+
+std::vector<std::vector<std::string>> CSQLHelper::safe_vquery(const char *fmt, va_list args)
 {
 	std::vector<std::vector<std::string> > results;
 	try
 	{
-		va_list args;
-		va_start(args, fmt);
 		char* zQuery = sqlite3_vmprintf(fmt, args);
-		va_end(args);
 		if (!zQuery)
 		{
 			_log.Log(LOG_ERROR, "SQL: Out of memory, or invalid printf!....");
@@ -4570,6 +4681,8 @@ std::vector<std::vector<std::string> > CSQLHelper::query(const std::string& szQu
 		std::vector<std::vector<std::string> > results;
 		return results;
 	}
+	rxcapture::CStageTimer dbTimer(rxcapture::STAGE_DB);
+	tracer::CSpan span("sql");
 	std::lock_guard<std::mutex> l(m_sqlQueryMutex);
 
 	sqlite3_stmt* statement;
@@ -4611,8 +4724,73 @@ std::vector<std::vector<std::string> > CSQLHelper::query(const std::string& szQu
 	return results;
 }
 
+bool CSQLHelper::safe_query_each(const std::function<void(const char *const *values, int cols)> &onRow, const char *fmt, ...)
+{
+	metrics::CScopeTimer timer(StatementMetric(fmt));
+	va_list args;
+	va_start(args, fmt);
+	char* zQuery = sqlite3_vmprintf(fmt, args);
+	va_end(args);
+	if (!zQuery)
+	{
+		_log.Log(LOG_ERROR, "SQL: Out of memory, or invalid printf!....");
+		return false;
+	}
+	if (!m_dbase)
+	{
+		_log.Log(LOG_ERROR, "Database not open!!...Check your user rights!..");
+		sqlite3_free(zQuery);
+		return false;
+	}
+
+	bool bOK = false;
+	{
+		std::lock_guard<std::mutex> l(m_sqlQueryMutex);
+		_log.Debug(DEBUG_SQL, "Query:%s", zQuery);
+		sqlite3_stmt* statement;
+		if (sqlite3_prepare_v2(m_dbase, zQuery, -1, &statement, nullptr) == SQLITE_OK)
+		{
+			int cols = sqlite3_column_count(statement);
+			std::vector<const char*> values(cols);
+			while (sqlite3_step(statement) == SQLITE_ROW)
+			{
+				for (int col = 0; col < cols; col++)
+				{
+					const char* value = (const char*)sqlite3_column_text(statement, col);
+					values[col] = (value != nullptr) ? value : "";
+				}
+				onRow(values.data(), cols);
+			}
+			sqlite3_finalize(statement);
+			bOK = true;
+		}
+		std::string error = sqlite3_errmsg(m_dbase);
+		if (error != "not an error")
+		{
+			_log.Log(LOG_ERROR, "SQL Query(\"%s\") : %s", zQuery, error.c_str());
+			bOK = false;
+		}
+	}
+	sqlite3_free(zQuery);
+	return bOK;
+}
+
+bool CSQLHelper::GetCalendarMonths(const std::string &table, const uint64_t idx, const std::string &field, std::vector<calendar_rollup::_tMonth> &months)
+{
+	if (!m_dbase)
+		return false;
+	std::lock_guard<std::mutex> l(m_sqlQueryMutex);
+	if (!calendar_rollup::GetMonths(m_dbase, table, idx, field, months))
+	{
+		_log.Log(LOG_ERROR, "SQL: Calendar rollup of %s.%s (idx: %" PRIu64 ") failed: %s", table.c_str(), field.c_str(), idx, sqlite3_errmsg(m_dbase));
+		return false;
+	}
+	return true;
+}
+
 std::vector<std::vector<std::string> > CSQLHelper::safe_queryBlob(const char* fmt, ...)
 {
+	metrics::CScopeTimer timer(StatementMetric(fmt));
 	va_list args;
 	std::vector<std::vector<std::string> > results;
 	va_start(args, fmt);
@@ -5390,6 +5568,55 @@ uint64_t CSQLHelper::UpdateManagedValueInt(
 	return ulID;
 }
 
+bool CSQLHelper::UpdateMeterValueInt(const int HardwareID, const int OrgHardwareID, const char *ID, const unsigned char unit, const unsigned char devType, const unsigned char subType,
+				     const unsigned char signallevel, const unsigned char batterylevel, const int nValue, const char *sValue, std::string &devname, uint64_t &ulID)
+{
+	if (!meter_store::IsMeterType(devType, subType))
+		return false;
+
+	meter_store::_tMeterKey key;
+	key.HardwareID = HardwareID;
+	key.OrgHardwareID = OrgHardwareID;
+	key.DeviceID = ID;
+	key.Unit = unit;
+	key.Type = devType;
+	key.SubType = subType;
+	meter_store::_tMeterRow row;
+	{
+		rxcapture::CStageTimer dbTimer(rxcapture::STAGE_DB);
+		tracer::CSpan span("sql");
+		metrics::CScopeTimer timer(StatementMetric("UPDATE DeviceStatus (meter store)"));
+		std::lock_guard<std::mutex> l(m_sqlQueryMutex);
+		if (!m_meterStore.Get(m_dbase, key, row))
+			return false; // a new device, inserted by UpdateValueInt
+		if (!row.Options.empty())
+		{
+			// logged as managed counter, or the energy is computed from the previous update
+			std::map<std::string, std::string> options = BuildDeviceOptions(row.Options);
+			if ((options["AddDBLogEntry"] == "true") || ((options["EnergyMeterMode"] == "1") && (devType == pTypeGeneral) && (subType == sTypeKwh)))
+				return false;
+		}
+		if (!m_meterStore.Update(m_dbase, key, nValue, sValue, TimeToString(nullptr, TF_DateTime), signallevel, batterylevel))
+			_log.Log(LOG_ERROR, "SQL Update meter %s: %s", row.Name.c_str(), sqlite3_errmsg(m_dbase));
+	}
+	ulID = row.ID;
+	devname = row.Name;
+
+	_log.Debug(DEBUG_NORM, "SQLH UpdateValueInt %s HwID:%d  DevID:%s Type:%d  sType:%d nValue:%d sValue:%s IDX: %" PRIu64, devname.c_str(), HardwareID, ID, devType, subType, nValue, sValue, ulID);
+
+	if (row.bUsed)
+	{
+		m_mainworker.m_eventsystem.ProcessDevice(HardwareID, ulID, unit, devType, subType, signallevel, batterylevel, nValue, sValue);
+
+		if (OrgHardwareID == 0)
+		{
+			//Send to connected Sharing Users
+			m_mainworker.m_sharedserver.SendToAll(HardwareID, ulID, nullptr);
+		}
+	}
+	return true;
+}
+
 uint64_t CSQLHelper::UpdateValueInt(
         const int HardwareID, const int OrgHardwareID, const char *ID, const unsigned char unit, const unsigned char devType, const unsigned char subType,
         const unsigned char signallevel, const unsigned char batterylevel, const int nValue, const char *sValue, std::string &devname,
@@ -5407,6 +5634,9 @@ uint64_t CSQLHelper::UpdateValueInt(
 	}
 
 	uint64_t ulID = 0;
+	if (UpdateMeterValueInt(HardwareID, OrgHardwareID, ID, unit, devType, subType, signallevel, batterylevel, nValue, sValue, devname, ulID))
+		return ulID;
+
 	std::map<std::string, std::string> options;
 
 	bool bIsManagedCounter = (devType == pTypeGeneral && subType == sTypeManagedCounter);
@@ -5595,8 +5825,7 @@ uint64_t CSQLHelper::UpdateValueInt(
 	case pTypeHoneywell_AL:
 		if ((devType == pTypeRadiator1) && (subType != sTypeSmartwaresSwitchRadiator))
 			break;
-		m_LastSwitchID = ID;
-		m_LastSwitchRowID = ulID;
+		SetLastSwitch(ID, ulID);
 
 		//Add Lighting log (Skip duplicates)
 		if (
@@ -6175,6 +6404,9 @@ void CSQLHelper::ScheduleShortlog()
 
 	try
 	{
+		//The shortlog reads the meter values from DeviceStatus
+		FlushMeters(true);
+
 		//Force WAL flush
 		sqlite3_wal_checkpoint(m_dbase, nullptr);
 
@@ -6434,6 +6666,8 @@ void CSQLHelper::UpdateTemperatureLog()
 				dewpoint,
 				setpoint
 			);
+			if (m_shortlogStore.IsOpen())
+				m_shortlogStore.Append("Temperature", ID, now, { round_digits(temp, 2), round_digits(chill, 2), (double)humidity, (double)barometer, round_digits(dewpoint, 2), round_digits(setpoint, 2) });
 		}
 	}
 }
@@ -6547,15 +6781,18 @@ void CSQLHelper::UpdateWindLog()
 			int speed = atoi(splitresults[2].c_str());
 			int gust = atoi(splitresults[3].c_str());
 
-			auto ittWC = m_mainworker.m_wind_calculator.find(DeviceID);
-			if (ittWC != m_mainworker.m_wind_calculator.end())
 			{
-				int speed_max, gust_max, speed_min, gust_min;
-				ittWC->second.GetMMSpeedGust(speed_min, speed_max, gust_min, gust_max);
-				if (speed_max != -1)
-					speed = speed_max;
-				if (gust_max != -1)
-					gust = gust_max;
+				std::lock_guard<std::mutex> lock(m_mainworker.m_calculatorMutex);
+				auto ittWC = m_mainworker.m_wind_calculator.find(DeviceID);
+				if (ittWC != m_mainworker.m_wind_calculator.end())
+				{
+					int speed_max, gust_max, speed_min, gust_min;
+					ittWC->second.GetMMSpeedGust(speed_min, speed_max, gust_min, gust_max);
+					if (speed_max != -1)
+						speed = speed_max;
+					if (gust_max != -1)
+						gust = gust_max;
+				}
 			}
 
 			//insert record
@@ -6649,8 +6886,6 @@ bool CSQLHelper::UpdateCalendarMeter(
 	int64_t counter3,
 	int64_t counter4)
 {
-	std::vector<std::vector<std::string> > result;
-
 	bool bIsManagedCounter = (devType == pTypeGeneral && subType == sTypeManagedCounter);
 
 	value1 = (value1 < 0 && !bIsManagedCounter) ? 0 : value1;
@@ -6669,165 +6904,93 @@ bool CSQLHelper::UpdateCalendarMeter(
 
 	float price = 0.0F;
 
-	result = safe_query("SELECT ID, Name, SwitchType FROM DeviceStatus WHERE (HardwareID=%d AND DeviceID='%q' AND Unit=%d AND Type=%d AND SubType=%d)", HardwareID, DeviceID, unit, devType, subType);
-	if (result.empty()) {
-		return false;
-	}
-
-	std::vector<std::string> sd = result[0];
-	uint64_t DeviceRowID = std::stoull(sd[0]);
-	//std::string devname = sd[1];
-	//_eSwitchType switchtype = (_eSwitchType)atoi(sd[2].c_str());
-
 	if (shortLog)
 	{
 		if (!CheckDateTimeSQL(date)) {
 			_log.Log(LOG_ERROR, "UpdateCalendarMeter(): incorrect date time format received, YYYY-MM-DD HH:mm:ss expected!");
 			return false;
 		}
+	}
+	else if (!CheckDateSQL(date)) {
+		_log.Log(LOG_ERROR, "UpdateCalendarMeter(): incorrect date format received, YYYY-MM-DD expected!");
+		return false;
+	}
 
-		//insert or replace record
-		if (multiMeter) {
-			result = safe_query(
-				"SELECT DeviceRowID FROM MultiMeter "
-				"WHERE ((DeviceRowID=='%" PRIu64 "') AND (Date=='%q'))",
-				DeviceRowID, date
-			);
-			if (result.empty())
-			{
-				safe_query(
-					"INSERT INTO MultiMeter (DeviceRowID, Value1, Value2, Value3, Value4, Value5, Value6, Price, Date) "
-					"VALUES ('%" PRIu64 "', '%" PRId64 "', '%" PRId64 "', '%" PRId64 "', '%" PRId64 "', '%" PRId64 "', '%" PRId64 "', '%.4f', '%q')",
-					DeviceRowID,
-					value1,
-					value2,
-					value3,
-					value4,
-					value5,
-					value6,
-					price,
-					date
-				);
-			}
-			else
-			{
-				safe_query(
-					"UPDATE MultiMeter SET Value1='%" PRId64 "', Value2='%" PRId64 "', Value3='%" PRId64 "', Value4='%" PRId64 "', Value5='%" PRId64 "', Value6='%" PRId64 "', Price='%.4f' "
-					"WHERE ((DeviceRowID=='%" PRIu64 "') AND (Date=='%q'))",
-					value1,
-					value2,
-					value3,
-					value4,
-					value5,
-					value6,
-					price,
-					DeviceRowID,
-					date
-				);
-			}
-		}
-		else {
-			result = safe_query(
-				"SELECT DeviceRowID FROM Meter "
-				"WHERE ((DeviceRowID=='%" PRIu64 "') AND (Date=='%q'))",
-				DeviceRowID, date
-			);
-			if (result.empty())
-			{
-				safe_query(
-					"INSERT INTO Meter (DeviceRowID, Value, Usage, Price, Date) "
-					"VALUES ('%" PRIu64 "','%" PRId64 "','%" PRId64 "', '%.4f', '%q')",
-					DeviceRowID, value1, value2, price, date
-				);
-			}
-			else
-			{
-				safe_query(
-					"UPDATE Meter SET DeviceRowID='%" PRIu64 "', Value='%" PRId64 "', Usage='%" PRId64 "', Price='%.4f', Date='%q' "
-					"WHERE ((DeviceRowID=='%" PRIu64 "') AND (Date=='%q'))",
-					DeviceRowID, value1, value2, price, date,
-					DeviceRowID, date
-				);
-			}
-		}
+	//Histories are imported with a call per hour or day, the statements are prepared once and kept by the meter store
+	//Parameters: ?1-?6 values, ?7-?10 counters, ?11 price, ?12 DeviceRowID, ?13 date
+	const char *szUpdate;
+	const char *szInsert;
+	if (shortLog && multiMeter)
+	{
+		szUpdate = "UPDATE MultiMeter SET Value1=?1, Value2=?2, Value3=?3, Value4=?4, Value5=?5, Value6=?6, Price=?11 WHERE ((DeviceRowID==?12) AND (Date==?13))";
+		szInsert = "INSERT INTO MultiMeter (Value1, Value2, Value3, Value4, Value5, Value6, Price, DeviceRowID, Date) VALUES (?1, ?2, ?3, ?4, ?5, ?6, ?11, ?12, ?13)";
+	}
+	else if (shortLog)
+	{
+		szUpdate = "UPDATE Meter SET Value=?1, Usage=?2, Price=?11 WHERE ((DeviceRowID==?12) AND (Date==?13))";
+		szInsert = "INSERT INTO Meter (Value, Usage, Price, DeviceRowID, Date) VALUES (?1, ?2, ?11, ?12, ?13)";
+	}
+	else if (multiMeter)
+	{
+		szUpdate = "UPDATE MultiMeter_Calendar SET Value1=?1, Value2=?2, Value3=?3, Value4=?4, Value5=?5, Value6=?6, Counter1=?7, Counter2=?8, Counter3=?9, Counter4=?10, Price=?11 "
+			   "WHERE ((DeviceRowID==?12) AND (Date==?13))";
+		szInsert = "INSERT INTO MultiMeter_Calendar (Value1, Value2, Value3, Value4, Value5, Value6, Counter1, Counter2, Counter3, Counter4, Price, DeviceRowID, Date) "
+			   "VALUES (?1, ?2, ?3, ?4, ?5, ?6, ?7, ?8, ?9, ?10, ?11, ?12, ?13)";
 	}
 	else
 	{
-		if (!CheckDateSQL(date)) {
-			_log.Log(LOG_ERROR, "UpdateCalendarMeter(): incorrect date format received, YYYY-MM-DD expected!");
+		szUpdate = "UPDATE Meter_Calendar SET Counter=?1, Value=?2, Price=?11 WHERE ((DeviceRowID==?12) AND (Date==?13))";
+		szInsert = "INSERT INTO Meter_Calendar (Counter, Value, Price, DeviceRowID, Date) VALUES (?1, ?2, ?11, ?12, ?13)";
+	}
+	const int64_t values[] = { value1, value2, value3, value4, value5, value6, counter1, counter2, counter3, counter4 };
+
+	rxcapture::CStageTimer dbTimer(rxcapture::STAGE_DB);
+	tracer::CSpan span("sql");
+	metrics::CScopeTimer timer(StatementMetric(szUpdate));
+	std::lock_guard<std::mutex> l(m_sqlQueryMutex);
+	if (!m_dbase)
+		return false;
+
+	sqlite3_stmt *stmt = m_meterStore.GetStatement(m_dbase, "SELECT ID FROM DeviceStatus WHERE (HardwareID=?1 AND DeviceID=?2 AND Unit=?3 AND Type=?4 AND SubType=?5)");
+	if (stmt == nullptr)
+	{
+		_log.Log(LOG_ERROR, "UpdateCalendarMeter(): %s", sqlite3_errmsg(m_dbase));
+		return false;
+	}
+	sqlite3_bind_int(stmt, 1, HardwareID);
+	sqlite3_bind_text(stmt, 2, DeviceID, -1, SQLITE_STATIC);
+	sqlite3_bind_int(stmt, 3, unit);
+	sqlite3_bind_int(stmt, 4, devType);
+	sqlite3_bind_int(stmt, 5, subType);
+	bool bFound = (sqlite3_step(stmt) == SQLITE_ROW);
+	uint64_t DeviceRowID = (bFound) ? static_cast<uint64_t>(sqlite3_column_int64(stmt, 0)) : 0;
+	sqlite3_reset(stmt);
+	if (!bFound)
+		return false;
+
+	//update the record, insert it when it is not there yet
+	for (const char *szSQL : { szUpdate, szInsert })
+	{
+		stmt = m_meterStore.GetStatement(m_dbase, szSQL);
+		if (stmt == nullptr)
+		{
+			_log.Log(LOG_ERROR, "UpdateCalendarMeter(): %s", sqlite3_errmsg(m_dbase));
 			return false;
 		}
-		if (multiMeter) {
-			result = safe_query(
-				"SELECT DeviceRowID FROM MultiMeter_Calendar "
-				"WHERE (DeviceRowID=='%" PRIu64 "') AND (Date=='%q')",
-				DeviceRowID, date
-			);
-			if (result.empty())
-			{
-				safe_query(
-					"INSERT INTO MultiMeter_Calendar (DeviceRowID, Value1, Value2, Value3, Value4, Value5, Value6, Counter1, Counter2, Counter3, Counter4, Price, Date) "
-					"VALUES ('%" PRIu64 "', '%" PRId64 "', '%" PRId64 "', '%" PRId64 "', '%" PRId64 "', '%" PRId64 "', '%" PRId64 "', '%" PRId64 "', '%" PRId64 "', '%" PRId64 "', '%" PRId64 "', '%.4f', '%q')",
-					DeviceRowID,
-					value1,
-					value2,
-					value3,
-					value4,
-					value5,
-					value6,
-					counter1,
-					counter2,
-					counter3,
-					counter4,
-					price,
-					date
-				);
-			}
-			else
-			{
-				safe_query(
-					"UPDATE MultiMeter_Calendar SET Value1='%" PRId64 "', Value2='%" PRId64 "', Value3='%" PRId64 "', Value4='%" PRId64 "', Value5='%" PRId64 "', Value6='%" PRId64 "' , Counter1='%" PRId64 "' , Counter2='%" PRId64 "' , Counter3='%" PRId64 "' , Counter4='%" PRId64 "', Price='%.4f' "
-					"WHERE ((DeviceRowID=='%" PRIu64 "') AND (Date=='%q'))",
-					value1,
-					value2,
-					value3,
-					value4,
-					value5,
-					value6,
-					counter1,
-					counter2,
-					counter3,
-					counter4,
-					price,
-					DeviceRowID,
-					date
-				);
-			}
-		}
-		else {
-			result = safe_query(
-				"SELECT DeviceRowID FROM Meter_Calendar "
-				"WHERE (DeviceRowID=='%" PRIu64 "') AND (Date=='%q')",
-				DeviceRowID, date
-			);
-			if (result.empty())
-			{
-				safe_query(
-					"INSERT INTO Meter_Calendar (DeviceRowID, Counter, Value, Price, Date) "
-					"VALUES ('%" PRIu64 "', '%" PRId64 "', '%" PRId64 "', '%.4f', '%q')",
-					DeviceRowID, value1, value2, price, date
-				);
-			}
-			else
-			{
-				safe_query(
-					"UPDATE Meter_Calendar SET DeviceRowID='%" PRIu64 "', Counter='%" PRId64 "', Value='%" PRId64 "', Price='%.4f', Date='%q' "
-					"WHERE (DeviceRowID=='%" PRIu64 "') AND (Date=='%q')",
-					DeviceRowID, value1, value2, price, date,
-					DeviceRowID, date
-				);
-			}
+		for (int ii = 0; ii < 10; ii++)
+			sqlite3_bind_int64(stmt, ii + 1, values[ii]);
+		sqlite3_bind_double(stmt, 11, price);
+		sqlite3_bind_int64(stmt, 12, static_cast<sqlite3_int64>(DeviceRowID));
+		sqlite3_bind_text(stmt, 13, date, -1, SQLITE_STATIC);
+		int rc = sqlite3_step(stmt);
+		sqlite3_reset(stmt);
+		if (rc != SQLITE_DONE)
+		{
+			_log.Log(LOG_ERROR, "UpdateCalendarMeter(): %s", sqlite3_errmsg(m_dbase));
+			return false;
 		}
+		if (sqlite3_changes(m_dbase) > 0)
+			break;
 	}
 	return true;
 }
@@ -7426,6 +7589,8 @@ void CSQLHelper::UpdatePercentageLog()
 				ID,
 				percentage
 			);
+			if (m_shortlogStore.IsOpen())
+				m_shortlogStore.Append("Percentage", ID, now, { atof(std_format("%g", percentage).c_str()) });
 		}
 	}
 }
@@ -7484,10 +7649,41 @@ void CSQLHelper::UpdateFanLog()
 				ID,
 				speed
 			);
+			if (m_shortlogStore.IsOpen())
+				m_shortlogStore.Append("Fan", ID, now, { (double)speed });
 		}
 	}
 }
 
+// Fills the short log store with the rows already in the Temperature, Percentage and Fan tables (of all devices, or of one device)
+void CSQLHelper::ImportShortLogStore(const std::string& sIdx)
+{
+	if (sIdx.empty())
+		_log.Log(LOG_STATUS, "TimeSeriesStore: importing existing short log...");
+	static const std::pair<const char*, const char*> tables[] = {
+		{ "Temperature", "Temperature, Chill, Humidity, Barometer, DewPoint, SetPoint" },
+		{ "Percentage", "Percentage" },
+		{ "Fan", "Speed" },
+	};
+	for (const auto& table : tables)
+	{
+		uint64_t points = 0;
+		std::vector<double> values;
+		safe_query_each(
+			[&](const char* const* sd, int cols) {
+				values.clear();
+				for (int ii = 2; ii < cols; ii++)
+					values.push_back(atof(sd[ii]));
+				if (m_shortlogStore.Append(table.first, std::strtoull(sd[0], nullptr, 10), static_cast<time_t>(std::strtoll(sd[1], nullptr, 10)), values))
+					points++;
+			},
+			"SELECT DeviceRowID, CAST(strftime('%%s', Date, 'utc') AS INTEGER), %s FROM %s WHERE ('%q' == '' OR DeviceRowID == '%q') ORDER BY DeviceRowID, Date",
+			table.second, table.first, sIdx.c_str(), sIdx.c_str());
+		if (sIdx.empty())
+			_log.Log(LOG_STATUS, "TimeSeriesStore: imported %" PRIu64 " %s points", points, table.first);
+	}
+}
+
 void CSQLHelper::AddCalendarTemperature()
 {
 	//Get All temperature devices in the Temperature Table
@@ -7888,7 +8084,7 @@ void CSQLHelper::AddCalendarUpdateMeter()
 						sd[2].c_str()
 						);
 					//also send this to Influx as this can be used as start counter of today()
-					m_influxpush.DoInfluxPush(ID, true);
+					m_influxpush.PushDevice(ID, true);
 				}
 			}
 		}
@@ -8292,6 +8488,8 @@ void CSQLHelper::CleanupShortLog()
 
 		sprintf(szQuery, "DELETE FROM Fan WHERE %s", szQueryFilter.c_str());
 		query(szQuery);
+
+		m_shortlogStore.Purge(mytime(nullptr) - n5MinuteHistoryDays * 86400);
 	}
 }
 
@@ -8305,6 +8503,7 @@ void CSQLHelper::ClearShortLog()
 	query("DELETE FROM MultiMeter");
 	query("DELETE FROM Percentage");
 	query("DELETE FROM Fan");
+	m_shortlogStore.Clear();
 	VacuumDatabase();
 }
 
@@ -8427,9 +8626,11 @@ void CSQLHelper::DeleteDevices(const std::string& idx)
 						str.c_str());
 			safe_exec_no_return("DELETE FROM SharedDevices WHERE (DeviceRowID== '%q')", str.c_str());
 			safe_exec_no_return("DELETE FROM PushLink WHERE (DeviceRowID== '%q')", str.c_str());
+			safe_exec_no_return("DELETE FROM Calendar_Rollup WHERE (DeviceRowID== '%q')", str.c_str());
 			//notify eventsystem device is no longer present
 			uint64_t ullidx = std::stoull(str);
 			m_mainworker.m_eventsystem.RemoveSingleState(ullidx, m_mainworker.m_eventsystem.REASON_DEVICE);
+			m_shortlogStore.RemoveDevice(ullidx);
 			//and now delete all records in the DeviceStatus table itself
 			safe_exec_no_return("DELETE FROM DeviceStatus WHERE (ID == '%q')", str.c_str());
 		}
@@ -8554,15 +8755,133 @@ void CSQLHelper::CheckSceneStatusWithDevice(const std::string& DevIdx)
 
 void CSQLHelper::CheckSceneStatusWithDevice(const uint64_t DevIdx)
 {
+	for (const auto SceneRowID : GetDeviceScenes(DevIdx))
+	{
+		CheckSceneStatus(SceneRowID);
+	}
+}
+
+void CSQLHelper::InvalidateSceneIndex()
+{
+	m_bSceneIndexValid = false;
+}
+
+//Called by the update hook, the caller may hold m_sqlQueryMutex
+void CSQLHelper::InvalidateMeterRow(const uint64_t ID)
+{
+	m_meterStore.Invalidate(ID);
+}
+
+void CSQLHelper::SetMeterWriteInterval(int iSeconds)
+{
+	iSeconds = std::min(iSeconds, m_ShortLogInterval * 60);
+	m_meterStore.SetWriteInterval(iSeconds);
+	if (iSeconds <= 0)
+		FlushMeters(true);
+}
+
+bool CSQLHelper::GetPendingMeterValue(const uint64_t ID, meter_store::_tMeterRow &row)
+{
+	std::lock_guard<std::mutex> l(m_sqlQueryMutex);
+	return m_meterStore.GetPending(ID, row);
+}
+
+void CSQLHelper::UpdateReceivedBatteryLevel(const uint64_t ID, const int BatteryLevel)
+{
+	std::lock_guard<std::mutex> l(m_sqlQueryMutex);
+	if (m_dbase == nullptr)
+		return;
+	if (!m_meterStore.WriteBatteryLevel(m_dbase, ID, BatteryLevel))
+		_log.Log(LOG_ERROR, "SQL Update battery level: %s", sqlite3_errmsg(m_dbase));
+}
+
+void CSQLHelper::UpdateReceivedName(const uint64_t ID, const std::string& Name)
+{
+	std::lock_guard<std::mutex> l(m_sqlQueryMutex);
+	if (m_dbase == nullptr)
+		return;
+	if (!m_meterStore.WriteName(m_dbase, ID, Name))
+		_log.Log(LOG_ERROR, "SQL Update device name: %s", sqlite3_errmsg(m_dbase));
+}
+
+void CSQLHelper::FlushMeters(const bool bAll)
+{
+	std::lock_guard<std::mutex> l(m_sqlQueryMutex);
+	if (m_dbase == nullptr)
+		return;
+	if (m_meterStore.Flush(m_dbase, bAll) < 0)
+		_log.Log(LOG_ERROR, "SQL Flush meters: %s", sqlite3_errmsg(m_dbase));
+}
+
+//Caller must hold m_sceneIndexMutex
+void CSQLHelper::RefreshSceneIndex()
+{
+	// set before reading, a change made while we read invalidates it again
+	if (m_bSceneIndexValid.exchange(true))
+		return;
+
+	m_sceneActivators.clear();
+	m_deviceScenes.clear();
+
 	std::vector<std::vector<std::string> > result;
+	result = safe_query("SELECT ID, Activators, SceneType FROM Scenes WHERE (Activators!='') ORDER BY ID");
+	for (const auto &sd : result)
+	{
+		uint64_t SceneRowID = std::stoull(sd[0]);
+		int SceneType = atoi(sd[2].c_str());
+
+		std::vector<std::string> arrayActivators;
+		StringSplit(sd[1], ";", arrayActivators);
+		for (const auto &sCodeCmd : arrayActivators)
+		{
+			std::vector<std::string> arrayCode;
+			StringSplit(sCodeCmd, ":", arrayCode);
+			if (arrayCode.empty())
+				continue;
 
-	result = safe_query("SELECT SceneRowID FROM SceneDevices WHERE (DeviceRowID == %" PRIu64 ")", DevIdx);
+			char *pEnd = nullptr;
+			uint64_t DevRowIdx = strtoull(arrayCode[0].c_str(), &pEnd, 10);
+			if (pEnd == arrayCode[0].c_str())
+			{
+				_log.Log(LOG_ERROR, "Scene %" PRIu64 " has an invalid activator (%s)", SceneRowID, sCodeCmd.c_str());
+				continue;
+			}
+			_tSceneActivator activator;
+			activator.SceneRowID = SceneRowID;
+			activator.SceneType = SceneType;
+			activator.bHaveCode = ((arrayCode.size() == 2) && (!arrayCode[1].empty()));
+			activator.Code = (activator.bHaveCode) ? atoi(arrayCode[1].c_str()) : 0;
+			m_sceneActivators[DevRowIdx].push_back(activator);
+		}
+	}
+
+	result = safe_query("SELECT DeviceRowID, SceneRowID FROM SceneDevices ORDER BY ID");
 	for (const auto &sd : result)
 	{
-		CheckSceneStatus(sd[0]);
+		m_deviceScenes[std::stoull(sd[0])].push_back(std::stoull(sd[1]));
 	}
 }
 
+std::vector<CSQLHelper::_tSceneActivator> CSQLHelper::GetSceneActivators(const uint64_t DevRowIdx)
+{
+	std::lock_guard<std::mutex> l(m_sceneIndexMutex);
+	RefreshSceneIndex();
+	auto itt = m_sceneActivators.find(DevRowIdx);
+	if (itt == m_sceneActivators.end())
+		return {};
+	return itt->second;
+}
+
+std::vector<uint64_t> CSQLHelper::GetDeviceScenes(const uint64_t DevRowIdx)
+{
+	std::lock_guard<std::mutex> l(m_sceneIndexMutex);
+	RefreshSceneIndex();
+	auto itt = m_deviceScenes.find(DevRowIdx);
+	if (itt == m_deviceScenes.end())
+		return {};
+	return itt->second;
+}
+
 void CSQLHelper::CheckSceneStatus(const std::string& Idx)
 {
 	uint64_t idxll = std::stoull(Idx);
@@ -8659,6 +8978,18 @@ void CSQLHelper::DeleteDateRange(const char *ID, const std::string &fromDate, co
 		safe_query("DELETE FROM %q WHERE (DeviceRowID=='%q') AND (Date>='%q') AND (Date<='%q')", historyTable.c_str(), ID, fromDate.c_str(), toDate.c_str() );
 		_log.Debug(DEBUG_NORM, "CSQLHelper::DeleteDateRange; delete from %s with idx: %s and Date >= %s and date <= %s" , historyTable.c_str(), std::string(ID).c_str(), fromDate.c_str(), toDate.c_str() );
 	}
+
+	if (m_shortlogStore.IsOpen())
+	{
+		// same bounds as the string compare above: a date without time is the start of that day, for the
+		// end it excludes the whole day
+		time_t tFrom, tTo;
+		struct tm tm1;
+		bool bFromDate = (fromDate.size() == 10);
+		bool bToDate = (toDate.size() == 10);
+		if ((ParseSQLdatetime(tFrom, tm1, bFromDate ? fromDate + " 00:00:00" : fromDate)) && (ParseSQLdatetime(tTo, tm1, bToDate ? toDate + " 00:00:00" : toDate)))
+			m_shortlogStore.RemoveRange(std::strtoull(ID, nullptr, 10), tFrom, bToDate ? tTo - 1 : tTo);
+	}
 }
 
 void CSQLHelper::DeleteDataPoint(const char* ID, const std::string& Date)
@@ -8781,7 +9112,11 @@ bool CSQLHelper::RestoreDatabase(const std::string& dbase)
 
 	StopThread();
 
-	//stop database
+	//stop database, the held back meter values belong to the replaced database
+	{
+		std::lock_guard<std::mutex> l(m_sqlQueryMutex);
+		m_meterStore.Clear();
+	}
 	sqlite3_close(m_dbase);
 	m_dbase = nullptr;
 	std::ofstream outfile2;
@@ -8824,6 +9159,7 @@ bool CSQLHelper::BackupDatabase(const std::string& OutputFile)
 		return false; //database not open!
 
 	//First cleanup the database
+	FlushMeters(true);
 	OptimizeDatabase(m_dbase);
 	VacuumDatabase();
 
@@ -9770,6 +10106,30 @@ void CSQLHelper::AllowNewHardwareTimer(const int iTotMinutes)
 	_log.Log(LOG_STATUS, "New sensors allowed for %d minutes...", iTotMinutes);
 }
 
+void CSQLHelper::SetLastSwitch(const std::string& ID, const uint64_t RowID)
+{
+	std::lock_guard<std::mutex> l(m_lastSwitchMutex);
+	m_LastSwitchID = ID;
+	m_LastSwitchRowID = RowID;
+}
+
+bool CSQLHelper::GetLastSwitch(std::string& ID, uint64_t& RowID)
+{
+	std::lock_guard<std::mutex> l(m_lastSwitchMutex);
+	if (m_LastSwitchID.empty())
+		return false;
+	ID = m_LastSwitchID;
+	RowID = m_LastSwitchRowID;
+	return true;
+}
+
+void CSQLHelper::ClearLastSwitch()
+{
+	std::lock_guard<std::mutex> l(m_lastSwitchMutex);
+	m_LastSwitchID.clear();
+	m_LastSwitchRowID = 0;
+}
+
 /*
 std::string CSQLHelper::GetDeviceValue(const char * FieldName, const char *Idx)
 {
@@ -10468,6 +10828,13 @@ bool CSQLHelper::TransferDevice(const std::string& sOldIdx, const std::string& s
 	m_sql.safe_query("UPDATE Percentage SET DeviceRowID='%q' WHERE (DeviceRowID == '%q') AND (Date>'%q')", sOldIdx.c_str(), sNewIdx.c_str(), szLastOldDate.c_str());
 	m_sql.safe_query("UPDATE Percentage_Calendar SET DeviceRowID='%q' WHERE (DeviceRowID == '%q') AND (Date>'%q')", sOldIdx.c_str(), sNewIdx.c_str(), szLastOldDate.c_str());
 
+	//rebuild the short log series of the old device from the moved rows
+	if (m_shortlogStore.IsOpen())
+	{
+		m_shortlogStore.RemoveDevice(std::stoull(sOldIdx));
+		ImportShortLogStore(sOldIdx);
+	}
+
 	m_sql.DeleteDevices(sNewIdx);
 
  	m_mainworker.m_scheduler.ReloadSchedules();
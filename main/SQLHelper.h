@@ -1,9 +1,17 @@
 #pragma once
 
+#include <atomic>
+#include <cstdarg>
+#include <functional>
 #include <string>
+#include <unordered_map>
+#include "CalendarRollup.h"
+#include "MeterStore.h"
 #include "RFXNames.h"
+#include "TimeSeriesStore.h"
 #include "../hardware/hardwaretypes.h"
 #include "Helper.h"
+#include "Trace.h"
 #include "../httpclient/UrlEncode.h"
 #include "../httpclient/HTTPClient.h"
 
@@ -86,6 +94,7 @@ struct _tTaskItem
 	_tColor _Color;
 	std::string _relatedEvent;
 	timeval _DelayTimeBegin = { 0 };
+	tracer::_tLink _trace = tracer::Link(); // trace of the thread that queued the task
 
 	static _tTaskItem UpdateDevice(const float DelayTime, const uint64_t idx, const int nValue, const std::string &sValue, const int Protected, const bool bEventTrigger, const std::string &User)
 	{
@@ -322,7 +331,10 @@ public:
 	~CSQLHelper();
 
 	void SetDatabaseName(const std::string &DBName);
+	const std::string &GetDatabaseName() const;
 	void SetJournalMode(const std::string &mode);
+	// optional columnar copy of the Temperature/Percentage/Fan short logs, used for the 'day' graphs
+	void SetShortLogStorePath(const std::string &szPath);
 
 	bool OpenDatabase();
 	void CloseDatabase();
@@ -386,6 +398,31 @@ public:
 	void CheckSceneStatusWithDevice(uint64_t DevIdx);
 	void CheckSceneStatusWithDevice(const std::string &DevIdx);
 
+	struct _tSceneActivator
+	{
+		uint64_t SceneRowID;
+		int SceneType;
+		bool bHaveCode;
+		int Code;
+	};
+	// Scenes/groups activated by this device (Scenes.Activators), from an index that is rebuilt after the Scenes or SceneDevices tables changed
+	std::vector<_tSceneActivator> GetSceneActivators(uint64_t DevRowIdx);
+	// Scenes/groups this device is part of (SceneDevices)
+	std::vector<uint64_t> GetDeviceScenes(uint64_t DevRowIdx);
+	// has to be called after Scenes.Activators or Scenes.SceneType was changed, inserts and deletes are seen by the update hook
+	void InvalidateSceneIndex();
+	// DeviceStatus row written outside of the meter store
+	void InvalidateMeterRow(uint64_t ID);
+	// writes the meter values that are held back by MeterWriteInterval, all of them or those whose interval has passed
+	void FlushMeters(bool bAll);
+	// the meter value of a device that is held back by MeterWriteInterval and not yet in DeviceStatus
+	bool GetPendingMeterValue(uint64_t ID, meter_store::_tMeterRow &row);
+	// battery level/name of a received device, written through the meter store so a held back value is kept
+	void UpdateReceivedBatteryLevel(uint64_t ID, int BatteryLevel);
+	void UpdateReceivedName(uint64_t ID, const std::string &Name);
+	// seconds in which the updates of a meter are coalesced (MeterWriteInterval), at most the shortlog interval
+	void SetMeterWriteInterval(int iSeconds);
+
 	void ScheduleShortlog();
 	void CleanupShortLog();
 	void ScheduleDay();
@@ -418,8 +455,15 @@ public:
 	bool HandleOnOffAction(bool bIsOn, const std::string &OnAction, const std::string &OffAction);
 
 	std::vector<std::vector<std::string>> safe_query(const char *fmt, ...);
+	// For a statement that is built at run time: the statement metrics use szLabel (a string literal) as the
+	// series name, the built format would add a series for every variant
+	std::vector<std::vector<std::string>> safe_query_label(const char *szLabel, const char *fmt, ...);
 	std::vector<std::vector<std::string>> safe_queryBlob(const char *fmt, ...);
 	std::vector<std::vector<std::string>> unsafe_query(const std::string& szQuery);
+	// Passes every row to onRow straight from the sqlite cursor (NULL columns as ""), without building a result set
+	bool safe_query_each(const std::function<void(const char *const *values, int cols)> &onRow, const char *fmt, ...);
+	// Monthly min/max/sum/count of a *_Calendar field, served from (and refreshing) the Calendar_Rollup table
+	bool GetCalendarMonths(const std::string &table, uint64_t idx, const std::string &field, std::vector<calendar_rollup::_tMonth> &months);
 
 	void safe_exec_no_return(const char *fmt, ...);
 	bool safe_UpdateBlobInTableWithID(const std::string &Table, const std::string &Column, const std::string &sID, const std::string &BlobData);
@@ -445,6 +489,11 @@ public:
 	void DeletePreferencesVar(const std::string &Key);
 	void AllowNewHardwareTimer(int iTotMinutes);
 
+	// last switch that received a command, for the learn switch command. Set by the RX threads
+	void SetLastSwitch(const std::string &ID, uint64_t RowID);
+	bool GetLastSwitch(std::string &ID, uint64_t &RowID);
+	void ClearLastSwitch();
+
 	bool InsertCustomIconFromZip(const std::string &szZip, std::string &ErrorMessage);
 	uint64_t InsertCustomIconFromZipFile(const std::string &szZipFile, std::string &ErrorMessage);
 
@@ -459,9 +508,7 @@ public:
 	bool CalcMultiMeterPrice(const uint64_t idx, const float divider, const char* szDateStart, const char* szDateEnd, float& price);
 	bool TransferDevice(const std::string& sOldIdx, const std::string&  sNewIdx);
 public:
-	std::string m_LastSwitchID; // for learning command
 	std::string m_UniqueID;
-	uint64_t m_LastSwitchRowID;
 	_eWindUnit m_windunit;
 	std::string m_windsign;
 	float m_windscale;
@@ -483,6 +530,7 @@ public:
 	bool m_bDisableDzVentsSystem;
 	double m_max_kwh_usage;
 	std::map<uint64_t, float> m_actual_prices;
+	CTimeSeriesStore m_shortlogStore;
 
 private:
 	std::mutex m_executeThreadMutex;
@@ -490,16 +538,25 @@ private:
 	sqlite3 *m_dbase;
 	std::string m_dbase_name;
 	std::string m_journal_mode;
+	std::string m_shortlog_store_path;
 	unsigned char m_sensortimeoutcounter;
 	std::map<uint64_t, int> m_timeoutlastsend;
 	std::map<uint64_t, int> m_batterylowlastsend;
 	bool m_bAcceptHardwareTimerActive;
 	float m_iAcceptHardwareTimerCounter;
 	bool m_bPreviousAcceptNewHardware;
+	std::mutex m_lastSwitchMutex;
+	std::string m_LastSwitchID;
+	uint64_t m_LastSwitchRowID;
 
 	std::vector<_tTaskItem> m_background_task_queue;
 	std::shared_ptr<std::thread> m_thread;
 	std::mutex m_background_task_mutex;
+	std::mutex m_sceneIndexMutex;
+	std::atomic<bool> m_bSceneIndexValid{ false };
+	std::unordered_map<uint64_t, std::vector<_tSceneActivator>> m_sceneActivators;
+	std::unordered_map<uint64_t, std::vector<uint64_t>> m_deviceScenes;
+	meter_store::CMeterStore m_meterStore;
 	bool StartThread();
 	void StopThread();
 	void Do_Work();
@@ -514,11 +571,16 @@ private:
 	void FixDaylightSaving();
 
 	void RefreshActualPrices();
+	void RefreshSceneIndex();
 
 	// Returns DeviceRowID
 	uint64_t UpdateValueInt(const int HardwareID, const int OrgHardwareID, const char *ID, const unsigned char unit, const unsigned char devType, const unsigned char subType, const unsigned char signallevel, const unsigned char batterylevel, const int nValue,
 				const char *sValue, std::string &devname, const bool bUseOnOffAction, const char* User = nullptr);
 
+	// Meters through the meter store, false when the device has to take the full UpdateValueInt path
+	bool UpdateMeterValueInt(int HardwareID, int OrgHardwareID, const char *ID, unsigned char unit, unsigned char devType, unsigned char subType, unsigned char signallevel,
+				 unsigned char batterylevel, int nValue, const char *sValue, std::string &devname, uint64_t &ulID);
+
 	uint64_t UpdateManagedValueInt(int HardwareID, int OrgHardwareID, const char* ID, unsigned char unit, unsigned char devType, unsigned char subType, unsigned char signallevel, unsigned char batterylevel, int nValue,
 		const char* sValue, std::string& devname, bool bUseOnOffAction, const char* User = nullptr);
 
@@ -539,6 +601,7 @@ private:
 	void UpdateMultiMeter();
 	void UpdatePercentageLog();
 	void UpdateFanLog();
+	void ImportShortLogStore(const std::string &sIdx = "");
 	void AddCalendarTemperature();
 	void AddCalendarUpdateRain();
 	void AddCalendarUpdateWind();
@@ -556,6 +619,7 @@ private:
 	void CorrectOffDelaySwitchStates();
 
 	std::vector<std::vector<std::string>> query(const std::string &szQuery);
+	std::vector<std::vector<std::string>> safe_vquery(const char *fmt, va_list args);
 	std::vector<std::vector<std::string>> queryBlob(const std::string &szQuery);
 };
 
@@ -420,6 +420,7 @@ void signal_handler(int sig_num
 	case SIGILL:
 	case SIGABRT:
 	case SIGFPE:
+		_log.SetSynchronous();
 #if defined(__linux__)
 #if defined(__GLIBC__)
 		pthread_getname_np(pthread_self(), thread_name, sizeof(thread_name));
@@ -474,6 +475,7 @@ void signal_handler(int sig_num
 		break;
 #ifndef WIN32
 	case SIGUSR1:
+		_log.SetSynchronous();
 		fatal_handling = 1;
 		fatal_handling_thread = pthread_self();
 		_log.Log(LOG_ERROR, "Domoticz(%d) is exiting due to watchdog triggered...", getpid());
@@ -0,0 +1,164 @@
+#include "stdafx.h"
+#include "StartupProfile.h"
+#include "Logger.h"
+#include <inttypes.h>
+
+namespace startup
+{
+	namespace
+	{
+		const std::chrono::steady_clock::time_point g_tStart = std::chrono::steady_clock::now();
+
+		std::mutex g_mutex;
+		bool g_bProfiling = false;
+		bool g_bComplete = false;
+		std::string g_stage = "starting";
+		int g_hardwareStarted = 0;
+		int g_hardwareTotal = 0;
+		std::vector<_tPhase> g_phases;
+		std::vector<std::pair<std::string, std::function<void()>>> g_deferred;
+
+		uint64_t NowMs()
+		{
+			return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - g_tStart).count();
+		}
+	} // namespace
+
+	void SetProfiling(const bool bProfiling)
+	{
+		std::lock_guard<std::mutex> l(g_mutex);
+		g_bProfiling = bProfiling;
+	}
+
+	CPhase::CPhase(const std::string &name, const int level)
+		: m_level(level)
+	{
+		Next(name);
+	}
+
+	CPhase::~CPhase()
+	{
+		End();
+	}
+
+	void CPhase::Next(const std::string &name)
+	{
+		End();
+		std::lock_guard<std::mutex> l(g_mutex);
+		if (g_bComplete)
+			return; // only the startup itself is profiled, not a later database restore
+		_tPhase phase;
+		phase.name = name;
+		phase.level = m_level;
+		phase.startMs = NowMs();
+		m_index = static_cast<int>(g_phases.size());
+		g_phases.push_back(phase);
+	}
+
+	void CPhase::End()
+	{
+		if (m_index < 0)
+			return;
+		std::lock_guard<std::mutex> l(g_mutex);
+		_tPhase &phase = g_phases[m_index];
+		phase.durationMs = NowMs() - phase.startMs;
+		phase.bRunning = false;
+		m_index = -1;
+	}
+
+	void SetStage(const char *szStage)
+	{
+		std::lock_guard<std::mutex> l(g_mutex);
+		g_stage = szStage;
+	}
+
+	void SetHardwareProgress(const int started, const int total)
+	{
+		std::lock_guard<std::mutex> l(g_mutex);
+		g_hardwareStarted = started;
+		g_hardwareTotal = total;
+	}
+
+	void Defer(const std::string &name, const std::function<void()> &task)
+	{
+		{
+			std::lock_guard<std::mutex> l(g_mutex);
+			if (!g_bComplete)
+			{
+				g_deferred.emplace_back(name, task);
+				return;
+			}
+		}
+		task();
+	}
+
+	void Complete()
+	{
+		SetStage("maintenance");
+		{
+			CPhase phase("deferred maintenance");
+			while (true)
+			{
+				std::vector<std::pair<std::string, std::function<void()>>> deferred;
+				{
+					std::lock_guard<std::mutex> l(g_mutex);
+					deferred.swap(g_deferred);
+					// from here on Defer runs its task right away
+					g_bComplete = deferred.empty();
+				}
+				if (deferred.empty())
+					break;
+				for (const auto &task : deferred)
+				{
+					CPhase taskPhase(task.first, 1);
+					task.second();
+				}
+			}
+		}
+
+		std::lock_guard<std::mutex> l(g_mutex);
+		g_stage = "ready";
+
+		uint64_t webserverMs = 0;
+		for (const auto &phase : g_phases)
+		{
+			if (phase.name == "webserver")
+				webserverMs = phase.startMs + phase.durationMs;
+		}
+		_log.Log(LOG_STATUS, "Startup: complete in %.1f seconds (web server available after %.1f seconds, %d hardware)", NowMs() / 1000.0, webserverMs / 1000.0,
+			g_hardwareTotal);
+		if (!g_bProfiling)
+			return;
+		_log.Log(LOG_STATUS, "Startup profile:    start   duration  phase");
+		for (const auto &phase : g_phases)
+		{
+			_log.Log(LOG_STATUS, "Startup profile: %8" PRIu64 " %8" PRIu64 " ms  %s%s", phase.startMs, phase.durationMs, (phase.level > 0) ? "  " : "", phase.name.c_str());
+		}
+	}
+
+	bool IsComplete()
+	{
+		std::lock_guard<std::mutex> l(g_mutex);
+		return g_bComplete;
+	}
+
+	_tStatus GetStatus()
+	{
+		_tStatus status;
+		uint64_t nowMs = NowMs();
+		std::lock_guard<std::mutex> l(g_mutex);
+		status.bReady = g_bComplete;
+		status.stage = g_stage;
+		status.uptimeMs = nowMs;
+		status.hardwareStarted = g_hardwareStarted;
+		status.hardwareTotal = g_hardwareTotal;
+		status.deferredTasks = g_deferred.size();
+		status.phases = g_phases;
+		for (auto &phase : status.phases)
+		{
+			if (phase.bRunning)
+				phase.durationMs = nowMs - phase.startMs;
+		}
+		return status;
+	}
+} // namespace startup
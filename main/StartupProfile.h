@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Startup phases, their timings and the work that is deferred until startup is complete
+//
+// MainWorker::Start and the database open mark their phases, the hardware start adds one phase per
+// hardware. The web server is started early, getstartupstatus reports the progress while the rest of
+// the system comes up. With -startupprofile the full phase breakdown is logged when startup completes.
+namespace startup
+{
+	struct _tPhase
+	{
+		std::string name;
+		int level = 0;
+		uint64_t startMs = 0; // since the process started
+		uint64_t durationMs = 0;
+		bool bRunning = true;
+	};
+
+	struct _tStatus
+	{
+		bool bReady = false;
+		std::string stage;
+		uint64_t uptimeMs = 0;
+		int hardwareStarted = 0;
+		int hardwareTotal = 0;
+		size_t deferredTasks = 0;
+		std::vector<_tPhase> phases;
+	};
+
+	void SetProfiling(bool bProfiling);
+
+	// Times its scope as a phase, level 1 phases are shown as part of the level 0 phase before them
+	class CPhase
+	{
+	public:
+		explicit CPhase(const std::string &name, int level = 0);
+		~CPhase();
+		// ends this phase and starts the next one at the same level
+		void Next(const std::string &name);
+		CPhase(const CPhase &) = delete;
+		CPhase &operator=(const CPhase &) = delete;
+
+	private:
+		void End();
+		int m_index = -1;
+		int m_level;
+	};
+
+	// coarse stage reported by getstartupstatus (database, webserver, hardware, ...)
+	void SetStage(const char *szStage);
+	void SetHardwareProgress(int started, int total);
+
+	// maintenance that does not have to be done before devices are served, runs right away after startup
+	void Defer(const std::string &name, const std::function<void()> &task);
+	// runs the deferred tasks and reports the startup time
+	void Complete();
+
+	bool IsComplete();
+	_tStatus GetStatus();
+} // namespace startup
@@ -0,0 +1,620 @@
+#include "stdafx.h"
+#include "TimeSeriesStore.h"
+#include "Helper.h"
+#include "Logger.h"
+#include <fstream>
+#include <inttypes.h>
+
+namespace
+{
+	constexpr uint32_t iBlockMagic = 0x31535444; // "DTS1"
+	// magic, points, columns, payload bytes, first time, last time
+	constexpr size_t iBlockHeaderSize = 4 + 2 + 1 + 4 + 8 + 8;
+	constexpr size_t iMaxColumns = 16;
+
+	size_t HeadRecordSize(const size_t columns)
+	{
+		return 8 + 1 + columns * 8;
+	}
+
+	int LeadingZeros(uint64_t x)
+	{
+		int n = 0;
+		for (uint64_t mask = 1ULL << 63; (mask != 0) && ((x & mask) == 0); mask >>= 1)
+			n++;
+		return n;
+	}
+
+	int TrailingZeros(uint64_t x)
+	{
+		int n = 0;
+		for (; (n < 64) && ((x & 1) == 0); x >>= 1)
+			n++;
+		return n;
+	}
+
+	class CBitWriter
+	{
+	public:
+		explicit CBitWriter(std::string &out)
+			: m_out(out)
+		{
+		}
+		void Write(const uint64_t value, const int bits)
+		{
+			for (int ii = bits - 1; ii >= 0; ii--)
+			{
+				if (m_free == 0)
+				{
+					m_out += '\0';
+					m_free = 8;
+				}
+				m_free--;
+				if ((value >> ii) & 1)
+					m_out.back() |= static_cast<char>(1 << m_free);
+			}
+		}
+
+	private:
+		std::string &m_out;
+		int m_free = 0;
+	};
+
+	class CBitReader
+	{
+	public:
+		CBitReader(const uint8_t *data, const size_t len)
+			: m_data(data)
+			, m_bits(len * 8)
+		{
+		}
+		uint64_t Read(const int bits)
+		{
+			uint64_t value = 0;
+			for (int ii = 0; ii < bits; ii++)
+			{
+				if (m_pos >= m_bits)
+				{
+					m_bError = true;
+					return 0;
+				}
+				value = (value << 1) | ((m_data[m_pos >> 3] >> (7 - (m_pos & 7))) & 1);
+				m_pos++;
+			}
+			return value;
+		}
+		bool Error() const
+		{
+			return m_bError;
+		}
+
+	private:
+		const uint8_t *m_data;
+		size_t m_bits;
+		size_t m_pos = 0;
+		bool m_bError = false;
+	};
+
+	void EncodeTimes(CBitWriter &writer, const std::vector<time_t> &times)
+	{
+		int64_t prevDelta = 0;
+		for (size_t ii = 1; ii < times.size(); ii++)
+		{
+			int64_t delta = static_cast<int64_t>(times[ii] - times[ii - 1]);
+			int64_t dod = delta - prevDelta;
+			prevDelta = delta;
+			if (dod == 0)
+				writer.Write(0, 1);
+			else if ((dod >= -63) && (dod <= 64))
+			{
+				writer.Write(0x2, 2);
+				writer.Write(static_cast<uint64_t>(dod + 63), 7);
+			}
+			else if ((dod >= -255) && (dod <= 256))
+			{
+				writer.Write(0x6, 3);
+				writer.Write(static_cast<uint64_t>(dod + 255), 9);
+			}
+			else if ((dod >= -2047) && (dod <= 2048))
+			{
+				writer.Write(0xE, 4);
+				writer.Write(static_cast<uint64_t>(dod + 2047), 12);
+			}
+			else
+			{
+				writer.Write(0xF, 4);
+				writer.Write(static_cast<uint64_t>(dod), 64);
+			}
+		}
+	}
+
+	bool DecodeTimes(CBitReader &reader, const time_t tFirst, const size_t points, std::vector<time_t> &times)
+	{
+		times.resize(points);
+		times[0] = tFirst;
+		int64_t prevDelta = 0;
+		for (size_t ii = 1; ii < points; ii++)
+		{
+			int64_t dod = 0;
+			if (reader.Read(1) != 0)
+			{
+				if (reader.Read(1) == 0)
+					dod = static_cast<int64_t>(reader.Read(7)) - 63;
+				else if (reader.Read(1) == 0)
+					dod = static_cast<int64_t>(reader.Read(9)) - 255;
+				else if (reader.Read(1) == 0)
+					dod = static_cast<int64_t>(reader.Read(12)) - 2047;
+				else
+					dod = static_cast<int64_t>(reader.Read(64));
+			}
+			prevDelta += dod;
+			times[ii] = times[ii - 1] + static_cast<time_t>(prevDelta);
+		}
+		return !reader.Error();
+	}
+
+	// values of one column are at values[column + ii * columns]
+	void EncodeColumn(CBitWriter &writer, const std::vector<double> &values, const size_t column, const size_t columns)
+	{
+		int prevLeading = -1;
+		int prevTrailing = 0;
+		uint64_t prev = 0;
+		for (size_t ii = column; ii < values.size(); ii += columns)
+		{
+			uint64_t bits;
+			memcpy(&bits, &values[ii], sizeof(bits));
+			if (ii == column)
+			{
+				writer.Write(bits, 64);
+				prev = bits;
+				continue;
+			}
+			uint64_t x = bits ^ prev;
+			prev = bits;
+			if (x == 0)
+			{
+				writer.Write(0, 1);
+				continue;
+			}
+			writer.Write(1, 1);
+			int leading = std::min(LeadingZeros(x), 31);
+			int trailing = TrailingZeros(x);
+			if ((prevLeading >= 0) && (leading >= prevLeading) && (trailing >= prevTrailing))
+			{
+				// fits in the previous meaningful window
+				writer.Write(0, 1);
+				writer.Write(x >> prevTrailing, 64 - prevLeading - prevTrailing);
+				continue;
+			}
+			int meaningful = 64 - leading - trailing;
+			writer.Write(1, 1);
+			writer.Write(static_cast<uint64_t>(leading), 5);
+			writer.Write(static_cast<uint64_t>(meaningful - 1), 6);
+			writer.Write(x >> trailing, meaningful);
+			prevLeading = leading;
+			prevTrailing = trailing;
+		}
+	}
+
+	bool DecodeColumn(CBitReader &reader, std::vector<double> &values, const size_t column, const size_t columns)
+	{
+		int prevLeading = 0;
+		int prevTrailing = 0;
+		uint64_t prev = 0;
+		for (size_t ii = column; ii < values.size(); ii += columns)
+		{
+			if (ii == column)
+				prev = reader.Read(64);
+			else if (reader.Read(1) != 0)
+			{
+				if (reader.Read(1) != 0)
+				{
+					prevLeading = static_cast<int>(reader.Read(5));
+					int meaningful = static_cast<int>(reader.Read(6)) + 1;
+					prevTrailing = 64 - prevLeading - meaningful;
+					if (prevTrailing < 0)
+						return false;
+				}
+				prev ^= reader.Read(64 - prevLeading - prevTrailing) << prevTrailing;
+			}
+			memcpy(&values[ii], &prev, sizeof(prev));
+		}
+		return !reader.Error();
+	}
+
+	struct _tBlockHeader
+	{
+		uint16_t points = 0;
+		uint8_t columns = 0;
+		uint32_t payload = 0;
+		int64_t tFirst = 0;
+		int64_t tLast = 0;
+	};
+
+	bool ParseBlockHeader(const std::string &data, const size_t pos, _tBlockHeader &header)
+	{
+		if (pos + iBlockHeaderSize > data.size())
+			return false;
+		uint32_t magic;
+		const char *p = data.data() + pos;
+		memcpy(&magic, p, sizeof(magic));
+		memcpy(&header.points, p + 4, sizeof(header.points));
+		memcpy(&header.columns, p + 6, sizeof(header.columns));
+		memcpy(&header.payload, p + 7, sizeof(header.payload));
+		memcpy(&header.tFirst, p + 11, sizeof(header.tFirst));
+		memcpy(&header.tLast, p + 19, sizeof(header.tLast));
+		return (magic == iBlockMagic) && (header.points > 0) && (header.columns > 0) && (header.columns <= iMaxColumns) && (pos + iBlockHeaderSize + header.payload <= data.size());
+	}
+
+	bool ReadFile(const std::string &szFile, std::string &data)
+	{
+		std::ifstream file(szFile, std::ios::in | std::ios::binary);
+		if (!file.is_open())
+			return false;
+		file.seekg(0, std::ios::end);
+		data.resize(static_cast<size_t>(file.tellg()));
+		file.seekg(0);
+		return data.empty() || file.read(&data[0], data.size());
+	}
+} // namespace
+
+CTimeSeriesStore::~CTimeSeriesStore()
+{
+	Close();
+}
+
+bool CTimeSeriesStore::Open(const std::string &szPath)
+{
+	std::lock_guard<std::mutex> l(m_mutex);
+	m_headPoints.clear();
+	m_szPath.clear();
+	std::string szDir = szPath;
+	while ((!szDir.empty()) && ((szDir.back() == '/') || (szDir.back() == '\\')))
+		szDir.pop_back();
+	mkdir_deep(szDir.c_str(), 0755);
+	if (szDir.empty() || (!file_exist(szDir.c_str())))
+	{
+		_log.Log(LOG_ERROR, "TimeSeriesStore: cannot create %s", szPath.c_str());
+		return false;
+	}
+	m_szPath = szDir + "/";
+	_log.Log(LOG_STATUS, "TimeSeriesStore: short log series stored in %s", m_szPath.c_str());
+	return true;
+}
+
+void CTimeSeriesStore::Close()
+{
+	std::lock_guard<std::mutex> l(m_mutex);
+	m_szPath.clear();
+	m_headPoints.clear();
+}
+
+bool CTimeSeriesStore::IsEmpty()
+{
+	std::lock_guard<std::mutex> l(m_mutex);
+	std::vector<std::string> tables;
+	DirectoryListing(tables, m_szPath, true, false);
+	for (const auto &table : tables)
+	{
+		std::vector<std::string> files;
+		DirectoryListing(files, m_szPath + table, false, true);
+		if (!files.empty())
+			return false;
+	}
+	return true;
+}
+
+std::string CTimeSeriesStore::SeriesFile(const std::string &table, const uint64_t idx, const char *szExtension) const
+{
+	return m_szPath + table + "/" + std::to_string(idx) + szExtension;
+}
+
+bool CTimeSeriesStore::ReadHead(const std::string &szHeadFile, std::vector<time_t> &times, std::vector<double> &values, uint8_t &columns)
+{
+	times.clear();
+	values.clear();
+	columns = 0;
+	std::string data;
+	if (!ReadFile(szHeadFile, data))
+		return false;
+	size_t pos = 0;
+	while (pos + 9 <= data.size())
+	{
+		int64_t tTime;
+		uint8_t cols;
+		memcpy(&tTime, data.data() + pos, sizeof(tTime));
+		memcpy(&cols, data.data() + pos + 8, sizeof(cols));
+		if ((cols == 0) || (cols > iMaxColumns) || (pos + HeadRecordSize(cols) > data.size()))
+			break; // truncated record
+		if (columns == 0)
+			columns = cols;
+		times.push_back(static_cast<time_t>(tTime));
+		for (size_t ii = 0; ii < columns; ii++)
+		{
+			double value = 0;
+			if (ii < cols)
+				memcpy(&value, data.data() + pos + 9 + ii * 8, sizeof(value));
+			values.push_back(value);
+		}
+		pos += HeadRecordSize(cols);
+	}
+	return true;
+}
+
+time_t CTimeSeriesStore::LastSealedTime(const std::string &table, const uint64_t idx)
+{
+	std::string segment;
+	if (!ReadFile(SeriesFile(table, idx, ".seg"), segment))
+		return 0;
+	time_t tLastSealed = 0;
+	size_t pos = 0;
+	_tBlockHeader header;
+	while (ParseBlockHeader(segment, pos, header))
+	{
+		tLastSealed = static_cast<time_t>(header.tLast);
+		pos += iBlockHeaderSize + header.payload;
+	}
+	return tLastSealed;
+}
+
+bool CTimeSeriesStore::Append(const std::string &table, const uint64_t idx, const time_t tTime, const std::vector<double> &values)
+{
+	std::lock_guard<std::mutex> l(m_mutex);
+	return AppendLocked(table, idx, tTime, values);
+}
+
+bool CTimeSeriesStore::AppendLocked(const std::string &table, const uint64_t idx, const time_t tTime, const std::vector<double> &values)
+{
+	if (values.empty() || (values.size() > iMaxColumns) || m_szPath.empty())
+		return false;
+
+	std::string szHeadFile = SeriesFile(table, idx, ".head");
+	std::string key = table + "/" + std::to_string(idx);
+	auto itt = m_headPoints.find(key);
+	if (itt == m_headPoints.end())
+	{
+		createdir((m_szPath + table).c_str(), 0755);
+		std::vector<time_t> times;
+		std::vector<double> headValues;
+		uint8_t columns;
+		ReadHead(szHeadFile, times, headValues, columns);
+		time_t tLastSealed = LastSealedTime(table, idx);
+		size_t nPoints = std::count_if(times.begin(), times.end(), [tLastSealed](const time_t tTime) { return tTime > tLastSealed; });
+		itt = m_headPoints.insert(std::make_pair(key, nPoints)).first;
+	}
+
+	std::string record(HeadRecordSize(values.size()), '\0');
+	int64_t t64 = static_cast<int64_t>(tTime);
+	uint8_t columns = static_cast<uint8_t>(values.size());
+	memcpy(&record[0], &t64, sizeof(t64));
+	memcpy(&record[8], &columns, sizeof(columns));
+	memcpy(&record[9], values.data(), values.size() * sizeof(double));
+
+	std::ofstream file(szHeadFile, std::ios::out | std::ios::binary | std::ios::app);
+	if (!file.is_open())
+	{
+		_log.Log(LOG_ERROR, "TimeSeriesStore: cannot write %s", szHeadFile.c_str());
+		return false;
+	}
+	file.write(record.data(), record.size());
+	file.close();
+
+	if (++itt->second >= iBlockPoints)
+		return SealBlock(table, idx);
+	return true;
+}
+
+bool CTimeSeriesStore::SealBlock(const std::string &table, const uint64_t idx)
+{
+	std::string szHeadFile = SeriesFile(table, idx, ".head");
+	std::vector<time_t> times;
+	std::vector<double> values;
+	uint8_t columns;
+	if ((!ReadHead(szHeadFile, times, values, columns)) || times.empty())
+		return false;
+
+	// records that are already in the last block, see the truncate below
+	time_t tLastSealed = LastSealedTime(table, idx);
+	size_t nSealed = 0;
+	while ((nSealed < times.size()) && (times[nSealed] <= tLastSealed))
+		nSealed++;
+	times.erase(times.begin(), times.begin() + nSealed);
+	values.erase(values.begin(), values.begin() + nSealed * columns);
+	if (times.empty())
+	{
+		std::ofstream head(szHeadFile, std::ios::out | std::ios::binary | std::ios::trunc);
+		m_headPoints[table + "/" + std::to_string(idx)] = 0;
+		return true;
+	}
+
+	std::string payload;
+	CBitWriter writer(payload);
+	EncodeTimes(writer, times);
+	for (size_t column = 0; column < columns; column++)
+		EncodeColumn(writer, values, column, columns);
+
+	std::string block(iBlockHeaderSize, '\0');
+	uint16_t points = static_cast<uint16_t>(times.size());
+	uint32_t payloadSize = static_cast<uint32_t>(payload.size());
+	int64_t tFirst = static_cast<int64_t>(times.front());
+	int64_t tLast = static_cast<int64_t>(times.back());
+	memcpy(&block[0], &iBlockMagic, sizeof(iBlockMagic));
+	memcpy(&block[4], &points, sizeof(points));
+	memcpy(&block[6], &columns, sizeof(columns));
+	memcpy(&block[7], &payloadSize, sizeof(payloadSize));
+	memcpy(&block[11], &tFirst, sizeof(tFirst));
+	memcpy(&block[19], &tLast, sizeof(tLast));
+	block += payload;
+
+	std::string szSegmentFile = SeriesFile(table, idx, ".seg");
+	std::ofstream file(szSegmentFile, std::ios::out | std::ios::binary | std::ios::app);
+	if (!file.is_open())
+	{
+		_log.Log(LOG_ERROR, "TimeSeriesStore: cannot write %s", szSegmentFile.c_str());
+		return false;
+	}
+	file.write(block.data(), block.size());
+	file.close();
+
+	// a crash before this point leaves the records in the head as well, Scan and the next SealBlock skip
+	// the ones up to the last sealed time
+	std::ofstream head(szHeadFile, std::ios::out | std::ios::binary | std::ios::trunc);
+	m_headPoints[table + "/" + std::to_string(idx)] = 0;
+	return true;
+}
+
+bool CTimeSeriesStore::Scan(const std::string &table, const uint64_t idx, const time_t tFrom, const std::function<void(time_t tTime, const double *values, size_t columns)> &onPoint)
+{
+	std::lock_guard<std::mutex> l(m_mutex);
+	return ScanLocked(table, idx, tFrom, onPoint);
+}
+
+bool CTimeSeriesStore::ScanLocked(const std::string &table, const uint64_t idx, const time_t tFrom, const std::function<void(time_t tTime, const double *values, size_t columns)> &onPoint)
+{
+	if (m_szPath.empty())
+		return false;
+
+	std::string segment;
+	bool bHaveSegment = ReadFile(SeriesFile(table, idx, ".seg"), segment);
+	std::vector<time_t> times;
+	std::vector<double> values;
+	uint8_t columns;
+	bool bHaveHead = ReadHead(SeriesFile(table, idx, ".head"), times, values, columns);
+	if ((!bHaveSegment) && (!bHaveHead))
+		return false;
+
+	time_t tLastSealed = 0;
+	size_t pos = 0;
+	_tBlockHeader header;
+	std::vector<time_t> blockTimes;
+	std::vector<double> blockValues;
+	while (ParseBlockHeader(segment, pos, header))
+	{
+		const uint8_t *payload = reinterpret_cast<const uint8_t *>(segment.data() + pos + iBlockHeaderSize);
+		pos += iBlockHeaderSize + header.payload;
+		tLastSealed = static_cast<time_t>(header.tLast);
+		if (tLastSealed < tFrom)
+			continue;
+		CBitReader reader(payload, header.payload);
+		blockValues.assign(static_cast<size_t>(header.points) * header.columns, 0.0);
+		bool bOK = DecodeTimes(reader, static_cast<time_t>(header.tFirst), header.points, blockTimes);
+		for (size_t column = 0; bOK && (column < header.columns); column++)
+			bOK = DecodeColumn(reader, blockValues, column, header.columns);
+		if (!bOK)
+		{
+			_log.Log(LOG_ERROR, "TimeSeriesStore: corrupt block in %s/%" PRIu64, table.c_str(), idx);
+			continue;
+		}
+		for (size_t ii = 0; ii < header.points; ii++)
+		{
+			if (blockTimes[ii] >= tFrom)
+				onPoint(blockTimes[ii], &blockValues[ii * header.columns], header.columns);
+		}
+	}
+	for (size_t ii = 0; ii < times.size(); ii++)
+	{
+		if ((times[ii] >= tFrom) && (times[ii] > tLastSealed))
+			onPoint(times[ii], &values[ii * columns], columns);
+	}
+	return true;
+}
+
+void CTimeSeriesStore::Purge(const time_t tBefore)
+{
+	std::lock_guard<std::mutex> l(m_mutex);
+	if (m_szPath.empty())
+		return;
+	std::vector<std::string> tables;
+	DirectoryListing(tables, m_szPath, true, false);
+	for (const auto &table : tables)
+	{
+		std::vector<std::string> files;
+		DirectoryListing(files, m_szPath + table, false, true);
+		for (const auto &szFile : files)
+		{
+			if ((szFile.size() < 4) || (szFile.compare(szFile.size() - 4, 4, ".seg") != 0))
+				continue;
+			std::string szSegmentFile = m_szPath + table + "/" + szFile;
+			std::string segment;
+			if (!ReadFile(szSegmentFile, segment))
+				continue;
+			size_t pos = 0;
+			_tBlockHeader header;
+			while (ParseBlockHeader(segment, pos, header) && (header.tLast < tBefore))
+				pos += iBlockHeaderSize + header.payload;
+			if (pos == 0)
+				continue;
+			if (pos >= segment.size())
+			{
+				std::remove(szSegmentFile.c_str());
+				continue;
+			}
+			std::string szTmpFile = szSegmentFile + ".tmp";
+			std::ofstream file(szTmpFile, std::ios::out | std::ios::binary | std::ios::trunc);
+			file.write(segment.data() + pos, segment.size() - pos);
+			file.close();
+			std::remove(szSegmentFile.c_str());
+			std::rename(szTmpFile.c_str(), szSegmentFile.c_str());
+		}
+	}
+}
+
+void CTimeSeriesStore::RemoveDevice(const uint64_t idx)
+{
+	std::lock_guard<std::mutex> l(m_mutex);
+	if (m_szPath.empty())
+		return;
+	std::vector<std::string> tables;
+	DirectoryListing(tables, m_szPath, true, false);
+	for (const auto &table : tables)
+	{
+		std::remove(SeriesFile(table, idx, ".seg").c_str());
+		std::remove(SeriesFile(table, idx, ".head").c_str());
+		m_headPoints.erase(table + "/" + std::to_string(idx));
+	}
+}
+
+void CTimeSeriesStore::RemoveRange(const uint64_t idx, const time_t tFrom, const time_t tTo)
+{
+	std::lock_guard<std::mutex> l(m_mutex);
+	if (m_szPath.empty())
+		return;
+	std::vector<std::string> tables;
+	DirectoryListing(tables, m_szPath, true, false);
+	for (const auto &table : tables)
+	{
+		// blocks are immutable, the series is written again without the removed points
+		std::vector<std::pair<time_t, std::vector<double>>> points;
+		bool bRemoved = false;
+		ScanLocked(table, idx, 0, [&](const time_t tTime, const double *values, const size_t columns) {
+			if ((tTime >= tFrom) && (tTime <= tTo))
+				bRemoved = true;
+			else
+				points.emplace_back(tTime, std::vector<double>(values, values + columns));
+		});
+		if (!bRemoved)
+			continue;
+		std::remove(SeriesFile(table, idx, ".seg").c_str());
+		std::remove(SeriesFile(table, idx, ".head").c_str());
+		m_headPoints.erase(table + "/" + std::to_string(idx));
+		for (const auto &point : points)
+			AppendLocked(table, idx, point.first, point.second);
+	}
+}
+
+void CTimeSeriesStore::Clear()
+{
+	std::lock_guard<std::mutex> l(m_mutex);
+	if (m_szPath.empty())
+		return;
+	std::vector<std::string> tables;
+	DirectoryListing(tables, m_szPath, true, false);
+	for (const auto &table : tables)
+	{
+		std::vector<std::string> files;
+		DirectoryListing(files, m_szPath + table, false, true);
+		for (const auto &szFile : files)
+			std::remove((m_szPath + table + "/" + szFile).c_str());
+	}
+	m_headPoints.clear();
+}
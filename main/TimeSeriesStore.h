@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <ctime>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Optional append-only columnar store for the short log tables (one series per table and device)
+//
+// Layout: <path>/<table>/<idx>.seg holds sealed blocks, <idx>.head the raw records of the block being filled.
+// A block is written once iBlockPoints records are collected and holds the timestamps as delta-of-delta
+// and every column as XOR compressed doubles (Gorilla encoding), stored one column after the other.
+//
+// block	: uint32 magic + uint16 points + uint8 columns + uint32 payload bytes + int64 first time + int64 last time + payload
+// head		: records of int64 time + uint8 columns + columns * double
+class CTimeSeriesStore
+{
+public:
+	static constexpr size_t iBlockPoints = 288; // one day of 5 minute samples
+
+	~CTimeSeriesStore();
+	bool Open(const std::string &szPath);
+	void Close();
+	bool IsOpen() const
+	{
+		return !m_szPath.empty();
+	}
+	// true when no series has been written yet (used to trigger the import of the existing tables)
+	bool IsEmpty();
+
+	bool Append(const std::string &table, uint64_t idx, time_t tTime, const std::vector<double> &values);
+	// calls onPoint for every point at or after tFrom in time order, returns false when the series does not exist
+	bool Scan(const std::string &table, uint64_t idx, time_t tFrom, const std::function<void(time_t tTime, const double *values, size_t columns)> &onPoint);
+
+	// drops sealed blocks that end before tBefore
+	void Purge(time_t tBefore);
+	void RemoveDevice(uint64_t idx);
+	// removes the points from tFrom up to and including tTo of the device in every table
+	void RemoveRange(uint64_t idx, time_t tFrom, time_t tTo);
+	void Clear();
+
+private:
+	// the callers hold m_mutex
+	bool AppendLocked(const std::string &table, uint64_t idx, time_t tTime, const std::vector<double> &values);
+	bool ScanLocked(const std::string &table, uint64_t idx, time_t tFrom, const std::function<void(time_t tTime, const double *values, size_t columns)> &onPoint);
+	std::string SeriesFile(const std::string &table, uint64_t idx, const char *szExtension) const;
+	bool SealBlock(const std::string &table, uint64_t idx);
+	bool ReadHead(const std::string &szHeadFile, std::vector<time_t> &times, std::vector<double> &values, uint8_t &columns);
+	// time of the last sealed point, 0 when nothing is sealed. Head records up to it were left by a crash during SealBlock
+	time_t LastSealedTime(const std::string &table, uint64_t idx);
+
+	std::mutex m_mutex;
+	std::string m_szPath;
+	std::map<std::string, size_t> m_headPoints;
+};
@@ -0,0 +1,239 @@
+#include "stdafx.h"
+#include "Trace.h"
+#include "Logger.h"
+#include <inttypes.h>
+
+namespace tracer
+{
+	namespace
+	{
+		constexpr size_t RING_SIZE = 1024;
+		constexpr size_t NAME_SIZE = 48;
+
+		// seq is odd while the slot is written, the exporter skips slots that changed while it read them
+		struct _tSpan
+		{
+			std::atomic<uint64_t> seq{ 0 };
+			uint64_t traceId;
+			uint64_t tStartUs;
+			uint64_t durationUs;
+			bool bQueue;
+			char szName[NAME_SIZE];
+		};
+
+		struct _tRing
+		{
+			int tid = 0;
+			std::atomic<bool> bThreadExited{ false };
+			std::atomic<uint64_t> head{ 0 };
+			_tSpan spans[RING_SIZE];
+		};
+
+		std::atomic<uint32_t> g_iSampleRate{ 0 };
+		std::atomic<uint64_t> g_iMessageCounter{ 0 };
+		std::atomic<uint64_t> g_iNextTraceId{ 1 };
+
+		std::mutex g_ringsMutex;
+		std::vector<std::shared_ptr<_tRing>> g_rings;
+		int g_iNextTid = 1;
+
+		thread_local uint64_t tl_traceId = 0;
+
+		const std::chrono::steady_clock::time_point g_tEpoch = std::chrono::steady_clock::now();
+
+		uint64_t NowUs()
+		{
+			return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - g_tEpoch).count();
+		}
+
+		// the ring is kept after the thread exits so its spans can still be exported
+		struct _tThreadRing
+		{
+			std::shared_ptr<_tRing> pRing;
+			~_tThreadRing()
+			{
+				if (pRing)
+					pRing->bThreadExited = true;
+			}
+			_tRing &Get()
+			{
+				if (!pRing)
+				{
+					pRing = std::make_shared<_tRing>();
+					std::lock_guard<std::mutex> l(g_ringsMutex);
+					pRing->tid = g_iNextTid++;
+					g_rings.push_back(pRing);
+				}
+				return *pRing;
+			}
+		};
+		thread_local _tThreadRing tl_ring;
+
+		void Record(const uint64_t traceId, const char *szName, const char *szDetail, const uint64_t tStartUs, const uint64_t tEndUs, const bool bQueue)
+		{
+			_tRing &ring = tl_ring.Get();
+			uint64_t head = ring.head.load(std::memory_order_relaxed);
+			_tSpan &span = ring.spans[head % RING_SIZE];
+			span.seq.store(2 * head + 1, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+			span.traceId = traceId;
+			span.tStartUs = tStartUs;
+			span.durationUs = (tEndUs > tStartUs) ? tEndUs - tStartUs : 0;
+			span.bQueue = bQueue;
+			if (szDetail != nullptr)
+				snprintf(span.szName, NAME_SIZE, "%s %s", szName, szDetail);
+			else
+				snprintf(span.szName, NAME_SIZE, "%s", szName);
+			span.seq.store(2 * head + 2, std::memory_order_release);
+			ring.head.store(head + 1, std::memory_order_release);
+		}
+
+		void AppendJsonString(std::string &out, const char *szValue)
+		{
+			out += '"';
+			for (const char *p = szValue; *p != 0; p++)
+			{
+				if ((*p == '"') || (*p == '\\'))
+					out += '\\';
+				if (static_cast<unsigned char>(*p) >= 0x20)
+					out += *p;
+			}
+			out += '"';
+		}
+	} // namespace
+
+	void SetSampleRate(const uint32_t iSampleRate)
+	{
+		g_iSampleRate = iSampleRate;
+		if (iSampleRate == 0)
+			_log.Log(LOG_STATUS, "Trace: disabled");
+		else
+			_log.Log(LOG_STATUS, "Trace: enabled, sampling 1 in %u received messages", iSampleRate);
+	}
+
+	uint32_t GetSampleRate()
+	{
+		return g_iSampleRate.load(std::memory_order_relaxed);
+	}
+
+	_tLink StartTrace()
+	{
+		_tLink link;
+		uint32_t iSampleRate = g_iSampleRate.load(std::memory_order_relaxed);
+		if (iSampleRate == 0)
+			return link;
+		if ((g_iMessageCounter.fetch_add(1, std::memory_order_relaxed) % iSampleRate) != 0)
+			return link;
+		link.traceId = g_iNextTraceId.fetch_add(1, std::memory_order_relaxed);
+		link.tQueuedUs = NowUs();
+		return link;
+	}
+
+	_tLink Link()
+	{
+		_tLink link;
+		if (tl_traceId != 0)
+		{
+			link.traceId = tl_traceId;
+			link.tQueuedUs = NowUs();
+		}
+		return link;
+	}
+
+	uint64_t CurrentTraceId()
+	{
+		return tl_traceId;
+	}
+
+	CContext::CContext(const _tLink &link, const char *szQueueName)
+		: m_prevTraceId(tl_traceId)
+	{
+		tl_traceId = link.traceId;
+		if (link.traceId != 0)
+			Record(link.traceId, szQueueName, nullptr, link.tQueuedUs, NowUs(), true);
+	}
+
+	CContext::~CContext()
+	{
+		tl_traceId = m_prevTraceId;
+	}
+
+	CSpan::CSpan(const char *szName, const char *szDetail)
+		: m_szName(szName)
+		, m_szDetail(szDetail)
+	{
+		if (tl_traceId != 0)
+			m_tStartUs = NowUs();
+	}
+
+	CSpan::~CSpan()
+	{
+		if ((tl_traceId != 0) && (m_tStartUs != 0))
+			Record(tl_traceId, m_szName, m_szDetail, m_tStartUs, NowUs(), false);
+	}
+
+	int ExportChromeTrace(const std::string &szFileName)
+	{
+		std::vector<std::shared_ptr<_tRing>> rings;
+		{
+			std::lock_guard<std::mutex> l(g_ringsMutex);
+			rings = g_rings;
+			// rings of exited threads are exported one last time
+			g_rings.erase(std::remove_if(g_rings.begin(), g_rings.end(), [](const std::shared_ptr<_tRing> &pRing) { return pRing->bThreadExited.load(); }), g_rings.end());
+		}
+
+		std::string out = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+		auto NextEvent = [&out] { out += (out.back() == '[') ? "\n" : ",\n"; };
+		int nSpans = 0;
+		char szTmp[160];
+		for (const auto &pRing : rings)
+		{
+			// queue waits go on a track of their own, they overlap the spans of the consuming thread
+			for (int ii = 0; ii < 2; ii++)
+			{
+				NextEvent();
+				snprintf(szTmp, sizeof(szTmp), "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s %d\"}}", pRing->tid + ii * 100000,
+					(ii == 0) ? "thread" : "queue wait", pRing->tid);
+				out += szTmp;
+			}
+
+			uint64_t head = pRing->head.load(std::memory_order_acquire);
+			uint64_t first = (head > RING_SIZE) ? head - RING_SIZE : 0;
+			for (uint64_t idx = first; idx < head; idx++)
+			{
+				const _tSpan &slot = pRing->spans[idx % RING_SIZE];
+				if (slot.seq.load(std::memory_order_acquire) != 2 * idx + 2)
+					continue;
+				uint64_t traceId = slot.traceId;
+				uint64_t tStartUs = slot.tStartUs;
+				uint64_t durationUs = slot.durationUs;
+				bool bQueue = slot.bQueue;
+				char szName[NAME_SIZE];
+				memcpy(szName, slot.szName, NAME_SIZE);
+				szName[NAME_SIZE - 1] = 0;
+				std::atomic_thread_fence(std::memory_order_acquire);
+				if (slot.seq.load(std::memory_order_relaxed) != 2 * idx + 2)
+					continue; // overwritten while reading
+
+				NextEvent();
+				out += "{\"ph\":\"X\",\"name\":";
+				AppendJsonString(out, szName);
+				snprintf(szTmp, sizeof(szTmp), ",\"cat\":\"%s\",\"pid\":1,\"tid\":%d,\"ts\":%" PRIu64 ",\"dur\":%" PRIu64 ",\"args\":{\"trace_id\":\"%016" PRIx64 "\"}}",
+					bQueue ? "queue" : "domoticz", pRing->tid + (bQueue ? 100000 : 0), tStartUs, durationUs, traceId);
+				out += szTmp;
+				nSpans++;
+			}
+		}
+		out += "\n]}\n";
+
+		std::ofstream file(szFileName, std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+		{
+			_log.Log(LOG_ERROR, "Trace: cannot write %s", szFileName.c_str());
+			return -1;
+		}
+		file << out;
+		_log.Log(LOG_STATUS, "Trace: %d spans written to %s", nSpans, szFileName.c_str());
+		return nSpans;
+	}
+} // namespace tracer
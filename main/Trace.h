@@ -0,0 +1,65 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// End-to-end tracing of received messages (decode, database, events, scripts, switch commands, push)
+//
+// CheckAndPushRxMessage starts a trace for a sampled message. The trace id travels with the work items
+// (_tRxQueueItem, _tEventQueue, _tTaskItem, device bus events) as a _tLink, and the thread that picks an
+// item up adopts it with a CContext. Spans record into a ring per thread without locks; the rings are
+// exported as Chrome trace JSON (chrome://tracing, ui.perfetto.dev).
+//
+// While tracing is disabled, or for messages that are not sampled, a span is one thread_local read.
+namespace tracer
+{
+	// Trace of the thread that created a work item, and the time it was queued
+	struct _tLink
+	{
+		uint64_t traceId = 0;
+		uint64_t tQueuedUs = 0;
+	};
+
+	// enabled with a sample rate of 1 in iSampleRate messages, 0 disables tracing
+	void SetSampleRate(uint32_t iSampleRate);
+	uint32_t GetSampleRate();
+
+	// a new trace for a received message, or an empty link when it is not sampled
+	_tLink StartTrace();
+	// the trace of the calling thread, to store in a work item
+	_tLink Link();
+	uint64_t CurrentTraceId();
+
+	// Adopts the trace of a work item on this thread, the time it spent in the queue is recorded as a span
+	class CContext
+	{
+	public:
+		CContext(const _tLink &link, const char *szQueueName);
+		~CContext();
+		CContext(const CContext &) = delete;
+		CContext &operator=(const CContext &) = delete;
+
+	private:
+		uint64_t m_prevTraceId;
+	};
+
+	// Records its scope as a span of the current trace, szDetail (script name, ...) is appended to the name
+	// and has to outlive the span
+	class CSpan
+	{
+	public:
+		explicit CSpan(const char *szName, const char *szDetail = nullptr);
+		~CSpan();
+		CSpan(const CSpan &) = delete;
+		CSpan &operator=(const CSpan &) = delete;
+
+	private:
+		const char *m_szName;
+		const char *m_szDetail;
+		uint64_t m_tStartUs = 0;
+	};
+
+	// writes the recorded spans to szFileName, returns the number of spans written or -1 on error
+	int ExportChromeTrace(const std::string &szFileName);
+} // namespace tracer
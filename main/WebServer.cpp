@@ -15,6 +15,7 @@
 #include "LuaHandler.h"
 #include "Logger.h"
 #include "SQLHelper.h"
+#include "Metrics.h"
 #include "../httpclient/HTTPClient.h"
 #include "../hardware/hardwaretypes.h"
 #include "../webserver/Base64.h"
@@ -257,6 +258,7 @@ namespace http
 			// Maybe handle these differently? (Or remove)
 			m_pWebEm->RegisterPageCode("/images/floorplans/plan", [this](auto&& session, auto&& req, auto&& rep) { GetFloorplanImage(session, req, rep); });
 			m_pWebEm->RegisterPageCode("/service-worker.js", [this](auto&& session, auto&& req, auto&& rep) { GetServiceWorker(session, req, rep); });
+			m_pWebEm->RegisterPageCode("/metrics", [this](auto&& session, auto&& req, auto&& rep) { GetMetricsPage(session, req, rep); });
 
 			// End of 'Pages' to be moved...
 
@@ -285,9 +287,14 @@ namespace http
 			RegisterCommandCode("getversion", [this](auto&& session, auto&& req, auto&& root) { Cmd_GetVersion(session, req, root); }, true);
 			RegisterCommandCode("getauth", [this](auto&& session, auto&& req, auto&& root) { Cmd_GetAuth(session, req, root); }, true);
 			RegisterCommandCode("getuptime", [this](auto&& session, auto&& req, auto&& root) { Cmd_GetUptime(session, req, root); }, true);
+			RegisterCommandCode("getstartupstatus", [this](auto&& session, auto&& req, auto&& root) { Cmd_GetStartupStatus(session, req, root); }, true);
 			RegisterCommandCode("getconfig", [this](auto&& session, auto&& req, auto&& root) { Cmd_GetConfig(session, req, root); }, true);
 
 			// Commands that require authentication
+			RegisterCommandCode("getrxqueuestats", [this](auto&& session, auto&& req, auto&& root) { Cmd_GetRxQueueStats(session, req, root); });
+			RegisterCommandCode("getdevicebusstats", [this](auto&& session, auto&& req, auto&& root) { Cmd_GetDeviceBusStats(session, req, root); });
+			RegisterCommandCode("settracing", [this](auto&& session, auto&& req, auto&& root) { Cmd_SetTracing(session, req, root); });
+			RegisterCommandCode("exporttrace", [this](auto&& session, auto&& req, auto&& root) { Cmd_ExportTrace(session, req, root); });
 			RegisterCommandCode("sendopenthermcommand", [this](auto&& session, auto&& req, auto&& root) { Cmd_SendOpenThermCommand(session, req, root); });
 
 			RegisterCommandCode("storesettings", [this](auto&& session, auto&& req, auto&& root) { Cmd_PostSettings(session, req, root); });
@@ -371,6 +378,7 @@ namespace http
 			RegisterCommandCode("saveinfluxlinkconfig", [this](auto&& session, auto&& req, auto&& root) { Cmd_SaveInfluxLinkConfig(session, req, root); });
 			RegisterCommandCode("getinfluxlinkconfig", [this](auto&& session, auto&& req, auto&& root) { Cmd_GetInfluxLinkConfig(session, req, root); });
 			RegisterCommandCode("getinfluxlinks", [this](auto&& session, auto&& req, auto&& root) { Cmd_GetInfluxLinks(session, req, root); });
+			RegisterCommandCode("getinfluxlinkstats", [this](auto&& session, auto&& req, auto&& root) { Cmd_GetInfluxLinkStats(session, req, root); });
 			RegisterCommandCode("saveinfluxlink", [this](auto&& session, auto&& req, auto&& root) { Cmd_SaveInfluxLink(session, req, root); });
 			RegisterCommandCode("deleteinfluxlink", [this](auto&& session, auto&& req, auto&& root) { Cmd_DeleteInfluxLink(session, req, root); });
 
@@ -1106,7 +1114,7 @@ namespace http
 							" LEFT OUTER JOIN DeviceToPlansMap as B ON (B.DeviceRowID==a.ID) AND (B.DevSceneType==1)"
 							" ORDER BY ");
 						szQuery += szOrderBy;
-						result = m_sql.safe_query(szQuery.c_str(), order.c_str());
+						result = m_sql.safe_query_label("SELECT Scenes (getdevices, ordered)", szQuery.c_str(), order.c_str());
 					}
 
 					if (!result.empty())
@@ -1291,7 +1299,7 @@ namespace http
 							"WHERE (A.HardwareID == %q) "
 							"ORDER BY ");
 						szQuery += szOrderBy;
-						result = m_sql.safe_query(szQuery.c_str(), hardwareid.c_str(), order.c_str());
+						result = m_sql.safe_query_label("SELECT DeviceStatus (getdevices, hardware, ordered)", szQuery.c_str(), hardwareid.c_str(), order.c_str());
 					}
 					else
 					{
@@ -1306,7 +1314,7 @@ namespace http
 							"ON (B.DeviceRowID==a.ID) AND (B.DevSceneType==0) "
 							"ORDER BY ");
 						szQuery += szOrderBy;
-						result = m_sql.safe_query(szQuery.c_str(), order.c_str());
+						result = m_sql.safe_query_label("SELECT DeviceStatus (getdevices, ordered)", szQuery.c_str(), order.c_str());
 					}
 				}
 			}
@@ -1410,7 +1418,7 @@ namespace http
 						"WHERE (B.DeviceRowID==A.ID)"
 						" AND (B.SharedUserID==%lu) ORDER BY ");
 					szQuery += szOrderBy;
-					result = m_sql.safe_query(szQuery.c_str(), m_users[iUser].ID, order.c_str());
+					result = m_sql.safe_query_label("SELECT DeviceStatus (getdevices, shared, ordered)", szQuery.c_str(), m_users[iUser].ID, order.c_str());
 				}
 			}
 
@@ -2256,10 +2264,7 @@ namespace http
 
 							_tTrendCalculator::_eTendencyType tstate = _tTrendCalculator::_eTendencyType::TENDENCY_UNKNOWN;
 							uint64_t tID = ((uint64_t)(hardwareID & 0x7FFFFFFF) << 32) | (devIdx & 0x7FFFFFFF);
-							if (m_mainworker.m_trend_calculator.find(tID) != m_mainworker.m_trend_calculator.end())
-							{
-								tstate = m_mainworker.m_trend_calculator[tID].m_state;
-							}
+							tstate = m_mainworker.GetTrendState(tID);
 							root["result"][ii]["trend"] = (int)tstate;
 
 							if (dSubType == sTypeThermostat6TempHum && strarray.size() >= 4)
@@ -2310,10 +2315,7 @@ namespace http
 
 						_tTrendCalculator::_eTendencyType tstate = _tTrendCalculator::_eTendencyType::TENDENCY_UNKNOWN;
 						uint64_t tID = ((uint64_t)(hardwareID & 0x7FFFFFFF) << 32) | (devIdx & 0x7FFFFFFF);
-						if (m_mainworker.m_trend_calculator.find(tID) != m_mainworker.m_trend_calculator.end())
-						{
-							tstate = m_mainworker.m_trend_calculator[tID].m_state;
-						}
+						tstate = m_mainworker.GetTrendState(tID);
 						root["result"][ii]["trend"] = (int)tstate;
 					}
 					else if (dType == pTypeThermostat1)
@@ -2339,10 +2341,7 @@ namespace http
 						root["result"][ii]["HaveTimeout"] = bHaveTimeout;
 						_tTrendCalculator::_eTendencyType tstate = _tTrendCalculator::_eTendencyType::TENDENCY_UNKNOWN;
 						uint64_t tID = ((uint64_t)(hardwareID & 0x7FFFFFFF) << 32) | (devIdx & 0x7FFFFFFF);
-						if (m_mainworker.m_trend_calculator.find(tID) != m_mainworker.m_trend_calculator.end())
-						{
-							tstate = m_mainworker.m_trend_calculator[tID].m_state;
-						}
+						tstate = m_mainworker.GetTrendState(tID);
 						root["result"][ii]["trend"] = (int)tstate;
 					}
 					else if (dType == pTypeHUM)
@@ -2377,10 +2376,7 @@ namespace http
 
 							_tTrendCalculator::_eTendencyType tstate = _tTrendCalculator::_eTendencyType::TENDENCY_UNKNOWN;
 							uint64_t tID = ((uint64_t)(hardwareID & 0x7FFFFFFF) << 32) | (devIdx & 0x7FFFFFFF);
-							if (m_mainworker.m_trend_calculator.find(tID) != m_mainworker.m_trend_calculator.end())
-							{
-								tstate = m_mainworker.m_trend_calculator[tID].m_state;
-							}
+							tstate = m_mainworker.GetTrendState(tID);
 							root["result"][ii]["trend"] = (int)tstate;
 						}
 					}
@@ -2425,10 +2421,7 @@ namespace http
 
 							_tTrendCalculator::_eTendencyType tstate = _tTrendCalculator::_eTendencyType::TENDENCY_UNKNOWN;
 							uint64_t tID = ((uint64_t)(hardwareID & 0x7FFFFFFF) << 32) | (devIdx & 0x7FFFFFFF);
-							if (m_mainworker.m_trend_calculator.find(tID) != m_mainworker.m_trend_calculator.end())
-							{
-								tstate = m_mainworker.m_trend_calculator[tID].m_state;
-							}
+							tstate = m_mainworker.GetTrendState(tID);
 							root["result"][ii]["trend"] = (int)tstate;
 						}
 					}
@@ -2451,10 +2444,7 @@ namespace http
 
 							_tTrendCalculator::_eTendencyType tstate = _tTrendCalculator::_eTendencyType::TENDENCY_UNKNOWN;
 							uint64_t tID = ((uint64_t)(hardwareID & 0x7FFFFFFF) << 32) | (devIdx & 0x7FFFFFFF);
-							if (m_mainworker.m_trend_calculator.find(tID) != m_mainworker.m_trend_calculator.end())
-							{
-								tstate = m_mainworker.m_trend_calculator[tID].m_state;
-							}
+							tstate = m_mainworker.GetTrendState(tID);
 							root["result"][ii]["trend"] = (int)tstate;
 						}
 					}
@@ -2475,10 +2465,7 @@ namespace http
 
 								_tTrendCalculator::_eTendencyType tstate = _tTrendCalculator::_eTendencyType::TENDENCY_UNKNOWN;
 								uint64_t tID = ((uint64_t)(hardwareID & 0x7FFFFFFF) << 32) | (devIdx & 0x7FFFFFFF);
-								if (m_mainworker.m_trend_calculator.find(tID) != m_mainworker.m_trend_calculator.end())
-								{
-									tstate = m_mainworker.m_trend_calculator[tID].m_state;
-								}
+								tstate = m_mainworker.GetTrendState(tID);
 								root["result"][ii]["trend"] = (int)tstate;
 							}
 							else
@@ -2539,10 +2526,7 @@ namespace http
 
 								_tTrendCalculator::_eTendencyType tstate = _tTrendCalculator::_eTendencyType::TENDENCY_UNKNOWN;
 								uint64_t tID = ((uint64_t)(hardwareID & 0x7FFFFFFF) << 32) | (devIdx & 0x7FFFFFFF);
-								if (m_mainworker.m_trend_calculator.find(tID) != m_mainworker.m_trend_calculator.end())
-								{
-									tstate = m_mainworker.m_trend_calculator[tID].m_state;
-								}
+								tstate = m_mainworker.GetTrendState(tID);
 								root["result"][ii]["trend"] = (int)tstate;
 							}
 							root["result"][ii]["Data"] = sValue;
@@ -3345,10 +3329,7 @@ namespace http
 							root["result"][ii]["Type"] = "temperature";
 							_tTrendCalculator::_eTendencyType tstate = _tTrendCalculator::_eTendencyType::TENDENCY_UNKNOWN;
 							uint64_t tID = ((uint64_t)(hardwareID & 0x7FFFFFFF) << 32) | (devIdx & 0x7FFFFFFF);
-							if (m_mainworker.m_trend_calculator.find(tID) != m_mainworker.m_trend_calculator.end())
-							{
-								tstate = m_mainworker.m_trend_calculator[tID].m_state;
-							}
+							tstate = m_mainworker.GetTrendState(tID);
 							root["result"][ii]["trend"] = (int)tstate;
 						}
 						else if (dSubType == sTypePercentage)
@@ -3911,44 +3892,63 @@ namespace http
 
 		void CWebServer::MakeCompareDataSensor(Json::Value& root, const std::string& sgroupby, const std::string& dbasetable, uint64_t deviceidx, const std::string& dfield, const double divider, const bool isCounter)
 		{
-			std::string queryString;
-			queryString.append("SELECT strftime('%Y', Date) as y,");
-			if ((sgroupby == "month") || (sgroupby == "year"))
-				queryString.append("strftime('%m', Date) as m");
-			else if (sgroupby == "quarter")
-				queryString.append("case when cast(strftime('%m', Date) as integer) between 1 and 3 then 'Q1' when cast(strftime('%m', Date) as integer) between 4 and 6 then 'Q2' when cast(strftime('%m', Date) as integer) between 7 and 9 then 'Q3' else 'Q4' end as Q");
-
-			queryString.append(", ");
-			if (!isCounter)
+			// monthly aggregates come from the Calendar_Rollup table, quarters are combined from their months
+			std::vector<calendar_rollup::_tMonth> months;
+			if (!m_sql.GetCalendarMonths(dbasetable, deviceidx, dfield, months))
+				return;
+
+			struct _tGroup
 			{
-				//probably should add an additional option to select AVG/MIN/MAX
-				if (dfield.find("_Min") != std::string::npos)
-					queryString.append("MIN(" + dfield + ")");
-				else if (dfield.find("_Max") != std::string::npos)
-					queryString.append("MAX(" + dfield + ")");
+				int year;
+				std::string category;
+				calendar_rollup::_tMonth total;
+			};
+			std::vector<_tGroup> groups;
+			for (const auto& month : months)
+			{
+				std::string category;
+				if (sgroupby == "quarter")
+					category = std_format("Q%d", (month.month - 1) / 3 + 1);
 				else
-					queryString.append("AVG(" + dfield + ")");
+					category = std_format("%02d", month.month);
+				if (groups.empty() || (groups.back().year != month.year) || (groups.back().category != category))
+				{
+					groups.push_back({ month.year, category, month });
+					continue;
+				}
+				auto& total = groups.back().total;
+				if (month.count > 0)
+				{
+					total.min = (total.count > 0) ? std::min(total.min, month.min) : month.min;
+					total.max = (total.count > 0) ? std::max(total.max, month.max) : month.max;
+				}
+				total.sum += month.sum;
+				total.count += month.count;
 			}
-			else
-				queryString.append("SUM(" + dfield + ")");
-			queryString.append("/" + std::to_string(divider));
-			queryString.append(" as s FROM " + dbasetable + " WHERE DeviceRowID == " + std::to_string(deviceidx) + " GROUP BY strftime('%Y', Date), ");
-			if ((sgroupby == "month") || (sgroupby == "year"))
-				queryString.append("strftime('%m', Date)");
-			else if (sgroupby == "quarter")
-				queryString.append("case when cast(strftime('%m', Date) as integer) between 1 and 3 then 'Q1' when cast(strftime('%m', Date) as integer) between 4 and 6 then 'Q2' when cast(strftime('%m', Date) as integer) between 7 and 9 then 'Q3' else 'Q4' end");
-			auto result = m_sql.unsafe_query(queryString.c_str());
 
 			int firstYearCounting = 0;
 			double yearSumPrevious[12] = { 0 };
 			int yearPrevious[12] = { 0 };
 
-			for (const auto& sd : result)
+			for (const auto& group : groups)
 			{
-				const int year = atoi(sd[0].c_str());
-				const double value = atof(sd[2].c_str());
+				const int year = group.year;
+				double value = 0;
+				if (group.total.count > 0)
+				{
+					//probably should add an additional option to select AVG/MIN/MAX
+					if (isCounter)
+						value = group.total.sum;
+					else if (dfield.find("_Min") != std::string::npos)
+						value = group.total.min;
+					else if (dfield.find("_Max") != std::string::npos)
+						value = group.total.max;
+					else
+						value = group.total.sum / group.total.count;
+				}
+				value /= divider;
 
-				const int previousIndex = sgroupby == "year" ? 0 : sgroupby == "quarter" ? sd[1][1] - '0' - 1 : atoi(sd[1].c_str()) - 1;
+				const int previousIndex = sgroupby == "year" ? 0 : sgroupby == "quarter" ? group.category[1] - '0' - 1 : atoi(group.category.c_str()) - 1;
 				const double* sumPrevious = year - 1 != yearPrevious[previousIndex] ? NULL : &yearSumPrevious[previousIndex];
 				const char* trend = !sumPrevious ? "" : *sumPrevious < value ? "up" : *sumPrevious > value ? "down" : "equal";
 				const int ii = root["result"].size();
@@ -3958,7 +3958,7 @@ namespace http
 				}
 
 				root["result"][ii]["y"] = year;
-				root["result"][ii]["c"] = (sgroupby == "year") ? sd[0] : sd[1];
+				root["result"][ii]["c"] = (sgroupby == "year") ? std::to_string(year) : group.category;
 				root["result"][ii]["s"] = value;
 				root["result"][ii]["t"] = trend;
 				yearSumPrevious[previousIndex] = value;
@@ -3994,7 +3994,7 @@ namespace http
 			if (bUseValuesOrCounter)
 			{
 				queryString = "select count(*) from " + dbasetable + " where DeviceRowID = " + std::to_string(idx) + " and " + counter("") + " != 0 ";
-				result = m_sql.safe_query(queryString.c_str(), idx, idx, idx, idx, idx);
+				result = m_sql.safe_query_label("select count(*) (graph group by, counters)", queryString.c_str(), idx, idx, idx, idx, idx);
 				if (atoi(result[0][0].c_str()) == 0)
 				{
 					bUseValues = true;
@@ -4082,7 +4082,7 @@ namespace http
 			{
 				queryString.append(",strftime('%%m',Date)");
 			}
-			result = m_sql.safe_query(queryString.c_str(), idx, idx, idx, idx, idx);
+			result = m_sql.safe_query_label("select (graph group by)", queryString.c_str(), idx, idx, idx, idx, idx);
 			if (!result.empty())
 			{
 				int firstYearCounting = 0;
@@ -4273,12 +4273,22 @@ namespace http
 			}
 		}
 
+		// Latency per API command, unknown commands share one series so clients can not grow the label set
+		static metrics::CHistogram &RequestMetric(const std::string &command)
+		{
+			static auto &family = metrics::Registry().Histogram("domoticz_http_request_seconds", "Time spent handling a json.htm command", "command");
+			return family.Get(command);
+		}
+
 		// Primary API (v1) entry point
 		void CWebServer::GetJSonPage(WebEmSession& session, const request& req, reply& rep)
 		{
 			Json::Value root;
 			root["status"] = "ERR";
 
+			auto tStart = std::chrono::steady_clock::now();
+			std::string metricCommand = "unknown";
+
 			std::string rtype = request::findValue(&req, "type");
 			if (rtype == "command")
 			{
@@ -4290,7 +4300,15 @@ namespace http
 					auto pf = m_webcommands.find(cparam);
 					if (pf != m_webcommands.end())
 					{
+						if (cparam == "graph")
+						{
+							// graph data can be large, it has its own (unstyled, optionally downsampled) output
+							GetGraphPage(session, req, rep);
+							RequestMetric(cparam).ObserveSince(tStart);
+							return;
+						}
 						pf->second(session, req, root);
+						metricCommand = cparam;
 					}
 					else
 					{	// See if we still have a Param based version not converted to a proper command
@@ -4299,6 +4317,8 @@ namespace http
 						{
 							_log.Debug(DEBUG_WEBSERVER, "CWebServer::GetJSonPage(param)(%s) returned an error!", cparam.c_str());
 						}
+						else
+							metricCommand = cparam;
 					}
 				}
 			} //(rtype=="command")
@@ -4311,6 +4331,19 @@ namespace http
 
 			reply::set_content(&rep, root.toStyledString());
 			rep.status = static_cast<http::server::reply::status_type>(session.reply_status);
+			RequestMetric(metricCommand).ObserveSince(tStart);
+		}
+
+		// Prometheus scrape target
+		void CWebServer::GetMetricsPage(WebEmSession& session, const request& req, reply& rep)
+		{
+			if (session.rights != URIGHTS_ADMIN)
+			{
+				session.reply_status = reply::forbidden;
+				return; // Only admin user allowed
+			}
+			reply::set_content(&rep, metrics::Registry().Render());
+			reply::add_header_content_type(&rep, "text/plain; version=0.0.4");
 		}
 
 		void CWebServer::UploadFloorplanImage(WebEmSession& session, const request& req, std::string& redirect_uri)
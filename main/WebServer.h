@@ -48,6 +48,7 @@ class CWebServer : public session_store, public std::enable_shared_from_this<CWe
 	void GetInternalCameraSnapshot(WebEmSession & session, const request& req, reply & rep);
 	void GetFloorplanImage(WebEmSession& session, const request& req, reply& rep);
 	void GetServiceWorker(WebEmSession& session, const request& req, reply& rep);
+	void GetMetricsPage(WebEmSession& session, const request& req, reply& rep);
 	void GetDatabaseBackup(WebEmSession & session, const request& req, reply & rep);
 
 	void GetOauth2AuthCode(WebEmSession &session, const request &req, reply &rep);
@@ -185,6 +186,11 @@ private:
 	void Cmd_GetMyProfile(WebEmSession& session, const request& req, Json::Value& root);
 	void Cmd_UpdateMyProfile(WebEmSession& session, const request& req, Json::Value& root);
 	void Cmd_GetUptime(WebEmSession & session, const request& req, Json::Value &root);
+	void Cmd_GetStartupStatus(WebEmSession & session, const request& req, Json::Value &root);
+	void Cmd_GetRxQueueStats(WebEmSession & session, const request& req, Json::Value &root);
+	void Cmd_GetDeviceBusStats(WebEmSession & session, const request& req, Json::Value &root);
+	void Cmd_SetTracing(WebEmSession & session, const request& req, Json::Value &root);
+	void Cmd_ExportTrace(WebEmSession & session, const request& req, Json::Value &root);
 	void Cmd_GetActualHistory(WebEmSession & session, const request& req, Json::Value &root);
 	void Cmd_GetNewHistory(WebEmSession & session, const request& req, Json::Value &root);
 	void Cmd_GetConfig(WebEmSession& session, const request& req, Json::Value& root);
@@ -255,6 +261,7 @@ private:
 	void Cmd_SaveInfluxLinkConfig(WebEmSession& session, const request& req, Json::Value& root);
 	void Cmd_GetInfluxLinkConfig(WebEmSession& session, const request& req, Json::Value& root);
 	void Cmd_GetInfluxLinks(WebEmSession& session, const request& req, Json::Value& root);
+	void Cmd_GetInfluxLinkStats(WebEmSession& session, const request& req, Json::Value& root);
 	void Cmd_SaveInfluxLink(WebEmSession& session, const request& req, Json::Value& root);
 	void Cmd_DeleteInfluxLink(WebEmSession& session, const request& req, Json::Value& root);
 	void Cmd_SaveHttpLinkConfig(WebEmSession & session, const request& req, Json::Value &root);
@@ -366,6 +373,8 @@ private:
 	void Cmd_BindEvohome(WebEmSession & session, const request& req, Json::Value &root);
 	void Cmd_CustomLightIcons(WebEmSession & session, const request& req, Json::Value &root);
 	void Cmd_HandleGraph(WebEmSession & session, const request& req, Json::Value &root);
+	void GetGraphPage(WebEmSession & session, const request& req, reply & rep);
+	bool StreamDayGraph(const request& req, std::string &content, size_t maxpoints, bool bMinMax);
 	void Cmd_RemoteWebClientsLog(WebEmSession& session, const request& req, Json::Value& root);
 	void Cmd_SetUsed(WebEmSession & session, const request& req, Json::Value &root);
 
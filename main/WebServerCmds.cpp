@@ -27,6 +27,7 @@
 #include "Logger.h"
 #include "SQLHelper.h"
 #include "KWHStats.h"
+#include "StartupProfile.h"
 #include "../httpclient/HTTPClient.h"
 #include "../hardware/hardwaretypes.h"
 #include "../webserver/Base64.h"
@@ -1037,13 +1038,7 @@ namespace http
 			root["status"] = "OK";
 			root["title"] = "GetLog";
 
-			time_t lastlogtime = 0;
-			std::string slastlogtime = request::findValue(&req, "lastlogtime");
-			if (!slastlogtime.empty())
-			{
-				std::stringstream s_str(slastlogtime);
-				s_str >> lastlogtime;
-			}
+			constexpr size_t iMaxLines = 1000;
 
 			_eLogLevel lLevel = LOG_NORM;
 			std::string sloglevel = request::findValue(&req, "loglevel");
@@ -1051,21 +1046,34 @@ namespace http
 			{
 				lLevel = (_eLogLevel)atoi(sloglevel.c_str());
 			}
+			int hardwareID = -1;
+			std::string shardwareid = request::findValue(&req, "hardwareid");
+			if (!shardwareid.empty())
+				hardwareID = atoi(shardwareid.c_str());
 
-			std::list<CLogger::_tLogLineStruct> logmessages = _log.GetLog(lLevel);
-			int ii = 0;
-			for (const auto& msg : logmessages)
+			// resume from lastlogid (cursor returned by the previous call), or from lastlogtime
+			uint64_t cursor = 0;
+			std::string slastlogid = request::findValue(&req, "lastlogid");
+			std::string slastlogtime = request::findValue(&req, "lastlogtime");
+			if (!slastlogid.empty())
+				cursor = std::strtoull(slastlogid.c_str(), nullptr, 10);
+			else if ((!slastlogtime.empty()) && (slastlogtime != "0"))
+				cursor = _log.FindLogCursor((time_t)atoll(slastlogtime.c_str()) + 1);
+			else
 			{
-				if (msg.logtime > lastlogtime)
-				{
-					std::stringstream szLogTime;
-					szLogTime << msg.logtime;
-					root["LastLogTime"] = szLogTime.str();
-					root["result"][ii]["level"] = static_cast<int>(msg.level);
-					root["result"][ii]["message"] = msg.logmessage;
-					ii++;
-				}
+				// first call, only the most recent lines
+				uint64_t next = _log.GetNextLogCursor();
+				cursor = (next > iMaxLines) ? next - iMaxLines : 0;
 			}
+
+			int ii = 0;
+			cursor = _log.ForEachLogLine(cursor, lLevel, hardwareID, iMaxLines, [&](const CLogger::_tLogLineStruct& msg) {
+				root["LastLogTime"] = std::to_string(msg.logtime);
+				root["result"][ii]["level"] = static_cast<int>(msg.level);
+				root["result"][ii]["message"] = msg.logmessage;
+				ii++;
+			});
+			root["LastLogId"] = std::to_string(cursor);
 		}
 
 		void CWebServer::Cmd_ClearLog(WebEmSession& session, const request& req, Json::Value& root)
@@ -1580,6 +1588,124 @@ namespace http
 			root["seconds"] = seconds;
 		}
 
+		// Answers while the system is still starting, "degraded" is set until all hardware is started
+		void CWebServer::Cmd_GetStartupStatus(WebEmSession& session, const request& req, Json::Value& root)
+		{
+			startup::_tStatus status = startup::GetStatus();
+			root["status"] = "OK";
+			root["title"] = "GetStartupStatus";
+			root["ready"] = status.bReady;
+			root["degraded"] = !status.bReady;
+			root["stage"] = status.stage;
+			root["uptime_ms"] = (Json::UInt64)status.uptimeMs;
+			root["hardware_started"] = status.hardwareStarted;
+			root["hardware_total"] = status.hardwareTotal;
+			root["deferred_tasks"] = (Json::UInt64)status.deferredTasks;
+			if (session.rights != URIGHTS_ADMIN)
+				return; // phase names contain hardware names
+			root["phases"] = Json::Value(Json::arrayValue);
+			int ii = 0;
+			for (const auto& phase : status.phases)
+			{
+				root["phases"][ii]["name"] = phase.name;
+				root["phases"][ii]["level"] = phase.level;
+				root["phases"][ii]["start_ms"] = (Json::UInt64)phase.startMs;
+				root["phases"][ii]["duration_ms"] = (Json::UInt64)phase.durationMs;
+				root["phases"][ii]["running"] = phase.bRunning;
+				ii++;
+			}
+		}
+
+		void CWebServer::Cmd_GetRxQueueStats(WebEmSession& session, const request& req, Json::Value& root)
+		{
+			if (session.rights != URIGHTS_ADMIN)
+			{
+				session.reply_status = reply::forbidden;
+				return; // Only admin user allowed
+			}
+			MainWorker::_tRxQueueStats stats = m_mainworker.GetRxQueueStats();
+			root["status"] = "OK";
+			root["title"] = "GetRxQueueStats";
+			root["depth"] = (Json::UInt64)stats.depth;
+			root["maxdepth"] = (Json::UInt64)stats.maxDepth;
+			root["capacity"] = (Json::UInt64)stats.capacity;
+			root["shards"] = (Json::UInt64)stats.shards;
+			root["processed"] = (Json::UInt64)stats.processed;
+			root["dropped"] = (Json::UInt64)stats.dropped;
+			root["latency_last_us"] = (Json::UInt64)stats.lastLatencyUs;
+			root["latency_avg_us"] = (Json::UInt64)stats.avgLatencyUs;
+			root["latency_max_us"] = (Json::UInt64)stats.maxLatencyUs;
+		}
+
+		void CWebServer::Cmd_GetDeviceBusStats(WebEmSession& session, const request& req, Json::Value& root)
+		{
+			if (session.rights != URIGHTS_ADMIN)
+			{
+				session.reply_status = reply::forbidden;
+				return; // Only admin user allowed
+			}
+			root["status"] = "OK";
+			root["title"] = "GetDeviceBusStats";
+			root["result"] = Json::Value(Json::arrayValue);
+			int ii = 0;
+			for (const auto& stats : m_mainworker.m_deviceEventBus.GetStats())
+			{
+				root["result"][ii]["name"] = stats.name;
+				root["result"][ii]["policy"] = (stats.policy == CDeviceEventBus::_eQueuePolicy::ALL_EVENTS) ? "all" : "latest";
+				root["result"][ii]["capacity"] = (Json::UInt64)stats.capacity;
+				root["result"][ii]["depth"] = (Json::UInt64)stats.depth;
+				root["result"][ii]["maxdepth"] = (Json::UInt64)stats.maxDepth;
+				root["result"][ii]["published"] = (Json::UInt64)stats.published;
+				root["result"][ii]["processed"] = (Json::UInt64)stats.processed;
+				root["result"][ii]["coalesced"] = (Json::UInt64)stats.coalesced;
+				root["result"][ii]["dropped"] = (Json::UInt64)stats.dropped;
+				root["result"][ii]["lag_last_us"] = (Json::UInt64)stats.lastLagUs;
+				root["result"][ii]["lag_avg_us"] = (Json::UInt64)stats.avgLagUs;
+				root["result"][ii]["lag_max_us"] = (Json::UInt64)stats.maxLagUs;
+				root["result"][ii]["handler_avg_us"] = (Json::UInt64)stats.avgHandlerUs;
+				root["result"][ii]["handler_max_us"] = (Json::UInt64)stats.maxHandlerUs;
+				ii++;
+			}
+		}
+
+		// sample=N traces 1 in N received messages, sample=0 disables tracing
+		void CWebServer::Cmd_SetTracing(WebEmSession& session, const request& req, Json::Value& root)
+		{
+			if (session.rights != URIGHTS_ADMIN)
+			{
+				session.reply_status = reply::forbidden;
+				return; // Only admin user allowed
+			}
+			std::string ssample = request::findValue(&req, "sample");
+			if (ssample.empty())
+				return;
+			int iSample = atoi(ssample.c_str());
+			if (iSample < 0)
+				return;
+			tracer::SetSampleRate(static_cast<uint32_t>(iSample));
+			root["status"] = "OK";
+			root["title"] = "SetTracing";
+			root["sample"] = iSample;
+		}
+
+		void CWebServer::Cmd_ExportTrace(WebEmSession& session, const request& req, Json::Value& root)
+		{
+			if (session.rights != URIGHTS_ADMIN)
+			{
+				session.reply_status = reply::forbidden;
+				return; // Only admin user allowed
+			}
+			std::string szFileName = szUserDataFolder + "domoticz_trace.json";
+			int nSpans = tracer::ExportChromeTrace(szFileName);
+			if (nSpans < 0)
+				return;
+			root["status"] = "OK";
+			root["title"] = "ExportTrace";
+			root["file"] = szFileName;
+			root["spans"] = nSpans;
+			root["sample"] = tracer::GetSampleRate();
+		}
+
 		void CWebServer::Cmd_GetActualHistory(WebEmSession& session, const request& req, Json::Value& root)
 		{
 			root["status"] = "OK";
@@ -2525,6 +2651,13 @@ namespace http
 					m_sql.UpdatePreferencesVar("UVCParams", UVCParams);
 				cntSettings++;
 
+				int iCameraSnapshotMaxAge = atoi(request::findValue(&req, "CameraSnapshotMaxAge").c_str());
+				if (iCameraSnapshotMaxAge < 0)
+					iCameraSnapshotMaxAge = 0;
+				m_sql.UpdatePreferencesVar("CameraSnapshotMaxAge", iCameraSnapshotMaxAge); cntSettings++;
+				m_sql.UpdatePreferencesVar("CameraRelay", (request::findValue(&req, "CameraRelay") == "on" ? 1 : 0)); cntSettings++;
+				m_mainworker.m_cameras.ReloadCameras();
+
 				/* Also update m_sql.variables */
 				/* --------------------------- */
 
@@ -2534,6 +2667,12 @@ namespace http
 				m_sql.m_ShortLogInterval = iShortLogInterval;
 				m_sql.UpdatePreferencesVar("ShortLogInterval", m_sql.m_ShortLogInterval); cntSettings++;
 
+				int iMeterWriteInterval = atoi(request::findValue(&req, "MeterWriteInterval").c_str());
+				if (iMeterWriteInterval < 0)
+					iMeterWriteInterval = 0;
+				m_sql.UpdatePreferencesVar("MeterWriteInterval", iMeterWriteInterval); cntSettings++;
+				m_sql.SetMeterWriteInterval(iMeterWriteInterval);
+
 				m_sql.m_bShortLogAddOnlyNewValues = (request::findValue(&req, "ShortLogAddOnlyNewValues") == "on" ? 1 : 0);
 				m_sql.UpdatePreferencesVar("ShortLogAddOnlyNewValues", m_sql.m_bShortLogAddOnlyNewValues); cntSettings++;
 
@@ -2925,6 +3064,7 @@ namespace http
 			root["title"] = "UpdateScene";
 			m_sql.safe_query("UPDATE Scenes SET Name='%q', Description='%q', SceneType=%d, Protected=%d, OnAction='%q', OffAction='%q' WHERE (ID == '%q')", name.c_str(),
 				description.c_str(), atoi(stype.c_str()), iProtected, onaction.c_str(), offaction.c_str(), idx.c_str());
+			m_sql.InvalidateSceneIndex();
 			uint64_t ullidx = std::stoull(idx);
 			m_mainworker.m_eventsystem.WWWUpdateSingleState(ullidx, name, m_mainworker.m_eventsystem.REASON_SCENEGROUP);
 		}
@@ -3106,11 +3246,11 @@ namespace http
 			root["ActTime"] = static_cast<int>(now);
 
 			std::vector<std::vector<std::string>> result, result2;
-			std::string szQuery = "SELECT ID, Name, Activators, Favorite, nValue, SceneType, LastUpdate, Protected, OnAction, OffAction, Description FROM Scenes";
 			if (!rid.empty())
-				szQuery += " WHERE (ID == " + rid + ")";
-			szQuery += " ORDER BY [Order]";
-			result = m_sql.safe_query(szQuery.c_str());
+				result = m_sql.safe_query("SELECT ID, Name, Activators, Favorite, nValue, SceneType, LastUpdate, Protected, OnAction, OffAction, Description FROM Scenes WHERE (ID == '%q') ORDER BY [Order]",
+							  rid.c_str());
+			else
+				result = m_sql.safe_query("SELECT ID, Name, Activators, Favorite, nValue, SceneType, LastUpdate, Protected, OnAction, OffAction, Description FROM Scenes ORDER BY [Order]");
 			if (!result.empty())
 			{
 				int ii = 0;
@@ -3729,6 +3869,7 @@ namespace http
 				Activators += ":" + cmnd;
 			}
 			m_sql.safe_query("UPDATE Scenes SET Activators='%q' WHERE (ID==%q)", Activators.c_str(), sceneidx.c_str());
+			m_sql.InvalidateSceneIndex();
 		}
 
 		void CWebServer::Cmd_RemoveSceneCode(WebEmSession& session, const request& req, Json::Value& root)
@@ -3797,6 +3938,7 @@ namespace http
 				if (Activators != newActivation)
 				{
 					m_sql.safe_query("UPDATE Scenes SET Activators='%q' WHERE (ID==%q)", newActivation.c_str(), sceneidx.c_str());
+					m_sql.InvalidateSceneIndex();
 				}
 			}
 		}
@@ -3816,6 +3958,7 @@ namespace http
 			root["title"] = "ClearSceneCode";
 
 			m_sql.safe_query("UPDATE Scenes SET Activators='' WHERE (ID==%q)", sceneidx.c_str());
+			m_sql.InvalidateSceneIndex();
 		}
 
 		void CWebServer::Cmd_GetSerialDevices(WebEmSession& session, const request& req, Json::Value& root)
@@ -4703,6 +4846,10 @@ namespace http
 				{
 					root["ShortLogInterval"] = nValue;
 				}
+				else if (Key == "MeterWriteInterval")
+				{
+					root["MeterWriteInterval"] = nValue;
+				}
 				else if (Key == "SecPassword")
 				{
 					root["SecPassword"] = sValue;
@@ -4869,6 +5016,14 @@ namespace http
 				{
 					root["UVCParams"] = sValue;
 				}
+				else if (Key == "CameraSnapshotMaxAge")
+				{
+					root["CameraSnapshotMaxAge"] = nValue;
+				}
+				else if (Key == "CameraRelay")
+				{
+					root["CameraRelay"] = nValue;
+				}
 				else if (Key == "AcceptNewHardware")
 				{
 					root["AcceptNewHardware"] = nValue;
@@ -27,6 +27,133 @@
 #include "Logger.h"
 #include "SQLHelper.h"
 
+namespace
+{
+	constexpr size_t iMinGraphPoints = 3;
+
+	// Largest-Triangle-Three-Buckets, keeps the points that contribute most to the shape of the series (x = sample index)
+	std::vector<size_t> DownsampleLTTB(const std::vector<double> &values, const size_t maxpoints)
+	{
+		std::vector<size_t> selected;
+		size_t count = values.size();
+		selected.reserve(maxpoints);
+		selected.push_back(0);
+		double bucketSize = double(count - 2) / double(maxpoints - 2);
+		size_t a = 0;
+		for (size_t bucket = 0; bucket < maxpoints - 2; bucket++)
+		{
+			// average of the next bucket
+			size_t nextStart = size_t(double(bucket + 1) * bucketSize) + 1;
+			size_t nextEnd = std::min(size_t(double(bucket + 2) * bucketSize) + 1, count);
+			double avgX = 0;
+			double avgY = 0;
+			for (size_t ii = nextStart; ii < nextEnd; ii++)
+			{
+				avgX += double(ii);
+				avgY += values[ii];
+			}
+			size_t nextCount = std::max<size_t>(nextEnd - nextStart, 1);
+			avgX /= double(nextCount);
+			avgY /= double(nextCount);
+
+			size_t start = size_t(double(bucket) * bucketSize) + 1;
+			size_t end = std::min(size_t(double(bucket + 1) * bucketSize) + 1, count - 1);
+			double maxArea = -1;
+			size_t maxIndex = start;
+			for (size_t ii = start; ii < end; ii++)
+			{
+				double area = std::fabs((double(a) - avgX) * (values[ii] - values[a]) - (double(a) - double(ii)) * (avgY - values[a]));
+				if (area > maxArea)
+				{
+					maxArea = area;
+					maxIndex = ii;
+				}
+			}
+			selected.push_back(maxIndex);
+			a = maxIndex;
+		}
+		selected.push_back(count - 1);
+		return selected;
+	}
+
+	// Keeps the minimum and maximum of every bucket (in their original order), so peaks are never lost
+	std::vector<size_t> DownsampleMinMax(const std::vector<double> &values, const size_t maxpoints)
+	{
+		std::vector<size_t> selected;
+		size_t count = values.size();
+		size_t buckets = std::max<size_t>(maxpoints / 2, 1);
+		double bucketSize = double(count) / double(buckets);
+		selected.reserve(buckets * 2);
+		for (size_t bucket = 0; bucket < buckets; bucket++)
+		{
+			size_t start = size_t(double(bucket) * bucketSize);
+			size_t end = std::min(size_t(double(bucket + 1) * bucketSize), count);
+			if (start >= end)
+				continue;
+			size_t minIndex = start;
+			size_t maxIndex = start;
+			for (size_t ii = start + 1; ii < end; ii++)
+			{
+				if (values[ii] < values[minIndex])
+					minIndex = ii;
+				if (values[ii] > values[maxIndex])
+					maxIndex = ii;
+			}
+			selected.push_back(std::min(minIndex, maxIndex));
+			if (minIndex != maxIndex)
+				selected.push_back(std::max(minIndex, maxIndex));
+		}
+		return selected;
+	}
+
+	// Returns the indexes to keep, or an empty vector when no downsampling is needed
+	std::vector<size_t> DownsampleSeries(const std::vector<double> &values, const size_t maxpoints, const bool bMinMax)
+	{
+		if ((maxpoints < iMinGraphPoints) || (values.size() <= maxpoints))
+			return std::vector<size_t>();
+		if (bMinMax)
+			return DownsampleMinMax(values, maxpoints);
+		return DownsampleLTTB(values, maxpoints);
+	}
+
+	// Downsamples a graph "result" array on its main value, rows are kept or dropped as a whole
+	void DownsampleGraphResult(Json::Value &result, const size_t maxpoints, const bool bMinMax)
+	{
+		if ((!result.isArray()) || (result.size() <= maxpoints) || (maxpoints < iMinGraphPoints))
+			return;
+		if (!result[0].isObject())
+			return;
+
+		static const char *szValueKeys[] = { "te", "v", "mm", "uvi", "sp", "hu", "ba", "se", "v1", "eu", "u", "di" };
+		std::string valueKey;
+		for (const auto &key : szValueKeys)
+		{
+			if (result[0].isMember(key))
+			{
+				valueKey = key;
+				break;
+			}
+		}
+		if (valueKey.empty())
+			return;
+
+		std::vector<double> values;
+		values.reserve(result.size());
+		for (const auto &row : result)
+		{
+			const Json::Value &value = row[valueKey];
+			values.push_back(value.isNumeric() ? value.asDouble() : (value.isString() ? atof(value.asCString()) : 0.0));
+		}
+		std::vector<size_t> selected = DownsampleSeries(values, maxpoints, bMinMax);
+		if (selected.empty())
+			return;
+		Json::Value downsampled(Json::arrayValue);
+		for (const auto index : selected)
+			downsampled.append(std::move(result[(Json::ArrayIndex)index]));
+		result.swap(downsampled);
+	}
+} // namespace
+
 namespace http
 {
 	namespace server
@@ -4576,5 +4703,241 @@ namespace http
 			} // custom range
 		}
 
+
+		// Graph entry point of json.htm, adds optional server side downsampling (maxpoints=n, downsample=lttb|minmax)
+		void CWebServer::GetGraphPage(WebEmSession& session, const request& req, reply& rep)
+		{
+			size_t maxpoints = 0;
+			std::string smaxpoints = request::findValue(&req, "maxpoints");
+			if (!smaxpoints.empty())
+				maxpoints = static_cast<size_t>(std::max(atoi(smaxpoints.c_str()), 0));
+			bool bMinMax = (request::findValue(&req, "downsample") == "minmax");
+
+			std::string content;
+			if (!StreamDayGraph(req, content, maxpoints, bMinMax))
+			{
+				Json::Value root;
+				root["status"] = "ERR";
+				Cmd_HandleGraph(session, req, root);
+				if ((maxpoints > 0) && (request::findValue(&req, "groupby").empty()) && (root.isMember("result")))
+					DownsampleGraphResult(root["result"], maxpoints, bMinMax);
+				content = JSonToRawString(root);
+			}
+			reply::set_content(&rep, content);
+			rep.status = static_cast<http::server::reply::status_type>(session.reply_status);
+		}
+
+		// Writes the short log based 'day' graphs with the most rows (temperature, percentage, fan) straight from the
+		// database cursor to the output, without a Json::Value tree. Returns false for everything else.
+		bool CWebServer::StreamDayGraph(const request& req, std::string& content, const size_t maxpoints, const bool bMinMax)
+		{
+			if ((request::findValue(&req, "range") != "day") || (!request::findValue(&req, "groupby").empty()))
+				return false;
+
+			std::string sensor = request::findValue(&req, "sensor");
+			std::string dbasetable;
+			std::string dfield;
+			if (sensor == "temp")
+				dbasetable = "Temperature";
+			else if (sensor == "Percentage")
+			{
+				dbasetable = "Percentage";
+				dfield = "Percentage";
+			}
+			else if (sensor == "fan")
+			{
+				dbasetable = "Fan";
+				dfield = "Speed";
+			}
+			else
+				return false;
+
+			std::string sidx = request::findValue(&req, "idx");
+			if (sidx.empty())
+				return false;
+			uint64_t idx = std::strtoull(sidx.c_str(), nullptr, 10);
+
+			auto result = m_sql.safe_query("SELECT Type, SubType, Options FROM DeviceStatus WHERE (ID == %" PRIu64 ")", idx);
+			if (result.empty())
+				return false;
+			unsigned char dType = atoi(result[0][0].c_str());
+			unsigned char dSubType = atoi(result[0][1].c_str());
+			std::map<std::string, std::string> options = m_sql.BuildDeviceOptions(result[0][2]);
+			unsigned char tempsign = m_sql.m_tempsign[0];
+
+			// same field selection as the 'day' temp graph in Cmd_HandleGraph
+			bool bTemp = (dType == pTypeRego6XXTemp || dType == pTypeTEMP || dType == pTypeTEMP_HUM || dType == pTypeTEMP_HUM_BARO || dType == pTypeTEMP_BARO
+				|| dType == pTypeWIND && dSubType == sTypeWIND4 || dType == pTypeUV && dSubType == sTypeUV3 || dType == pTypeThermostat1 || dType == pTypeRadiator1
+				|| dType == pTypeRFXSensor && dSubType == sTypeRFXSensorTemp || dType == pTypeGeneral && dSubType == sTypeSystemTemp
+				|| dType == pTypeGeneral && dSubType == sTypeBaro || dType == pTypeEvohomeZone || dType == pTypeThermostat6 || dType == pTypeEvohomeWater);
+			bool bChill = ((dType == pTypeWIND) && ((dSubType == sTypeWIND4) || (dSubType == sTypeWINDNoTemp)));
+			bool bHum = ((dType == pTypeHUM) || (dType == pTypeTEMP_HUM) || (dType == pTypeTEMP_HUM_BARO)
+				|| ((dType == pTypeThermostat6) && ((dSubType == sTypeThermostat6TempHum) || (dSubType == sTypeThermostat6TempHumBaro))));
+			bool bBaro = ((dType == pTypeTEMP_HUM_BARO) || (dType == pTypeTEMP_BARO) || ((dType == pTypeGeneral) && (dSubType == sTypeBaro))
+				|| ((dType == pTypeThermostat6) && ((dSubType == sTypeThermostat6TempBaro) || (dSubType == sTypeThermostat6TempHumBaro))));
+			bool bBaroRaw = ((dType == pTypeTEMP_HUM_BARO) && (dSubType != sTypeTHBFloat));
+			bool bZoneSetpoint = ((dType == pTypeEvohomeZone) || (dType == pTypeEvohomeWater) || (dType == pTypeThermostat6));
+			bool bSetpoint = ((dType == pTypeSetpoint) && (dSubType == sTypeSetpoint));
+			std::string value_unit = options["ValueUnit"];
+			bool bSetpointIsTemp = (value_unit.empty()) || (value_unit == "°C") || (value_unit == "°F") || (value_unit == "C") || (value_unit == "F");
+
+			std::vector<std::string> rows;
+			std::vector<double> values;
+			content.clear();
+			CJsonStreamWriter writer(content);
+			writer.BeginObject();
+			writer.Key("status");
+			writer.String("OK");
+			writer.Key("title");
+			writer.String("Graph " + sensor + " day");
+			bool bHaveRows = false;
+
+			auto writeRow = [&](CJsonStreamWriter& w, const char* const* sd) -> double {
+				char szTmp[40];
+				double primary = 0;
+				bool bHavePrimary = false;
+				w.BeginObject();
+				if (dfield.empty())
+				{
+					w.Key("d");
+					w.String(sd[4], std::min<size_t>(strlen(sd[4]), 16));
+					if (bTemp)
+					{
+						primary = ConvertTemperature(atof(sd[0]), tempsign);
+						bHavePrimary = true;
+						w.Key("te");
+						w.Number(primary);
+					}
+					if (bChill)
+					{
+						w.Key("ch");
+						w.Number(ConvertTemperature(atof(sd[1]), tempsign));
+					}
+					if (bHum)
+					{
+						if (!bHavePrimary)
+						{
+							primary = atof(sd[2]);
+							bHavePrimary = true;
+						}
+						w.Key("hu");
+						w.String(sd[2], strlen(sd[2]));
+					}
+					if (bBaro)
+					{
+						if (bBaroRaw)
+							snprintf(szTmp, sizeof(szTmp), "%s", sd[3]);
+						else
+							snprintf(szTmp, sizeof(szTmp), "%.1f", atof(sd[3]) / 10.0F);
+						if (!bHavePrimary)
+						{
+							primary = atof(szTmp);
+							bHavePrimary = true;
+						}
+						w.Key("ba");
+						w.String(szTmp, strlen(szTmp));
+					}
+					if (bZoneSetpoint)
+					{
+						w.Key("se");
+						w.Number(ConvertTemperature(atof(sd[5]), tempsign));
+					}
+					if (bSetpoint)
+					{
+						primary = (bSetpointIsTemp) ? ConvertTemperature(atof(sd[0]), tempsign) : atof(sd[0]);
+						w.Key("te");
+						w.Number(primary);
+					}
+				}
+				else
+				{
+					w.Key("d");
+					w.String(sd[1], std::min<size_t>(strlen(sd[1]), 16));
+					w.Key("v");
+					w.String(sd[0], strlen(sd[0]));
+					primary = atof(sd[0]);
+				}
+				w.EndObject();
+				return primary;
+			};
+
+			auto onRow = [&](const char* const* sd, int cols) {
+				if (maxpoints > 0)
+				{
+					rows.emplace_back();
+					CJsonStreamWriter rowWriter(rows.back());
+					values.push_back(writeRow(rowWriter, sd));
+					return;
+				}
+				if (!bHaveRows)
+				{
+					writer.Key("result");
+					writer.BeginArray();
+					bHaveRows = true;
+				}
+				writeRow(writer, sd);
+			};
+
+			// with the columnar short log store enabled the series is one sequential read instead of an index walk over the table
+			bool bFromStore = false;
+			if (m_sql.m_shortlogStore.IsOpen())
+			{
+				int n5MinuteHistoryDays = 1;
+				m_sql.GetPreferencesVar("5MinuteHistoryDays", n5MinuteHistoryDays);
+				char szColumns[6][40];
+				const char* sd[6];
+				bFromStore = m_sql.m_shortlogStore.Scan(dbasetable, idx, mytime(nullptr) - n5MinuteHistoryDays * 86400, [&](time_t tTime, const double* values, size_t columns) {
+					// same column order as the queries below
+					static const int iStoreColumn[6] = { 0, 1, 2, 3, -1, 5 };
+					const int iDateColumn = dfield.empty() ? 4 : 1;
+					const int iColumns = dfield.empty() ? 6 : 2;
+					for (int ii = 0; ii < iColumns; ii++)
+					{
+						int column = dfield.empty() ? iStoreColumn[ii] : 0;
+						if (ii == iDateColumn)
+						{
+							struct tm ltime;
+							localtime_r(&tTime, &ltime);
+							strftime(szColumns[ii], sizeof(szColumns[ii]), "%Y-%m-%d %H:%M:%S", &ltime);
+						}
+						else
+							snprintf(szColumns[ii], sizeof(szColumns[ii]), "%.15g", (static_cast<size_t>(column) < columns) ? values[column] : 0.0);
+						sd[ii] = szColumns[ii];
+					}
+					onRow(sd, iColumns);
+				});
+			}
+			if (!bFromStore)
+			{
+				if (dfield.empty())
+					m_sql.safe_query_each(onRow, "SELECT Temperature, Chill, Humidity, Barometer, Date, SetPoint FROM %s WHERE (DeviceRowID==%" PRIu64 ") ORDER BY Date ASC",
+						dbasetable.c_str(), idx);
+				else
+					m_sql.safe_query_each(onRow, "SELECT %s, Date FROM %s WHERE (DeviceRowID==%" PRIu64 ") ORDER BY Date ASC", dfield.c_str(), dbasetable.c_str(), idx);
+			}
+
+			if (!rows.empty())
+			{
+				writer.Key("result");
+				writer.BeginArray();
+				bHaveRows = true;
+				std::vector<size_t> selected = DownsampleSeries(values, maxpoints, bMinMax);
+				if (selected.empty())
+				{
+					for (const auto& row : rows)
+						writer.Raw(row);
+				}
+				else
+				{
+					for (const auto index : selected)
+						writer.Raw(rows[index]);
+				}
+			}
+			if (bHaveRows)
+				writer.EndArray();
+			writer.EndObject();
+			return true;
+		}
+
 	} // namespace server
 } // namespace http
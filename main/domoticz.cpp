@@ -19,6 +19,7 @@
 
 #include "stdafx.h"
 #include "mainworker.h"
+#include "StartupProfile.h"
 #include <stdio.h>
 #include <sys/types.h>
 #include <signal.h>
@@ -86,7 +87,17 @@ namespace
 		"\t-nobrowser (do not start web browser (Windows Only)\n"
 #endif
 		"\t-noupdates do not use the internal update functionality\n"
+		"\t-rxcapture file_path (record all received frames to a capture file)\n"
+		"\t-rxreplay file_path (replay a capture file through the RX queues and log queue/decode/db/event/push timings. The replayed values are written to the\n"
+		"\t\tdatabase, so this only runs with -dbase :memory: or a scratch copy passed with -rxreplaydbase)\n"
+		"\t-rxreplaydbase file_path (scratch database for -rxreplay, used instead of -dbase, the file is modified)\n"
+		"\t-rxreplayspeed factor (1 = recorded speed, 10 = ten times faster, 0 = as fast as possible [default])\n"
+		"\t-rxreplayexit (stop after the replay is done)\n"
+		"\t-rxshards N (number of threads decoding received frames, default: number of cores, at most 4)\n"
+		"\t-tracesample N (trace 1 in N received messages, export with json.htm?type=command&param=exporttrace)\n"
+		"\t-startupprofile (log the time spent in each startup phase)\n"
 		"\t-dbase_disable_wal_mode\n"
+		"\t-shortlogstore dir_path (also keep the temperature/percentage/fan short log in a compressed columnar store, used by the day graphs)\n"
 #if defined WIN32
 		"\t-log file_path (for example D:\\domoticz.log)\n"
 		"\t-weblog file_path (for example D:\\domoticz_access.log)\n"
@@ -94,6 +105,8 @@ namespace
 		"\t-log file_path (for example /var/log/domoticz.log)\n"
 		"\t-weblog file_path (for example /var/log/domoticz_access.log)\n"
 #endif
+		"\t-logmaxsize size_mb (rotate the log file when it is larger, keeping 5 old files)\n"
+		"\t-logbuffer lines (number of recent log lines kept in memory for the web log viewer, default 10000)\n"
 		"\t-loglevel (combination of: all,normal,status,error,debug)\n"
 		"\t-debuglevel (combination of: all,normal,hardware,received,webserver,eventsystem,python,thread_id,sql,auth)\n"
 		"\t-notimestamps (do not prepend timestamps to logs; useful with syslog, etc.)\n"
@@ -169,6 +182,8 @@ bool g_bLlmMCPSupport = false;
 bool bStartWebBrowser = true;
 bool g_bUseWatchdog = true;
 
+#define LOG_ROTATE_FILES 5
+
 #define DAEMON_NAME "domoticz"
 #define PID_FILE "/var/run/domoticz.pid" 
 
@@ -585,6 +600,12 @@ bool ParseConfigFile(const std::string &szConfigFile)
 		else if (szFlag == "weblog_file") {
 			weblogfile = sLine;
 		}
+		else if (szFlag == "log_max_size") {
+			_log.SetOutputFileRotation((uint64_t)atoi(sLine.c_str()) * 1024 * 1024, LOG_ROTATE_FILES);
+		}
+		else if (szFlag == "log_buffer_lines") {
+			_log.SetLogBufferSize((size_t)atoi(sLine.c_str()));
+		}
 		else if (szFlag == "loglevel") {
 			_log.SetLogFlags(sLine);
 		}
@@ -606,6 +627,9 @@ bool ParseConfigFile(const std::string &szConfigFile)
 		else if ( (szFlag == "dbase_disable_wal_mode") && (GetConfigBool(sLine) ) )  {
 			journalMode = "DELETE";
 		}
+		else if (szFlag == "shortlog_store_path") {
+			m_sql.SetShortLogStorePath(sLine);
+		}
 
 		else if (szFlag == "startup_delay") {
 			int DelaySeconds = atoi(sLine.c_str());
@@ -728,6 +752,24 @@ int main(int argc, char**argv)
 			}
 			logfile = cmdLine.GetSafeArgument("-log", 0, "domoticz.log");
 		}
+		if (cmdLine.HasSwitch("-logmaxsize"))
+		{
+			if (cmdLine.GetArgumentCount("-logmaxsize") != 1)
+			{
+				_log.Log(LOG_ERROR, "Please specify a maximum log file size (in MB)");
+				return 1;
+			}
+			_log.SetOutputFileRotation((uint64_t)atoi(cmdLine.GetSafeArgument("-logmaxsize", 0, "0").c_str()) * 1024 * 1024, LOG_ROTATE_FILES);
+		}
+		if (cmdLine.HasSwitch("-logbuffer"))
+		{
+			if (cmdLine.GetArgumentCount("-logbuffer") != 1)
+			{
+				_log.Log(LOG_ERROR, "Please specify the number of log lines to keep in memory");
+				return 1;
+			}
+			_log.SetLogBufferSize((size_t)atoi(cmdLine.GetSafeArgument("-logbuffer", 0, "0").c_str()));
+		}
 		if (cmdLine.HasSwitch("-weblog"))
 		{
 			if (cmdLine.GetArgumentCount("-weblog") != 1)
@@ -1096,6 +1138,74 @@ int main(int argc, char**argv)
 		bEnableMDNS = false;
 		_log.Log(LOG_STATUS, "mDNS Support disabled!");
 	}
+	if (cmdLine.HasSwitch("-shortlogstore"))
+	{
+		if (cmdLine.GetArgumentCount("-shortlogstore") != 1)
+		{
+			_log.Log(LOG_ERROR, "Please specify a short log store directory");
+			return 1;
+		}
+		m_sql.SetShortLogStorePath(cmdLine.GetSafeArgument("-shortlogstore", 0, ""));
+	}
+	if (cmdLine.HasSwitch("-rxcapture"))
+	{
+		if (cmdLine.GetArgumentCount("-rxcapture") != 1)
+		{
+			_log.Log(LOG_ERROR, "Please specify a capture file");
+			return 1;
+		}
+		m_mainworker.SetRxCaptureFile(cmdLine.GetSafeArgument("-rxcapture", 0, ""));
+	}
+	if (cmdLine.HasSwitch("-rxshards"))
+	{
+		int nShards = atoi(cmdLine.GetSafeArgument("-rxshards", 0, "0").c_str());
+		if ((cmdLine.GetArgumentCount("-rxshards") != 1) || (nShards < 1) || (nShards > 64))
+		{
+			_log.Log(LOG_ERROR, "Please specify a number of RX threads (1 - 64)");
+			return 1;
+		}
+		m_mainworker.SetRxShards(nShards);
+	}
+	if (cmdLine.HasSwitch("-rxreplay"))
+	{
+		if (cmdLine.GetArgumentCount("-rxreplay") != 1)
+		{
+			_log.Log(LOG_ERROR, "Please specify a capture file to replay");
+			return 1;
+		}
+		std::string szScratchDatabase;
+		if (cmdLine.HasSwitch("-rxreplaydbase"))
+		{
+			if (cmdLine.GetArgumentCount("-rxreplaydbase") != 1)
+			{
+				_log.Log(LOG_ERROR, "Please specify a scratch database for the replay");
+				return 1;
+			}
+			szScratchDatabase = cmdLine.GetSafeArgument("-rxreplaydbase", 0, "");
+			dbasefile = szScratchDatabase;
+			m_sql.SetDatabaseName(dbasefile);
+		}
+		else if (dbasefile != ":memory:")
+		{
+			_log.Log(LOG_ERROR, "RxReplay: refusing to replay into %s, use -dbase :memory: or pass a scratch database with -rxreplaydbase", dbasefile.c_str());
+			return 1;
+		}
+		double speed = 0;
+		if (cmdLine.HasSwitch("-rxreplayspeed"))
+			speed = atof(cmdLine.GetSafeArgument("-rxreplayspeed", 0, "0").c_str());
+		m_mainworker.SetRxReplay(cmdLine.GetSafeArgument("-rxreplay", 0, ""), szScratchDatabase, speed, cmdLine.HasSwitch("-rxreplayexit"));
+	}
+	if (cmdLine.HasSwitch("-startupprofile"))
+		startup::SetProfiling(true);
+	if (cmdLine.HasSwitch("-tracesample"))
+	{
+		if (cmdLine.GetArgumentCount("-tracesample") != 1)
+		{
+			_log.Log(LOG_ERROR, "Please specify a sample rate");
+			return 1;
+		}
+		tracer::SetSampleRate(static_cast<uint32_t>(atoi(cmdLine.GetSafeArgument("-tracesample", 0, "0").c_str())));
+	}
 	if (cmdLine.HasSwitch("-mcp"))
 	{
 		g_bLlmMCPSupport = true;
@@ -1226,6 +1336,9 @@ int main(int argc, char**argv)
 		return 1;
 	}
 
+	// log writer thread, also after daemonization
+	_log.StartAsyncWriter();
+
 	// start Watchdog thread after daemonization
 	m_LastHeartbeat = mytime(nullptr);
 	std::thread thread_watchdog(Do_Watchdog_Work);
@@ -1288,6 +1401,7 @@ int main(int argc, char**argv)
 	WSACleanup();
 	CoUninitialize();
 #endif
+	_log.StopAsyncWriter();
 	g_stop_watchdog = true;
 	thread_watchdog.join();
 	return 0;
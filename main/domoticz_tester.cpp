@@ -7,6 +7,18 @@
 #include "Helper.h"
 #include "appversion.h"
 #include "localtime_r.h"
+#include "CalendarRollup.h"
+#include "CameraFeed.h"
+#include "MeterStore.h"
+#include "RFXNames.h"
+#include "TimeSeriesStore.h"
+#include "Logger.h"
+#include "../hardware/EvohomeBase.h"
+#include "../hardware/hardwaretypes.h"
+#include <inttypes.h>
+#include <sqlite3.h>
+#include <atomic>
+#include <thread>
 
 #ifndef WIN32
 	#include <sys/stat.h>
@@ -33,6 +45,11 @@ constexpr const char *szHelp
 	"Available modules:\n"
 	"\thelper\n"
 	"\tbaroforecastcalculator\n"
+	"\tcalendarrollup (-function benchmark -input <years>[|<database file>])\n"
+	"\trfxnames (-function benchmark -input <rounds>)\n"
+	"\tmeterstore (-function benchmark -input <updates>[|<database file>], -function pending -input <updates>)\n"
+	"\ttimeseriesstore (-function deleterange -input <first point>|<last point>, -function crashseal -input <points>)\n"
+	"\tcamerafeed (-function relay -input <MJPEG stream url>|<viewers>|<frames per viewer>)\n"
 	""
 };
 
@@ -41,6 +58,7 @@ int iAppRevision=0;
 std::string szAppHash="???";
 std::string szAppDate="???";
 std::string szPyVersion="None";
+std::string szUserDataFolder;
 int ActYear;
 time_t m_StartTime = time(nullptr);
 
@@ -87,6 +105,44 @@ void Log(const char *logline, ...)
 	std::cout << sstr.str() << std::endl;
 }
 
+// the tester does not link Logger.cpp, modules that log write to the console instead
+struct CLogger::_tAsyncQueue
+{
+};
+CLogger _log;
+
+CLogger::CLogger()
+{
+}
+
+CLogger::~CLogger()
+{
+}
+
+void CLogger::Log(const _eLogLevel /*level*/, const char *logline, ...)
+{
+	if (bQuiet)
+		return;
+	va_list argList;
+	char cbuffer[MAX_LOG_LINE_LENGTH];
+	va_start(argList, logline);
+	vsnprintf(cbuffer, sizeof(cbuffer), logline, argList);
+	va_end(argList);
+	::Log("%s", cbuffer);
+}
+
+void CLogger::Debug(const _eDebugLevel /*level*/, const char *logline, ...)
+{
+	if ((bQuiet) || (!bVerbose))
+		return;
+	va_list argList;
+	char cbuffer[MAX_LOG_LINE_LENGTH];
+	va_start(argList, logline);
+	vsnprintf(cbuffer, sizeof(cbuffer), logline, argList);
+	va_end(argList);
+	::Log("%s", cbuffer);
+}
+
 void GetAppVersion()
 {
 	szAppVersion = VERSION_STRING;
@@ -200,6 +256,50 @@ bool helper_tester(const std::string szFunction, std::string &szInput, std::stri
 	{
 		bSuccess = base32_encode(szInput, szOutput);
 	}
+	// StringSplitNumbers
+	else if (szFunction == "StringSplitNumbers")
+	{
+		std::vector<double> values;
+		StringSplitNumbers(szInput, ";", values);
+		for (const auto value : values)
+			szOutput += std_format("%s%g", szOutput.empty() ? "" : ";", value);
+		bSuccess = true;
+	}
+	// StringSplit_benchmark, <rounds> of splitting and converting a set of typical sValues
+	else if (szFunction == "StringSplit_benchmark")
+	{
+		const std::vector<std::string> sValues = { "21.3;55;1;1013;1", "21.3", "12.6;45;2", "180;S;15;22;18.4;18.4", "1234567;2345678;123456;234567;1250;0", "0.25;1250.000" };
+		const int iRounds = std::max(1, atoi(szInput.c_str()));
+		double checksum = 0;
+		auto measure = [&](const char *szName, const std::function<void(const std::string &)> &run) {
+			auto tStart = std::chrono::steady_clock::now();
+			for (int round = 0; round < iRounds; round++)
+				for (const auto &sValue : sValues)
+					run(sValue);
+			double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - tStart).count();
+			szOutput += std_format("%s%s: %.1f ns", szOutput.empty() ? "" : ", ", szName, ns / (iRounds * sValues.size()));
+		};
+		std::vector<std::string> splitresults;
+		measure("StringSplit+atof", [&](const std::string &sValue) {
+			StringSplit(sValue, ";", splitresults);
+			for (const auto &field : splitresults)
+				checksum += atof(field.c_str());
+		});
+		std::vector<std::string_view> splitviews;
+		measure("StringSplit(string_view)+StringToDouble", [&](const std::string &sValue) {
+			StringSplit(std::string_view(sValue), ";", splitviews);
+			double value;
+			for (const auto &field : splitviews)
+				checksum += StringToDouble(field, value) ? value : 0;
+		});
+		std::vector<double> values;
+		measure("StringSplitNumbers", [&](const std::string &sValue) {
+			StringSplitNumbers(sValue, ";", values);
+			for (const auto value : values)
+				checksum += value;
+		});
+		bSuccess = (checksum != 0);
+	}
 	else
 	{
 		szOutput = "NOT FOUND!";
@@ -207,6 +307,584 @@ bool helper_tester(const std::string szFunction, std::string &szInput, std::stri
 	return bSuccess;
 }
 
+/* **********
+CalendarRollup.cpp
+********** */
+double ElapsedMs(const std::chrono::steady_clock::time_point &tStart)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - tStart).count();
+}
+
+// runs a query and returns the number of rows, only used to time the query
+int CountRows(sqlite3 *db, const std::string &szQuery)
+{
+	sqlite3_stmt *statement;
+	if (sqlite3_prepare_v2(db, szQuery.c_str(), -1, &statement, nullptr) != SQLITE_OK)
+		return -1;
+	int rows = 0;
+	while (sqlite3_step(statement) == SQLITE_ROW)
+		rows++;
+	sqlite3_finalize(statement);
+	return rows;
+}
+
+bool calendarrollup_tester(const std::string szFunction, std::string &szInput, std::string &szOutput)
+{
+	std::vector<std::string> svInputs;
+	StringSplit(szInput, INPUTSEPERATOR, svInputs);
+
+	if ((szFunction != "benchmark") || svInputs.empty())
+	{
+		szOutput = "NOT FOUND!";
+		return false;
+	}
+
+	// 'year' and 'groupby=month' temperature graphs of one device, on a calendar table with <years> of daily rows (and 9 other devices)
+	const int iYears = std::max(1, atoi(svInputs[0].c_str()));
+	const std::string szDatabase = (svInputs.size() > 1) ? svInputs[1] : ":memory:";
+	constexpr int iDevices = 10;
+	constexpr int idx = 1;
+
+	sqlite3 *db = nullptr;
+	if (sqlite3_open(szDatabase.c_str(), &db) != SQLITE_OK)
+	{
+		szOutput = std_format("cannot open %s", szDatabase.c_str());
+		sqlite3_close(db);
+		return false;
+	}
+	sqlite3_exec(db, "DROP TABLE IF EXISTS Temperature_Calendar; DROP TABLE IF EXISTS Calendar_Rollup;", nullptr, nullptr, nullptr);
+	sqlite3_exec(db, "CREATE TABLE Temperature_Calendar ([DeviceRowID] BIGINT(10) NOT NULL, [Temp_Min] FLOAT NOT NULL, [Temp_Max] FLOAT NOT NULL, [Temp_Avg] FLOAT DEFAULT 0, [Date] DATE NOT NULL);",
+		     nullptr, nullptr, nullptr);
+	sqlite3_exec(db, "CREATE INDEX tc_id_date_idx ON Temperature_Calendar(DeviceRowID, Date);", nullptr, nullptr, nullptr);
+	for (const auto &sqlRollup : calendar_rollup::GetSchema())
+		sqlite3_exec(db, sqlRollup.c_str(), nullptr, nullptr, nullptr);
+
+	time_t tDay = mytime(nullptr) - (time_t)iYears * 365 * 86400;
+	sqlite3_exec(db, "BEGIN TRANSACTION", nullptr, nullptr, nullptr);
+	sqlite3_stmt *insert;
+	sqlite3_prepare_v2(db, "INSERT INTO Temperature_Calendar (DeviceRowID, Temp_Min, Temp_Max, Temp_Avg, Date) VALUES (?1,?2,?3,?4,?5)", -1, &insert, nullptr);
+	for (int day = 0; day < iYears * 365; day++, tDay += 86400)
+	{
+		struct tm ltime;
+		localtime_r(&tDay, &ltime);
+		char szDate[20];
+		strftime(szDate, sizeof(szDate), "%Y-%m-%d", &ltime);
+		for (int device = 1; device <= iDevices; device++)
+		{
+			double temp = 10.0 + 10.0 * sin(day * 2 * 3.14159265 / 365) + device;
+			sqlite3_bind_int64(insert, 1, device);
+			sqlite3_bind_double(insert, 2, temp - 4);
+			sqlite3_bind_double(insert, 3, temp + 4);
+			sqlite3_bind_double(insert, 4, temp);
+			sqlite3_bind_text(insert, 5, szDate, -1, SQLITE_TRANSIENT);
+			sqlite3_step(insert);
+			sqlite3_reset(insert);
+		}
+	}
+	sqlite3_finalize(insert);
+	sqlite3_exec(db, "COMMIT", nullptr, nullptr, nullptr);
+
+	// range=year, as read by the graph handler
+	auto tStart = std::chrono::steady_clock::now();
+	int iYearRows = CountRows(db, std_format("SELECT Temp_Min, Temp_Max, Temp_Avg, Date FROM Temperature_Calendar WHERE (DeviceRowID==%d AND Date>=date('now','-1 year')) ORDER BY Date ASC", idx));
+	double dYearMs = ElapsedMs(tStart);
+
+	// groupby=month, aggregated at query time
+	tStart = std::chrono::steady_clock::now();
+	int iGroupRows = CountRows(db, std_format("SELECT strftime('%%Y', Date) as y, strftime('%%m', Date) as m, AVG(Temp_Avg) FROM Temperature_Calendar WHERE DeviceRowID == %d GROUP BY strftime('%%Y', Date), strftime('%%m', Date)", idx));
+	double dGroupMs = ElapsedMs(tStart);
+
+	// groupby=month from the rollup: first build, cached, and after a new day was added
+	std::vector<calendar_rollup::_tMonth> months;
+	tStart = std::chrono::steady_clock::now();
+	bool bOK = calendar_rollup::GetMonths(db, "Temperature_Calendar", idx, "Temp_Avg", months);
+	double dColdMs = ElapsedMs(tStart);
+
+	tStart = std::chrono::steady_clock::now();
+	bOK = calendar_rollup::GetMonths(db, "Temperature_Calendar", idx, "Temp_Avg", months) && bOK;
+	double dWarmMs = ElapsedMs(tStart);
+
+	sqlite3_exec(db, std_format("INSERT INTO Temperature_Calendar (DeviceRowID, Temp_Min, Temp_Max, Temp_Avg, Date) VALUES (%d, 0, 0, 0, date('now'))", idx).c_str(), nullptr, nullptr, nullptr);
+	tStart = std::chrono::steady_clock::now();
+	bOK = calendar_rollup::GetMonths(db, "Temperature_Calendar", idx, "Temp_Avg", months) && bOK;
+	double dDirtyMs = ElapsedMs(tStart);
+
+	sqlite3_close(db);
+
+	szOutput = std_format("years: %d, year range: %d rows %.3f ms, groupby=month: %d rows %.3f ms, rollup: %d rows %.3f ms (first) %.3f ms (cached) %.3f ms (after insert)", iYears, iYearRows, dYearMs,
+			      iGroupRows, dGroupMs, (int)months.size(), dColdMs, dWarmMs, dDirtyMs);
+	return bOK && (iGroupRows == (int)months.size());
+}
+
+/* **********
+RFXNames.cpp
+********** */
+// RFXNames.cpp only needs this name lookup of EvohomeBase.cpp, which would pull in the whole hardware framework
+const char *CEvohomeBase::GetWebAPIModeName(uint8_t nControllerMode)
+{
+	return "Unknown";
+}
+
+bool rfxnames_tester(const std::string szFunction, std::string &szInput, std::string &szOutput)
+{
+	if (szFunction != "benchmark")
+	{
+		szOutput = "NOT FOUND!";
+		return false;
+	}
+
+	// every (sub)type id a getdevices/push/event pass can ask for, <rounds> times
+	const int iRounds = std::max(1, atoi(szInput.c_str()));
+	size_t checksum = 0;
+	std::string szResult;
+	auto measure = [&](const char *szName, const uint64_t calls, const std::function<void()> &run) {
+		auto tStart = std::chrono::steady_clock::now();
+		for (int round = 0; round < iRounds; round++)
+			run();
+		double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - tStart).count();
+		szResult += std_format("%s%s: %.1f ns", szResult.empty() ? "" : ", ", szName, ns / (calls * iRounds));
+	};
+
+	measure("RFX_Type_Desc", 256 * 2, [&] {
+		for (int ii = 0; ii < 256; ii++)
+			checksum += (size_t)RFX_Type_Desc(ii, 1) + (size_t)RFX_Type_Desc(ii, 2);
+	});
+	measure("RFX_Type_SubType_Desc", 256 * 256, [&] {
+		for (int ii = 0; ii < 256; ii++)
+			for (int jj = 0; jj < 256; jj++)
+				checksum += (size_t)RFX_Type_SubType_Desc(ii, jj);
+	});
+	measure("Switch_Type_Desc", STYPE_END, [&] {
+		for (int ii = 0; ii < STYPE_END; ii++)
+			checksum += (size_t)Switch_Type_Desc((_eSwitchType)ii);
+	});
+	measure("Meter_Type_Desc", MTYPE_END, [&] {
+		for (int ii = 0; ii < MTYPE_END; ii++)
+			checksum += (size_t)Meter_Type_Desc((_eMeterType)ii);
+	});
+	measure("Hardware_Type_Desc", HTYPE_END * 2, [&] {
+		for (int ii = 0; ii < HTYPE_END; ii++)
+			checksum += (size_t)Hardware_Type_Desc(ii) + (size_t)Hardware_Short_Desc(ii);
+	});
+	measure("Notification_Type_Desc", (NTYPE_SLEEPING + 1) * 3, [&] {
+		for (int ii = 0; ii <= NTYPE_SLEEPING; ii++)
+			checksum += (size_t)Notification_Type_Desc(ii, 0) + (size_t)Notification_Type_Desc(ii, 1) + (size_t)Notification_Type_Label(ii);
+	});
+
+	// reverse lookups, every known description has to map back to its own type
+	std::vector<std::string> switchNames;
+	for (int ii = 0; ii < STYPE_END; ii++)
+		switchNames.emplace_back(Switch_Type_Desc((_eSwitchType)ii));
+	for (int ii = 0; ii < STYPE_END; ii++)
+	{
+		if ((switchNames[ii] != "Unknown") && (Switch_Type_FromDesc(switchNames[ii]) != ii))
+		{
+			szOutput = std_format("Switch_Type_FromDesc(%s) mismatch", switchNames[ii].c_str());
+			return false;
+		}
+	}
+	measure("Switch_Type_FromDesc", STYPE_END, [&] {
+		for (const auto &name : switchNames)
+			checksum += Switch_Type_FromDesc(name);
+	});
+	std::vector<std::string> hardwareNames;
+	for (int ii = 0; ii < HTYPE_END; ii++)
+		hardwareNames.emplace_back(Hardware_Type_Desc(ii));
+	measure("Hardware_Type_FromDesc", HTYPE_END, [&] {
+		for (const auto &name : hardwareNames)
+			checksum += Hardware_Type_FromDesc(name);
+	});
+
+	szOutput = szResult;
+	return checksum != 0;
+}
+
+/* **********
+MeterStore.cpp
+********** */
+static void CreateDeviceStatusTable(sqlite3 *db)
+{
+	sqlite3_exec(db, "DROP TABLE IF EXISTS DeviceStatus;", nullptr, nullptr, nullptr);
+	sqlite3_exec(db, "CREATE TABLE DeviceStatus ([ID] INTEGER PRIMARY KEY, [HardwareID] INTEGER NOT NULL, [OrgHardwareID] INTEGER DEFAULT 0, [DeviceID] VARCHAR(25) NOT NULL, "
+			 "[Unit] INTEGER DEFAULT 0, [Name] VARCHAR(100) DEFAULT Unknown, [Used] INTEGER DEFAULT 0, [Type] INTEGER NOT NULL, [SubType] INTEGER NOT NULL, "
+			 "[SwitchType] INTEGER DEFAULT 0, [SignalLevel] INTEGER DEFAULT 0, [BatteryLevel] INTEGER DEFAULT 0, [nValue] INTEGER DEFAULT 0, [sValue] VARCHAR(200) DEFAULT null, "
+			 "[LastUpdate] DATETIME DEFAULT (datetime('now','localtime')), [Options] TEXT DEFAULT null);",
+		     nullptr, nullptr, nullptr);
+	sqlite3_exec(db, "CREATE INDEX ds_hduts_idx ON DeviceStatus(HardwareID, DeviceID, Unit, Type, SubType);", nullptr, nullptr, nullptr);
+}
+
+// <updates> updates of a P1 meter with a 60 second write interval, each followed by the battery level write
+// that is done after a received message is decoded. The update hook invalidates the row like the one of
+// CSQLHelper. Then the name and the value are changed by someone else
+static bool meterstore_pending(const int iUpdates, std::string &szOutput)
+{
+	sqlite3 *db = nullptr;
+	sqlite3_open(":memory:", &db);
+	CreateDeviceStatusTable(db);
+	sqlite3_exec(db, std_format("INSERT INTO DeviceStatus (HardwareID, DeviceID, Unit, Name, Used, Type, SubType, sValue) VALUES (1, '1', 1, 'Power', 1, %d, %d, '0;0;0;0;0;0')", pTypeP1Power,
+				    sTypeP1Power)
+			     .c_str(),
+		     nullptr, nullptr, nullptr);
+
+	meter_store::CMeterStore store;
+	store.SetWriteInterval(60);
+	sqlite3_update_hook(
+		db,
+		[](void *pStore, int /*operation*/, const char * /*szDatabase*/, const char *szTable, sqlite3_int64 rowid) {
+			if (strcmp(szTable, "DeviceStatus") == 0)
+				static_cast<meter_store::CMeterStore *>(pStore)->Invalidate(static_cast<uint64_t>(rowid));
+		},
+		&store);
+	// the DeviceStatus reads of the store
+	int iReads = 0;
+	sqlite3_trace_v2(
+		db, SQLITE_TRACE_STMT,
+		[](unsigned /*type*/, void *pReads, void *pStatement, void * /*pSQL*/) {
+			if (strncmp(sqlite3_sql(static_cast<sqlite3_stmt *>(pStatement)), "SELECT", 6) == 0)
+				(*static_cast<int *>(pReads))++;
+			return 0;
+		},
+		&iReads);
+
+	meter_store::_tMeterKey key;
+	key.HardwareID = 1;
+	key.DeviceID = "1";
+	key.Unit = 1;
+	key.Type = pTypeP1Power;
+	key.SubType = sTypeP1Power;
+	meter_store::_tMeterRow row;
+	auto sValueOf = [](const int update) { return std_format("%d;%d;0;0;%d;0", 1000 + update, 2000 + update, update % 3000); };
+	auto dbValue = [&]() {
+		std::string sValue;
+		sqlite3_stmt *stmt;
+		if (sqlite3_prepare_v2(db, "SELECT sValue FROM DeviceStatus WHERE (ID=1)", -1, &stmt, nullptr) == SQLITE_OK)
+		{
+			if (sqlite3_step(stmt) == SQLITE_ROW)
+				sValue = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 0));
+			sqlite3_finalize(stmt);
+		}
+		return sValue;
+	};
+
+	bool bOK = true;
+	for (int update = 0; update < iUpdates; update++)
+	{
+		bOK = store.Get(db, key, row) && store.Update(db, key, 0, sValueOf(update), TimeToString(nullptr, TF_DateTime), 12, 255) && bOK;
+		bOK = store.WriteBatteryLevel(db, row.ID, 255) && bOK;
+	}
+	int iStoreReads = iReads;
+
+	// renamed through the web, the held back value is still the newest
+	sqlite3_exec(db, "UPDATE DeviceStatus SET Name='Renamed' WHERE (ID=1)", nullptr, nullptr, nullptr);
+	bOK = (store.Flush(db, true) >= 0) && bOK;
+	bool bPendingKept = (dbValue() == sValueOf(iUpdates - 1));
+
+	// a value set through the web or a script wins over a held back one
+	bOK = store.Get(db, key, row) && store.Update(db, key, 0, sValueOf(iUpdates), TimeToString(nullptr, TF_DateTime), 12, 255) && bOK;
+	sqlite3_exec(db, "UPDATE DeviceStatus SET sValue='1;1;0;0;1;0' WHERE (ID=1)", nullptr, nullptr, nullptr);
+	bOK = (store.Flush(db, true) >= 0) && bOK;
+	bool bExternalKept = (dbValue() == "1;1;0;0;1;0");
+
+	store.Clear();
+	sqlite3_close(db);
+	szOutput = std_format("reads during the updates: %d, held back value kept after a rename: %s, value set by someone else kept: %s", iStoreReads,
+			      bPendingKept ? "yes" : "no", bExternalKept ? "yes" : "no");
+	return bOK;
+}
+
+bool meterstore_tester(const std::string szFunction, std::string &szInput, std::string &szOutput)
+{
+	std::vector<std::string> svInputs;
+	StringSplit(szInput, INPUTSEPERATOR, svInputs);
+
+	if ((szFunction == "pending") && (!svInputs.empty()))
+		return meterstore_pending(std::max(1, atoi(svInputs[0].c_str())), szOutput);
+	if ((szFunction != "benchmark") || svInputs.empty())
+	{
+		szOutput = "NOT FOUND!";
+		return false;
+	}
+
+	// <updates> P1/kWh meter updates spread over 60 meters, the way UpdateValueInt did them and through the meter store
+	const int iUpdates = std::max(1, atoi(svInputs[0].c_str()));
+	const std::string szDatabase = (svInputs.size() > 1) ? svInputs[1] : ":memory:";
+	constexpr int iMeters = 60;
+
+	sqlite3 *db = nullptr;
+	if (sqlite3_open(szDatabase.c_str(), &db) != SQLITE_OK)
+	{
+		szOutput = std_format("cannot open %s", szDatabase.c_str());
+		sqlite3_close(db);
+		return false;
+	}
+	sqlite3_exec(db, "PRAGMA journal_mode = WAL; PRAGMA synchronous = NORMAL;", nullptr, nullptr, nullptr);
+	CreateDeviceStatusTable(db);
+	sqlite3_exec(db, "BEGIN TRANSACTION", nullptr, nullptr, nullptr);
+	for (int meter = 0; meter < iMeters; meter++)
+	{
+		sqlite3_exec(db, std_format("INSERT INTO DeviceStatus (HardwareID, DeviceID, Unit, Name, Used, Type, SubType, sValue) VALUES (1, '%04X', 1, 'Meter %d', 1, %d, %d, '0;0;0;0;0;0')",
+					    meter, meter, pTypeP1Power, sTypeP1Power).c_str(),
+			     nullptr, nullptr, nullptr);
+	}
+	sqlite3_exec(db, "COMMIT", nullptr, nullptr, nullptr);
+
+	auto sValueOf = [](const int update) { return std_format("%d;%d;0;0;%d;0", 1000 + update, 2000 + update, update % 3000); };
+	auto key = [](const int update) {
+		meter_store::_tMeterKey key;
+		key.HardwareID = 1;
+		key.DeviceID = std_format("%04X", update % iMeters);
+		key.Unit = 1;
+		key.Type = pTypeP1Power;
+		key.SubType = sTypeP1Power;
+		return key;
+	};
+	// every meter has to end up with its last value
+	auto verify = [&]() {
+		int iOK = 0;
+		for (int update = std::max(0, iUpdates - iMeters); update < iUpdates; update++)
+			iOK += CountRows(db, std_format("SELECT ID FROM DeviceStatus WHERE (DeviceID='%04X' AND sValue='%s')", update % iMeters, sValueOf(update).c_str()));
+		return iOK == std::min(iUpdates, iMeters);
+	};
+	const std::string szLastUpdate = TimeToString(nullptr, TF_DateTime);
+
+	// formatted and compiled for every update (safe_query)
+	auto tStart = std::chrono::steady_clock::now();
+	for (int update = 0; update < iUpdates; update++)
+	{
+		meter_store::_tMeterKey meter = key(update);
+		char *szQuery = sqlite3_mprintf("SELECT ID, Name, Used, SwitchType, nValue, sValue, LastUpdate, Options FROM DeviceStatus WHERE (HardwareID=%d AND OrgHardwareID=%d AND DeviceID='%q' AND Unit=%d AND Type=%d AND SubType=%d)",
+						meter.HardwareID, meter.OrgHardwareID, meter.DeviceID.c_str(), meter.Unit, meter.Type, meter.SubType);
+		sqlite3_stmt *statement;
+		uint64_t ID = 0;
+		if (sqlite3_prepare_v2(db, szQuery, -1, &statement, nullptr) == SQLITE_OK)
+		{
+			if (sqlite3_step(statement) == SQLITE_ROW)
+				ID = sqlite3_column_int64(statement, 0);
+			sqlite3_finalize(statement);
+		}
+		sqlite3_free(szQuery);
+		szQuery = sqlite3_mprintf("UPDATE DeviceStatus SET SignalLevel=%d, BatteryLevel=%d, nValue=%d, sValue='%q', LastUpdate='%q' WHERE (ID = %" PRIu64 ")", 12, 255, 0,
+					  sValueOf(update).c_str(), szLastUpdate.c_str(), ID);
+		sqlite3_exec(db, szQuery, nullptr, nullptr, nullptr);
+		sqlite3_free(szQuery);
+	}
+	double dQueryMs = ElapsedMs(tStart);
+	bool bOK = verify();
+
+	// the meter store, writing every update and coalescing them within 60 seconds
+	double dStoreMs[2];
+	int iWritten = 0;
+	for (int mode = 0; mode < 2; mode++)
+	{
+		meter_store::CMeterStore store;
+		store.SetWriteInterval((mode == 0) ? 0 : 60);
+		tStart = std::chrono::steady_clock::now();
+		for (int update = 0; update < iUpdates; update++)
+		{
+			meter_store::_tMeterKey meter = key(update);
+			meter_store::_tMeterRow row;
+			bOK = store.Get(db, meter, row) && store.Update(db, meter, 0, sValueOf(update), szLastUpdate, 12, 255) && bOK;
+		}
+		iWritten = store.Flush(db, true);
+		dStoreMs[mode] = ElapsedMs(tStart);
+		bOK = (iWritten >= 0) && verify() && bOK;
+		store.Clear();
+	}
+
+	sqlite3_close(db);
+
+	auto perSecond = [&](const double dMs) { return (dMs > 0) ? iUpdates * 1000.0 / dMs : 0.0; };
+	szOutput = std_format("updates: %d, meters: %d, query: %.0f/s, meter store: %.0f/s, meter store (60 s write interval): %.0f/s (%d rows written at the end)", iUpdates, iMeters,
+			      perSecond(dQueryMs), perSecond(dStoreMs[0]), perSecond(dStoreMs[1]), iWritten);
+	return bOK;
+}
+
+/* **********
+TimeSeriesStore.cpp
+********** */
+// a crash in SealBlock after the block was written but before the head was truncated: the head still holds
+// the sealed points when domoticz starts again, then <points> more points are appended
+static bool timeseriesstore_crashseal(const int iPoints, std::string &szOutput)
+{
+	constexpr time_t tStart = 1700000000;
+	const std::string szPath = "timeseriesstore_test";
+	auto valuesOf = [](const int point) { return std::vector<double>{ 20.0 + point * 0.1, 0, 50, 1013, 0, 0 }; };
+
+	CTimeSeriesStore store;
+	if (!store.Open(szPath))
+	{
+		szOutput = std_format("cannot open %s", szPath.c_str());
+		return false;
+	}
+	store.Clear();
+	for (int point = 0; point < static_cast<int>(CTimeSeriesStore::iBlockPoints); point++)
+		store.Append("Temperature", 1, tStart + point * 300, valuesOf(point));
+
+	// head records: int64 time + uint8 columns + columns * double, see TimeSeriesStore.h
+	std::ofstream head(szPath + "/Temperature/1.head", std::ios::out | std::ios::binary | std::ios::trunc);
+	for (int point = 0; point < static_cast<int>(CTimeSeriesStore::iBlockPoints); point++)
+	{
+		int64_t tTime = tStart + point * 300;
+		uint8_t columns = 6;
+		std::vector<double> values = valuesOf(point);
+		head.write(reinterpret_cast<const char *>(&tTime), sizeof(tTime));
+		head.write(reinterpret_cast<const char *>(&columns), sizeof(columns));
+		head.write(reinterpret_cast<const char *>(values.data()), values.size() * sizeof(double));
+	}
+	head.close();
+
+	store.Close();
+	store.Open(szPath);
+	for (int point = static_cast<int>(CTimeSeriesStore::iBlockPoints); point < static_cast<int>(CTimeSeriesStore::iBlockPoints) + iPoints; point++)
+		store.Append("Temperature", 1, tStart + point * 300, valuesOf(point));
+
+	int iRead = 0;
+	int iDuplicates = 0;
+	time_t tPrevious = 0;
+	store.Scan("Temperature", 1, tStart, [&](const time_t tTime, const double *, const size_t) {
+		if (tTime <= tPrevious)
+			iDuplicates++;
+		tPrevious = std::max(tTime, tPrevious);
+		iRead++;
+	});
+
+	store.Clear();
+	store.Close();
+	std::remove((szPath + "/Temperature").c_str());
+	std::remove(szPath.c_str());
+
+	szOutput = std_format("points: %d, duplicates: %d", iRead, iDuplicates);
+	return true;
+}
+
+bool timeseriesstore_tester(const std::string szFunction, std::string &szInput, std::string &szOutput)
+{
+	std::vector<std::string> svInputs;
+	StringSplit(szInput, INPUTSEPERATOR, svInputs);
+
+	if ((szFunction == "crashseal") && (svInputs.size() == 1))
+		return timeseriesstore_crashseal(atoi(svInputs[0].c_str()), szOutput);
+	if ((szFunction != "deleterange") || (svInputs.size() != 2))
+	{
+		szOutput = "NOT FOUND!";
+		return false;
+	}
+
+	// a day and an hour of 5 minute temperatures (one sealed block and a head), the points from <first> up to
+	// and including <last> are deleted and the series is read back the way the day graph does
+	constexpr int iPoints = CTimeSeriesStore::iBlockPoints + 12;
+	constexpr time_t tStart = 1700000000;
+	const int iFirst = atoi(svInputs[0].c_str());
+	const int iLast = atoi(svInputs[1].c_str());
+	const std::string szPath = "timeseriesstore_test";
+
+	CTimeSeriesStore store;
+	if (!store.Open(szPath))
+	{
+		szOutput = std_format("cannot open %s", szPath.c_str());
+		return false;
+	}
+	store.Clear();
+	for (int point = 0; point < iPoints; point++)
+		store.Append("Temperature", 1, tStart + point * 300, { 20.0 + point * 0.1, 0, 50, 1013, 0, 0 });
+	store.Append("Temperature", 2, tStart, { 20.0, 0, 50, 1013, 0, 0 });
+
+	store.RemoveRange(1, tStart + iFirst * 300, tStart + iLast * 300);
+
+	int iRead = 0;
+	int iDeletedRead = 0;
+	bool bInOrder = true;
+	time_t tPrevious = 0;
+	store.Scan("Temperature", 1, tStart, [&](const time_t tTime, const double *values, const size_t columns) {
+		int point = static_cast<int>((tTime - tStart) / 300);
+		if ((point >= iFirst) && (point <= iLast))
+			iDeletedRead++;
+		bInOrder = bInOrder && (tTime > tPrevious) && (columns == 6) && (values[0] == 20.0 + point * 0.1);
+		tPrevious = tTime;
+		iRead++;
+	});
+	int iOther = 0;
+	store.Scan("Temperature", 2, tStart, [&](const time_t, const double *, const size_t) { iOther++; });
+
+	// points appended after the delete go on from the rewritten series
+	store.Append("Temperature", 1, tStart + iPoints * 300, { 20.0 + iPoints * 0.1, 0, 50, 1013, 0, 0 });
+	int iAfterAppend = 0;
+	store.Scan("Temperature", 1, tStart, [&](const time_t, const double *, const size_t) { iAfterAppend++; });
+
+	store.Clear();
+	store.Close();
+	std::remove((szPath + "/Temperature").c_str());
+	std::remove(szPath.c_str());
+
+	szOutput = std_format("points: %d, deleted points read: %d", iRead, iDeletedRead);
+	return (iDeletedRead == 0) && bInOrder && (iOther == 1) && (iAfterAppend == iRead + 1);
+}
+
+/* **********
+CameraFeed.cpp
+********** */
+bool camerafeed_tester(const std::string szFunction, std::string &szInput, std::string &szOutput)
+{
+	std::vector<std::string> svInputs;
+	StringSplit(szInput, INPUTSEPERATOR, svInputs);
+
+	if ((szFunction != "relay") || (svInputs.size() != 3))
+	{
+		szOutput = "NOT FOUND!";
+		return false;
+	}
+
+	// the viewers read frames through the relay at the same time, each asks for a frame newer than the
+	// one it has (max age 0). The stand-in camera numbers its frames ("frame <n>"), every viewer should
+	// get increasing numbers out of the one stream, without a snapshot fetch
+	const std::string szURL = svInputs[0];
+	const int iViewers = atoi(svInputs[1].c_str());
+	const int iFrames = atoi(svInputs[2].c_str());
+	std::atomic<int> iFetches{ 0 };
+	CCameraFeed feed(
+		"relay test",
+		[&](std::vector<unsigned char> &) {
+			iFetches++;
+			return false;
+		},
+		szURL);
+
+	std::vector<std::vector<CCameraFeed::frame_t>> viewerFrames(iViewers);
+	std::vector<std::thread> viewers;
+	for (int ii = 0; ii < iViewers; ii++)
+	{
+		viewers.emplace_back([&, ii] {
+			for (int jj = 0; jj < iFrames; jj++)
+				viewerFrames[ii].push_back(feed.GetFrame(0, true));
+		});
+	}
+	for (auto &viewer : viewers)
+		viewer.join();
+	feed.StopRelay();
+
+	int iReceived = 0;
+	int iSuccessive = 0;
+	for (const auto &frames : viewerFrames)
+	{
+		int iPrevious = 0;
+		for (const auto &frame : frames)
+		{
+			if (!frame)
+				continue;
+			iReceived++;
+			const std::string szFrame(frame->begin(), frame->end());
+			const size_t pos = szFrame.find("frame ");
+			const int iNumber = (pos != std::string::npos) ? atoi(szFrame.c_str() + pos + 6) : 0;
+			if (iNumber > iPrevious)
+				iSuccessive++;
+			iPrevious = iNumber;
+		}
+	}
+
+	szOutput = std_format("frames: %d, successive frames: %d, snapshot fetches: %d", iReceived, iSuccessive, iFetches.load());
+	return (iReceived == iViewers * iFrames) && (iSuccessive == iReceived) && (iFetches == 0);
+}
+
 /* **********
 Main function
 ********** */
@@ -317,9 +995,25 @@ int main(int argc, char**argv)
 			return 1;
 		}
 	}
-	else if (false)
+	else if (szTestModule == "calendarrollup")
+	{
+		bSuccess = calendarrollup_tester(szTestFunction, szTestInput, szTestOutput);
+	}
+	else if (szTestModule == "rfxnames")
+	{
+		bSuccess = rfxnames_tester(szTestFunction, szTestInput, szTestOutput);
+	}
+	else if (szTestModule == "meterstore")
+	{
+		bSuccess = meterstore_tester(szTestFunction, szTestInput, szTestOutput);
+	}
+	else if (szTestModule == "timeseriesstore")
+	{
+		bSuccess = timeseriesstore_tester(szTestFunction, szTestInput, szTestOutput);
+	}
+	else if (szTestModule == "camerafeed")
 	{
-		/* code */
+		bSuccess = camerafeed_tester(szTestFunction, szTestInput, szTestOutput);
 	}
 	else
 	{
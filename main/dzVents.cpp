@@ -12,6 +12,8 @@
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
 #include "../webserver/Base64.h"
+#include <sys/stat.h>
+#include <unordered_set>
 
 extern "C" {
 #include <lua.h>
@@ -76,6 +78,8 @@ void CdzVents::EvaluateDzVents(lua_State* lua_state, const std::vector<CEventSys
 
 	ExportDomoticzDataToLua(lua_state, items);
 	SetGlobalVariables(lua_state, reasonTime, secStatus);
+	ExportScriptManifest(lua_state);
+	m_storage.Register(lua_state);
 
 	if (reasonURL)
 		ProcessHttpResponse(lua_state, items);
@@ -87,6 +91,113 @@ void CdzVents::EvaluateDzVents(lua_State* lua_state, const std::vector<CEventSys
 		ProcessNotification(lua_state, items);
 }
 
+void CdzVents::InvalidateScriptManifest()
+{
+	std::lock_guard<std::mutex> l(m_manifestMutex);
+	m_scriptCache.clear();
+}
+
+namespace
+{
+	int WriteChunk(lua_State* /*lua_state*/, const void* p, size_t sz, void* ud)
+	{
+		static_cast<std::string*>(ud)->append(static_cast<const char*>(p), sz);
+		return 0;
+	}
+} // namespace
+
+void CdzVents::ScanScriptFolder(const std::string& dir, const std::string& type, std::map<std::string, _tScriptFile>& scripts)
+{
+	std::vector<std::string> files;
+	DirectoryListing(files, dir, false, true);
+	std::sort(files.begin(), files.end());
+
+	for (const auto& file : files)
+	{
+		if ((file.size() <= 4) || (file[0] == '.') || !std_ends_with(file, ".lua"))
+			continue;
+
+		_tScriptFile script;
+		script.name = file.substr(0, file.size() - 4);
+		script.type = type;
+		script.path = dir + file;
+		struct stat st;
+		if (stat(script.path.c_str(), &st) == 0)
+		{
+			script.mtime = st.st_mtime;
+			script.size = static_cast<int64_t>(st.st_size);
+		}
+
+		auto itt = m_scriptCache.find(script.path);
+		if ((itt != m_scriptCache.end()) && (itt->second.mtime == script.mtime) && (itt->second.size == script.size))
+		{
+			// unchanged, keep the compiled chunk
+			script.bytecode = itt->second.bytecode;
+		}
+		else
+		{
+			std::ifstream is(script.path, std::ios::in | std::ios::binary);
+			std::string source((std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>());
+			lua_State* lua_state = luaL_newstate();
+			std::string chunkname = "@" + script.path;
+			if (luaL_loadbufferx(lua_state, source.c_str(), source.size(), chunkname.c_str(), "t") == LUA_OK)
+				lua_dump(lua_state, WriteChunk, &script.bytecode, 0);
+			lua_close(lua_state);
+			_log.Debug(DEBUG_EVENTSYSTEM, "dzVents: (re)compiled %s", script.path.c_str());
+		}
+		scripts[script.path] = script;
+	}
+}
+
+// Lists the script folders without spawning a shell (readdir + stat), only changed files are compiled again
+void CdzVents::RefreshScriptManifest()
+{
+	std::map<std::string, _tScriptFile> scripts;
+	ScanScriptFolder(m_scriptsDir, "external", scripts);
+	ScanScriptFolder(m_generatedScriptsDir, "internal", scripts);
+
+	m_scriptManifest.clear();
+	for (const auto& type : { "external", "internal" })
+	{
+		for (const auto& script : scripts)
+		{
+			if (script.second.type == type)
+				m_scriptManifest.push_back(script.second);
+		}
+	}
+	m_scriptCache = std::move(scripts);
+}
+
+// Publishes the manifest as scriptManifest = { { name, type, path, mtime, chunk }, ... }
+// chunk is the loaded precompiled script, the runtime uses it in place of reading and parsing the file again
+void CdzVents::ExportScriptManifest(lua_State* lua_state)
+{
+	std::lock_guard<std::mutex> l(m_manifestMutex);
+	RefreshScriptManifest();
+
+	lua_createtable(lua_state, static_cast<int>(m_scriptManifest.size()), 0);
+	int index = 1;
+	for (const auto& script : m_scriptManifest)
+	{
+		lua_createtable(lua_state, 0, 5);
+		lua_pushstring(lua_state, script.name.c_str());
+		lua_setfield(lua_state, -2, "name");
+		lua_pushstring(lua_state, script.type.c_str());
+		lua_setfield(lua_state, -2, "type");
+		lua_pushstring(lua_state, script.path.c_str());
+		lua_setfield(lua_state, -2, "path");
+		lua_pushinteger(lua_state, static_cast<lua_Integer>(script.mtime));
+		lua_setfield(lua_state, -2, "mtime");
+		std::string chunkname = "@" + script.path;
+		if (!script.bytecode.empty() && (luaL_loadbufferx(lua_state, script.bytecode.c_str(), script.bytecode.size(), chunkname.c_str(), "b") == LUA_OK))
+			lua_setfield(lua_state, -2, "chunk");
+		else if (!script.bytecode.empty())
+			lua_pop(lua_state, 1); // error message
+		lua_rawseti(lua_state, -2, index++);
+	}
+	lua_setglobal(lua_state, "scriptManifest");
+}
+
 void CdzVents::ProcessNotificationItem(CLuaTable& luaTable, int& index, const CEventSystem::_tEventQueue& item)
 {
 	std::string type, status;
@@ -931,34 +1042,46 @@ void CdzVents::ExportDomoticzDataToLua(lua_State* lua_state, const std::vector<C
 
 	CLuaTable luaTable(lua_state, "domoticzData");
 
+	// Devices that triggered this run are exported with the values of their events
+	std::unordered_set<uint64_t> changedDevices;
+	for (const auto& item : items)
+	{
+		if (item.reason == m_mainworker.m_eventsystem.REASON_DEVICE)
+			changedDevices.insert(item.id);
+	}
+	CEventSystem::_tDeviceStatus changedItem;
+	std::vector<std::string_view> strarray;
+
 	// First export all the devices.
 	for (const auto& state : m_mainworker.m_eventsystem.m_devicestates)
 	{
-		CEventSystem::_tDeviceStatus sitem = state.second;
-		const char* dev_type = RFX_Type_Desc(sitem.devType, 1);
-		const char* sub_type = RFX_Type_SubType_Desc(sitem.devType, sitem.subType);
-
-		bool triggerDevice = false;
-		for (const auto& item : items)
+		bool triggerDevice = ((state.ID > 0) && (changedDevices.find(state.ID) != changedDevices.end()));
+		if (triggerDevice)
 		{
-			if (sitem.ID > 0 && sitem.ID == item.id && item.reason == m_mainworker.m_eventsystem.REASON_DEVICE)
+			changedItem = state;
+			for (const auto& item : items)
 			{
-				triggerDevice = true;
-				sitem.lastUpdate = item.lastUpdate;
-				sitem.lastLevel = item.lastLevel;
-				sitem.sValue = item.sValue;
-				sitem.nValueWording = item.nValueWording;
-				sitem.nValue = item.nValue;
-				if (!item.JsonMapString.empty())
-					sitem.JsonMapString = item.JsonMapString;
-				if (!item.JsonMapFloat.empty())
-					sitem.JsonMapFloat = item.JsonMapFloat;
-				if (!item.JsonMapInt.empty())
-					sitem.JsonMapInt = item.JsonMapInt;
-				if (!item.JsonMapBool.empty())
-					sitem.JsonMapBool = item.JsonMapBool;
+				if (state.ID == item.id && item.reason == m_mainworker.m_eventsystem.REASON_DEVICE)
+				{
+					changedItem.lastUpdate = item.lastUpdate;
+					changedItem.lastLevel = item.lastLevel;
+					changedItem.sValue = item.sValue;
+					changedItem.nValueWording = item.nValueWording;
+					changedItem.nValue = item.nValue;
+					if (!item.JsonMapString.empty())
+						changedItem.JsonMapString = item.JsonMapString;
+					if (!item.JsonMapFloat.empty())
+						changedItem.JsonMapFloat = item.JsonMapFloat;
+					if (!item.JsonMapInt.empty())
+						changedItem.JsonMapInt = item.JsonMapInt;
+					if (!item.JsonMapBool.empty())
+						changedItem.JsonMapBool = item.JsonMapBool;
+				}
 			}
 		}
+		const CEventSystem::_tDeviceStatus& sitem = (triggerDevice) ? changedItem : state;
+		const char* dev_type = RFX_Type_Desc(sitem.devType, 1);
+		const char* sub_type = RFX_Type_SubType_Desc(sitem.devType, sitem.subType);
 
 		ParseSQLdatetime(checktime, ntime, sitem.lastUpdate, tm1.tm_isdst);
 		bool timed_out = (now - checktime >= SensorTimeOut * 60);
@@ -982,12 +1105,11 @@ void CdzVents::ExportDomoticzDataToLua(lua_State* lua_state, const std::vector<C
 			luaTable.AddBool("timedOut", timed_out);
 
 			//get all svalues separate
-			std::vector<std::string> strarray;
 			StringSplit(sitem.sValue, ";", strarray);
 
 			luaTable.OpenSubTableEntry("rawData", 0, 0);
 			for (size_t i = 0; i < strarray.size(); i++)
-				luaTable.AddString(i + 1, strarray[i]);
+				luaTable.AddString(i + 1, std::string(strarray[i]));
 
 			luaTable.CloseSubTableEntry();
 
@@ -1002,13 +1124,13 @@ void CdzVents::ExportDomoticzDataToLua(lua_State* lua_state, const std::vector<C
 			luaTable.AddInteger("hardwareID", sitem.hardwareID);
 			if (sitem.devType == pTypeGeneral && sitem.subType == sTypeKwh)
 			{
-				long double value = 0.0F;
+				double value = 0.0F;
 				if (strarray.size() > 1)
-					value = atof(strarray[1].c_str());
+					StringToDouble(strarray[1], value);
 				luaTable.AddNumber("whTotal", value);
 				value = 0.0F;
 				if (!strarray.empty())
-					value = atof(strarray[0].c_str());
+					StringToDouble(strarray[0], value);
 				luaTable.AddNumber("whActual", value);
 			}
 
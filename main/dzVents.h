@@ -1,6 +1,8 @@
 #pragma once
 #include "EventSystem.h"
 #include "LuaTable.h"
+#include "dzVentsStorage.h"
+#include <mutex>
 
 class CdzVents
 {
@@ -15,9 +17,12 @@ public:
 	void LoadEvents();
 	bool processLuaCommand(lua_State* lua_state, const std::string& filename, const int tIndex);
 	void EvaluateDzVents(lua_State* lua_state, const std::vector<CEventSystem::_tEventQueue>& items, const int secStatus);
+	// forces a full rescan and recompile of the script files on the next run (generated scripts are rewritten by LoadEvents)
+	void InvalidateScriptManifest();
 
-	std::string m_scriptsDir, m_dataDir, m_runtimeDir;
+	std::string m_scriptsDir, m_generatedScriptsDir, m_dataDir, m_runtimeDir;
 	bool m_bdzVentsExist;
+	CdzVentsStorage m_storage;
 
 private:
 	enum _eType
@@ -28,6 +33,16 @@ private:
 		TYPE_FLOAT,     // 3
 		TYPE_BOOLEAN    // 4
 	};
+	// A dzVents script file as seen by the runtime, compiled once and reused until the file changes
+	struct _tScriptFile
+	{
+		std::string name; // module name, file name without .lua
+		std::string type; // "external" (scripts folder) or "internal" (generated_scripts)
+		std::string path;
+		time_t mtime = 0;
+		int64_t size = 0;
+		std::string bytecode; // empty when the file does not compile, the runtime require then reports the error
+	};
 	struct _tLuaTableValues
 	{
 		_eType type;
@@ -56,7 +71,14 @@ private:
 	void ProcessSecurity(lua_State* lua_state, const std::vector<CEventSystem::_tEventQueue>& items);
 	void ProcessNotification(lua_State* lua_state, const std::vector<CEventSystem::_tEventQueue>& items);
 	void ProcessNotificationItem(CLuaTable& luaTable, int& index, const CEventSystem::_tEventQueue& item);
+	void RefreshScriptManifest();
+	void ScanScriptFolder(const std::string& dir, const std::string& type, std::map<std::string, _tScriptFile>& scripts);
+	void ExportScriptManifest(lua_State* lua_state);
 	static int l_domoticz_print(lua_State* lua_state);
 	static CdzVents m_dzvents;
 	std::string m_version;
+
+	std::mutex m_manifestMutex;
+	std::vector<_tScriptFile> m_scriptManifest; // external scripts first, in directory order
+	std::map<std::string, _tScriptFile> m_scriptCache; // by path
 };
@@ -0,0 +1,684 @@
+#include "stdafx.h"
+#include "dzVentsStorage.h"
+#include "Helper.h"
+#include "Logger.h"
+#include "localtime_r.h"
+#include <cmath>
+#include <cstring>
+#include <sys/stat.h>
+
+extern "C" {
+#include <lua.h>
+#include <lualib.h>
+#include <lauxlib.h>
+}
+
+namespace
+{
+	constexpr uint32_t iLogMagic = 0x4C575A44; // DZWL
+	constexpr uint32_t iRemoved = 0xFFFFFFFF;
+	constexpr int iMaxDepth = 100;
+	constexpr time_t iFlushInterval = 5 * 60;
+	constexpr size_t iMaxLogSize = 4 * 1024 * 1024;
+
+	void PutUInt32(std::string &out, const uint32_t value)
+	{
+		out.append(reinterpret_cast<const char *>(&value), sizeof(value));
+	}
+
+	bool GetUInt32(const char *&pData, const char *pEnd, uint32_t &value)
+	{
+		if (pEnd - pData < static_cast<ptrdiff_t>(sizeof(value)))
+			return false;
+		memcpy(&value, pData, sizeof(value));
+		pData += sizeof(value);
+		return true;
+	}
+} // namespace
+
+CdzVentsStorage::~CdzVentsStorage()
+{
+	if (m_fLog != nullptr)
+		fclose(m_fLog);
+}
+
+void CdzVentsStorage::Open(const std::string &szDataFolder)
+{
+	std::lock_guard<std::mutex> l(m_mutex);
+	std::string szLogFile = szDataFolder + "__storage.wal";
+	if ((m_fLog != nullptr) && (szLogFile == m_szLogFile))
+		return;
+	if (m_fLog != nullptr)
+	{
+		for (auto &entry : m_entries)
+		{
+			if (entry.second.bDirty)
+				WriteFile(entry.second);
+		}
+		fclose(m_fLog);
+		m_fLog = nullptr;
+	}
+	m_entries.clear();
+	m_szLogFile = szLogFile;
+	ReplayLog();
+
+	// the replayed data is written to the data files, after that the log can start empty
+	bool bOK = true;
+	for (auto &entry : m_entries)
+	{
+		if (entry.second.bDirty)
+			bOK = WriteFile(entry.second) && bOK;
+	}
+	m_fLog = fopen(m_szLogFile.c_str(), bOK ? "wb" : "ab");
+	if (m_fLog == nullptr)
+		_log.Log(LOG_ERROR, "dzVents: Cannot open %s, persistent data is written directly to the data files", m_szLogFile.c_str());
+	m_logSize = 0;
+	m_tLastFlush = mytime(nullptr);
+}
+
+void CdzVentsStorage::Flush(const bool bForce)
+{
+	std::lock_guard<std::mutex> l(m_mutex);
+	time_t tNow = mytime(nullptr);
+	if (!bForce && (tNow - m_tLastFlush < iFlushInterval) && (m_logSize < iMaxLogSize))
+		return;
+	m_tLastFlush = tNow;
+
+	bool bOK = true;
+	for (auto &entry : m_entries)
+	{
+		if (entry.second.bDirty)
+			bOK = WriteFile(entry.second) && bOK;
+	}
+	if (bOK && (m_fLog != nullptr) && (m_logSize != 0))
+	{
+		fclose(m_fLog);
+		m_fLog = fopen(m_szLogFile.c_str(), "wb");
+		m_logSize = 0;
+	}
+}
+
+void CdzVentsStorage::Register(lua_State *lua_state)
+{
+	static const luaL_Reg functions[] = {
+		{ "load", l_load },
+		{ "store", l_store },
+		{ "aggregate", l_aggregate },
+		{ nullptr, nullptr },
+	};
+	lua_createtable(lua_state, 0, 3);
+	lua_pushlightuserdata(lua_state, this);
+	luaL_setfuncs(lua_state, functions, 1);
+	lua_setglobal(lua_state, "dzStorage");
+}
+
+// dzStorage.load(path) : true + data, false when there is no data file yet, nil when the runtime has to load the file itself
+int CdzVentsStorage::l_load(lua_State *lua_state)
+{
+	auto storage = static_cast<CdzVentsStorage *>(lua_touserdata(lua_state, lua_upvalueindex(1)));
+	std::string path = luaL_checkstring(lua_state, 1);
+	int result = storage->Load(lua_state, path);
+	if (result == 1)
+	{
+		lua_pushboolean(lua_state, 1);
+		lua_insert(lua_state, -2);
+		return 2;
+	}
+	if (result == 0)
+		lua_pushboolean(lua_state, 0);
+	else
+		lua_pushnil(lua_state);
+	return 1;
+}
+
+// dzStorage.store(path, data) : false when the runtime has to write the file itself
+int CdzVentsStorage::l_store(lua_State *lua_state)
+{
+	auto storage = static_cast<CdzVentsStorage *>(lua_touserdata(lua_state, lua_upvalueindex(1)));
+	std::string path = luaL_checkstring(lua_state, 1);
+	lua_pushboolean(lua_state, storage->Store(lua_state, 2, path));
+	return 1;
+}
+
+// dzStorage.aggregate(items, from, to) : sum, count, index of the minimum, index of the maximum of items[from..to].data
+// Follows the Lua reduce in HistoricalStorage (integer sum while all values are integers, first minimum/maximum wins),
+// returns nothing when an item has no number so the runtime can report it
+int CdzVentsStorage::l_aggregate(lua_State *lua_state)
+{
+	luaL_checktype(lua_state, 1, LUA_TTABLE);
+	lua_Integer from = luaL_checkinteger(lua_state, 2);
+	lua_Integer to = luaL_checkinteger(lua_state, 3);
+
+	bool bIntSum = true;
+	uint64_t iSum = 0; // wraps like Lua integers
+	double dSum = 0;
+	lua_Integer count = 0;
+	lua_Integer minIndex = 0, maxIndex = 0;
+	bool bMinInt = false, bMaxInt = false;
+	lua_Integer iMin = 0, iMax = 0;
+	double dMin = 0, dMax = 0;
+
+	for (lua_Integer ii = from; ii <= to; ii++)
+	{
+		if (lua_rawgeti(lua_state, 1, ii) != LUA_TTABLE)
+			return 0;
+		if (lua_getfield(lua_state, -1, "data") != LUA_TNUMBER)
+			return 0;
+		bool bInt = lua_isinteger(lua_state, -1);
+		lua_Integer iValue = bInt ? lua_tointeger(lua_state, -1) : 0;
+		double dValue = lua_tonumber(lua_state, -1);
+		lua_pop(lua_state, 2);
+
+		if (bIntSum && bInt)
+			iSum += static_cast<uint64_t>(iValue);
+		else
+		{
+			if (bIntSum)
+			{
+				dSum = static_cast<double>(static_cast<lua_Integer>(iSum));
+				bIntSum = false;
+			}
+			dSum += dValue;
+		}
+
+		auto less = [](bool bIntA, lua_Integer iA, double dA, bool bIntB, lua_Integer iB, double dB) {
+			return (bIntA && bIntB) ? (iA < iB) : (dA < dB);
+		};
+		if ((count == 0) || less(bInt, iValue, dValue, bMinInt, iMin, dMin))
+		{
+			minIndex = ii;
+			bMinInt = bInt;
+			iMin = iValue;
+			dMin = dValue;
+		}
+		if ((count == 0) || less(bMaxInt, iMax, dMax, bInt, iValue, dValue))
+		{
+			maxIndex = ii;
+			bMaxInt = bInt;
+			iMax = iValue;
+			dMax = dValue;
+		}
+		count++;
+	}
+	if (bIntSum)
+		lua_pushinteger(lua_state, static_cast<lua_Integer>(iSum));
+	else
+		lua_pushnumber(lua_state, dSum);
+	lua_pushinteger(lua_state, count);
+	lua_pushinteger(lua_state, minIndex);
+	lua_pushinteger(lua_state, maxIndex);
+	return 4;
+}
+
+int CdzVentsStorage::Load(lua_State *lua_state, const std::string &path)
+{
+	std::lock_guard<std::mutex> l(m_mutex);
+	std::string key = Key(path);
+	struct stat st;
+	bool bExists = (stat(path.c_str(), &st) == 0);
+
+	auto itt = m_entries.find(key);
+	if ((itt != m_entries.end()) && !itt->second.bDirty)
+	{
+		// changed or removed outside of domoticz since we last read or wrote it
+		if (!bExists || (st.st_mtime != itt->second.mtime) || (static_cast<int64_t>(st.st_size) != itt->second.size))
+		{
+			m_entries.erase(itt);
+			itt = m_entries.end();
+		}
+	}
+	if (itt == m_entries.end())
+	{
+		if (!bExists)
+			return 0;
+		_tEntry entry;
+		entry.path = path;
+		if (!ReadFile(path, entry.value))
+			return -1;
+		entry.mtime = st.st_mtime;
+		entry.size = static_cast<int64_t>(st.st_size);
+		itt = m_entries.insert(std::make_pair(key, std::move(entry))).first;
+	}
+	ToLua(lua_state, itt->second.value);
+	return 1;
+}
+
+bool CdzVentsStorage::Store(lua_State *lua_state, const int index, const std::string &path)
+{
+	std::lock_guard<std::mutex> l(m_mutex);
+	if (m_fLog == nullptr)
+		return false;
+
+	std::string key = Key(path);
+	_tValue value;
+	std::set<const void *> seen;
+	if (!lua_istable(lua_state, index) || !FromLua(lua_state, index, value, seen, 0))
+	{
+		// the runtime writes this one itself, make sure an older copy does not come back from the log
+		auto itt = m_entries.find(key);
+		if (itt != m_entries.end())
+		{
+			AppendLog(key, path, nullptr);
+			m_entries.erase(itt);
+		}
+		return false;
+	}
+
+	_tEntry &entry = m_entries[key];
+	entry.path = path;
+	entry.value = std::move(value);
+	entry.bDirty = true;
+	AppendLog(key, path, &entry.value);
+	if (m_fLog == nullptr)
+		return WriteFile(entry);
+
+	if ((m_logSize >= iMaxLogSize) || (mytime(nullptr) - m_tLastFlush >= iFlushInterval))
+	{
+		m_tLastFlush = mytime(nullptr);
+		bool bOK = true;
+		for (auto &itt : m_entries)
+		{
+			if (itt.second.bDirty)
+				bOK = WriteFile(itt.second) && bOK;
+		}
+		if (bOK)
+		{
+			fclose(m_fLog);
+			m_fLog = fopen(m_szLogFile.c_str(), "wb");
+			m_logSize = 0;
+		}
+	}
+	return true;
+}
+
+bool CdzVentsStorage::ReadFile(const std::string &path, _tValue &value)
+{
+	// data files are plain table constructors, no libraries needed
+	lua_State *lua_state = luaL_newstate();
+	bool bOK = false;
+	if ((luaL_loadfilex(lua_state, path.c_str(), "t") == LUA_OK) && (lua_pcall(lua_state, 0, 1, 0) == LUA_OK) && lua_istable(lua_state, -1))
+	{
+		std::set<const void *> seen;
+		bOK = FromLua(lua_state, -1, value, seen, 0);
+	}
+	lua_close(lua_state);
+	return bOK;
+}
+
+bool CdzVentsStorage::WriteFile(_tEntry &entry)
+{
+	std::string source = "-- Persistent Data\nlocal multiRefObjects = {\n\n} -- multiRefObjects\nlocal obj1 = ";
+	WriteLuaSource(entry.value, source, 0);
+	source += "\nreturn obj1\n";
+
+	std::string tmpFile = entry.path + ".tmp";
+	FILE *fOut = fopen(tmpFile.c_str(), "wb");
+	if (fOut == nullptr)
+	{
+		_log.Log(LOG_ERROR, "dzVents: Cannot write %s", tmpFile.c_str());
+		return false;
+	}
+	bool bOK = (fwrite(source.data(), 1, source.size(), fOut) == source.size());
+	bOK = (fclose(fOut) == 0) && bOK;
+#ifdef WIN32
+	std::remove(entry.path.c_str());
+#endif
+	if (!bOK || (std::rename(tmpFile.c_str(), entry.path.c_str()) != 0))
+	{
+		_log.Log(LOG_ERROR, "dzVents: Cannot write %s", entry.path.c_str());
+		std::remove(tmpFile.c_str());
+		return false;
+	}
+	struct stat st;
+	if (stat(entry.path.c_str(), &st) == 0)
+	{
+		entry.mtime = st.st_mtime;
+		entry.size = static_cast<int64_t>(st.st_size);
+	}
+	entry.bDirty = false;
+	return true;
+}
+
+void CdzVentsStorage::AppendLog(const std::string &key, const std::string &path, const _tValue *value)
+{
+	if (m_fLog == nullptr)
+		return;
+	std::string record;
+	PutUInt32(record, iLogMagic);
+	PutUInt32(record, static_cast<uint32_t>(path.size()));
+	record += path;
+	size_t valueStart = record.size();
+	PutUInt32(record, iRemoved);
+	if (value != nullptr)
+	{
+		Encode(*value, record);
+		uint32_t valueSize = static_cast<uint32_t>(record.size() - valueStart - sizeof(uint32_t));
+		memcpy(&record[valueStart], &valueSize, sizeof(valueSize));
+	}
+	PutUInt32(record, Crc32(0, reinterpret_cast<const uint8_t *>(record.data() + sizeof(uint32_t)), record.size() - sizeof(uint32_t)));
+
+	if ((fwrite(record.data(), 1, record.size(), m_fLog) != record.size()) || (fflush(m_fLog) != 0))
+	{
+		_log.Log(LOG_ERROR, "dzVents: Cannot write %s, persistent data is written directly to the data files", m_szLogFile.c_str());
+		fclose(m_fLog);
+		m_fLog = nullptr;
+		return;
+	}
+	m_logSize += record.size();
+}
+
+void CdzVentsStorage::ReplayLog()
+{
+	FILE *fIn = fopen(m_szLogFile.c_str(), "rb");
+	if (fIn == nullptr)
+		return;
+	std::string content;
+	char buffer[16384];
+	size_t bytes;
+	while ((bytes = fread(buffer, 1, sizeof(buffer), fIn)) > 0)
+		content.append(buffer, bytes);
+	fclose(fIn);
+
+	const char *pData = content.data();
+	const char *pEnd = pData + content.size();
+	int records = 0;
+	while (pData < pEnd)
+	{
+		// a record that was not completely written ends the log
+		const char *pRecord = pData;
+		uint32_t magic, pathSize, valueSize, crc;
+		if (!GetUInt32(pData, pEnd, magic) || (magic != iLogMagic) || !GetUInt32(pData, pEnd, pathSize) || (pEnd - pData < static_cast<ptrdiff_t>(pathSize)))
+			break;
+		std::string path(pData, pathSize);
+		pData += pathSize;
+		if (!GetUInt32(pData, pEnd, valueSize))
+			break;
+		const char *pValue = pData;
+		if (valueSize != iRemoved)
+		{
+			if (pEnd - pData < static_cast<ptrdiff_t>(valueSize))
+				break;
+			pData += valueSize;
+		}
+		size_t checked = pData - pRecord - sizeof(uint32_t);
+		if (!GetUInt32(pData, pEnd, crc) || (crc != Crc32(0, reinterpret_cast<const uint8_t *>(pRecord + sizeof(uint32_t)), checked)))
+			break;
+
+		std::string key = Key(path);
+		if (valueSize == iRemoved)
+		{
+			m_entries.erase(key);
+		}
+		else
+		{
+			_tValue value;
+			if (!Decode(pValue, pValue + valueSize, value, 0))
+				break;
+			_tEntry &entry = m_entries[key];
+			entry.path = path;
+			entry.value = std::move(value);
+			entry.bDirty = true;
+		}
+		records++;
+	}
+	if (records != 0)
+		_log.Log(LOG_STATUS, "dzVents: Recovered %d persistent data update(s) from %s", records, m_szLogFile.c_str());
+}
+
+std::string CdzVentsStorage::Key(const std::string &path)
+{
+	std::string key = path;
+	std::replace(key.begin(), key.end(), '\\', '/');
+	return key;
+}
+
+bool CdzVentsStorage::FromLua(lua_State *lua_state, int index, _tValue &value, std::set<const void *> &seen, const int depth)
+{
+	index = lua_absindex(lua_state, index);
+	switch (lua_type(lua_state, index))
+	{
+	case LUA_TNIL:
+		value.type = _tValue::TYPE_NIL;
+		return true;
+	case LUA_TBOOLEAN:
+		value.type = _tValue::TYPE_BOOLEAN;
+		value.bValue = (lua_toboolean(lua_state, index) != 0);
+		return true;
+	case LUA_TNUMBER:
+		if (lua_isinteger(lua_state, index))
+		{
+			value.type = _tValue::TYPE_INTEGER;
+			value.iValue = lua_tointeger(lua_state, index);
+		}
+		else
+		{
+			value.type = _tValue::TYPE_NUMBER;
+			value.dValue = lua_tonumber(lua_state, index);
+		}
+		return true;
+	case LUA_TSTRING:
+	{
+		size_t len;
+		const char *str = lua_tolstring(lua_state, index, &len);
+		value.type = _tValue::TYPE_STRING;
+		value.sValue.assign(str, len);
+		return true;
+	}
+	case LUA_TTABLE:
+		break;
+	default:
+		return false;
+	}
+
+	// a table referenced twice would be stored as two copies
+	if ((depth >= iMaxDepth) || !seen.insert(lua_topointer(lua_state, index)).second || !lua_checkstack(lua_state, 4))
+		return false;
+	value.type = _tValue::TYPE_TABLE;
+	lua_pushnil(lua_state);
+	while (lua_next(lua_state, index) != 0)
+	{
+		int keyType = lua_type(lua_state, -2);
+		int valueType = lua_type(lua_state, -1);
+		if ((keyType != LUA_TBOOLEAN) && (keyType != LUA_TNUMBER) && (keyType != LUA_TSTRING))
+		{
+			lua_pop(lua_state, 2);
+			return false;
+		}
+		if ((valueType == LUA_TFUNCTION) || (valueType == LUA_TUSERDATA) || (valueType == LUA_TLIGHTUSERDATA) || (valueType == LUA_TTHREAD))
+		{
+			// persistence.lua stores these as nil
+			lua_pop(lua_state, 1);
+			continue;
+		}
+		value.keys.emplace_back();
+		value.values.emplace_back();
+		if (!FromLua(lua_state, -2, value.keys.back(), seen, depth + 1) || !FromLua(lua_state, -1, value.values.back(), seen, depth + 1))
+		{
+			lua_pop(lua_state, 2);
+			return false;
+		}
+		lua_pop(lua_state, 1);
+	}
+	return true;
+}
+
+void CdzVentsStorage::ToLua(lua_State *lua_state, const _tValue &value)
+{
+	switch (value.type)
+	{
+	case _tValue::TYPE_BOOLEAN:
+		lua_pushboolean(lua_state, value.bValue ? 1 : 0);
+		break;
+	case _tValue::TYPE_INTEGER:
+		lua_pushinteger(lua_state, static_cast<lua_Integer>(value.iValue));
+		break;
+	case _tValue::TYPE_NUMBER:
+		lua_pushnumber(lua_state, value.dValue);
+		break;
+	case _tValue::TYPE_STRING:
+		lua_pushlstring(lua_state, value.sValue.data(), value.sValue.size());
+		break;
+	case _tValue::TYPE_TABLE:
+		lua_checkstack(lua_state, 3);
+		lua_createtable(lua_state, 0, static_cast<int>(value.keys.size()));
+		for (size_t ii = 0; ii < value.keys.size(); ii++)
+		{
+			ToLua(lua_state, value.keys[ii]);
+			ToLua(lua_state, value.values[ii]);
+			lua_rawset(lua_state, -3);
+		}
+		break;
+	default:
+		lua_pushnil(lua_state);
+		break;
+	}
+}
+
+void CdzVentsStorage::Encode(const _tValue &value, std::string &out)
+{
+	out += static_cast<char>(value.type);
+	switch (value.type)
+	{
+	case _tValue::TYPE_BOOLEAN:
+		out += value.bValue ? '\1' : '\0';
+		break;
+	case _tValue::TYPE_INTEGER:
+		out.append(reinterpret_cast<const char *>(&value.iValue), sizeof(value.iValue));
+		break;
+	case _tValue::TYPE_NUMBER:
+		out.append(reinterpret_cast<const char *>(&value.dValue), sizeof(value.dValue));
+		break;
+	case _tValue::TYPE_STRING:
+		PutUInt32(out, static_cast<uint32_t>(value.sValue.size()));
+		out += value.sValue;
+		break;
+	case _tValue::TYPE_TABLE:
+		PutUInt32(out, static_cast<uint32_t>(value.keys.size()));
+		for (size_t ii = 0; ii < value.keys.size(); ii++)
+		{
+			Encode(value.keys[ii], out);
+			Encode(value.values[ii], out);
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+bool CdzVentsStorage::Decode(const char *&pData, const char *pEnd, _tValue &value, const int depth)
+{
+	if ((pData >= pEnd) || (depth > iMaxDepth))
+		return false;
+	value.type = static_cast<_tValue::_eType>(*pData++);
+	uint32_t size;
+	switch (value.type)
+	{
+	case _tValue::TYPE_NIL:
+		return true;
+	case _tValue::TYPE_BOOLEAN:
+		if (pData >= pEnd)
+			return false;
+		value.bValue = (*pData++ != 0);
+		return true;
+	case _tValue::TYPE_INTEGER:
+		if (pEnd - pData < static_cast<ptrdiff_t>(sizeof(value.iValue)))
+			return false;
+		memcpy(&value.iValue, pData, sizeof(value.iValue));
+		pData += sizeof(value.iValue);
+		return true;
+	case _tValue::TYPE_NUMBER:
+		if (pEnd - pData < static_cast<ptrdiff_t>(sizeof(value.dValue)))
+			return false;
+		memcpy(&value.dValue, pData, sizeof(value.dValue));
+		pData += sizeof(value.dValue);
+		return true;
+	case _tValue::TYPE_STRING:
+		if (!GetUInt32(pData, pEnd, size) || (pEnd - pData < static_cast<ptrdiff_t>(size)))
+			return false;
+		value.sValue.assign(pData, size);
+		pData += size;
+		return true;
+	case _tValue::TYPE_TABLE:
+		if (!GetUInt32(pData, pEnd, size) || (pEnd - pData < static_cast<ptrdiff_t>(size) * 2))
+			return false;
+		value.keys.resize(size);
+		value.values.resize(size);
+		for (uint32_t ii = 0; ii < size; ii++)
+		{
+			if (!Decode(pData, pEnd, value.keys[ii], depth + 1) || !Decode(pData, pEnd, value.values[ii], depth + 1))
+				return false;
+		}
+		return true;
+	default:
+		return false;
+	}
+}
+
+// Same layout as persistence.lua, numbers are written with full precision
+void CdzVentsStorage::WriteLuaSource(const _tValue &value, std::string &out, const int level)
+{
+	switch (value.type)
+	{
+	case _tValue::TYPE_BOOLEAN:
+		out += value.bValue ? "true" : "false";
+		break;
+	case _tValue::TYPE_INTEGER:
+		out += std::to_string(value.iValue);
+		break;
+	case _tValue::TYPE_NUMBER:
+		if (std::isnan(value.dValue))
+			out += "0/0";
+		else if (std::isinf(value.dValue))
+			out += (value.dValue > 0) ? "1/0" : "-1/0";
+		else
+		{
+			char szTmp[40];
+			snprintf(szTmp, sizeof(szTmp), "%.17g", value.dValue);
+			out += szTmp;
+			// keep it a float when read back
+			if (strpbrk(szTmp, ".e") == nullptr)
+				out += ".0";
+		}
+		break;
+	case _tValue::TYPE_STRING:
+		out += '"';
+		for (size_t ii = 0; ii < value.sValue.size(); ii++)
+		{
+			unsigned char c = static_cast<unsigned char>(value.sValue[ii]);
+			if ((c == '"') || (c == '\\'))
+			{
+				out += '\\';
+				out += static_cast<char>(c);
+			}
+			else if (c == '\n')
+				out += "\\n";
+			else if ((c < 32) || (c == 127))
+			{
+				char szTmp[8];
+				snprintf(szTmp, sizeof(szTmp), "\\%03d", c);
+				out += szTmp;
+			}
+			else
+				out += static_cast<char>(c);
+		}
+		out += '"';
+		break;
+	case _tValue::TYPE_TABLE:
+		out += "{\n";
+		for (size_t ii = 0; ii < value.keys.size(); ii++)
+		{
+			out.append(level + 1, '\t');
+			out += '[';
+			WriteLuaSource(value.keys[ii], out, level + 1);
+			out += "] = ";
+			WriteLuaSource(value.values[ii], out, level + 1);
+			out += ";\n";
+		}
+		out.append(level, '\t');
+		out += '}';
+		break;
+	default:
+		out += "nil";
+		break;
+	}
+}
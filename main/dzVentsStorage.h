@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstdint>
+#include <ctime>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+struct lua_State;
+
+// Memory resident store for the dzVents persistent data (the data sections of the scripts and global_data)
+//
+// The runtime hands over the data table after every script run. It is kept in memory and appended to a
+// write-ahead log, the data files themselves (same persistence.lua format as before) are only rewritten
+// on Flush, every few minutes or when the log grows too big. At startup the log is replayed so nothing
+// stored since the last flush is lost.
+//
+// Tables that cannot be stored 1:1 (shared or cyclic references, table keys) are refused, the runtime
+// then writes the file itself like it always did.
+//
+// log record : uint32 magic + uint32 path bytes + path + uint32 value bytes (0xFFFFFFFF = removed) + value + uint32 crc32
+class CdzVentsStorage
+{
+public:
+	struct _tValue
+	{
+		enum _eType : uint8_t
+		{
+			TYPE_NIL,
+			TYPE_BOOLEAN,
+			TYPE_INTEGER,
+			TYPE_NUMBER,
+			TYPE_STRING,
+			TYPE_TABLE
+		};
+		_eType type = TYPE_NIL;
+		bool bValue = false;
+		int64_t iValue = 0;
+		double dValue = 0;
+		std::string sValue;
+		std::vector<_tValue> keys;
+		std::vector<_tValue> values;
+	};
+
+	~CdzVentsStorage();
+
+	// opens the log in the data folder and replays it, called when the events are (re)loaded
+	void Open(const std::string &szDataFolder);
+	// writes the changed data files, bForce ignores the flush interval
+	void Flush(bool bForce);
+
+	// exposes load, store and aggregate as the global dzStorage table
+	void Register(lua_State *lua_state);
+
+private:
+	struct _tEntry
+	{
+		std::string path;
+		_tValue value;
+		bool bDirty = false;
+		time_t mtime = 0;
+		int64_t size = -1;
+	};
+
+	static int l_load(lua_State *lua_state);
+	static int l_store(lua_State *lua_state);
+	static int l_aggregate(lua_State *lua_state);
+
+	// 1 = pushed the table, 0 = there is no data file, -1 = not handled (the runtime loads the file itself)
+	int Load(lua_State *lua_state, const std::string &path);
+	bool Store(lua_State *lua_state, int index, const std::string &path);
+
+	bool ReadFile(const std::string &path, _tValue &value);
+	bool WriteFile(_tEntry &entry);
+	void AppendLog(const std::string &key, const std::string &path, const _tValue *value);
+	void ReplayLog();
+
+	static std::string Key(const std::string &path);
+	static bool FromLua(lua_State *lua_state, int index, _tValue &value, std::set<const void *> &seen, int depth);
+	static void ToLua(lua_State *lua_state, const _tValue &value);
+	static void Encode(const _tValue &value, std::string &out);
+	static bool Decode(const char *&pData, const char *pEnd, _tValue &value, int depth);
+	static void WriteLuaSource(const _tValue &value, std::string &out, int level);
+
+	std::mutex m_mutex;
+	std::string m_szLogFile;
+	FILE *m_fLog = nullptr;
+	size_t m_logSize = 0;
+	time_t m_tLastFlush = 0;
+	std::map<std::string, _tEntry> m_entries;
+};
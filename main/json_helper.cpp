@@ -52,3 +52,133 @@ bool JSonRenameKey(Json::Value& value, const std::string& srcKey, const std::str
 	value.removeMember(srcKey);
 	return true;
 }
+
+CJsonStreamWriter::CJsonStreamWriter(std::string &out)
+	: m_out(out)
+{
+}
+
+void CJsonStreamWriter::BeforeValue()
+{
+	if (m_afterKey)
+	{
+		m_afterKey = false;
+		return;
+	}
+	if (m_first.empty())
+		return;
+	if (!m_first.back())
+		m_out += ',';
+	m_first.back() = false;
+}
+
+void CJsonStreamWriter::BeginObject()
+{
+	BeforeValue();
+	m_out += '{';
+	m_first.push_back(true);
+}
+
+void CJsonStreamWriter::EndObject()
+{
+	m_out += '}';
+	m_first.pop_back();
+}
+
+void CJsonStreamWriter::BeginArray()
+{
+	BeforeValue();
+	m_out += '[';
+	m_first.push_back(true);
+}
+
+void CJsonStreamWriter::EndArray()
+{
+	m_out += ']';
+	m_first.pop_back();
+}
+
+void CJsonStreamWriter::Key(const char *name)
+{
+	String(name, strlen(name));
+	m_out += ':';
+	m_afterKey = true;
+}
+
+void CJsonStreamWriter::String(const char *value, const size_t len)
+{
+	BeforeValue();
+	m_out += '"';
+	for (size_t ii = 0; ii < len; ii++)
+	{
+		unsigned char c = static_cast<unsigned char>(value[ii]);
+		switch (c)
+		{
+		case '"':
+			m_out += "\\\"";
+			break;
+		case '\\':
+			m_out += "\\\\";
+			break;
+		case '\n':
+			m_out += "\\n";
+			break;
+		case '\r':
+			m_out += "\\r";
+			break;
+		case '\t':
+			m_out += "\\t";
+			break;
+		default:
+			if (c < 0x20)
+			{
+				char szTmp[8];
+				sprintf(szTmp, "\\u%04x", c);
+				m_out += szTmp;
+			}
+			else
+				m_out += static_cast<char>(c);
+			break;
+		}
+	}
+	m_out += '"';
+}
+
+void CJsonStreamWriter::String(const std::string &value)
+{
+	String(value.data(), value.size());
+}
+
+void CJsonStreamWriter::Number(const double value)
+{
+	BeforeValue();
+	if (!std::isfinite(value))
+	{
+		m_out += "null";
+		return;
+	}
+	// shortest representation that reads back as the same double
+	char szTmp[32];
+	snprintf(szTmp, sizeof(szTmp), "%.15g", value);
+	if (strtod(szTmp, nullptr) != value)
+		snprintf(szTmp, sizeof(szTmp), "%.17g", value);
+	m_out += szTmp;
+}
+
+void CJsonStreamWriter::Number(const int64_t value)
+{
+	BeforeValue();
+	m_out += std::to_string(value);
+}
+
+void CJsonStreamWriter::Bool(const bool value)
+{
+	BeforeValue();
+	m_out += (value) ? "true" : "false";
+}
+
+void CJsonStreamWriter::Raw(const std::string &json)
+{
+	BeforeValue();
+	m_out += json;
+}
@@ -7,3 +7,30 @@ bool ParseJSonStrict(const std::string& inStr, Json::Value& json_output, std::st
 std::string JSonToFormatString(const Json::Value& json_input);
 std::string JSonToRawString(const Json::Value& json_input);
 bool JSonRenameKey(Json::Value& value, const std::string& srcKey, const std::string& destKey);
+
+// Minimal forward-only JSON writer that appends compact JSON to a string,
+// for large responses where building a Json::Value tree first is too costly
+class CJsonStreamWriter
+{
+public:
+	explicit CJsonStreamWriter(std::string &out);
+	void BeginObject();
+	void EndObject();
+	void BeginArray();
+	void EndArray();
+	void Key(const char *name);
+	void String(const char *value, size_t len);
+	void String(const std::string &value);
+	void Number(double value);
+	void Number(int64_t value);
+	void Bool(bool value);
+	// appends an already serialized JSON value
+	void Raw(const std::string &json);
+
+private:
+	void BeforeValue();
+
+	std::string &m_out;
+	std::vector<bool> m_first;
+	bool m_afterKey = false;
+};
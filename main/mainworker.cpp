@@ -5,6 +5,8 @@
 #include "Logger.h"
 #include "WebServerHelper.h"
 #include "SQLHelper.h"
+#include "Metrics.h"
+#include "StartupProfile.h"
 #include "../push/FibaroPush.h"
 #include "../push/HttpPush.h"
 #include "../push/InfluxPush.h"
@@ -17,6 +19,7 @@
 #include "../main/json_helper.h"
 
 #include <algorithm>
+#include <cassert>
 #include <set>
 
 #include "../mdns/mdns.hpp"
@@ -176,15 +179,10 @@
 #include <inttypes.h>
 
 #ifdef _DEBUG
-//#define PARSE_RFXCOM_DEVICE_LOG
 //#define DEBUG_DOWNLOAD
 //#define DEBUG_RXQUEUE
 #endif
 
-#ifdef PARSE_RFXCOM_DEVICE_LOG
-#include <iostream>
-#include <fstream>
-#endif
 
 extern std::string szStartupFolder;
 extern std::string szUserDataFolder;
@@ -198,6 +196,7 @@ extern http::server::_eWebCompressionMode g_wwwCompressMode;
 extern http::server::CWebServerHelper m_webservers;
 extern bool g_bUseEventTrigger;
 extern bool bNoCleanupDev;
+extern bool g_bStopApplication;
 extern domoticz_mdns::mDNS m_mdns;
 extern bool bEnableMDNS;
 
@@ -207,12 +206,101 @@ CHttpPush m_httppush;
 CInfluxPush m_influxpush;
 CMQTTPush m_mqttpush;
 
+// hardware started at the same time during startup
+constexpr size_t MAX_PARALLEL_HARDWARE_START = 4;
+
+static metrics::CGauge &RxQueueDepthMetric(const int HwdID)
+{
+	static auto &family = metrics::Registry().Gauge("domoticz_rx_queue_depth", "Messages waiting in the RX queue", "hardware");
+	return family.Get(std::to_string(HwdID));
+}
+
+static metrics::CHistogram &RxQueueWaitMetric(const int HwdID)
+{
+	static auto &family = metrics::Registry().Histogram("domoticz_rx_queue_wait_seconds", "Time a message waited in the RX queue", "hardware");
+	return family.Get(std::to_string(HwdID));
+}
+
+static metrics::CHistogram &RxProcessMetric(const int HwdID)
+{
+	static auto &family = metrics::Registry().Histogram("domoticz_rx_process_seconds", "Time spent processing a received message", "hardware");
+	return family.Get(std::to_string(HwdID));
+}
+
+// a DeviceStatus.LastUpdate timestamp as seconds, taken as UTC like strftime('%s', LastUpdate) does
+static time_t LastUpdateToSeconds(const std::string &sLastUpdate)
+{
+	struct tm ltime = {};
+	if (sscanf(sLastUpdate.c_str(), "%d-%d-%d %d:%d:%d", &ltime.tm_year, &ltime.tm_mon, &ltime.tm_mday, &ltime.tm_hour, &ltime.tm_min, &ltime.tm_sec) != 6)
+		return 0;
+	ltime.tm_year -= 1900;
+	ltime.tm_mon -= 1;
+#ifdef WIN32
+	return _mkgmtime(&ltime);
+#else
+	return timegm(&ltime);
+#endif
+}
+
+// the value a device event is published with, read on the thread that updated the device
+static bool LoadDeviceEventValue(const uint64_t DeviceRowIdx, CDeviceEventBus::_tDeviceValue &value)
+{
+	auto result = m_sql.safe_query("SELECT Name, Type, SubType, SwitchType, nValue, sValue, LastLevel, Color, SignalLevel, BatteryLevel, LastUpdate "
+				       "FROM DeviceStatus WHERE (ID == %" PRIu64 ")",
+				       DeviceRowIdx);
+	if (result.empty())
+		return false;
+	const auto &sd = result[0];
+	value.Name = sd[0];
+	value.devType = atoi(sd[1].c_str());
+	value.devSubType = atoi(sd[2].c_str());
+	value.SwitchType = atoi(sd[3].c_str());
+	value.nValue = atoi(sd[4].c_str());
+	value.sValue = sd[5];
+	value.LastLevel = atoi(sd[6].c_str());
+	value.Color = sd[7];
+	value.SignalLevel = atoi(sd[8].c_str());
+	value.BatteryLevel = atoi(sd[9].c_str());
+	value.LastUpdate = sd[10];
+
+	// a meter value held back by MeterWriteInterval is not in the row yet
+	meter_store::_tMeterRow meterRow;
+	if (m_sql.GetPendingMeterValue(DeviceRowIdx, meterRow))
+	{
+		value.nValue = meterRow.nValue;
+		value.sValue = meterRow.sValue;
+		value.SignalLevel = meterRow.SignalLevel;
+		value.BatteryLevel = meterRow.BatteryLevel;
+		value.LastUpdate = meterRow.LastUpdate;
+	}
+	value.tLastUpdate = LastUpdateToSeconds(value.LastUpdate);
+	return true;
+}
+
 MainWorker::MainWorker()
 {
 	m_SecCountdown = -1;
 
 	m_bStartHardware = false;
-	m_hardwareStartCounter = 0;
+
+	sOnDeviceReceived.connect([this](auto id, auto idx, auto &&name, auto rx) {
+		CDeviceEventBus::_tDeviceEvent event;
+		event.type = CDeviceEventBus::_tDeviceEvent::_eType::RECEIVED;
+		event.HwdID = id;
+		event.DeviceRowIdx = idx;
+		event.DeviceName = name;
+		// only read when MQTT or the push links are active, the websocket reads the row itself
+		if (m_deviceEventBus.WantsValue())
+			event.bHaveValue = LoadDeviceEventValue(idx, event.value);
+		m_deviceEventBus.Publish(event);
+	});
+	sOnDeviceUpdate.connect([this](auto id, auto idx) {
+		CDeviceEventBus::_tDeviceEvent event;
+		event.type = CDeviceEventBus::_tDeviceEvent::_eType::UPDATED;
+		event.HwdID = id;
+		event.DeviceRowIdx = idx;
+		m_deviceEventBus.Publish(event);
+	});
 
 	// Set default settings for web servers
 	m_webserver_settings.listening_address = "::"; // listen to all network interfaces
@@ -250,6 +338,7 @@ MainWorker::MainWorker()
 	m_SecStatus = SECSTATUS_DISARMED;
 
 	m_rxMessageIdx = 1;
+	SetRxShards(std::min<size_t>(std::max<unsigned int>(std::thread::hardware_concurrency(), 1), 4));
 	m_bForceLogNotificationCheck = false;
 }
 
@@ -290,16 +379,54 @@ void MainWorker::AddAllDomoticzHardware()
 			AddHardwareFromParams(ID, Name, Enabled, Type, LogLevelEnabled, Address, Port, SerialPort, Username, Password, Extra, mode1, mode2, mode3, mode4, mode5, mode6, DataTimeout,
 				false);
 		}
-		m_hardwareStartCounter = 0;
 		m_bStartHardware = true;
 	}
 }
 
 void MainWorker::StartDomoticzHardware()
 {
-	for (const auto& device : m_hardwaredevices)
-		if (!device->IsStarted())
-			device->Start();
+	std::vector<CDomoticzHardwareBase*> pending;
+	std::vector<CDomoticzHardwareBase*> plugins;
+	{
+		std::lock_guard<std::mutex> l(m_devicemutex);
+		for (const auto& device : m_hardwaredevices)
+		{
+			if (device->IsStarted())
+				continue;
+			// plugins share the Python interpreter, they are started one by one
+			if (device->HwdType == HTYPE_PythonPlugin)
+				plugins.push_back(device);
+			else
+				pending.push_back(device);
+		}
+	}
+	const int total = static_cast<int>(pending.size() + plugins.size());
+	std::atomic<int> started{ 0 };
+	startup::SetHardwareProgress(0, total);
+
+	auto StartDevice = [&](CDomoticzHardwareBase* pDevice) {
+		startup::CPhase phase(std_format("hardware %d (%s)", pDevice->m_HwdID, pDevice->m_Name.c_str()), 1);
+		pDevice->Start();
+		startup::SetHardwareProgress(++started, total);
+	};
+
+	// Hardware that connects to a device or service can take seconds to start, start a few at the same time
+	std::atomic<size_t> next{ 0 };
+	std::vector<std::thread> workers;
+	const size_t nWorkers = std::min<size_t>(MAX_PARALLEL_HARDWARE_START, pending.size());
+	for (size_t ii = 0; ii < nWorkers; ii++)
+	{
+		workers.emplace_back([&] {
+			size_t idx;
+			while ((idx = next++) < pending.size())
+				StartDevice(pending[idx]);
+		});
+		SetThreadName(workers.back().native_handle(), "HardwareStart");
+	}
+	for (auto* pDevice : plugins)
+		StartDevice(pDevice);
+	for (auto& worker : workers)
+		worker.join();
 }
 
 void MainWorker::StopDomoticzHardware()
@@ -1111,34 +1238,22 @@ bool MainWorker::Start()
 		std::transform(m_szSystemName.begin(), m_szSystemName.end(), m_szSystemName.begin(), ::tolower);
 	}
 
+	startup::SetStage("database");
+	startup::CPhase phase("database");
 	if (!m_sql.OpenDatabase())
 	{
 		return false;
 	}
 
+	phase.Next("settings");
 	HTTPClient::SetUserAgent(GenerateUserAgent());
 	m_notifications.Init();
 	GetSunSettings();
 	GetAvailableWebThemes();
-#ifdef ENABLE_PYTHON
-	if (m_sql.m_bEnableEventSystem)
-	{
-		m_pluginsystem.StartPluginSystem();
-	}
-#endif
-	AddAllDomoticzHardware();
-	m_fibaropush.Start();
-	m_httppush.Start();
-	m_influxpush.Start();
-	m_mqttpush.Start();
-	m_googlepubsubpush.Start();
-#ifdef PARSE_RFXCOM_DEVICE_LOG
-	if (m_bStartHardware == false)
-		m_bStartHardware = true;
-#endif
-	// load notifications configuration
-	m_notifications.LoadConfig();
 
+	// The web server comes first, getstartupstatus reports the progress of the rest
+	startup::SetStage("webserver");
+	phase.Next("webserver");
 	if (m_webserver_settings.is_enabled()
 #ifdef WWW_ENABLE_SSL
 		|| m_secure_webserver_settings.is_enabled()
@@ -1172,8 +1287,31 @@ bool MainWorker::Start()
 	m_webservers.SetWebRoot(szWebRoot);
 	m_webservers.SetWebCompressionMode(g_wwwCompressMode);
 
+	startup::SetStage("hardware");
+#ifdef ENABLE_PYTHON
+	phase.Next("plugin system");
+	if (m_sql.m_bEnableEventSystem)
+	{
+		m_pluginsystem.StartPluginSystem();
+	}
+#endif
+	phase.Next("load hardware");
+	AddAllDomoticzHardware();
+	phase.Next("push links");
+	m_fibaropush.Start();
+	m_httppush.Start();
+	m_influxpush.Start();
+	m_mqttpush.Start();
+	m_googlepubsubpush.Start();
+	if (!m_szRxCaptureFile.empty())
+		m_rxCapture.Open(m_szRxCaptureFile);
+	// load notifications configuration
+	m_notifications.LoadConfig();
+
 	//Start Scheduler
+	phase.Next("scheduler");
 	m_scheduler.StartScheduler();
+	phase.Next("services");
 	m_cameras.ReloadCameras();
 
 	int rnvalue = 0;
@@ -1223,15 +1361,18 @@ bool MainWorker::Start()
 		}
 	}
 
-	HandleHourPrice();
+	startup::Defer("hour prices", [this] { HandleHourPrice(); });
 
 	CKWHStats::InitGlobal();
 
 	m_thread = std::make_shared<std::thread>([this] { Do_Work(); });
 	SetThreadName(m_thread->native_handle(), "MainWorker");
-	m_rxMessageThread = std::make_shared<std::thread>([this] { Do_Work_On_Rx_Messages(); });
-	SetThreadName(m_rxMessageThread->native_handle(), "MainWorkerRxMsg");
-	return (m_thread != nullptr) && (m_rxMessageThread != nullptr);
+	for (size_t ii = 0; ii < m_rxShards.size(); ii++)
+	{
+		m_rxShards[ii]->thread = std::make_shared<std::thread>([this, ii] { Do_Work_On_Rx_Messages(ii); });
+		SetThreadName(m_rxShards[ii]->thread->native_handle(), (ii == 0) ? "MainWorkerRxMsg" : std_format("MainWorkerRx%d", (int)ii).c_str());
+	}
+	return (m_thread != nullptr);
 }
 
 bool MainWorker::Stop()
@@ -1241,22 +1382,37 @@ bool MainWorker::Stop()
 		m_notificationsystem.NotifyWait(Notification::DZ_STOP, Notification::STATUS_INFO); // blocking call
 	}
 
-	if (m_rxMessageThread) {
-		// Stop RxMessage thread before hardware to avoid NULL pointer exception
+	if ((!m_rxShards.empty()) && (m_rxShards[0]->thread)) {
+		// Stop RxMessage threads before hardware to avoid NULL pointer exception
 		m_TaskRXMessage.RequestStop();
 		UnlockRxMessageQueue();
-		m_rxMessageThread->join();
-		m_rxMessageThread.reset();
+		for (auto& shard : m_rxShards)
+		{
+			if (shard->thread)
+			{
+				shard->thread->join();
+				shard->thread.reset();
+			}
+		}
+		// after the RX threads, replayed frames still in the queues point at the stats of the replay thread
+		if (m_rxReplayThread)
+		{
+			m_rxReplayThread->join();
+			m_rxReplayThread.reset();
+		}
 	}
 	if (m_thread)
 	{
 		_log.Log(LOG_STATUS, "Stopping all hardware...");
 		StopDomoticzHardware();
+		m_rxCapture.Close();
 		m_webservers.StopServers();
 		m_sharedserver.StopServer();
 		m_scheduler.StopScheduler();
 		m_eventsystem.StopEventSystem();
 		m_notificationsystem.Stop();
+		m_notifications.FlushLastSend();
+		m_sql.FlushMeters(true);
 		m_fibaropush.Stop();
 		m_httppush.Stop();
 		m_influxpush.Stop();
@@ -1268,7 +1424,7 @@ bool MainWorker::Stop()
 		if (m_mdns.isServiceRunning())	// Stop mDNS service
 			m_mdns.stopService();
 
-		//    m_cameras.StopCameraGrabber();
+		m_cameras.StopRelays();
 
 		HTTPClient::Cleanup();
 
@@ -1547,75 +1703,148 @@ void MainWorker::HandleAutomaticBackups()
 	_log.Log(LOG_STATUS, "Ending automatic database backup procedure...");
 }
 
-void MainWorker::ParseRFXLogFile()
+void MainWorker::SetRxCaptureFile(const std::string& szFileName)
+{
+	m_szRxCaptureFile = szFileName;
+}
+
+void MainWorker::SetRxReplay(const std::string& szFileName, const std::string& szScratchDatabase, const double speed, const bool bStopAfterReplay)
+{
+	m_szRxReplayFile = szFileName;
+	m_szRxReplayDatabase = szScratchDatabase;
+	m_rxReplaySpeed = (speed > 0) ? speed : 0;
+	m_bStopAfterRxReplay = bStopAfterReplay;
+}
+
+void MainWorker::SetRxShards(const size_t nShards)
+{
+	m_rxShards.clear();
+	for (size_t ii = 0; ii < std::max<size_t>(nShards, 1); ii++)
+		m_rxShards.push_back(std::make_unique<_tRxShard>());
+}
+
+void MainWorker::StartRxReplay()
+{
+	if ((m_szRxReplayFile.empty()) || (m_rxReplayThread))
+		return;
+	m_rxReplayThread = std::make_shared<std::thread>([this] { Do_Work_RxReplay(); });
+	SetThreadName(m_rxReplayThread->native_handle(), "MainWorkerRxReplay");
+}
+
+void MainWorker::Do_Work_RxReplay()
 {
-#ifdef PARSE_RFXCOM_DEVICE_LOG
-	std::vector<std::string> _lines;
-	std::ifstream myfile("C:\\RFXtrxLog.txt");
-	if (myfile.is_open())
+	// the replayed frames update devices and logs like received ones, never do that to a live database
+	const std::string &szDatabase = m_sql.GetDatabaseName();
+	if ((szDatabase != ":memory:") && ((m_szRxReplayDatabase.empty()) || (szDatabase != m_szRxReplayDatabase)))
+	{
+		_log.Log(LOG_ERROR, "RxReplay: refusing to replay into %s, use -dbase :memory: or pass a scratch database with -rxreplaydbase", szDatabase.c_str());
+		if (m_bStopAfterRxReplay)
+			g_bStopApplication = true;
+		return;
+	}
+	std::vector<rxcapture::_tRxFrame> frames;
+	if (!rxcapture::LoadCaptureFile(m_szRxReplayFile, frames))
+	{
+		if (m_bStopAfterRxReplay)
+			g_bStopApplication = true;
+		return;
+	}
+	_log.Log(LOG_STATUS, "RxReplay: replaying %d frames from %s (speed: %s)", (int)frames.size(), m_szRxReplayFile.c_str(),
+		(m_rxReplaySpeed > 0) ? std_format("%gx", m_rxReplaySpeed).c_str() : "max");
+
+	// Frames of hardware that does not exist (in this database) are decoded using a dummy hardware of the recorded type
+	std::map<int, const CDomoticzHardwareBase*> hardware;
+	for (const auto& frame : frames)
 	{
-		while (myfile.good())
+		if ((frame.hardwareId < 1) || (hardware.find(frame.hardwareId) != hardware.end()))
+			continue;
+		CDomoticzHardwareBase* pHardware = GetHardware(frame.hardwareId);
+		if (pHardware == nullptr)
 		{
-			std::string _line;
-			getline(myfile, _line);
-			size_t tpos = _line.find("=");
-			if ((tpos == std::string::npos) || (tpos < 10))
-				continue;
-			if (_line[tpos - 4] != ':')
-				continue;
-			_line = _line.substr(tpos + 1);
-			tpos = _line.find(':');
-			if (tpos != std::string::npos)
-			{
-				_line = _line.substr(tpos + 1);
-			}
-			stdreplace(_line, " ", "");
-			_lines.push_back(_line);
+			pHardware = new CDummy(frame.hardwareId);
+			pHardware->HwdType = static_cast<_eHardwareTypes>(frame.hardwareType);
+			pHardware->m_Name = pHardware->m_ShortName = std_format("RX replay %d", frame.hardwareId);
+			pHardware->m_bOutputLog = false;
+			AddDomoticzHardware(pHardware);
 		}
-		myfile.close();
+		hardware[frame.hardwareId] = pHardware;
 	}
-	int HWID = 999;
-	//m_sql.DeleteHardware("999");
 
-	RFXComTCP* pHardware = (RFXComTCP*)GetHardware(HWID);
-	if (pHardware == NULL)
+	// the frames go through the RX queues like received ones, so they are decoded by the shard of their
+	// hardware in the recorded order and the queue wait is part of the timings
+	rxcapture::CReplayStats replayStats;
+	rxcapture::ResetStageTimes();
+
+	auto tStart = std::chrono::steady_clock::now();
+	uint64_t captureUs = 0;
+	size_t nQueued = 0;
+	for (const auto& frame : frames)
 	{
-		pHardware = new RFXComTCP(HWID, "127.0.0.1", 1234, CRFXBase::ATYPE_P1_DSMR_5);
-		//pHardware->sDecodeRXMessage.connect(boost::bind(&MainWorker::DecodeRXMessage, this, _1, _2, _3, _4, _5));
-		AddDomoticzHardware(pHardware);
-		pHardware->m_bEnableReceive = true;
-		pHardware->m_Name = pHardware->m_ShortName = "RFXCom debug";
+		captureUs += frame.deltaUs;
+		if (frame.hardwareId < 1)
+			continue;
+		if (m_rxReplaySpeed > 0)
+		{
+			auto tDue = tStart + std::chrono::microseconds(static_cast<uint64_t>(captureUs / m_rxReplaySpeed));
+			while ((std::chrono::steady_clock::now() < tDue) && (!m_TaskRXMessage.IsStopRequested(0)))
+				std::this_thread::sleep_until(std::min(tDue, std::chrono::steady_clock::now() + std::chrono::milliseconds(500)));
+		}
+		if (m_TaskRXMessage.IsStopRequested(0))
+			break;
+
+		_tRxQueueItem rxMessage;
+		BuildRxQueueItem(rxMessage, frame.hardwareId, frame.rxCommand.data(), frame.name.c_str(), frame.batteryLevel, frame.userName.c_str());
+		rxMessage.replayStats = &replayStats;
+		// wait for room when the queue is full, a replay should not drop frames
+		if (!PushRxQueueItem(rxMessage, true))
+			break;
+		nQueued++;
 	}
 
-	unsigned char rxbuffer[600];
-	static const char* const lut = "0123456789ABCDEF";
-	for (const auto& hexstring : _lines)
+	// wait for the RX threads to process the queued frames, give up when they stop making progress
+	size_t nDone = 0;
+	auto tProgress = std::chrono::steady_clock::now();
+	while (!m_TaskRXMessage.IsStopRequested(10))
 	{
-		if (hexstring.size() % 2 != 0)
-			continue;//illegal
-		size_t totbytes = hexstring.size() / 2;
-		size_t ii = 0;
-		for (ii = 0; ii < totbytes; ii++)
+		size_t nCount = replayStats.Count();
+		if (nCount >= nQueued)
+			break;
+		if (nCount != nDone)
 		{
-			std::string hbyte = hexstring.substr((ii * 2), 2);
-
-			char a = hbyte[0];
-			const char* p = std::lower_bound(lut, lut + 16, a);
-			if (*p != a) throw std::invalid_argument("not a hex digit");
+			nDone = nCount;
+			tProgress = std::chrono::steady_clock::now();
+		}
+		else if (std::chrono::steady_clock::now() - tProgress > std::chrono::seconds(30))
+		{
+			_log.Log(LOG_ERROR, "RxReplay: only %d of %d queued frames were processed", (int)nCount, (int)nQueued);
+			break;
+		}
+	}
+	double totalMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - tStart).count();
 
-			char b = hbyte[1];
-			const char* q = std::lower_bound(lut, lut + 16, b);
-			if (*q != b) throw std::invalid_argument("not a hex digit");
+	std::vector<uint64_t> queueNs;
+	std::vector<uint64_t> processNs;
+	replayStats.Get(queueNs, processNs);
+	uint64_t stageNs[rxcapture::STAGE_COUNT];
+	rxcapture::GetStageTimes(stageNs);
 
-			unsigned char uchar = static_cast<unsigned char>(((p - lut) << 4) | (q - lut));
-			rxbuffer[ii] = uchar;
+	size_t nFrames = processNs.size();
+	_log.Log(LOG_STATUS, "RxReplay: %d frames in %.1f ms (%.0f frames/s)", (int)nFrames, totalMs, (totalMs > 0) ? (nFrames * 1000.0 / totalMs) : 0.0);
+	if (nFrames > 0)
+	{
+		std::sort(queueNs.begin(), queueNs.end());
+		std::sort(processNs.begin(), processNs.end());
+		_log.Log(LOG_STATUS, "RxReplay: queue wait: p50 %.1f us, p99 %.1f us, max %.1f us", queueNs[nFrames / 2] / 1000.0, queueNs[(nFrames * 99) / 100] / 1000.0,
+			queueNs.back() / 1000.0);
+		_log.Log(LOG_STATUS, "RxReplay: per frame: p50 %.1f us, p99 %.1f us, max %.1f us", processNs[nFrames / 2] / 1000.0, processNs[(nFrames * 99) / 100] / 1000.0,
+			processNs.back() / 1000.0);
+		for (int ii = 0; ii < rxcapture::STAGE_COUNT; ii++)
+		{
+			_log.Log(LOG_STATUS, "RxReplay: stage %-6s: %.1f ms total, %.1f us/frame", rxcapture::szStageNames[ii], stageNs[ii] / 1000000.0, stageNs[ii] / 1000.0 / nFrames);
 		}
-		if (ii == 0)
-			continue;
-		pHardware->onInternalMessage((const uint8_t*)&rxbuffer, ii);
-		sleep_milliseconds(100);
 	}
-#endif
+	if (m_bStopAfterRxReplay)
+		g_bStopApplication = true;
 }
 
 void MainWorker::Do_Work()
@@ -1678,28 +1907,33 @@ void MainWorker::Do_Work()
 			m_bHaveDownloadedDomoticzUpdate = true;
 		}
 
-		second_counter++;
-		if (second_counter < 2)
-			continue;
-		second_counter = 0;
-
 		if (m_bStartHardware)
 		{
-			m_hardwareStartCounter++;
-			if (m_hardwareStartCounter >= 2)
+			m_bStartHardware = false;
 			{
-				m_bStartHardware = false;
+				startup::CPhase phase("hardware start");
 				StartDomoticzHardware();
 #ifdef ENABLE_PYTHON
 				m_pluginsystem.AllPluginsStarted();
 #endif
-				ParseRFXLogFile();
+			}
+			StartRxReplay();
+			startup::SetStage("events");
+			{
+				startup::CPhase phase("event system");
 				m_notificationsystem.Start();
 				m_eventsystem.SetEnabled(m_sql.m_bEnableEventSystem);
 				m_eventsystem.StartEventSystem();
 				m_notificationsystem.Notify(Notification::DZ_START, Notification::STATUS_INFO);
 			}
+			if (!startup::IsComplete())
+				startup::Complete();
 		}
+
+		second_counter++;
+		if (second_counter < 2)
+			continue;
+		second_counter = 0;
 		if (!m_devicestorestart.empty())
 		{
 			for (const auto& hwid : m_devicestorestart)
@@ -1842,6 +2076,7 @@ void MainWorker::Do_Work()
 
 bool MainWorker::WriteToHardware(const int HwdID, const char* pdata, const uint8_t length)
 {
+	tracer::CSpan span("WriteToHardware");
 	int hindex = FindDomoticzHardware(HwdID);
 
 	if (hindex == -1)
@@ -1894,6 +2129,8 @@ void MainWorker::DecodeRXMessage(const CDomoticzHardwareBase* pHardware, const u
 {
 	if ((pHardware == nullptr) || (pRXCommand == nullptr))
 		return;
+	if (m_rxCapture.IsOpen())
+		m_rxCapture.Record(pHardware->m_HwdID, pHardware->HwdType, pRXCommand, defaultName, BatteryLevel, userName);
 	if ((pHardware->HwdType == HTYPE_Domoticz) && (pHardware->m_HwdID == 8765))
 	{
 		//Directly process the command
@@ -1935,34 +2172,19 @@ void MainWorker::CheckAndPushRxMessage(const CDomoticzHardwareBase* pHardware, c
 		return;
 	}
 
-	// Build queue item
-	_tRxQueueItem rxMessage;
-	if (defaultName != nullptr)
-	{
-		rxMessage.Name = defaultName;
-	}
-	rxMessage.BatteryLevel = BatteryLevel;
-	if (userName != nullptr)
-		rxMessage.UserName = userName;
-	rxMessage.rxMessageIdx = m_rxMessageIdx++;
-	rxMessage.hardwareId = pHardware->m_HwdID;
-	// defensive copy of the command
-	rxMessage.vrxCommand.insert(rxMessage.vrxCommand.begin(), pRXCommand, pRXCommand + pRXCommand[0] + 1);
-	rxMessage.crc = 0x0;
-#ifdef DEBUG_RXQUEUE
-	// CRC
-	rxMessage.crc = crc16ccitt(pRXCommand, pRXCommand[0] + 1);
-#endif
-
 	if (m_TaskRXMessage.IsStopRequested(0)) {
 		// Server is stopping
 		return;
 	}
 
-	// Trigger
-	rxMessage.trigger = nullptr; // Should be initialized to NULL if trigger is no used
+	// Build queue item
+	_tRxQueueItem rxMessage;
+	BuildRxQueueItem(rxMessage, pHardware->m_HwdID, pRXCommand, defaultName, BatteryLevel, userName);
+
+	// Trigger (lives on our stack, we do not return before it is signaled or the server stops)
+	queue_element_trigger trigger;
 	if (wait) { // add trigger to wait for the message to be processed
-		rxMessage.trigger = new queue_element_trigger();
+		rxMessage.trigger = &trigger;
 	}
 
 #ifdef DEBUG_RXQUEUE
@@ -1976,14 +2198,15 @@ void MainWorker::CheckAndPushRxMessage(const CDomoticzHardwareBase* pHardware, c
 #endif
 
 	// Push item to queue
-	m_rxMessageQueue.push(rxMessage);
+	if (!PushRxQueueItem(rxMessage, wait))
+		return;
 
-	if (rxMessage.trigger != nullptr)
+	if (wait)
 	{
 #ifdef DEBUG_RXQUEUE
 		_log.Log(LOG_STATUS, "RxQueue: wait for rxMessage(%lu) to be processed...", rxMessage.rxMessageIdx);
 #endif
-		while (!rxMessage.trigger->timed_wait(std::chrono::duration<int>(1))) {
+		while (!trigger.timed_wait(std::chrono::duration<int>(1))) {
 #ifdef DEBUG_RXQUEUE
 			_log.Log(LOG_STATUS, "RxQueue: wait 1s for rxMessage(%lu) to be processed...", rxMessage.rxMessageIdx);
 #endif
@@ -1993,12 +2216,136 @@ void MainWorker::CheckAndPushRxMessage(const CDomoticzHardwareBase* pHardware, c
 			}
 		}
 #ifdef DEBUG_RXQUEUE
-		if (wait) {
-			_log.Log(LOG_STATUS, "RxQueue: rxMessage(%lu) processed", rxMessage.rxMessageIdx);
-		}
+		_log.Log(LOG_STATUS, "RxQueue: rxMessage(%lu) processed", rxMessage.rxMessageIdx);
+#endif
+	}
+}
+
+void MainWorker::BuildRxQueueItem(_tRxQueueItem& rxMessage, const int hardwareId, const uint8_t* pRXCommand, const char* defaultName, const int BatteryLevel, const char* userName)
+{
+	rxMessage.Name = InternRxName(defaultName);
+	if (rxMessage.Name == nullptr)
+		rxMessage.NameCopy = defaultName;
+	rxMessage.UserName = InternRxName(userName);
+	if (rxMessage.UserName == nullptr)
+		rxMessage.UserNameCopy = userName;
+	rxMessage.BatteryLevel = BatteryLevel;
+	rxMessage.rxMessageIdx = m_rxMessageIdx++;
+	rxMessage.hardwareId = hardwareId;
+	rxMessage.trace = tracer::StartTrace();
+	// defensive copy of the command
+	memcpy(rxMessage.rxCommand, pRXCommand, pRXCommand[0] + 1);
+#ifdef DEBUG_RXQUEUE
+	// CRC
+	rxMessage.crc = crc16ccitt(pRXCommand, pRXCommand[0] + 1);
 #endif
-		delete rxMessage.trigger;
+}
+
+// the shard whose thread decodes the messages of this hardware
+//
+// The decoders read a device row, compute the new value from it (counters, totals, levels...) and write it
+// back without a lock around the two. That is only safe because all queued messages of a hardware are
+// decoded by one thread, and the rows they touch belong to that hardware (HardwareID = the hardware that
+// received the message). Do not pick the shard from anything else than the hardware id.
+//
+// Rows that are also written outside of the RX queue are not covered, the same as with the single RX thread
+// before: messages of the shared server are decoded on the caller's thread under
+// m_decodeRXMessageMutex, DomoticzTCP writes the remote devices (OrgHardwareID) directly, plugins, scripts
+// and the web API call UpdateValue themselves.
+MainWorker::_tRxShard& MainWorker::GetRxShard(const int hardwareId)
+{
+	return *m_rxShards[static_cast<size_t>(hardwareId) % m_rxShards.size()];
+}
+
+bool MainWorker::PushRxQueueItem(_tRxQueueItem& rxMessage, const bool wait)
+{
+	_tRxShard& shard = GetRxShard(rxMessage.hardwareId);
+	rxMessage.tEnqueued = std::chrono::steady_clock::now();
+	while (!shard.queue.try_push(rxMessage))
+	{
+		if (wait)
+		{
+			// caller is blocking anyway, wait for the worker to make room
+			if (m_TaskRXMessage.IsStopRequested(10))
+				return false;
+			continue;
+		}
+		uint64_t dropped = ++m_rxQueueDropped;
+		time_t atime = mytime(nullptr);
+		time_t lastLog = m_rxQueueLastDropLog.load();
+		if ((atime - lastLog >= 10) && m_rxQueueLastDropLog.compare_exchange_strong(lastLog, atime))
+		{
+			_log.Log(LOG_ERROR, "RxQueue: queue full (%d items), message from hardware id %d dropped (total dropped: %" PRIu64 ")",
+				(int)shard.queue.capacity(), rxMessage.hardwareId, dropped);
+		}
+		return false;
 	}
+	size_t depth = shard.queue.size();
+	size_t maxDepth = m_rxQueueMaxDepth.load(std::memory_order_relaxed);
+	while ((depth > maxDepth) && !m_rxQueueMaxDepth.compare_exchange_weak(maxDepth, depth, std::memory_order_relaxed))
+		;
+	if (rxMessage.hardwareId > 0)
+		RxQueueDepthMetric(rxMessage.hardwareId).Add(1);
+	return true;
+}
+
+// the pooled copy of a name, nullptr when the pool is full and the caller has to keep its own copy
+const char* MainWorker::InternRxName(const char* szName)
+{
+	// hardware that puts a counter or a timestamp in its names would otherwise grow the pool forever
+	constexpr size_t iMaxPooledNames = 1024;
+	if ((szName == nullptr) || (*szName == 0))
+		return "";
+	std::string_view name(szName);
+	{
+		boost::shared_lock<boost::shared_mutex> lock(m_rxNamePoolMutex);
+		auto itt = m_rxNameIndex.find(name);
+		if (itt != m_rxNameIndex.end())
+			return itt->data();
+	}
+	boost::unique_lock<boost::shared_mutex> lock(m_rxNamePoolMutex);
+	auto itt = m_rxNameIndex.find(name);
+	if (itt != m_rxNameIndex.end())
+		return itt->data();
+	if (m_rxNamePool.size() >= iMaxPooledNames)
+	{
+		if (!m_bRxNamePoolFull)
+			_log.Log(LOG_STATUS, "RxQueue: %d different device/user names seen, new names are no longer pooled", (int)iMaxPooledNames);
+		m_bRxNamePoolFull = true;
+		return nullptr;
+	}
+	// deque keeps element addresses stable on push_back
+	m_rxNamePool.emplace_back(name);
+	m_rxNameIndex.insert(m_rxNamePool.back());
+	return m_rxNamePool.back().c_str();
+}
+
+MainWorker::_tRxQueueStats MainWorker::GetRxQueueStats()
+{
+	_tRxQueueStats stats;
+	for (const auto& shard : m_rxShards)
+	{
+		stats.depth += shard->queue.size();
+		stats.capacity += shard->queue.capacity();
+	}
+	stats.maxDepth = m_rxQueueMaxDepth;
+	stats.shards = m_rxShards.size();
+	stats.processed = m_rxQueueProcessed;
+	stats.dropped = m_rxQueueDropped;
+	stats.lastLatencyUs = m_rxQueueLastLatencyUs;
+	stats.maxLatencyUs = m_rxQueueMaxLatencyUs;
+	if (stats.processed > 0)
+		stats.avgLatencyUs = m_rxQueueTotalLatencyUs / stats.processed;
+	return stats;
+}
+
+_tTrendCalculator::_eTendencyType MainWorker::GetTrendState(const uint64_t tID)
+{
+	std::lock_guard<std::mutex> lock(m_calculatorMutex);
+	auto itt = m_trend_calculator.find(tID);
+	if (itt == m_trend_calculator.end())
+		return _tTrendCalculator::_eTendencyType::TENDENCY_UNKNOWN;
+	return itt->second.m_state;
 }
 
 void MainWorker::UnlockRxMessageQueue()
@@ -2006,24 +2353,31 @@ void MainWorker::UnlockRxMessageQueue()
 #ifdef DEBUG_RXQUEUE
 	_log.Log(LOG_STATUS, "RxQueue: unlock queue using dummy message");
 #endif
-	// Push dummy message to unlock queue
-	_tRxQueueItem rxMessage;
-	rxMessage.rxMessageIdx = m_rxMessageIdx++;
-	rxMessage.hardwareId = -1;
-	rxMessage.trigger = nullptr;
-	rxMessage.BatteryLevel = 0;
-	m_rxMessageQueue.push(rxMessage);
+	// Push dummy message to unlock the queues (if a queue is full its worker is awake anyway)
+	for (auto& shard : m_rxShards)
+	{
+		_tRxQueueItem rxMessage;
+		rxMessage.rxMessageIdx = m_rxMessageIdx++;
+		rxMessage.hardwareId = -1;
+		shard->queue.try_push(rxMessage);
+	}
 }
 
-void MainWorker::Do_Work_On_Rx_Messages()
+// the shard of the RX thread, -1 on every other thread
+static thread_local int tl_iRxShard = -1;
+
+void MainWorker::Do_Work_On_Rx_Messages(const size_t iShard)
 {
-	_log.Log(LOG_STATUS, "RxQueue: queue worker started...");
+	tl_iRxShard = static_cast<int>(iShard);
+	if (iShard == 0)
+		_log.Log(LOG_STATUS, "RxQueue: queue worker started (%d decode threads)...", (int)m_rxShards.size());
+	mpsc_queue<_tRxQueueItem>& rxQueue = m_rxShards[iShard]->queue;
 
+	_tRxQueueItem rxQItem;
 	while (!m_TaskRXMessage.IsStopRequested(0))
 	{
 		// Wait and pop next message or timeout
-		_tRxQueueItem rxQItem;
-		bool hasPopped = m_rxMessageQueue.timed_wait_and_pop<std::chrono::duration<int> >(rxQItem, std::chrono::duration<int>(5));
+		bool hasPopped = rxQueue.timed_wait_and_pop<std::chrono::duration<int> >(rxQItem, std::chrono::duration<int>(5));
 		// (if no message for 5 seconds, returns anyway to check m_TaskRXMessage.IsStopRequested)
 
 		if (!hasPopped) {
@@ -2047,6 +2401,7 @@ void MainWorker::Do_Work_On_Rx_Messages()
 				rxQItem.trigger->popped();
 			continue;
 		}
+		RxQueueDepthMetric(rxQItem.hardwareId).Add(-1);
 
 		const CDomoticzHardwareBase* pHardware = GetHardware(rxQItem.hardwareId);
 
@@ -2058,18 +2413,12 @@ void MainWorker::Do_Work_On_Rx_Messages()
 				rxQItem.trigger->popped();
 			continue;
 		}
-		if (rxQItem.vrxCommand.empty()) {
-			_log.Log(LOG_ERROR, "RxQueue: cannot retrieve command with id: %d", rxQItem.hardwareId);
-			if (rxQItem.trigger != nullptr)
-				rxQItem.trigger->popped();
-			continue;
-		}
 
-		const uint8_t* pRXCommand = &rxQItem.vrxCommand[0];
+		const uint8_t* pRXCommand = rxQItem.rxCommand;
 
 #ifdef DEBUG_RXQUEUE
 		// CRC
-		uint16_t crc = crc16ccitt(pRXCommand, rxQItem.vrxCommand.size());
+		uint16_t crc = crc16ccitt(pRXCommand, pRXCommand[0] + 1);
 		if (rxQItem.crc != crc) {
 			_log.Log(LOG_ERROR, "RxQueue: cannot process invalid rxMessage(%lu) from hardware with id=%d (type %d)",
 				rxQItem.rxMessageIdx,
@@ -2087,14 +2436,37 @@ void MainWorker::Do_Work_On_Rx_Messages()
 			pRXCommand[1],
 			pRXCommand[2]);
 #endif
-		ProcessRXMessage(pHardware, pRXCommand, rxQItem.Name.c_str(), rxQItem.BatteryLevel, rxQItem.UserName.c_str());
+		auto tPopped = std::chrono::steady_clock::now();
+		uint64_t latencyUs = std::chrono::duration_cast<std::chrono::microseconds>(tPopped - rxQItem.tEnqueued).count();
+		m_rxQueueLastLatencyUs = latencyUs;
+		m_rxQueueTotalLatencyUs += latencyUs;
+		uint64_t maxLatencyUs = m_rxQueueMaxLatencyUs.load(std::memory_order_relaxed);
+		while ((latencyUs > maxLatencyUs) && !m_rxQueueMaxLatencyUs.compare_exchange_weak(maxLatencyUs, latencyUs, std::memory_order_relaxed))
+			;
+		m_rxQueueProcessed++;
+		RxQueueWaitMetric(rxQItem.hardwareId).Observe(latencyUs);
+
+		tracer::CContext traceContext(rxQItem.trace, "rx queue");
+		auto tProcessStart = std::chrono::steady_clock::now();
+		if (rxQItem.replayStats != nullptr)
+		{
+			rxcapture::CProfileScope profile;
+			uint64_t queueNs = std::chrono::duration_cast<std::chrono::nanoseconds>(tPopped - rxQItem.tEnqueued).count();
+			rxcapture::AddStageTime(rxcapture::STAGE_QUEUE, queueNs);
+			ProcessRXMessage(pHardware, pRXCommand, rxQItem.GetName(), rxQItem.BatteryLevel, rxQItem.GetUserName());
+			rxQItem.replayStats->Add(queueNs, std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - tProcessStart).count());
+		}
+		else
+			ProcessRXMessage(pHardware, pRXCommand, rxQItem.GetName(), rxQItem.BatteryLevel, rxQItem.GetUserName());
+		RxProcessMetric(rxQItem.hardwareId).ObserveSince(tProcessStart);
 		if (rxQItem.trigger != nullptr)
 		{
 			rxQItem.trigger->popped();
 		}
 	}
 
-	_log.Log(LOG_STATUS, "RxQueue: queue worker stopped...");
+	if (iShard == 0)
+		_log.Log(LOG_STATUS, "RxQueue: queue worker stopped...");
 }
 
 void MainWorker::ProcessRXMessage(const CDomoticzHardwareBase* pHardware, const uint8_t* pRXCommand, const char* defaultName, const int BatteryLevel, const char* userName)
@@ -2102,6 +2474,12 @@ void MainWorker::ProcessRXMessage(const CDomoticzHardwareBase* pHardware, const
 	// current date/time based on current system
 	//size_t Len = pRXCommand[0] + 1;
 
+	// a message is decoded by the shard of its hardware, see GetRxShard
+	assert((tl_iRxShard < 0) || (&GetRxShard(pHardware->m_HwdID) == m_rxShards[tl_iRxShard].get()));
+
+	rxcapture::CStageTimer decodeTimer(rxcapture::STAGE_DECODE);
+	tracer::CSpan decodeSpan("decode");
+
 	uint64_t DeviceRowIdx = (uint64_t)-1;
 	std::string DeviceName;
 
@@ -2342,9 +2720,14 @@ void MainWorker::ProcessRXMessage(const CDomoticzHardwareBase* pHardware, const
 	if (DeviceRowIdx == (uint64_t)-1)
 		return;
 
+	// decoding (and the device update it does) runs on several threads, see GetRxShard. The writes below and
+	// the signal emission are done one message at a time
+	std::lock_guard<std::mutex> commitLock(m_rxCommitMutex);
+
 	if ((BatteryLevel != -1) && (procResult.bProcessBatteryValue))
 	{
-		m_sql.safe_query("UPDATE DeviceStatus SET BatteryLevel=%d WHERE (ID==%" PRIu64 ")", BatteryLevel, DeviceRowIdx);
+		// not through safe_query, the update hook would make the meter store drop a held back value
+		m_sql.UpdateReceivedBatteryLevel(DeviceRowIdx, BatteryLevel);
 		m_eventsystem.UpdateBatteryLevel(DeviceRowIdx, BatteryLevel); //GizMoCuz, temporarily... 
 	}
 
@@ -2353,7 +2736,7 @@ void MainWorker::ProcessRXMessage(const CDomoticzHardwareBase* pHardware, const
 		if (strlen(defaultName) > 0)
 		{
 			DeviceName = defaultName;
-			m_sql.safe_query("UPDATE DeviceStatus SET Name='%q' WHERE (ID==%" PRIu64 ")", defaultName, DeviceRowIdx);
+			m_sql.UpdateReceivedName(DeviceRowIdx, DeviceName);
 		}
 	}
 
@@ -2369,6 +2752,8 @@ void MainWorker::ProcessRXMessage(const CDomoticzHardwareBase* pHardware, const
 		const_cast<CDomoticzHardwareBase*>(pHardware)->Log(LOG_NORM, szLogString);
 	}
 
+	rxcapture::CStageTimer pushTimer(rxcapture::STAGE_PUSH);
+	tracer::CSpan pushSpan("publish");
 	sOnDeviceReceived(pHardware->m_HwdID, DeviceRowIdx, DeviceName, pRXCommand);
 }
 
@@ -3149,7 +3534,10 @@ void MainWorker::decode_Wind(const CDomoticzHardwareBase* pHardware, const tRBUF
 	//Apply user defined offset
 	dDirection = std::fmod(dDirection + AddjValue2, 360.0);
 
-	dDirection = m_wind_calculator[windID].AddValueAndReturnAvarage(dDirection);
+	{
+		std::lock_guard<std::mutex> lock(m_calculatorMutex);
+		dDirection = m_wind_calculator[windID].AddValueAndReturnAvarage(dDirection);
+	}
 
 	std::string strDirection;
 	if (dDirection > 348.75 || dDirection < 11.26)
@@ -3203,7 +3591,10 @@ void MainWorker::decode_Wind(const CDomoticzHardwareBase* pHardware, const tRBUF
 		intSpeed = intGust;
 	}
 
-	m_wind_calculator[windID].SetSpeedGust(intSpeed, intGust);
+	{
+		std::lock_guard<std::mutex> lock(m_calculatorMutex);
+		m_wind_calculator[windID].SetSpeedGust(intSpeed, intGust);
+	}
 
 	float temp = 0, chill = 0;
 	if (subType != sTypeWINDNoTempNoChill)
@@ -3273,7 +3664,10 @@ void MainWorker::decode_Wind(const CDomoticzHardwareBase* pHardware, const tRBUF
 	m_notifications.CheckAndHandleNotification(DevRowIdx, pHardware->m_HwdID, ID, procResult.DeviceName, Unit, devType, subType, cmnd, szTmp);
 
 	uint64_t tID = ((uint64_t)(pHardware->m_HwdID & 0x7FFFFFFF) << 32) | (DevRowIdx & 0x7FFFFFFF);
-	m_trend_calculator[tID].AddValueAndReturnTendency(static_cast<double>(chill), _tTrendCalculator::TAVERAGE_TEMP);
+	{
+		std::lock_guard<std::mutex> lock(m_calculatorMutex);
+		m_trend_calculator[tID].AddValueAndReturnTendency(static_cast<double>(chill), _tTrendCalculator::TAVERAGE_TEMP);
+	}
 
 	if (_log.IsDebugLevelEnabled(DEBUG_RECEIVED))
 	{
@@ -3412,7 +3806,10 @@ void MainWorker::decode_Temp(const CDomoticzHardwareBase* pHardware, const tRBUF
 		return;
 
 	uint64_t tID = ((uint64_t)(pHardware->m_HwdID & 0x7FFFFFFF) << 32) | (DevRowIdx & 0x7FFFFFFF);
-	m_trend_calculator[tID].AddValueAndReturnTendency(static_cast<double>(temp), _tTrendCalculator::TAVERAGE_TEMP);
+	{
+		std::lock_guard<std::mutex> lock(m_calculatorMutex);
+		m_trend_calculator[tID].AddValueAndReturnTendency(static_cast<double>(temp), _tTrendCalculator::TAVERAGE_TEMP);
+	}
 
 	bool bHandledNotification = false;
 	uint8_t humidity = 0;
@@ -3727,7 +4124,10 @@ void MainWorker::decode_TempHum(const CDomoticzHardwareBase* pHardware, const tR
 		return;
 
 	uint64_t tID = ((uint64_t)(pHardware->m_HwdID & 0x7FFFFFFF) << 32) | (DevRowIdx & 0x7FFFFFFF);
-	m_trend_calculator[tID].AddValueAndReturnTendency(static_cast<double>(temp), _tTrendCalculator::TAVERAGE_TEMP);
+	{
+		std::lock_guard<std::mutex> lock(m_calculatorMutex);
+		m_trend_calculator[tID].AddValueAndReturnTendency(static_cast<double>(temp), _tTrendCalculator::TAVERAGE_TEMP);
+	}
 
 	m_notifications.CheckAndHandleNotification(DevRowIdx, pHardware->m_HwdID, ID, procResult.DeviceName, Unit, devType, subType, cmnd, szTmp);
 
@@ -3938,7 +4338,10 @@ void MainWorker::decode_TempHumBaro(const CDomoticzHardwareBase* pHardware, cons
 		return;
 
 	uint64_t tID = ((uint64_t)(pHardware->m_HwdID & 0x7FFFFFFF) << 32) | (DevRowIdx & 0x7FFFFFFF);
-	m_trend_calculator[tID].AddValueAndReturnTendency(static_cast<double>(temp), _tTrendCalculator::TAVERAGE_TEMP);
+	{
+		std::lock_guard<std::mutex> lock(m_calculatorMutex);
+		m_trend_calculator[tID].AddValueAndReturnTendency(static_cast<double>(temp), _tTrendCalculator::TAVERAGE_TEMP);
+	}
 
 	//calculate Altitude
 	//float seaLevelPressure=101325.0f;
@@ -4074,7 +4477,10 @@ void MainWorker::decode_TempBaro(const CDomoticzHardwareBase* pHardware, const t
 		return;
 
 	uint64_t tID = ((uint64_t)(pHardware->m_HwdID & 0x7FFFFFFF) << 32) | (DevRowIdx & 0x7FFFFFFF);
-	m_trend_calculator[tID].AddValueAndReturnTendency(static_cast<double>(temp), _tTrendCalculator::TAVERAGE_TEMP);
+	{
+		std::lock_guard<std::mutex> lock(m_calculatorMutex);
+		m_trend_calculator[tID].AddValueAndReturnTendency(static_cast<double>(temp), _tTrendCalculator::TAVERAGE_TEMP);
+	}
 
 	m_notifications.CheckAndHandleNotification(DevRowIdx, pHardware->m_HwdID, ID, procResult.DeviceName, Unit, devType, subType, cmnd, szTmp);
 
@@ -4178,7 +4584,10 @@ void MainWorker::decode_TempRain(const CDomoticzHardwareBase* pHardware, const t
 		return;
 
 	uint64_t tID = ((uint64_t)(pHardware->m_HwdID & 0x7FFFFFFF) << 32) | (DevRowIdx & 0x7FFFFFFF);
-	m_trend_calculator[tID].AddValueAndReturnTendency(static_cast<double>(temp), _tTrendCalculator::TAVERAGE_TEMP);
+	{
+		std::lock_guard<std::mutex> lock(m_calculatorMutex);
+		m_trend_calculator[tID].AddValueAndReturnTendency(static_cast<double>(temp), _tTrendCalculator::TAVERAGE_TEMP);
+	}
 
 	sprintf(szTmp, "%.1f", temp);
 	uint64_t DevRowIdxTemp = m_sql.UpdateValue(pHardware->m_HwdID, 0, ID.c_str(), Unit, pTypeTEMP, sTypeTEMP3, SignalLevel, BatteryLevel, cmnd, szTmp, procResult.DeviceName, true, procResult.Username.c_str());
@@ -11632,6 +12041,7 @@ bool MainWorker::GetSensorData(const uint64_t idx, int& nValue, std::string& sVa
 
 MainWorker::eSwitchLightReturnCode MainWorker::SwitchLightInt(const std::vector<std::string>& sd, std::string switchcmd, int level, const _tColor color, const bool IsTesting, const std::string& User)
 {
+	tracer::CSpan span("SwitchLight");
 	int HardwareID = atoi(sd[0].c_str());
 	int hindex = FindDomoticzHardware(HardwareID);
 	if (hindex == -1)
@@ -13763,56 +14173,28 @@ bool MainWorker::SwitchScene(const uint64_t idx, std::string switchcmd, const st
 void MainWorker::CheckSceneCode(const uint64_t DevRowIdx, const uint8_t dType, const uint8_t dSubType, const int nValue, const char* sValue, const std::string& User)
 {
 	//check for scene code
-	std::vector<std::vector<std::string> > result;
-
-	result = m_sql.safe_query("SELECT ID, Activators, SceneType FROM Scenes WHERE (Activators!='')");
-	if (!result.empty())
+	for (const auto& activator : m_sql.GetSceneActivators(DevRowIdx))
 	{
-		for (const auto& sd : result)
-		{
-			std::vector<std::string> arrayActivators;
-			StringSplit(sd[1], ";", arrayActivators);
-			for (const auto& sCodeCmd : arrayActivators)
-			{
-				std::vector<std::string> arrayCode;
-				StringSplit(sCodeCmd, ":", arrayCode);
-
-				std::string sID = arrayCode[0];
-				std::string sCode;
-				if (arrayCode.size() == 2)
-				{
-					sCode = arrayCode[1];
-				}
+		int rnValue = nValue;
 
-				uint64_t aID = std::stoull(sID);
-				if (aID == DevRowIdx)
-				{
-					uint64_t ID = std::stoull(sd[0]);
-					int scenetype = atoi(sd[2].c_str());
-					int rnValue = nValue;
-
-					if ((scenetype == SGTYPE_SCENE) && (!sCode.empty()))
-					{
-						//Also check code
-						int iCode = atoi(sCode.c_str());
-						if (iCode != nValue)
-							continue;
-						rnValue = 1; //A Scene can only be activated (On)
-					}
+		if ((activator.SceneType == SGTYPE_SCENE) && (activator.bHaveCode))
+		{
+			//Also check code
+			if (activator.Code != nValue)
+				continue;
+			rnValue = 1; //A Scene can only be activated (On)
+		}
 
-					std::string lstatus;
-					int llevel = 0;
-					bool bHaveDimmer = false;
-					bool bHaveGroupCmd = false;
-					int maxDimLevel = 0;
+		std::string lstatus;
+		int llevel = 0;
+		bool bHaveDimmer = false;
+		bool bHaveGroupCmd = false;
+		int maxDimLevel = 0;
 
-					GetLightStatus(dType, dSubType, STYPE_OnOff, rnValue, sValue, lstatus, llevel, bHaveDimmer, maxDimLevel, bHaveGroupCmd);
-					std::string switchcmd = (IsLightSwitchOn(lstatus) == true) ? "On" : "Off";
+		GetLightStatus(dType, dSubType, STYPE_OnOff, rnValue, sValue, lstatus, llevel, bHaveDimmer, maxDimLevel, bHaveGroupCmd);
+		std::string switchcmd = (IsLightSwitchOn(lstatus) == true) ? "On" : "Off";
 
-					m_sql.AddTaskItem(_tTaskItem::SwitchSceneEvent(0.2F, ID, switchcmd, "SceneTrigger", User));
-				}
-			}
-		}
+		m_sql.AddTaskItem(_tTaskItem::SwitchSceneEvent(0.2F, activator.SceneRowID, switchcmd, "SceneTrigger", User));
 	}
 }
 
@@ -14213,7 +14595,10 @@ bool MainWorker::UpdateDevice(const int HardwareID, const int OrgHardwareID, con
 				if (temp != 12345.0F)
 				{
 					uint64_t tID = ((uint64_t)(HardwareID & 0x7FFFFFFF) << 32) | (devidx & 0x7FFFFFFF);
-					m_trend_calculator[tID].AddValueAndReturnTendency(static_cast<double>(temp), _tTrendCalculator::TAVERAGE_TEMP);
+					{
+						std::lock_guard<std::mutex> lock(m_calculatorMutex);
+						m_trend_calculator[tID].AddValueAndReturnTendency(static_cast<double>(temp), _tTrendCalculator::TAVERAGE_TEMP);
+					}
 				}
 			}
 
@@ -14281,7 +14666,10 @@ bool MainWorker::UpdateDevice(const int HardwareID, const int OrgHardwareID, con
 
 					// Calculate temperature trend
 					uint64_t tID = ((uint64_t)(HardwareID & 0x7FFFFFFF) << 32) | (devidx & 0x7FFFFFFF);
-					m_trend_calculator[tID].AddValueAndReturnTendency(static_cast<double>(temp), _tTrendCalculator::TAVERAGE_TEMP);
+					{
+						std::lock_guard<std::mutex> lock(m_calculatorMutex);
+						m_trend_calculator[tID].AddValueAndReturnTendency(static_cast<double>(temp), _tTrendCalculator::TAVERAGE_TEMP);
+					}
 				}
 				if (!strarray[1].empty())
 				{
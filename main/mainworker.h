@@ -6,7 +6,13 @@
 #include "EventSystem.h"
 #include "NotificationSystem.h"
 #include "Camera.h"
+#include "mpsc_queue.h"
+#include "DeviceEventBus.h"
+#include "RxCapture.h"
+#include "Trace.h"
 #include <deque>
+#include <string_view>
+#include <unordered_set>
 #include "WindCalculation.h"
 #include "TrendCalculator.h"
 #include "../tcpserver/TCPServer.h"
@@ -96,6 +102,27 @@ public:
 	void SetInternalSecStatus(const std::string& User);
 	bool GetSensorData(uint64_t idx, int &nValue, std::string &sValue);
 
+	struct _tRxQueueStats
+	{
+		size_t depth = 0;
+		size_t maxDepth = 0;
+		size_t capacity = 0;
+		size_t shards = 0;
+		uint64_t processed = 0;
+		uint64_t dropped = 0;
+		uint64_t lastLatencyUs = 0;
+		uint64_t avgLatencyUs = 0;
+		uint64_t maxLatencyUs = 0;
+	};
+	_tRxQueueStats GetRxQueueStats();
+
+	// RX frame capture/replay (see RxCapture.h), set before Start()
+	void SetRxCaptureFile(const std::string &szFileName);
+	// szScratchDatabase: the database the replay may write to, besides :memory:
+	void SetRxReplay(const std::string &szFileName, const std::string &szScratchDatabase, double speed, bool bStopAfterReplay);
+	// number of RX decode threads, set before Start()
+	void SetRxShards(size_t nShards);
+
 	bool UpdateDevice(const int DevIdx, const int nValue, const std::string &sValue, const std::string &userName, const int signallevel = 12, const int batterylevel = 255,
 			  const bool parseTrigger = true);
 	bool UpdateDevice(const int HardwareID, const int OrgHardwareID, const std::string &DeviceID, const int unit, const int devType, const int subType, const int nValue, std::string sValue,
@@ -104,6 +131,8 @@ public:
 	boost::signals2::signal<void(const int m_HwdID, const uint64_t DeviceRowIdx, const std::string &DeviceName, const uint8_t *pRXCommand)> sOnDeviceReceived;
 	boost::signals2::signal<void(const int m_HwdID, const uint64_t DeviceRowIdx)> sOnDeviceUpdate;
 	boost::signals2::signal<void(const uint64_t SceneIdx, const std::string &SceneName)> sOnSwitchScene;
+	// sOnDeviceReceived/sOnDeviceUpdate are forwarded to this bus, exporters subscribe here to get them on their own thread
+	CDeviceEventBus m_deviceEventBus;
 
 	CScheduler m_scheduler;
 	CEventSystem m_eventsystem;
@@ -134,6 +163,8 @@ public:
 	std::vector<std::string> m_webthemes;
 	std::map<uint16_t, _tWindCalculator> m_wind_calculator;
 	std::map<uint64_t, _tTrendCalculator> m_trend_calculator;
+	std::mutex m_calculatorMutex; // guards m_wind_calculator/m_trend_calculator, they are updated from the RX decode threads
+	_tTrendCalculator::_eTendencyType GetTrendState(uint64_t tID);
 
 	time_t m_LastHeartbeat = 0;
 
@@ -167,7 +198,6 @@ private:
 	std::string m_szDomoticzUpdateChecksumURL;
 	bool m_bDoDownloadDomoticzUpdate;
 	bool m_bStartHardware;
-	uint8_t m_hardwareStartCounter;
 
 	std::vector<CDomoticzHardwareBase*> m_hardwaredevices;
 	http::server::server_settings m_webserver_settings;
@@ -182,7 +212,15 @@ private:
 
 	void Do_Work();
 	void Heartbeat();
-	void ParseRFXLogFile();
+	rxcapture::CRxCaptureWriter m_rxCapture;
+	std::string m_szRxCaptureFile;
+	std::string m_szRxReplayFile;
+	std::string m_szRxReplayDatabase;
+	double m_rxReplaySpeed = 0; // 0 = as fast as possible
+	bool m_bStopAfterRxReplay = false;
+	std::shared_ptr<std::thread> m_rxReplayThread;
+	void StartRxReplay();
+	void Do_Work_RxReplay();
 	bool WriteToHardware(int HwdID, const char *pdata, uint8_t length);
 
 	void OnHardwareConnected(CDomoticzHardwareBase *pHardware);
@@ -197,24 +235,69 @@ private:
 	uint8_t get_BateryLevel(_eHardwareTypes HwdType, bool bIsInPercentage, uint8_t level);
 
 	// RxMessage queue resources
-	volatile unsigned long m_rxMessageIdx;
-	std::shared_ptr<std::thread> m_rxMessageThread;
+	std::atomic<unsigned long> m_rxMessageIdx;
 	StoppableTask m_TaskRXMessage;
-	void Do_Work_On_Rx_Messages();
+	void Do_Work_On_Rx_Messages(size_t iShard);
 	struct _tRxQueueItem {
-		std::string Name;
-		int BatteryLevel;
-		unsigned long rxMessageIdx;
-		int hardwareId;
-		std::vector<uint8_t> vrxCommand;
-		boost::uint16_t crc;
-		queue_element_trigger* trigger;
-		std::string UserName;
+		int hardwareId = -1;
+		int BatteryLevel = 0;
+		unsigned long rxMessageIdx = 0;
+		const char *Name = "";	  // interned, see InternRxName; nullptr when the pool is full and the name is in NameCopy
+		const char *UserName = ""; // interned, or nullptr and in UserNameCopy
+		std::string NameCopy;
+		std::string UserNameCopy;
+		uint16_t crc = 0;
+		queue_element_trigger *trigger = nullptr;
+		rxcapture::CReplayStats *replayStats = nullptr; // set for replayed frames, their timings are added to it
+		std::chrono::steady_clock::time_point tEnqueued;
+		tracer::_tLink trace;
+		uint8_t rxCommand[256]; // RFX packets are at most 255+1 bytes
+
+		const char *GetName() const
+		{
+			return (Name != nullptr) ? Name : NameCopy.c_str();
+		}
+		const char *GetUserName() const
+		{
+			return (UserName != nullptr) ? UserName : UserNameCopy.c_str();
+		}
+
+		_tRxQueueItem() = default;
+		_tRxQueueItem(_tRxQueueItem &&) = default;
+		_tRxQueueItem &operator=(_tRxQueueItem &&) = default;
+		_tRxQueueItem(const _tRxQueueItem &) = delete;
+		_tRxQueueItem &operator=(const _tRxQueueItem &) = delete;
+	};
+	// messages are decoded in parallel, sharded by hardware id so the order per hardware (and device) is kept
+	// and a device row is only updated by one RX thread, see GetRxShard
+	struct _tRxShard {
+		mpsc_queue<_tRxQueueItem> queue{ 1024 };
+		std::shared_ptr<std::thread> thread;
 	};
-	concurrent_queue<_tRxQueueItem> m_rxMessageQueue;
+	std::vector<std::unique_ptr<_tRxShard>> m_rxShards;
+	_tRxShard &GetRxShard(int hardwareId);
+	std::mutex m_rxCommitMutex;
+	bool PushRxQueueItem(_tRxQueueItem &rxMessage, bool wait);
+
+	// names/usernames are mostly a small fixed set, store them once and pass pointers through the queue.
+	// The pool is capped, names that do not fit anymore are copied into the queue item
+	std::deque<std::string> m_rxNamePool;
+	std::unordered_set<std::string_view> m_rxNameIndex;
+	boost::shared_mutex m_rxNamePoolMutex;
+	bool m_bRxNamePoolFull = false;
+	const char *InternRxName(const char *szName);
+
+	std::atomic<size_t> m_rxQueueMaxDepth{ 0 };
+	std::atomic<uint64_t> m_rxQueueDropped{ 0 };
+	std::atomic<uint64_t> m_rxQueueProcessed{ 0 };
+	std::atomic<uint64_t> m_rxQueueLastLatencyUs{ 0 };
+	std::atomic<uint64_t> m_rxQueueTotalLatencyUs{ 0 };
+	std::atomic<uint64_t> m_rxQueueMaxLatencyUs{ 0 };
+	std::atomic<time_t> m_rxQueueLastDropLog{ 0 };
 	void UnlockRxMessageQueue();
 	void PushRxMessage(const CDomoticzHardwareBase *pHardware, const uint8_t *pRXCommand, const char *defaultName, int BatteryLevel, const char *userName);
 	void CheckAndPushRxMessage(const CDomoticzHardwareBase *pHardware, const uint8_t *pRXCommand, const char *defaultName, int BatteryLevel, const char *userName, bool wait);
+	void BuildRxQueueItem(_tRxQueueItem &rxMessage, int hardwareId, const uint8_t *pRXCommand, const char *defaultName, int BatteryLevel, const char *userName);
 	void ProcessRXMessage(const CDomoticzHardwareBase *pHardware, const uint8_t *pRXCommand, const char *defaultName, int BatteryLevel,
 			      const char *userName); // battery level: 0-100, 255=no battery, -1 = don't set
 
@@ -0,0 +1,128 @@
+/*
+ * mpsc_queue.h
+ *
+ * Bounded multi-producer / single-consumer ring buffer.
+ * Producers claim a slot with a single CAS (no mutex), the consumer only takes
+ * the mutex to sleep when the ring is empty.
+ *      Source: https://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue
+ */
+#pragma once
+#ifndef MAIN_MPSC_QUEUE_H_
+#define MAIN_MPSC_QUEUE_H_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+template<typename Data>
+class mpsc_queue {
+private:
+	struct slot {
+		std::atomic<size_t> sequence;
+		Data data;
+	};
+
+	std::unique_ptr<slot[]> the_slots;
+	size_t the_mask;
+	alignas(64) std::atomic<size_t> the_enqueue_pos;
+	alignas(64) std::atomic<size_t> the_dequeue_pos;
+	std::atomic<bool> the_consumer_waiting;
+	std::mutex the_mutex;
+	std::condition_variable the_condition_variable;
+
+	bool has_data() const {
+		size_t pos = the_dequeue_pos.load(std::memory_order_relaxed);
+		return the_slots[pos & the_mask].sequence.load(std::memory_order_acquire) == pos + 1;
+	}
+
+public:
+	// capacity is rounded up to the next power of two
+	explicit mpsc_queue(size_t capacity) : the_enqueue_pos(0), the_dequeue_pos(0), the_consumer_waiting(false) {
+		size_t size = 2;
+		while (size < capacity)
+			size <<= 1;
+		the_slots.reset(new slot[size]);
+		the_mask = size - 1;
+		for (size_t i = 0; i < size; i++)
+			the_slots[i].sequence.store(i, std::memory_order_relaxed);
+	}
+
+	mpsc_queue(const mpsc_queue&) = delete;
+	mpsc_queue& operator=(const mpsc_queue&) = delete;
+
+	size_t capacity() const {
+		return the_mask + 1;
+	}
+
+	// approximate when producers are active
+	size_t size() const {
+		size_t enq = the_enqueue_pos.load(std::memory_order_relaxed);
+		size_t deq = the_dequeue_pos.load(std::memory_order_relaxed);
+		return (enq > deq) ? enq - deq : 0;
+	}
+
+	bool empty() const {
+		return !has_data();
+	}
+
+	// Any thread. Returns false (and leaves data untouched) when the ring is full.
+	bool try_push(Data& data) {
+		slot* pSlot;
+		size_t pos = the_enqueue_pos.load(std::memory_order_relaxed);
+		for (;;) {
+			pSlot = &the_slots[pos & the_mask];
+			size_t seq = pSlot->sequence.load(std::memory_order_acquire);
+			intptr_t dif = (intptr_t)seq - (intptr_t)pos;
+			if (dif == 0) {
+				if (the_enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+					break;
+			}
+			else if (dif < 0)
+				return false;
+			else
+				pos = the_enqueue_pos.load(std::memory_order_relaxed);
+		}
+		pSlot->data = std::move(data);
+		pSlot->sequence.store(pos + 1, std::memory_order_release);
+
+		// pairs with the fence in timed_wait_and_pop, so either the consumer sees the slot or we see it waiting
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (the_consumer_waiting.load(std::memory_order_relaxed)) {
+			std::lock_guard<std::mutex> lock(the_mutex);
+			the_condition_variable.notify_one();
+		}
+		return true;
+	}
+
+	// Consumer thread only
+	bool try_pop(Data& popped_value) {
+		size_t pos = the_dequeue_pos.load(std::memory_order_relaxed);
+		slot* pSlot = &the_slots[pos & the_mask];
+		if (pSlot->sequence.load(std::memory_order_acquire) != pos + 1)
+			return false;
+		popped_value = std::move(pSlot->data);
+		pSlot->sequence.store(pos + the_mask + 1, std::memory_order_release);
+		the_dequeue_pos.store(pos + 1, std::memory_order_relaxed);
+		return true;
+	}
+
+	// Consumer thread only
+	template<typename Duration>
+	bool timed_wait_and_pop(Data& popped_value, Duration const& wait_duration) {
+		if (try_pop(popped_value))
+			return true;
+		std::unique_lock<std::mutex> lock(the_mutex);
+		the_consumer_waiting.store(true, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		the_condition_variable.wait_for(lock, wait_duration, [this] { return has_data(); });
+		the_consumer_waiting.store(false, std::memory_order_relaxed);
+		lock.unlock();
+		return try_pop(popped_value);
+	}
+};
+
+#endif /* MAIN_MPSC_QUEUE_H_ */
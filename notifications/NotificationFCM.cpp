@@ -127,15 +127,13 @@ bool CNotificationFCM::SendMessageImplementation(
 
 	//Get All Devices
 	std::vector<std::vector<std::string>> mobileDevices;
-	std::string szQuery("SELECT ID,Active,Name,DeviceType,SenderID FROM MobileDevices");
 	if (!sMidx.empty()) {
-		szQuery += " WHERE (ID IN (" + sMidx + "))";
+		mobileDevices = m_sql.safe_query("SELECT ID,Active,Name,DeviceType,SenderID FROM MobileDevices WHERE (ID IN (%s))", sMidx.c_str());
 	}
 	else {
-		szQuery += " WHERE (Active == 1)";
+		mobileDevices = m_sql.safe_query("SELECT ID,Active,Name,DeviceType,SenderID FROM MobileDevices WHERE (Active == 1)");
 	}
 
-	mobileDevices = m_sql.safe_query(szQuery.c_str());
 	if (mobileDevices.empty())
 		return true;
 
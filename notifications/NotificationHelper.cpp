@@ -240,16 +240,87 @@ std::string CNotificationHelper::ParseCustomMessage(const std::string &cMessage,
 	return ret;
 }
 
-bool CNotificationHelper::ApplyRule(const std::string &rule, const bool equal, const bool less)
+bool CNotificationHelper::ApplyRule(const _eNotificationRule rule, const bool equal, const bool less)
 {
-	if (((rule == ">") || (rule == ">=")) && (!less) && (!equal))
-		return true;
-	if (((rule == "<") || (rule == "<=")) && (less))
-		return true;
-	if (((rule == "=") || (rule == ">=") || (rule == "<=")) && (equal))
+	switch (rule)
+	{
+	case NRULE_GREATER:
+		return (!less) && (!equal);
+	case NRULE_GREATEREQUAL:
+		return (!less) || (equal);
+	case NRULE_EQUAL:
+		return equal;
+	case NRULE_NOTEQUAL:
+		return !equal;
+	case NRULE_LESSEQUAL:
+		return (less) || (equal);
+	case NRULE_LESS:
+		return less;
+	default:
+		return false;
+	}
+}
+
+//Splits the Params string once, so the handlers do not have to parse it on every sensor update
+void CNotificationHelper::CompileParams(_tNotification &n)
+{
+	std::vector<std::string> splitresults;
+	StringSplit(n.Params, ";", splitresults);
+	n.ParamCount = splitresults.size();
+	n.NType = -1;
+	n.When.clear();
+	n.Rule = NRULE_NONE;
+	n.Value = 0.0F;
+	n.Recovery = false;
+	if (splitresults.empty())
+		return;
+
+	n.NType = Notification_Type_FromDesc(splitresults[0], 1);
+	if (splitresults.size() > 1)
+	{
+		n.When = splitresults[1];
+		if (n.When == ">")
+			n.Rule = NRULE_GREATER;
+		else if (n.When == ">=")
+			n.Rule = NRULE_GREATEREQUAL;
+		else if (n.When == "=")
+			n.Rule = NRULE_EQUAL;
+		else if (n.When == "!=")
+			n.Rule = NRULE_NOTEQUAL;
+		else if (n.When == "<=")
+			n.Rule = NRULE_LESSEQUAL;
+		else if (n.When == "<")
+			n.Rule = NRULE_LESS;
+	}
+	if (splitresults.size() > 2)
+		n.Value = static_cast<float>(atof(splitresults[2].c_str()));
+	if (splitresults.size() > 3)
+		n.Recovery = (splitresults[3] == "1");
+}
+
+//Returns the custom message of a rule, or (isRecovery) the pending recovery message
+bool CNotificationHelper::GetCustomMessage(const _tNotification &n, std::string &msg, const bool isRecovery)
+{
+	if (n.CustomMessage.empty())
+		return false;
+	if ((isRecovery) && (!n.Recovery))
+		return false;
+	std::vector<std::string> splitresults;
+	StringSplit(n.CustomMessage, ";;", splitresults);
+	if (splitresults.empty())
+		return false;
+	if (!isRecovery)
+	{
+		if (splitresults[0].empty())
+			return false;
+		msg = splitresults[0];
 		return true;
-	if ((rule == "!=") && (!equal))
+	}
+	if ((splitresults.size() > 1) && (!splitresults[1].empty()))
+	{
+		msg = splitresults[1];
 		return true;
+	}
 	return false;
 }
 
@@ -438,6 +509,8 @@ bool CNotificationHelper::CheckAndHandleNotification(const uint64_t DevRowIdx, c
 		case pTypeGeneral:
 			switch(cSubType) {
 				case sTypeVisibility:
+					if (!HasNotification(DevRowIdx, NTYPE_USAGE, true))
+						return false;
 					m_sql.GetMeterType(HardwareID, ID.c_str(), unit, cType, cSubType, meterType);
 					fValue2 = fValue;
 					if (meterType == 1) {
@@ -446,6 +519,8 @@ bool CNotificationHelper::CheckAndHandleNotification(const uint64_t DevRowIdx, c
 					}
 					return CheckAndHandleNotification(DevRowIdx, sName, cType, cSubType, NTYPE_USAGE, fValue2);
 				case sTypeDistance:
+					if (!HasNotification(DevRowIdx, NTYPE_USAGE, true))
+						return false;
 					m_sql.GetMeterType(HardwareID, ID.c_str(), unit, cType, cSubType, meterType);
 					fValue2 = fValue;
 					if (meterType == 1) {
@@ -522,8 +597,8 @@ bool CNotificationHelper::CheckAndHandleTempHumidityNotification(
 	const bool bHaveTemp,
 	const bool bHaveHumidity)
 {
-	std::vector<_tNotification> notifications = GetNotifications(Idx);
-	if (notifications.empty())
+	std::vector<_tNotification> notifications;
+	if (!GetNotifications(Idx, { NTYPE_TEMPERATURE, NTYPE_HUMIDITY }, true, notifications))
 		return false;
 
 	char szTmp[600];
@@ -540,33 +615,25 @@ bool CNotificationHelper::CheckAndHandleTempHumidityNotification(
 	std::string msg;
 
 	std::string label = Notification_Type_Label(NTYPE_TEMPERATURE);
-	std::string signtemp = Notification_Type_Desc(NTYPE_TEMPERATURE, 1);
-	std::string signhum = Notification_Type_Desc(NTYPE_HUMIDITY, 1);
 
 	for (const auto &n : notifications)
 	{
-		if (n.LastUpdate)
-			TouchLastUpdate(n.ID);
-
 		if ((atime >= n.LastSend) || (n.SendAlways) || (!n.CustomMessage.empty())) // emergency always goes true
 		{
 			std::string recoverymsg;
 			bool bRecoveryMessage = false;
-			bRecoveryMessage = CustomRecoveryMessage(n.ID, recoverymsg, true);
+			bRecoveryMessage = GetCustomMessage(n, recoverymsg, true);
 			if ((atime < n.LastSend) && (!n.SendAlways) && (!bRecoveryMessage))
 				continue;
-			std::vector<std::string> splitresults;
-			StringSplit(n.Params, ";", splitresults);
-			if (splitresults.size() < 3)
+			if (n.ParamCount < 3)
 				continue; //impossible
-			std::string ntype = splitresults[0];
 			std::string custommsg;
-			float svalue = static_cast<float>(atof(splitresults[2].c_str()));
+			float svalue = n.Value;
 			bool bSendNotification = false;
 			bool bCustomMessage = false;
-			bCustomMessage = CustomRecoveryMessage(n.ID, custommsg, false);
+			bCustomMessage = GetCustomMessage(n, custommsg, false);
 
-			if ((ntype == signtemp) && (bHaveTemp))
+			if ((n.NType == NTYPE_TEMPERATURE) && (bHaveTemp))
 			{
 				//temperature
 				if (m_sql.m_tempunit == TEMPUNIT_F)
@@ -582,10 +649,10 @@ bool CNotificationHelper::CheckAndHandleTempHumidityNotification(
 				else if (temp > 10.0) szExtraData += "Image=temp-10-15|";
 				else if (temp > 5.0) szExtraData += "Image=temp-5-10|";
 				else szExtraData += "Image=temp48|";
-				bSendNotification = ApplyRule(splitresults[1], (temp == svalue), (temp < svalue));
+				bSendNotification = ApplyRule(n.Rule, (temp == svalue), (temp < svalue));
 				if (bSendNotification && (!bRecoveryMessage || n.SendAlways))
 				{
-					sprintf(szTmp, "%s Temperature is %.1f %s [%s %.1f %s]", devicename.c_str(), temp, label.c_str(), splitresults[1].c_str(), svalue, label.c_str());
+					sprintf(szTmp, "%s Temperature is %.1f %s [%s %.1f %s]", devicename.c_str(), temp, label.c_str(), n.When.c_str(), svalue, label.c_str());
 					msg = szTmp;
 					sprintf(szTmp, "%.1f", temp);
 					notValue = szTmp;
@@ -602,14 +669,14 @@ bool CNotificationHelper::CheckAndHandleTempHumidityNotification(
 					bSendNotification = false;
 				}
 			}
-			else if ((ntype == signhum) && (bHaveHumidity))
+			else if ((n.NType == NTYPE_HUMIDITY) && (bHaveHumidity))
 			{
 				//humidity
 				szExtraData += "Image=moisture48|";
-				bSendNotification = ApplyRule(splitresults[1], (humidity == svalue), (humidity < svalue));
+				bSendNotification = ApplyRule(n.Rule, (humidity == svalue), (humidity < svalue));
 				if (bSendNotification && (!bRecoveryMessage || n.SendAlways))
 				{
-					sprintf(szTmp, "%s Humidity is %d %% [%s %.0f %%]", devicename.c_str(), humidity, splitresults[1].c_str(), svalue);
+					sprintf(szTmp, "%s Humidity is %d %% [%s %.0f %%]", devicename.c_str(), humidity, n.When.c_str(), svalue);
 					msg = szTmp;
 					sprintf(szTmp, "%d", humidity);
 					notValue = szTmp;
@@ -648,8 +715,8 @@ bool CNotificationHelper::CheckAndHandleDewPointNotification(
 	const float temp,
 	const float dewpoint)
 {
-	std::vector<_tNotification> notifications = GetNotifications(Idx);
-	if (notifications.empty())
+	std::vector<_tNotification> notifications;
+	if (!GetNotifications(Idx, { NTYPE_DEWPOINT }, true, notifications))
 		return false;
 
 	char szTmp[600];
@@ -664,21 +731,11 @@ bool CNotificationHelper::CheckAndHandleDewPointNotification(
 
 	std::string msg;
 
-	std::string signdewpoint = Notification_Type_Desc(NTYPE_DEWPOINT, 1);
-
 	for (const auto &n : notifications)
 	{
-		if (n.LastUpdate)
-			TouchLastUpdate(n.ID);
 		if ((atime >= n.LastSend) || (n.SendAlways)) // emergency always goes true
 		{
-			std::vector<std::string> splitresults;
-			StringSplit(n.Params, ";", splitresults);
-			if (splitresults.empty())
-				continue; //impossible
-			std::string ntype = splitresults[0];
-
-			if (ntype == signdewpoint)
+			if (n.NType == NTYPE_DEWPOINT)
 			{
 				//dewpoint
 				if (temp <= dewpoint)
@@ -704,8 +761,8 @@ bool CNotificationHelper::CheckAndHandleValueNotification(
 	const std::string &DeviceName,
 	const int value)
 {
-	std::vector<_tNotification> notifications = GetNotifications(Idx);
-	if (notifications.empty())
+	std::vector<_tNotification> notifications;
+	if (!GetNotifications(Idx, { NTYPE_VALUE }, true, notifications))
 		return false;
 
 	char szTmp[600];
@@ -719,22 +776,16 @@ bool CNotificationHelper::CheckAndHandleValueNotification(
 	std::string msg;
 	std::string notValue;
 
-	std::string signvalue = Notification_Type_Desc(NTYPE_VALUE, 1);
-
 	for (const auto &n : notifications)
 	{
-		if (n.LastUpdate)
-			TouchLastUpdate(n.ID);
 		if ((atime >= n.LastSend) || (n.SendAlways)) // emergency always goes true
 		{
-			std::vector<std::string> splitresults;
-			StringSplit(n.Params, ";", splitresults);
-			if (splitresults.size() < 2)
+			if (n.ParamCount < 2)
 				continue; //impossible
-			std::string ntype = splitresults[0];
-			int svalue = static_cast<int>(atoi(splitresults[1].c_str()));
+			//value rules store the threshold as the second parameter
+			int svalue = atoi(n.When.c_str());
 
-			if (ntype == signvalue)
+			if (n.NType == NTYPE_VALUE)
 			{
 				if (value > svalue)
 				{
@@ -761,8 +812,8 @@ bool CNotificationHelper::CheckAndHandleAmpere123Notification(
 	const float Ampere2,
 	const float Ampere3)
 {
-	std::vector<_tNotification> notifications = GetNotifications(Idx);
-	if (notifications.empty())
+	std::vector<_tNotification> notifications;
+	if (!GetNotifications(Idx, { NTYPE_AMPERE1, NTYPE_AMPERE2, NTYPE_AMPERE3 }, true, notifications))
 		return false;
 
 	char szTmp[600];
@@ -778,54 +829,29 @@ bool CNotificationHelper::CheckAndHandleAmpere123Notification(
 
 	std::string notValue;
 
-	std::string signamp1 = Notification_Type_Desc(NTYPE_AMPERE1, 1);
-	std::string signamp2 = Notification_Type_Desc(NTYPE_AMPERE2, 1);
-	std::string signamp3 = Notification_Type_Desc(NTYPE_AMPERE3, 1);
-
 	for (const auto &n : notifications)
 	{
-		if (n.LastUpdate)
-			TouchLastUpdate(n.ID);
-
 		if ((atime >= n.LastSend) || (n.SendAlways) || (!n.CustomMessage.empty())) // emergency always goes true
 		{
 			std::string recoverymsg;
 			bool bRecoveryMessage = false;
-			bRecoveryMessage = CustomRecoveryMessage(n.ID, recoverymsg, true);
+			bRecoveryMessage = GetCustomMessage(n, recoverymsg, true);
 			if ((atime < n.LastSend) && (!n.SendAlways) && (!bRecoveryMessage))
 				continue;
-			std::vector<std::string> splitresults;
-			StringSplit(n.Params, ";", splitresults);
-			if (splitresults.size() < 3)
+			if (n.ParamCount < 3)
 				continue; //impossible
-			std::string ntype = splitresults[0];
 			std::string custommsg;
-			std::string ltype;
-			float svalue = static_cast<float>(atof(splitresults[2].c_str()));
-			float ampere = 0.0F;
+			std::string ltype = Notification_Type_Desc(n.NType, 0);
+			float svalue = n.Value;
+			float ampere = (n.NType == NTYPE_AMPERE1) ? Ampere1 : (n.NType == NTYPE_AMPERE2) ? Ampere2 : Ampere3;
 			bool bSendNotification = false;
 			bool bCustomMessage = false;
-			bCustomMessage = CustomRecoveryMessage(n.ID, custommsg, false);
+			bCustomMessage = GetCustomMessage(n, custommsg, false);
 
-			if (ntype == signamp1)
-			{
-				ampere = Ampere1;
-				ltype = Notification_Type_Desc(NTYPE_AMPERE1, 0);
-			}
-			else if (ntype == signamp2)
-			{
-				ampere = Ampere2;
-				ltype = Notification_Type_Desc(NTYPE_AMPERE2, 0);
-			}
-			else if (ntype == signamp3)
-			{
-				ampere = Ampere3;
-				ltype = Notification_Type_Desc(NTYPE_AMPERE3, 0);
-			}
-			bSendNotification = ApplyRule(splitresults[1], (ampere == svalue), (ampere < svalue));
+			bSendNotification = ApplyRule(n.Rule, (ampere == svalue), (ampere < svalue));
 			if (bSendNotification && (!bRecoveryMessage || n.SendAlways))
 			{
-				sprintf(szTmp, "%s %s is %.1f Ampere [%s %.1f Ampere]", devicename.c_str(), ltype.c_str(), ampere, splitresults[1].c_str(), svalue);
+				sprintf(szTmp, "%s %s is %.1f Ampere [%s %.1f Ampere]", devicename.c_str(), ltype.c_str(), ampere, n.When.c_str(), svalue);
 				msg = szTmp;
 				sprintf(szTmp, "%.1f", ampere);
 				notValue = szTmp;
@@ -863,16 +889,11 @@ bool CNotificationHelper::CheckAndHandleNotification(
 	const _eNotificationTypes ntype,
 	const std::string &message)
 {
-	std::vector<_tNotification> notifications = GetNotifications(Idx);
-	if (notifications.empty())
+	std::vector<_tNotification> notifications;
+	if (!GetNotifications(Idx, { ntype }, true, notifications))
 		return false;
 
-	std::vector<std::vector<std::string> > result;
-	result = m_sql.safe_query("SELECT SwitchType, CustomImage FROM DeviceStatus WHERE (ID=%" PRIu64 ")", Idx);
-	if (result.empty())
-		return false;
-
-	std::string szExtraData = "|Name=" + devicename + "|SwitchType=" + result[0][0] + "|CustomImage=" + result[0][1] + "|";
+	std::string szExtraData;
 	std::string notValue;
 
 	time_t atime = mytime(nullptr);
@@ -880,20 +901,19 @@ bool CNotificationHelper::CheckAndHandleNotification(
 	//check if not sent 12 hours ago, and if applicable
 	atime -= m_NotificationSensorInterval;
 
-	std::string ltype = Notification_Type_Desc(ntype, 1);
 	for (const auto &n : notifications)
 	{
-		if (n.LastUpdate)
-			TouchLastUpdate(n.ID);
-		std::vector<std::string> splitresults;
-		StringSplit(n.Params, ";", splitresults);
-		if (splitresults.empty())
-			continue; //impossible
-		std::string atype = splitresults[0];
-		if (atype == ltype)
+		if (n.NType == ntype)
 		{
 			if ((atime >= n.LastSend) || (n.SendAlways)) // emergency always goes true
 			{
+				if (szExtraData.empty())
+				{
+					auto result = m_sql.safe_query("SELECT SwitchType, CustomImage FROM DeviceStatus WHERE (ID=%" PRIu64 ")", Idx);
+					if (result.empty())
+						return false;
+					szExtraData = "|Name=" + devicename + "|SwitchType=" + result[0][0] + "|CustomImage=" + result[0][1] + "|";
+				}
 				std::string msg = message;
 				if (!n.CustomMessage.empty())
 					msg = ParseCustomMessage(n.CustomMessage, devicename, notValue);
@@ -913,11 +933,10 @@ bool CNotificationHelper::CheckAndHandleNotification(
 	const _eNotificationTypes ntype,
 	const float mvalue)
 {
-	std::vector<_tNotification> notifications = GetNotifications(Idx);
-	if (notifications.empty())
+	std::vector<_tNotification> notifications;
+	if (!GetNotifications(Idx, { ntype }, true, notifications))
 		return false;
 
-
 	double intpart;
 	std::string pvalue;
 	if (modf(mvalue, &intpart) == 0)
@@ -925,12 +944,9 @@ bool CNotificationHelper::CheckAndHandleNotification(
 	else
 		pvalue = std_format("%.1f", mvalue);
 
-	std::vector<std::vector<std::string> > result;
-	result = m_sql.safe_query("SELECT SwitchType, sValue FROM DeviceStatus WHERE (ID=%" PRIu64 ")", Idx);
-	if (result.empty())
-		return false;
-	std::string szExtraData = "|Name=" + devicename + "|SwitchType=" + result[0][0] + "|";
-	std::string sValue = result[0][1];
+	//only read from the database when a rule fires
+	std::string szExtraData;
+	std::string sValue;
 
 	time_t atime = mytime(nullptr);
 
@@ -940,38 +956,39 @@ bool CNotificationHelper::CheckAndHandleNotification(
 	std::string msg;
 
 	std::string ltype = Notification_Type_Desc(ntype, 0);
-	std::string nsign = Notification_Type_Desc(ntype, 1);
 	std::string label = Notification_Type_Label(ntype);
 
 	for (const auto &n : notifications)
 	{
-		if (n.LastUpdate)
-			TouchLastUpdate(n.ID);
-
 		if ((atime >= n.LastSend) || (n.SendAlways) || (!n.CustomMessage.empty())) // emergency always goes true
 		{
 			std::string recoverymsg;
 			bool bRecoveryMessage = false;
-			bRecoveryMessage = CustomRecoveryMessage(n.ID, recoverymsg, true);
+			bRecoveryMessage = GetCustomMessage(n, recoverymsg, true);
 			if ((atime < n.LastSend) && (!n.SendAlways) && (!bRecoveryMessage))
 				continue;
-			std::vector<std::string> splitresults;
-			StringSplit(n.Params, ";", splitresults);
-			if (splitresults.size() < 3)
+			if (n.ParamCount < 3)
 				continue; //impossible
-			std::string ntype = splitresults[0];
 			std::string custommsg;
-			float svalue = static_cast<float>(atof(splitresults[2].c_str()));
+			float svalue = n.Value;
 			bool bSendNotification = false;
 			bool bCustomMessage = false;
-			bCustomMessage = CustomRecoveryMessage(n.ID, custommsg, false);
 
-			if (ntype == nsign)
+			if (n.NType == ntype)
 			{
-				bSendNotification = ApplyRule(splitresults[1], (mvalue == svalue), (mvalue < svalue));
+				bSendNotification = ApplyRule(n.Rule, (mvalue == svalue), (mvalue < svalue));
+				if ((bSendNotification || bRecoveryMessage) && (szExtraData.empty()))
+				{
+					auto result = m_sql.safe_query("SELECT SwitchType, sValue FROM DeviceStatus WHERE (ID=%" PRIu64 ")", Idx);
+					if (result.empty())
+						return false;
+					szExtraData = "|Name=" + devicename + "|SwitchType=" + result[0][0] + "|";
+					sValue = result[0][1];
+				}
+				bCustomMessage = GetCustomMessage(n, custommsg, false);
 				if (bSendNotification && (!bRecoveryMessage || n.SendAlways))
 				{
-					msg = std_format("%s %s is %s %s [%s %.1f %s]", devicename.c_str(), ltype.c_str(), pvalue.c_str(), label.c_str(), splitresults[1].c_str(), svalue, label.c_str());
+					msg = std_format("%s %s is %s %s [%s %.1f %s]", devicename.c_str(), ltype.c_str(), pvalue.c_str(), label.c_str(), n.When.c_str(), svalue, label.c_str());
 					if ((devType == pTypeGeneral) && (subType == sTypeAlert))
 					{
 						msg += " (" + sValue + ")";
@@ -1020,23 +1037,15 @@ bool CNotificationHelper::CheckAndHandleSwitchNotification(
 	const std::string &devicename,
 	const _eNotificationTypes ntype)
 {
-	std::vector<_tNotification> notifications = GetNotifications(Idx);
-	if (notifications.empty())
+	std::vector<_tNotification> notifications;
+	if (!GetNotifications(Idx, { ntype }, false, notifications))
 		return false;
 
-	std::vector<std::vector<std::string> > result;
-
-	result = m_sql.safe_query("SELECT SwitchType, CustomImage FROM DeviceStatus WHERE (ID=%" PRIu64 ")",
-		Idx);
-	if (result.empty())
-		return false;
-	_eSwitchType switchtype = (_eSwitchType)atoi(result[0][0].c_str());
-	std::string szExtraData = "|Name=" + devicename + "|SwitchType=" + result[0][0] + "|CustomImage=" + result[0][1] + "|";
+	_eSwitchType switchtype = STYPE_OnOff;
+	std::string szExtraData;
 
 	std::string msg;
 
-	std::string ltype = Notification_Type_Desc(ntype, 1);
-
 	time_t atime = mytime(nullptr);
 	atime -= m_NotificationSwitchInterval;
 
@@ -1044,17 +1053,19 @@ bool CNotificationHelper::CheckAndHandleSwitchNotification(
 	{
 		if ((atime >= n.LastSend) || (n.SendAlways)) // emergency always goes true
 		{
-			std::vector<std::string> splitresults;
-			StringSplit(n.Params, ";", splitresults);
-			if (splitresults.empty())
-				continue; //impossible
-			std::string atype = splitresults[0];
-
 			bool bSendNotification = false;
 			std::string notValue;
 
-			if (atype == ltype)
+			if (n.NType == ntype)
 			{
+				if (szExtraData.empty())
+				{
+					auto result = m_sql.safe_query("SELECT SwitchType, CustomImage FROM DeviceStatus WHERE (ID=%" PRIu64 ")", Idx);
+					if (result.empty())
+						return false;
+					switchtype = (_eSwitchType)atoi(result[0][0].c_str());
+					szExtraData = "|Name=" + devicename + "|SwitchType=" + result[0][0] + "|CustomImage=" + result[0][1] + "|";
+				}
 				bSendNotification = true;
 				msg = devicename;
 				if (ntype == NTYPE_SWITCH_ON)
@@ -1133,23 +1144,16 @@ bool CNotificationHelper::CheckAndHandleSwitchNotification(
 	const _eNotificationTypes ntype,
 	const int llevel)
 {
-	std::vector<_tNotification> notifications = GetNotifications(Idx);
-	if (notifications.empty())
+	std::vector<_tNotification> notifications;
+	if (!GetNotifications(Idx, { ntype }, false, notifications))
 		return false;
-	std::vector<std::vector<std::string> > result;
 
-	result = m_sql.safe_query("SELECT SwitchType, CustomImage, Options FROM DeviceStatus WHERE (ID=%" PRIu64 ")",
-		Idx);
-	if (result.empty())
-		return false;
-	_eSwitchType switchtype = (_eSwitchType)atoi(result[0][0].c_str());
-	std::string szExtraData = "|Name=" + devicename + "|SwitchType=" + result[0][0] + "|CustomImage=" + result[0][1] + "|";
-	std::string sOptions = result[0][2];
+	_eSwitchType switchtype = STYPE_OnOff;
+	std::string szExtraData;
+	std::string sOptions;
 
 	std::string msg;
 
-	std::string ltype = Notification_Type_Desc(ntype, 1);
-
 	time_t atime = mytime(nullptr);
 	atime -= m_NotificationSwitchInterval;
 
@@ -1157,62 +1161,67 @@ bool CNotificationHelper::CheckAndHandleSwitchNotification(
 	{
 		if ((atime >= n.LastSend) || (n.SendAlways)) // emergency always goes true
 		{
-			std::vector<std::string> splitresults;
-			StringSplit(n.Params, ";", splitresults);
-			if (splitresults.empty())
-				continue; //impossible
-			std::string atype = splitresults[0];
-
 			bool bSendNotification = false;
 			std::string notValue;
 
-			if (atype == ltype)
+			if (n.NType == ntype)
 			{
 				msg = devicename;
 				if (ntype == NTYPE_SWITCH_ON)
 				{
-					if (splitresults.size() < 3)
+					if (n.ParamCount < 3)
 						continue; //impossible
-					bool bWhenEqual = (splitresults[1] == "=");
-					int iLevel = atoi(splitresults[2].c_str());
-					if (!bWhenEqual || iLevel < 10 || iLevel > 100)
+					int iLevel = static_cast<int>(n.Value);
+					if ((n.Rule != NRULE_EQUAL) || iLevel < 10 || iLevel > 100)
 						continue; //invalid
 
 					if (llevel == iLevel)
-					{
 						bSendNotification = true;
-						std::string sLevel = std::to_string(llevel);
-						szExtraData += "Status=Level " + sLevel + "|";
-
-						if (switchtype == STYPE_Selector)
-						{
-							std::map<std::string, std::string> options = m_sql.BuildDeviceOptions(sOptions);
-							std::string levelNames = options["LevelNames"];
-							std::vector<std::string> splitresults;
-							StringSplit(levelNames, "|", splitresults);
-							msg += " >> " + splitresults[(llevel / 10)];
-							notValue = ">> " + splitresults[(llevel / 10)];
-						}
-						else
-						{
-							msg += " >> LEVEL " + sLevel;
-							notValue = ">> LEVEL " + sLevel;
-						}
+				}
+				else
+					bSendNotification = true;
+			}
+			if (bSendNotification)
+			{
+				if (szExtraData.empty())
+				{
+					auto result = m_sql.safe_query("SELECT SwitchType, CustomImage, Options FROM DeviceStatus WHERE (ID=%" PRIu64 ")", Idx);
+					if (result.empty())
+						return false;
+					switchtype = (_eSwitchType)atoi(result[0][0].c_str());
+					szExtraData = "|Name=" + devicename + "|SwitchType=" + result[0][0] + "|CustomImage=" + result[0][1] + "|";
+					sOptions = result[0][2];
+				}
+				std::string szStatusData;
+				if (ntype == NTYPE_SWITCH_ON)
+				{
+					std::string sLevel = std::to_string(llevel);
+					szStatusData = "Status=Level " + sLevel + "|";
+
+					if (switchtype == STYPE_Selector)
+					{
+						std::map<std::string, std::string> options = m_sql.BuildDeviceOptions(sOptions);
+						std::string levelNames = options["LevelNames"];
+						std::vector<std::string> splitresults;
+						StringSplit(levelNames, "|", splitresults);
+						msg += " >> " + splitresults[(llevel / 10)];
+						notValue = ">> " + splitresults[(llevel / 10)];
+					}
+					else
+					{
+						msg += " >> LEVEL " + sLevel;
+						notValue = ">> LEVEL " + sLevel;
 					}
 				}
 				else
 				{
-					bSendNotification = true;
-					szExtraData += "Status=Off|";
+					szStatusData = "Status=Off|";
 					msg += " >> OFF";
 					notValue = ">> OFF";
 				}
-			}
-			if (bSendNotification)
-			{
 				if (!n.CustomMessage.empty())
 					msg = ParseCustomMessage(n.CustomMessage, devicename, notValue);
-				SendMessageEx(Idx, devicename, n.ActiveSystems, n.CustomAction, msg, msg, szExtraData, n.Priority, std::string(""), true);
+				SendMessageEx(Idx, devicename, n.ActiveSystems, n.CustomAction, msg, msg, szExtraData + szStatusData, n.Priority, std::string(""), true);
 				TouchNotification(n.ID);
 			}
 		}
@@ -1228,6 +1237,9 @@ bool CNotificationHelper::CheckAndHandleRainNotification(
 	const _eNotificationTypes ntype,
 	const float mvalue)
 {
+	if (!HasNotification(Idx, ntype, true))
+		return false;
+
 	std::vector<std::vector<std::string> > result;
 
 	result = m_sql.safe_query("SELECT AddjValue,AddjMulti FROM DeviceStatus WHERE (ID=%" PRIu64 ")",
@@ -1288,206 +1300,175 @@ bool CNotificationHelper::CheckAndHandleRainNotification(
 
 void CNotificationHelper::CheckAndHandleLastUpdateNotification()
 {
-	if (m_notifications.empty())
+	FlushLastSend();
+
+	std::vector<std::pair<uint64_t, _tNotification>> notifications;
+	{
+		std::lock_guard<std::mutex> l(m_mutex);
+		for (const auto &n : m_notifications)
+		{
+			for (const auto &n2 : n.second)
+			{
+				if ((n2.NType == NTYPE_LASTUPDATE) && (n2.LastUpdate))
+					notifications.emplace_back(n.first, n2);
+			}
+		}
+	}
+	if (notifications.empty())
 		return;
 
 	time_t atime = mytime(nullptr);
 	atime -= m_NotificationSensorInterval;
 
-	for (const auto &n : m_notifications)
+	for (const auto &n : notifications)
 	{
-		for (const auto &n2 : n.second)
+		const _tNotification &n2 = n.second;
+		if ((atime >= n2.LastSend) || (n2.SendAlways) || (!n2.CustomMessage.empty())) // emergency always goes true
 		{
-			if (((atime >= n2.LastSend) || (n2.SendAlways) || (!n2.CustomMessage.empty()))
-			    && (n2.LastUpdate)) // emergency always goes true
+			if (n2.ParamCount < 3)
+				continue;
+			std::string recoverymsg;
+			bool bRecoveryMessage = false;
+			bRecoveryMessage = GetCustomMessage(n2, recoverymsg, true);
+			if ((atime < n2.LastSend) && (!n2.SendAlways) && (!bRecoveryMessage))
+				continue;
+			extern time_t m_StartTime;
+			time_t btime = mytime(nullptr);
+			std::string msg;
+			std::string szExtraData;
+			std::string custommsg;
+			uint64_t Idx = n.first;
+			uint32_t SensorTimeOut = static_cast<uint32_t>(n2.Value); // minutes
+			uint32_t diff = static_cast<uint32_t>(round(difftime(btime, n2.LastUpdate)));
+			bool bStartTime = (difftime(btime, m_StartTime) < SensorTimeOut * 60);
+			bool bSendNotification = ApplyRule(n2.Rule, (diff == SensorTimeOut * 60), (diff < SensorTimeOut * 60));
+			bool bCustomMessage = false;
+			bCustomMessage = GetCustomMessage(n2, custommsg, false);
+
+			if (bSendNotification && !bStartTime && (!bRecoveryMessage || n2.SendAlways))
 			{
-				std::vector<std::string> splitresults;
-				StringSplit(n2.Params, ";", splitresults);
-				if (splitresults.size() < 3)
+				if (SystemUptime() < SensorTimeOut * 60 && (!bRecoveryMessage || n2.SendAlways))
 					continue;
-				std::string ttype = Notification_Type_Desc(NTYPE_LASTUPDATE, 1);
-				if (splitresults[0] == ttype)
-				{
-					std::string recoverymsg;
-					bool bRecoveryMessage = false;
-					bRecoveryMessage = CustomRecoveryMessage(n2.ID, recoverymsg, true);
-					if ((atime < n2.LastSend) && (!n2.SendAlways) && (!bRecoveryMessage))
-						continue;
-					extern time_t m_StartTime;
-					time_t btime = mytime(nullptr);
-					std::string msg;
-					std::string szExtraData;
-					std::string custommsg;
-					uint64_t Idx = n.first;
-					uint32_t SensorTimeOut = static_cast<uint32_t>(atoi(splitresults[2].c_str()));  // minutes
-					uint32_t diff = static_cast<uint32_t>(round(difftime(btime, n2.LastUpdate)));
-					bool bStartTime = (difftime(btime, m_StartTime) < SensorTimeOut * 60);
-					bool bSendNotification = ApplyRule(splitresults[1], (diff == SensorTimeOut * 60), (diff < SensorTimeOut * 60));
-					bool bCustomMessage = false;
-					bCustomMessage = CustomRecoveryMessage(n2.ID, custommsg, false);
-
-					if (bSendNotification && !bStartTime && (!bRecoveryMessage || n2.SendAlways))
-					{
-						if (SystemUptime() < SensorTimeOut * 60 && (!bRecoveryMessage || n2.SendAlways))
-							continue;
-						std::vector<std::vector<std::string> > result;
-						result = m_sql.safe_query("SELECT SwitchType FROM DeviceStatus WHERE (ID=%" PRIu64 ")", Idx);
-						if (result.empty())
-							continue;
-						szExtraData = "|Name=" + n2.DeviceName + "|SwitchType=" + result[0][0] + "|";
-						std::string ltype = Notification_Type_Desc(NTYPE_LASTUPDATE, 0);
-						std::string label = Notification_Type_Label(NTYPE_LASTUPDATE);
-						char szDate[50];
-						char szTmp[300];
-						struct tm ltime;
-						localtime_r(&n2.LastUpdate, &ltime);
-						sprintf(szDate, "%04d-%02d-%02d %02d:%02d:%02d", ltime.tm_year + 1900, ltime.tm_mon + 1, ltime.tm_mday,
-							ltime.tm_hour, ltime.tm_min, ltime.tm_sec);
-						sprintf(szTmp, "Sensor %s %s: %s [%s %d %s]", n2.DeviceName.c_str(), ltype.c_str(), szDate,
-							splitresults[1].c_str(), SensorTimeOut, label.c_str());
-						msg = szTmp;
-					}
-					else if (!bSendNotification && bRecoveryMessage)
-					{
-						msg = recoverymsg;
-						std::string clearstr = "!";
-						CustomRecoveryMessage(n2.ID, clearstr, true);
-					}
-					else
-						continue;
+				std::vector<std::vector<std::string> > result;
+				result = m_sql.safe_query("SELECT SwitchType FROM DeviceStatus WHERE (ID=%" PRIu64 ")", Idx);
+				if (result.empty())
+					continue;
+				szExtraData = "|Name=" + n2.DeviceName + "|SwitchType=" + result[0][0] + "|";
+				std::string ltype = Notification_Type_Desc(NTYPE_LASTUPDATE, 0);
+				std::string label = Notification_Type_Label(NTYPE_LASTUPDATE);
+				char szDate[50];
+				char szTmp[300];
+				struct tm ltime;
+				localtime_r(&n2.LastUpdate, &ltime);
+				sprintf(szDate, "%04d-%02d-%02d %02d:%02d:%02d", ltime.tm_year + 1900, ltime.tm_mon + 1, ltime.tm_mday,
+					ltime.tm_hour, ltime.tm_min, ltime.tm_sec);
+				sprintf(szTmp, "Sensor %s %s: %s [%s %d %s]", n2.DeviceName.c_str(), ltype.c_str(), szDate,
+					n2.When.c_str(), SensorTimeOut, label.c_str());
+				msg = szTmp;
+			}
+			else if (!bSendNotification && bRecoveryMessage)
+			{
+				msg = recoverymsg;
+				std::string clearstr = "!";
+				CustomRecoveryMessage(n2.ID, clearstr, true);
+			}
+			else
+				continue;
 
-					if (bCustomMessage && !bRecoveryMessage)
-						msg = ParseCustomMessage(custommsg, n2.DeviceName, "");
-					SendMessageEx(Idx, n2.DeviceName, n2.ActiveSystems, n2.CustomAction, msg, msg, szExtraData, n2.Priority,
-						      std::string(""), true);
-					if (!bRecoveryMessage)
-					{
-						TouchNotification(n2.ID);
-						CustomRecoveryMessage(n2.ID, msg, true);
-					}
-				}
+			if (bCustomMessage && !bRecoveryMessage)
+				msg = ParseCustomMessage(custommsg, n2.DeviceName, "");
+			SendMessageEx(Idx, n2.DeviceName, n2.ActiveSystems, n2.CustomAction, msg, msg, szExtraData, n2.Priority,
+				      std::string(""), true);
+			if (!bRecoveryMessage)
+			{
+				TouchNotification(n2.ID);
+				CustomRecoveryMessage(n2.ID, msg, true);
 			}
 		}
 	}
 }
 
+//Only updates the in-memory LastSend, the database is updated in batches by FlushLastSend
 void CNotificationHelper::TouchNotification(const uint64_t ID)
 {
-	char szDate[50];
-	time_t atime = mytime(nullptr);
-	struct tm ltime;
-	localtime_r(&atime, &ltime);
-	sprintf(szDate, "%04d-%02d-%02d %02d:%02d:%02d", ltime.tm_year + 1900, ltime.tm_mon + 1, ltime.tm_mday, ltime.tm_hour, ltime.tm_min, ltime.tm_sec);
-
-	//Set LastSend date
-	m_sql.safe_query("UPDATE Notifications SET LastSend='%q' WHERE (ID=%" PRIu64 ")",
-		szDate, ID);
-
-	//Also touch it internally
 	std::lock_guard<std::mutex> l(m_mutex);
+	_tNotification *pNotification = FindNotification(ID);
+	if (pNotification == nullptr)
+		return;
+	pNotification->LastSend = mytime(nullptr);
+	m_dirtyLastSend.insert(ID);
+}
 
-	for (auto &m : m_notifications)
+void CNotificationHelper::FlushLastSend()
+{
+	std::vector<std::pair<uint64_t, time_t>> dirty;
 	{
-		for (auto &n : m.second)
+		std::lock_guard<std::mutex> l(m_mutex);
+		for (const auto ID : m_dirtyLastSend)
 		{
-			if (n.ID == ID)
-			{
-				n.LastSend = atime;
-				return;
-			}
+			_tNotification *pNotification = FindNotification(ID);
+			if (pNotification != nullptr)
+				dirty.emplace_back(ID, pNotification->LastSend);
 		}
+		m_dirtyLastSend.clear();
+	}
+	for (const auto &itt : dirty)
+	{
+		char szDate[50];
+		struct tm ltime;
+		localtime_r(&itt.second, &ltime);
+		sprintf(szDate, "%04d-%02d-%02d %02d:%02d:%02d", ltime.tm_year + 1900, ltime.tm_mon + 1, ltime.tm_mday, ltime.tm_hour, ltime.tm_min, ltime.tm_sec);
+		m_sql.safe_query("UPDATE Notifications SET LastSend='%q' WHERE (ID=%" PRIu64 ")", szDate, itt.first);
 	}
 }
 
 void CNotificationHelper::TouchLastUpdate(const uint64_t ID)
 {
-	time_t atime = mytime(nullptr);
 	std::lock_guard<std::mutex> l(m_mutex);
-
-	for (auto &m : m_notifications)
-	{
-		for (auto &n : m.second)
-		{
-			if (n.ID == ID)
-			{
-				n.LastUpdate = atime;
-				return;
-			}
-		}
-	}
+	_tNotification *pNotification = FindNotification(ID);
+	if (pNotification != nullptr)
+		pNotification->LastUpdate = mytime(nullptr);
 }
 
 bool CNotificationHelper::CustomRecoveryMessage(const uint64_t ID, std::string &msg, const bool isRecovery)
 {
 	std::lock_guard<std::mutex> l(m_mutex);
 
-	for (auto &m : m_notifications)
-	{
-		for (auto &n : m.second)
-		{
-			if (n.ID == ID)
-			{
-				std::vector<std::string> splitresults;
-				if (isRecovery)
-				{
-					StringSplit(n.Params, ";", splitresults);
-					if (splitresults.size() < 4)
-						return false;
-					if (splitresults[3] != "1")
-						return false;
-				}
-
-				std::string szTmp;
-				StringSplit(n.CustomMessage, ";;", splitresults);
-				if (msg.empty())
-				{
-					if (!splitresults.empty())
-					{
-						if (!splitresults[0].empty() && !isRecovery)
-						{
-							szTmp = splitresults[0];
-							msg = szTmp;
-							return true;
-						}
-						if (splitresults.size() > 1)
-						{
-							if (!splitresults[1].empty() && isRecovery)
-							{
-								szTmp = splitresults[1];
-								msg = szTmp;
-								return true;
-							}
-						}
-					}
-					return false;
-				}
-				if (!isRecovery)
-					return false;
+	_tNotification *pNotification = FindNotification(ID);
+	if (pNotification == nullptr)
+		return false;
+	_tNotification &n = *pNotification;
 
-				if (!splitresults.empty())
-				{
-					if (!splitresults[0].empty())
-						szTmp = splitresults[0];
-				}
-				if ((msg.find('!') != 0) && (msg.size() > 1))
-				{
-					szTmp.append(";;[Recovered] ");
-					szTmp.append(msg);
-				}
-				std::vector<std::vector<std::string> > result;
-				result = m_sql.safe_query("SELECT ID FROM Notifications WHERE (ID=='%" PRIu64 "') AND (Params=='%q')", n.ID,
-							  n.Params.c_str());
-				if (result.empty())
-					return false;
+	if (msg.empty())
+		return GetCustomMessage(n, msg, isRecovery);
+	if (!isRecovery)
+		return false;
+	if (!n.Recovery)
+		return false;
 
-				m_sql.safe_query("UPDATE Notifications SET CustomMessage='%q' WHERE ID=='%" PRIu64 "'", szTmp.c_str(),
-						 n.ID);
-				n.CustomMessage = szTmp;
-				return true;
-			}
-		}
+	std::vector<std::string> splitresults;
+	std::string szTmp;
+	StringSplit(n.CustomMessage, ";;", splitresults);
+	if (!splitresults.empty())
+	{
+		if (!splitresults[0].empty())
+			szTmp = splitresults[0];
 	}
-	return false;
+	if ((msg.find('!') != 0) && (msg.size() > 1))
+	{
+		szTmp.append(";;[Recovered] ");
+		szTmp.append(msg);
+	}
+	std::vector<std::vector<std::string> > result;
+	result = m_sql.safe_query("SELECT ID FROM Notifications WHERE (ID=='%" PRIu64 "') AND (Params=='%q')", n.ID,
+				  n.Params.c_str());
+	if (result.empty())
+		return false;
+
+	m_sql.safe_query("UPDATE Notifications SET CustomMessage='%q' WHERE ID=='%" PRIu64 "'", szTmp.c_str(),
+			 n.ID);
+	n.CustomMessage = szTmp;
+	return true;
 }
 
 bool CNotificationHelper::AddNotification(
@@ -1551,6 +1532,75 @@ std::vector<_tNotification> CNotificationHelper::GetNotifications(const uint64_t
 	return ret;
 }
 
+//Copies the active rules of a device that match one of the given types, and (bTouchLastUpdate) refreshes
+//the LastUpdate of its "last update" rules
+bool CNotificationHelper::GetNotifications(const uint64_t DevIdx, const std::initializer_list<int> ntypes, const bool bTouchLastUpdate, std::vector<_tNotification> &notifications)
+{
+	notifications.clear();
+	std::lock_guard<std::mutex> l(m_mutex);
+	auto itt = m_notifications.find(DevIdx);
+	if (itt == m_notifications.end())
+		return false;
+	time_t atime = 0;
+	for (auto &n : itt->second)
+	{
+		if (!n.Active)
+			continue;
+		if ((bTouchLastUpdate) && (n.LastUpdate))
+		{
+			if (atime == 0)
+				atime = mytime(nullptr);
+			n.LastUpdate = atime;
+		}
+		if (std::find(ntypes.begin(), ntypes.end(), n.NType) != ntypes.end())
+			notifications.push_back(n);
+	}
+	return !notifications.empty();
+}
+
+//Like GetNotifications, without copying the rules; the "last update" rules are refreshed also when the
+//device has no rule of the type, so the early return of the caller does not leave them behind
+bool CNotificationHelper::HasNotification(const uint64_t DevIdx, const int ntype, const bool bTouchLastUpdate)
+{
+	std::lock_guard<std::mutex> l(m_mutex);
+	auto itt = m_notifications.find(DevIdx);
+	if (itt == m_notifications.end())
+		return false;
+	bool bFound = false;
+	time_t atime = 0;
+	for (auto &n : itt->second)
+	{
+		if (!n.Active)
+			continue;
+		if ((bTouchLastUpdate) && (n.LastUpdate))
+		{
+			if (atime == 0)
+				atime = mytime(nullptr);
+			n.LastUpdate = atime;
+		}
+		if (n.NType == ntype)
+			bFound = true;
+	}
+	return bFound;
+}
+
+//Caller should hold m_mutex
+_tNotification *CNotificationHelper::FindNotification(const uint64_t ID)
+{
+	auto itt = m_notificationDevice.find(ID);
+	if (itt == m_notificationDevice.end())
+		return nullptr;
+	auto itt2 = m_notifications.find(itt->second);
+	if (itt2 == m_notifications.end())
+		return nullptr;
+	for (auto &n : itt2->second)
+	{
+		if (n.ID == ID)
+			return &n;
+	}
+	return nullptr;
+}
+
 bool CNotificationHelper::HasNotifications(const std::string &DevIdx)
 {
 	std::stringstream s_str(DevIdx);
@@ -1568,8 +1618,12 @@ bool CNotificationHelper::HasNotifications(const uint64_t DevIdx)
 //Re(Loads) all notifications stored in the database, so we do not have to query this all the time
 void CNotificationHelper::ReloadNotifications()
 {
+	//write pending LastSend times first, they are read back below
+	FlushLastSend();
+
 	std::lock_guard<std::mutex> l(m_mutex);
 	m_notifications.clear();
+	m_notificationDevice.clear();
 	std::vector<std::vector<std::string> > result;
 
 	m_sql.GetPreferencesVar("NotificationSensorInterval", m_NotificationSensorInterval);
@@ -1582,7 +1636,6 @@ void CNotificationHelper::ReloadNotifications()
 	time_t mtime = mytime(nullptr);
 	struct tm atime;
 	localtime_r(&mtime, &atime);
-	std::vector<std::string> splitresults;
 
 	std::stringstream sstr;
 
@@ -1610,6 +1663,7 @@ void CNotificationHelper::ReloadNotifications()
 		notification.ActiveSystems = sd[6];
 		notification.Priority = atoi(sd[7].c_str());
 		notification.SendAlways = (atoi(sd[8].c_str())!=0);
+		notification.LastUpdate = 0;
 
 		std::string stime = sd[9];
 		if (stime == "0")
@@ -1621,9 +1675,9 @@ void CNotificationHelper::ReloadNotifications()
 			struct tm ntime;
 			ParseSQLdatetime(notification.LastSend, ntime, stime, atime.tm_isdst);
 		}
-		std::string ttype = Notification_Type_Desc(NTYPE_LASTUPDATE, 1);
-		StringSplit(notification.Params, ";", splitresults);
-		if (splitresults[0] == ttype) {
+		CompileParams(notification);
+		if (notification.NType == NTYPE_LASTUPDATE) {
+			std::string ttype = Notification_Type_Desc(NTYPE_LASTUPDATE, 1);
 			std::vector<std::vector<std::string> > result2;
 			result2 = m_sql.safe_query(
 				"SELECT B.Name, B.LastUpdate "
@@ -1642,6 +1696,7 @@ void CNotificationHelper::ReloadNotifications()
 				ParseSQLdatetime(notification.LastUpdate, ntime, stime, atime.tm_isdst);
 			}
 		}
+		m_notificationDevice[notification.ID] = Idx;
 		m_notifications[Idx].push_back(notification);
 	}
 }
@@ -2,10 +2,23 @@
 #include "NotificationBase.h"
 #include "../webserver/cWebem.h"
 
+#include <initializer_list>
+#include <set>
 #include <string>
 
 #define NOTIFYALL std::string("")
 
+enum _eNotificationRule
+{
+	NRULE_NONE = 0,
+	NRULE_GREATER,
+	NRULE_GREATEREQUAL,
+	NRULE_EQUAL,
+	NRULE_NOTEQUAL,
+	NRULE_LESSEQUAL,
+	NRULE_LESS
+};
+
 struct _tNotification
 {
 	uint64_t ID;
@@ -19,6 +32,14 @@ struct _tNotification
 	std::string CustomAction;
 	std::string ActiveSystems;
 	bool SendAlways;
+
+	// Params ("type;when;value;recovery") compiled when the notifications are (re)loaded
+	int NType = -1;
+	size_t ParamCount = 0;
+	std::string When;
+	_eNotificationRule Rule = NRULE_NONE;
+	float Value = 0.0F;
+	bool Recovery = false;
 };
 
 class CNotificationHelper
@@ -38,6 +59,7 @@ class CNotificationHelper
 	// notification functions
 	void CheckAndHandleLastUpdateNotification();
 	void ReloadNotifications();
+	void FlushLastSend();
 	bool AddNotification(const std::string &DevIdx, const bool Avtive, const std::string &Param, const std::string &CustomMessage, const std::string& CustomAction, const std::string &ActiveSystems, int Priority, bool SendAlways);
 	bool RemoveDeviceNotifications(const std::string &DevIdx);
 	bool RemoveNotification(const std::string &ID);
@@ -80,10 +102,18 @@ class CNotificationHelper
 	bool CheckAndHandleRainNotification(uint64_t Idx, const std::string &DeviceName, unsigned char devType, unsigned char subType, _eNotificationTypes ntype, float mvalue);
 	bool CheckAndHandleAmpere123Notification(uint64_t Idx, const std::string &DeviceName, float Ampere1, float Ampere2, float Ampere3);
 
+	static void CompileParams(_tNotification &n);
+	static bool GetCustomMessage(const _tNotification &n, std::string &msg, bool isRecovery);
+	bool GetNotifications(uint64_t DevIdx, std::initializer_list<int> ntypes, bool bTouchLastUpdate, std::vector<_tNotification> &notifications);
+	bool HasNotification(uint64_t DevIdx, int ntype, bool bTouchLastUpdate);
+	_tNotification *FindNotification(uint64_t ID);
+
 	std::string ParseCustomMessage(const std::string &cMessage, const std::string &sName, const std::string &sValue);
-	bool ApplyRule(const std::string &rule, bool equal, bool less);
+	static bool ApplyRule(_eNotificationRule rule, bool equal, bool less);
 	std::mutex m_mutex;
 	std::map<uint64_t, std::vector<_tNotification>> m_notifications;
+	std::map<uint64_t, uint64_t> m_notificationDevice; // notification ID -> device idx
+	std::set<uint64_t> m_dirtyLastSend; // notification IDs with a LastSend not yet written to the database
 	int m_NotificationSensorInterval;
 	int m_NotificationSwitchInterval;
 };
@@ -4,6 +4,7 @@
 #include <json/json.h>
 #include "../main/Helper.h"
 #include "../main/Logger.h"
+#include "../main/mainworker.h"
 #include "../main/RFXtrx.h"
 #include "../main/SQLHelper.h"
 #include "../main/WebServer.h"
@@ -927,48 +928,215 @@ std::string CBasePush::getUnit(const int devType, const int devSubType, const in
 	return "";
 }
 
+boost::shared_mutex CBasePush::m_link_mutex;
+std::unordered_map<uint64_t, std::vector<CBasePush::_tPushLinks>> CBasePush::m_pushlinks;
+std::mutex CBasePush::m_target_mutex;
+std::vector<CBasePush *> CBasePush::m_targets;
+CDeviceEventBus::subscription CBasePush::m_sDispatchConnection;
+
 void CBasePush::ReloadPushLinks(const PushType PType)
 {
-	std::lock_guard<std::mutex> l(m_link_mutex);
-	m_pushlinks.clear();
 	std::vector<std::vector<std::string>> result;
-	result = m_sql.safe_query("SELECT A.DeviceRowID, A.DelimitedValue, B.ID, B.Name, B.Type, B.SubType, B.SwitchType "
+	result = m_sql.safe_query("SELECT A.DeviceRowID, A.DelimitedValue, A.TargetType, A.TargetVariable, A.TargetDeviceID, A.TargetProperty, A.IncludeUnit, "
+		"B.Name, B.Type, B.SubType, B.SwitchType "
 		"FROM PushLink as A, DeviceStatus as B "
 		"WHERE (A.PushType==%d AND A.Enabled==1 AND A.DeviceRowID == B.ID)",
 		PType);
+
+	boost::unique_lock<boost::shared_mutex> l(m_link_mutex);
+	for (auto itt = m_pushlinks.begin(); itt != m_pushlinks.end();)
+	{
+		auto &links = itt->second;
+		links.erase(std::remove_if(links.begin(), links.end(), [&](const _tPushLinks &val) { return val.pushType == PType; }), links.end());
+		if (links.empty())
+			itt = m_pushlinks.erase(itt);
+		else
+			++itt;
+	}
 	for (const auto& sd : result)
 	{
 		_tPushLinks tlink;
 		tlink.DeviceRowIdx = std::stoull(sd[0]);
-		tlink.DelimiterPos = std::stoi(sd[1]);
-		tlink.DeviceName = sd[3];
-		tlink.devType = std::stoi(sd[4]);
-		tlink.devSubType = std::stoi(sd[5]);
-		tlink.metertype = std::stoi(sd[6]);
-		m_pushlinks.push_back(tlink);
+		tlink.DelimiterPos = atoi(sd[1].c_str());
+		tlink.targetType = atoi(sd[2].c_str());
+		tlink.targetVariable = sd[3];
+		tlink.targetDeviceID = atoi(sd[4].c_str());
+		tlink.targetProperty = sd[5];
+		tlink.includeUnit = atoi(sd[6].c_str());
+		tlink.DeviceName = sd[7];
+		tlink.devType = atoi(sd[8].c_str());
+		tlink.devSubType = atoi(sd[9].c_str());
+		tlink.metertype = atoi(sd[10].c_str());
+		tlink.pushType = PType;
+		tlink.vType = DropdownOptionsValue(tlink.devType, tlink.devSubType, tlink.DelimiterPos);
+		tlink.unit = getUnit(tlink.devType, tlink.devSubType, tlink.DelimiterPos, tlink.metertype);
+		m_pushlinks[tlink.DeviceRowIdx].push_back(tlink);
 	}
 }
 
 bool CBasePush::IsLinkInDatabase(const uint64_t DeviceRowIdx)
 {
-	std::lock_guard<std::mutex> l(m_link_mutex);
-	return std::any_of(m_pushlinks.begin(), m_pushlinks.end(), [&](const _tPushLinks& val) { return DeviceRowIdx == val.DeviceRowIdx; });
+	_tPushLinks plink;
+	return GetPushLink(DeviceRowIdx, plink);
 }
 
 bool CBasePush::GetPushLink(const uint64_t DeviceRowIdx, _tPushLinks& plink)
 {
-	std::lock_guard<std::mutex> l(m_link_mutex);
-	for (const auto& itt : m_pushlinks)
+	boost::shared_lock<boost::shared_mutex> l(m_link_mutex);
+	auto itt = m_pushlinks.find(DeviceRowIdx);
+	if (itt == m_pushlinks.end())
+		return false;
+	for (const auto& link : itt->second)
 	{
-		if (itt.DeviceRowIdx == DeviceRowIdx)
+		if (link.pushType == m_PushType)
 		{
-			plink = itt;
+			plink = link;
 			return true;
 		}
 	}
 	return false;
 }
 
+bool CBasePush::GetLinks(const uint64_t DeviceRowIdx, const PushType PType, std::vector<_tPushLinks> &links)
+{
+	links.clear();
+	boost::shared_lock<boost::shared_mutex> l(m_link_mutex);
+	auto itt = m_pushlinks.find(DeviceRowIdx);
+	if (itt == m_pushlinks.end())
+		return false;
+	for (const auto &link : itt->second)
+	{
+		if ((PType == PushType::PUSHTYPE_UNKNOWN) || (link.pushType == PType))
+			links.push_back(link);
+	}
+	return !links.empty();
+}
+
+bool CBasePush::LoadDeviceValue(const uint64_t DeviceRowIdx, _tPushDeviceValue &value)
+{
+	auto result = m_sql.safe_query("SELECT Type, SubType, SwitchType, nValue, sValue, Name, strftime('%%s', LastUpdate) FROM DeviceStatus WHERE (ID == %" PRIu64 ")", DeviceRowIdx);
+	if (result.empty())
+		return false;
+	const auto &sd = result[0];
+	value.DeviceRowIdx = DeviceRowIdx;
+	value.devType = atoi(sd[0].c_str());
+	value.devSubType = atoi(sd[1].c_str());
+	value.metertype = atoi(sd[2].c_str());
+	value.nValue = atoi(sd[3].c_str());
+	value.sValue = sd[4];
+	value.DeviceName = sd[5];
+	value.lastUpdate = (time_t)atoll(sd[6].c_str());
+	value.sValues.clear();
+	if (value.sValue.find(';') != std::string::npos)
+		StringSplit(value.sValue, ";", value.sValues);
+	return true;
+}
+
+void CBasePush::UpdateLinkFormatting(_tPushLinks &link, const _tPushDeviceValue &value)
+{
+	// device type or meter type was changed after the links were loaded
+	if ((link.devType == value.devType) && (link.devSubType == value.devSubType) && (link.metertype == value.metertype))
+		return;
+	link.devType = value.devType;
+	link.devSubType = value.devSubType;
+	link.metertype = value.metertype;
+	link.vType = DropdownOptionsValue(link.devType, link.devSubType, link.DelimiterPos);
+	link.unit = getUnit(link.devType, link.devSubType, link.DelimiterPos, link.metertype);
+}
+
+void CBasePush::PushDevice(const uint64_t DeviceRowIdx, const bool bForced)
+{
+	if (!m_bLinkActive)
+		return;
+	std::vector<_tPushLinks> links;
+	if (!GetLinks(DeviceRowIdx, m_PushType, links))
+		return;
+	_tPushDeviceValue value;
+	if (!LoadDeviceValue(DeviceRowIdx, value))
+		return;
+	for (auto &link : links)
+		UpdateLinkFormatting(link, value);
+	OnPushValue(value, links, bForced);
+}
+
+void CBasePush::DispatchDeviceUpdate(const uint64_t DeviceRowIdx, const bool bForced, const CDeviceEventBus::_tDeviceEvent *pEvent)
+{
+	std::vector<_tPushLinks> links;
+	if (!GetLinks(DeviceRowIdx, PushType::PUSHTYPE_UNKNOWN, links))
+		return;
+
+	std::vector<CBasePush *> targets;
+	{
+		std::lock_guard<std::mutex> l(m_target_mutex);
+		for (auto pTarget : m_targets)
+		{
+			if (pTarget->m_bLinkActive)
+				targets.push_back(pTarget);
+		}
+	}
+	if (targets.empty())
+		return;
+
+	_tPushDeviceValue value;
+	if ((pEvent != nullptr) && (pEvent->bHaveValue))
+	{
+		// the value of this update, when the bus is behind the row already holds a later one
+		value.DeviceRowIdx = DeviceRowIdx;
+		value.devType = pEvent->value.devType;
+		value.devSubType = pEvent->value.devSubType;
+		value.metertype = pEvent->value.SwitchType;
+		value.nValue = pEvent->value.nValue;
+		value.sValue = pEvent->value.sValue;
+		value.DeviceName = pEvent->value.Name;
+		value.lastUpdate = pEvent->value.tLastUpdate;
+		if (value.sValue.find(';') != std::string::npos)
+			StringSplit(value.sValue, ";", value.sValues);
+	}
+	else if (!LoadDeviceValue(DeviceRowIdx, value))
+		return;
+	for (auto &link : links)
+		UpdateLinkFormatting(link, value);
+
+	std::vector<_tPushLinks> targetLinks;
+	for (auto pTarget : targets)
+	{
+		targetLinks.clear();
+		for (const auto &link : links)
+		{
+			if (link.pushType == pTarget->m_PushType)
+				targetLinks.push_back(link);
+		}
+		if (!targetLinks.empty())
+			pTarget->OnPushValue(value, targetLinks, bForced);
+	}
+}
+
+void CBasePush::RegisterPushTarget()
+{
+	std::lock_guard<std::mutex> l(m_target_mutex);
+	if (std::find(m_targets.begin(), m_targets.end(), this) == m_targets.end())
+		m_targets.push_back(this);
+	if (!m_sDispatchConnection.connected())
+		m_sDispatchConnection = m_mainworker.m_deviceEventBus.Subscribe("PushLinks", CDeviceEventBus::_eQueuePolicy::ALL_EVENTS, 4096, true, [](const auto &event) {
+			if (event.type == CDeviceEventBus::_tDeviceEvent::_eType::RECEIVED)
+				DispatchDeviceUpdate(event.DeviceRowIdx, false, &event);
+		});
+}
+
+void CBasePush::UnregisterPushTarget()
+{
+	CDeviceEventBus::subscription dispatchConnection;
+	{
+		std::lock_guard<std::mutex> l(m_target_mutex);
+		m_targets.erase(std::remove(m_targets.begin(), m_targets.end(), this), m_targets.end());
+		if (m_targets.empty())
+			dispatchConnection = std::move(m_sDispatchConnection);
+	}
+	// outside the lock, a running dispatch takes m_target_mutex
+	if (dispatchConnection.connected())
+		dispatchConnection.disconnect();
+}
+
 
 
 //Webserver helpers
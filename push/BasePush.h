@@ -2,7 +2,10 @@
 
 #define BOOST_ALLOW_DEPRECATED_HEADERS
 #include <boost/signals2.hpp>
+#include <boost/thread/shared_mutex.hpp>
+#include "../main/DeviceEventBus.h"
 #include <mutex>
+#include <unordered_map>
 
 class CBasePush
 {
@@ -26,9 +29,30 @@ public:
 		int devSubType;
 		int metertype;
 		PushType pushType;
+		int targetType;
+		std::string targetVariable;
+		int targetDeviceID;
+		std::string targetProperty;
+		int includeUnit;
+		std::string vType; // DropdownOptionsValue() of the DelimitedValue position
+		std::string unit;
+	};
+	// Current state of a linked device, read once per update and shared by all exporters
+	struct _tPushDeviceValue
+	{
+		uint64_t DeviceRowIdx;
+		std::string DeviceName;
+		int devType;
+		int devSubType;
+		int metertype;
+		int nValue;
+		std::string sValue;
+		std::vector<std::string> sValues; // sValue split on ';', empty when sValue has no ';'
+		time_t lastUpdate;
 	};
 
 	CBasePush();
+	virtual ~CBasePush() = default;
 
 	static std::vector<std::string> DropdownOptions(const int devType, const int devSubType);
 	static std::string DropdownOptionsValue(const int devType, const int devSubType, const int pos);
@@ -46,11 +70,15 @@ public:
 	void ReloadPushLinks(const PushType PType);
 	bool GetPushLink(const uint64_t DeviceRowIdx, _tPushLinks& plink);
 
+	// Pushes the current state of a device to this exporter (bForced skips 'only on change' filtering)
+	void PushDevice(const uint64_t DeviceRowIdx, const bool bForced = false);
+	// Single entry point for device updates, fans out to all registered exporters that have a link for the device.
+	// With an event its value is pushed, otherwise the current row
+	static void DispatchDeviceUpdate(const uint64_t DeviceRowIdx, const bool bForced = false, const CDeviceEventBus::_tDeviceEvent *pEvent = nullptr);
+
 protected:
 	PushType m_PushType;
 	bool m_bLinkActive;
-	boost::signals2::connection m_sConnection;
-	boost::signals2::connection m_sDeviceUpdate;
 	boost::signals2::connection m_sNotification;
 	boost::signals2::connection m_sSceneChanged;
 
@@ -63,9 +91,24 @@ protected:
 
 	bool IsLinkInDatabase(const uint64_t DeviceRowIdx);
 
-	std::mutex m_link_mutex;
+	// Exporters that use push links register themselves to receive OnPushValue calls
+	void RegisterPushTarget();
+	void UnregisterPushTarget();
+	virtual void OnPushValue(const _tPushDeviceValue &value, const std::vector<_tPushLinks> &links, const bool bForced)
+	{
+	}
 
 private:
-	std::vector<_tPushLinks> m_pushlinks;
+	static bool GetLinks(const uint64_t DeviceRowIdx, const PushType PType, std::vector<_tPushLinks> &links);
+	static bool LoadDeviceValue(const uint64_t DeviceRowIdx, _tPushDeviceValue &value);
+	static void UpdateLinkFormatting(_tPushLinks &link, const _tPushDeviceValue &value);
+
+	// links of all exporters, indexed by DeviceRowIdx
+	static boost::shared_mutex m_link_mutex;
+	static std::unordered_map<uint64_t, std::vector<_tPushLinks>> m_pushlinks;
+
+	static std::mutex m_target_mutex;
+	static std::vector<CBasePush *> m_targets;
+	static CDeviceEventBus::subscription m_sDispatchConnection;
 };
 
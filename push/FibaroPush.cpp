@@ -26,13 +26,12 @@ void CFibaroPush::Start()
 {
 	UpdateActive();
 	ReloadPushLinks(m_PushType);
-	m_sConnection = m_mainworker.sOnDeviceReceived.connect([this](auto id, auto idx, const auto &name, auto rx) { OnDeviceReceived(id, idx, name, rx); });
+	RegisterPushTarget();
 }
 
 void CFibaroPush::Stop()
 {
-	if (m_sConnection.connected())
-		m_sConnection.disconnect();
+	UnregisterPushTarget();
 }
 
 void CFibaroPush::UpdateActive()
@@ -42,23 +41,9 @@ void CFibaroPush::UpdateActive()
 	m_bLinkActive = (fActive == 1);
 }
 
-void CFibaroPush::OnDeviceReceived(const int m_HwdID, const uint64_t DeviceRowIdx, const std::string &DeviceName, const unsigned char *pRXCommand)
+void CFibaroPush::OnPushValue(const _tPushDeviceValue &value, const std::vector<_tPushLinks> &links, const bool bForced)
 {
-	if (m_bLinkActive)
-	{
-		DoFibaroPush(DeviceRowIdx);
-	}
-}
-
-void CFibaroPush::DoFibaroPush(const uint64_t DeviceRowIdx)
-{
-	std::vector<std::vector<std::string>> result;
-	result = m_sql.safe_query("SELECT A.DeviceRowID, A.DelimitedValue, B.ID, B.Type, B.SubType, B.nValue, B.sValue, A.TargetType, A.TargetVariable, A.TargetDeviceID, A.TargetProperty, "
-				  "A.IncludeUnit, B.SwitchType FROM PushLink as A, DeviceStatus as B "
-				  "WHERE (A.PushType==%d AND A.DeviceRowID == '%" PRIu64 "' AND A.Enabled = '1' AND A.DeviceRowID==B.ID)",
-				  PushType::PUSHTYPE_FIBARO, DeviceRowIdx);
-	if (result.empty())
-		return;
+	const uint64_t DeviceRowIdx = value.DeviceRowIdx;
 
 	std::string fibaroIP;
 	std::string fibaroUsername;
@@ -80,20 +65,20 @@ void CFibaroPush::DoFibaroPush(const uint64_t DeviceRowIdx)
 
 	if ((fibaroIP.empty()) || (fibaroUsername.empty()) || (fibaroPassword.empty()))
 		return;
-	for (const auto &sd : result)
+	for (const auto &link : links)
 	{
 		std::string sendValue;
-		int delpos = atoi(sd[1].c_str());
-		int dType = atoi(sd[3].c_str());
-		int dSubType = atoi(sd[4].c_str());
-		int nValue = atoi(sd[5].c_str());
-		std::string sValue = sd[6];
-		int targetType = atoi(sd[7].c_str());
-		std::string targetVariable = sd[8];
-		int targetDeviceID = atoi(sd[9].c_str());
-		std::string targetProperty = sd[10];
-		int includeUnit = atoi(sd[11].c_str());
-		int metertype = atoi(sd[12].c_str());
+		int delpos = link.DelimiterPos;
+		int dType = value.devType;
+		int dSubType = value.devSubType;
+		int nValue = value.nValue;
+		const std::string &sValue = value.sValue;
+		int targetType = link.targetType;
+		const std::string &targetVariable = link.targetVariable;
+		int targetDeviceID = link.targetDeviceID;
+		const std::string &targetProperty = link.targetProperty;
+		int includeUnit = link.includeUnit;
+		int metertype = value.metertype;
 		std::string lstatus;
 
 		if ((targetType == 0) || (targetType == 1)) {
@@ -106,13 +91,11 @@ void CFibaroPush::DoFibaroPush(const uint64_t DeviceRowIdx)
 				sendValue = lstatus;
 			}
 			else if (delpos > 0) {
-				std::vector<std::string> strarray;
-				if (sValue.find(';') != std::string::npos)
+				if (!value.sValues.empty())
 				{
-					StringSplit(sValue, ";", strarray);
-					if (int(strarray.size()) >= delpos)
+					if (int(value.sValues.size()) >= delpos)
 					{
-						std::string rawsendValue = strarray[delpos - 1];
+						const std::string &rawsendValue = value.sValues[delpos - 1];
 						sendValue = ProcessSendValue(DeviceRowIdx, rawsendValue, delpos, nValue, sValue, includeUnit, dType, dSubType, metertype);
 					}
 				}
@@ -13,7 +13,6 @@ public:
 	void UpdateActive();
 
 private:
-  void OnDeviceReceived(int m_HwdID, uint64_t DeviceRowIdx, const std::string &DeviceName, const unsigned char *pRXCommand);
-  void DoFibaroPush(const uint64_t DeviceRowIdx);
+  void OnPushValue(const _tPushDeviceValue &value, const std::vector<_tPushLinks> &links, const bool bForced) override;
 };
 extern CFibaroPush m_fibaropush;
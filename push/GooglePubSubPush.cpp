@@ -40,13 +40,12 @@ void CGooglePubSubPush::Start()
 {
 	UpdateActive();
 	ReloadPushLinks(m_PushType);
-	m_sConnection = m_mainworker.sOnDeviceReceived.connect([this](auto id, auto idx, const auto &name, auto rx) { OnDeviceReceived(id, idx, name, rx); });
+	RegisterPushTarget();
 }
 
 void CGooglePubSubPush::Stop()
 {
-	if (m_sConnection.connected())
-		m_sConnection.disconnect();
+	UnregisterPushTarget();
 }
 
 
@@ -57,15 +56,6 @@ void CGooglePubSubPush::UpdateActive()
 	m_bLinkActive = (fActive == 1);
 }
 
-void CGooglePubSubPush::OnDeviceReceived(const int m_HwdID, const uint64_t DeviceRowIdx, const std::string &DeviceName, const unsigned char *pRXCommand)
-{
-	if (m_bLinkActive)
-	{
-		DoGooglePubSubPush(DeviceRowIdx);
-	}
-}
-
-
 #ifdef ENABLE_PYTHON_DECAP
 static int numargs = 0;
 
@@ -100,15 +90,9 @@ boost::python::dict toPythonDict(std::map<K, V> map) {
 }
 #endif
 
-void CGooglePubSubPush::DoGooglePubSubPush(const uint64_t DeviceRowIdx)
+void CGooglePubSubPush::OnPushValue(const _tPushDeviceValue &value, const std::vector<_tPushLinks> &links, const bool bForced)
 {
-	std::vector<std::vector<std::string>> result;
-	result = m_sql.safe_query("SELECT A.DeviceRowID, A.DelimitedValue, B.ID, B.Type, B.SubType, B.nValue, B.sValue, A.TargetType, A.TargetVariable, A.TargetDeviceID, A.TargetProperty, "
-				  "A.IncludeUnit, B.SwitchType, strftime('%%s', B.LastUpdate), B.Name FROM PushLink as A, DeviceStatus as B "
-				  "WHERE (A.PushType==%d AND A.DeviceRowID == '%" PRIu64 "' AND A.Enabled = '1' AND A.DeviceRowID==B.ID)",
-				  PushType::PUSHTYPE_GOOGLE_PUB_SUB, DeviceRowIdx);
-	if (result.empty())
-		return;
+	const uint64_t DeviceRowIdx = value.DeviceRowIdx;
 
 	std::string googlePubSubData;
 #ifdef ENABLE_PYTHON_DECAP
@@ -120,7 +104,7 @@ void CGooglePubSubPush::DoGooglePubSubPush(const uint64_t DeviceRowIdx)
 		googlePubSubDebugActive = true;
 	}
 #endif
-	for (const auto &sd : result)
+	for (const auto &link : links)
 	{
 		std::string sendValue;
 
@@ -129,23 +113,21 @@ void CGooglePubSubPush::DoGooglePubSubPush(const uint64_t DeviceRowIdx)
 			return;
 
 
-		std::string sdeviceId = sd[0];
-		std::string ldelpos = sd[1];
-		int delpos = atoi(sd[1].c_str());
-		int dType = atoi(sd[3].c_str());
-		int dSubType = atoi(sd[4].c_str());
-		int nValue = atoi(sd[5].c_str());
-		std::string sValue = sd[6];
-		//int targetType = atoi(sd[7].c_str());
-		std::string targetVariable = sd[8];
-		//int targetDeviceID = atoi(sd[9].c_str());
-		std::string targetProperty = sd[10];
-		int includeUnit = atoi(sd[11].c_str());
-		int metertype = atoi(sd[12].c_str());
-		int lastUpdate = atoi(sd[13].c_str());
-		std::string ltargetVariable = sd[8];
-		std::string ltargetDeviceId = sd[9];
-		std::string lname = sd[14];
+		std::string sdeviceId = std::to_string(DeviceRowIdx);
+		std::string ldelpos = std::to_string(link.DelimiterPos);
+		int delpos = link.DelimiterPos;
+		int dType = value.devType;
+		int dSubType = value.devSubType;
+		int nValue = value.nValue;
+		const std::string &sValue = value.sValue;
+		const std::string &targetVariable = link.targetVariable;
+		const std::string &targetProperty = link.targetProperty;
+		int includeUnit = link.includeUnit;
+		int metertype = value.metertype;
+		int lastUpdate = (int)value.lastUpdate;
+		const std::string &ltargetVariable = link.targetVariable;
+		std::string ltargetDeviceId = std::to_string(link.targetDeviceID);
+		const std::string &lname = value.DeviceName;
 		sendValue = sValue;
 
 		unsigned long tzoffset = get_tzoffset();
@@ -181,20 +163,18 @@ void CGooglePubSubPush::DoGooglePubSubPush(const uint64_t DeviceRowIdx)
 		%idx : 'Original device' id (idx)
 		*/
 
-		std::string lunit = getUnit(dType, dSubType, delpos, metertype);
+		const std::string &lunit = link.unit;
 		std::string lType = RFX_Type_Desc(dType, 1);
 		std::string lSubType = RFX_Type_SubType_Desc(dType, dSubType);
 
 		char hostname[256];
 		gethostname(hostname, sizeof(hostname));
 
-		std::vector<std::string> strarray;
-		if (sendValue.find(';') != std::string::npos)
+		if (!value.sValues.empty())
 		{
-			StringSplit(sendValue, ";", strarray);
-			if (int(strarray.size()) >= delpos)
+			if (int(value.sValues.size()) >= delpos)
 			{
-				std::string rawsendValue = strarray[delpos - 1];
+				const std::string &rawsendValue = value.sValues[delpos - 1];
 				sendValue = ProcessSendValue(DeviceRowIdx, rawsendValue, delpos, nValue, sValue, false, dType, dSubType, metertype);
 			}
 		}
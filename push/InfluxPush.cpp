@@ -12,10 +12,21 @@
 #include "../main/WebServer.h"
 #include "../webserver/Base64.h"
 #include "../webserver/cWebem.h"
+#include "../webserver/GZipHelper.h"
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
 
 extern CInfluxPush m_influxpush;
+extern std::string szUserDataFolder;
+
+namespace
+{
+	constexpr size_t iInfluxBatchSize = 1000; // lines per POST
+	constexpr time_t iInfluxFlushSeconds = 1; // max. time a line waits for a batch to fill
+	constexpr size_t iInfluxMaxQueued = 50000; // in memory, before points are dropped
+	constexpr uint64_t iInfluxSpoolSize = 16 * 1024 * 1024; // disk spool used while the server is unreachable
+	constexpr int iInfluxMaxBackoffSeconds = 60;
+} // namespace
 
 CInfluxPush::CInfluxPush()
 {
@@ -31,19 +42,20 @@ bool CInfluxPush::Start()
 
 	UpdateSettings();
 	ReloadPushLinks(m_PushType);
+	m_spool.Open(szUserDataFolder + "influxdb_spool.dat", iInfluxSpoolSize);
+	m_iBatchLines = 0;
 
 	m_thread = std::make_shared<std::thread>([this] { Do_Work(); });
 	SetThreadName(m_thread->native_handle(), "InfluxPush");
 
-	m_sConnection = m_mainworker.sOnDeviceReceived.connect([this](auto id, auto idx, const auto &name, auto rx) { OnDeviceReceived(id, idx, name, rx); });
+	RegisterPushTarget();
 
 	return (m_thread != nullptr);
 }
 
 void CInfluxPush::Stop()
 {
-	if (m_sConnection.connected())
-		m_sConnection.disconnect();
+	UnregisterPushTarget();
 
 	if (m_thread)
 	{
@@ -51,6 +63,7 @@ void CInfluxPush::Stop()
 		m_thread->join();
 		m_thread.reset();
 	}
+	m_spool.Close();
 }
 
 void CInfluxPush::UpdateSettings()
@@ -108,70 +121,57 @@ void CInfluxPush::UpdateSettings()
 	m_szURL = sURL.str();
 }
 
-void CInfluxPush::OnDeviceReceived(int m_HwdID, uint64_t DeviceRowIdx, const std::string &DeviceName, const unsigned char *pRXCommand)
-{
-	DoInfluxPush(DeviceRowIdx);
-}
-
-void CInfluxPush::DoInfluxPush(const uint64_t DeviceRowIdx, const bool bForced)
+void CInfluxPush::OnPushValue(const _tPushDeviceValue &value, const std::vector<_tPushLinks> &links, const bool bForced)
 {
-	if (!m_bLinkActive)
-		return;
-	if (!IsLinkInDatabase(DeviceRowIdx))
-		return;
-
-	std::vector<std::vector<std::string>> result;
-	result = m_sql.safe_query(
-		"SELECT A.DeviceRowID, A.DelimitedValue, B.ID, B.Type, B.SubType, B.nValue, B.sValue, A.TargetType, A.IncludeUnit, B.Name, B.SwitchType FROM PushLink as A, DeviceStatus as B "
-		"WHERE (A.PushType==%d AND A.DeviceRowID == '%" PRIu64 "' AND A.Enabled==1 AND A.DeviceRowID==B.ID)",
-		PushType::PUSHTYPE_INFLUXDB, DeviceRowIdx);
-	if (result.empty())
-		return;
+	const uint64_t DeviceRowIdx = value.DeviceRowIdx;
 
-	int dType = atoi(result[0][3].c_str());
-	int dSubType = atoi(result[0][4].c_str());
-	int nValue = atoi(result[0][5].c_str());
-	std::string sValue = result[0][6];
-	std::string name = result[0][9];
-	int metertype = atoi(result[0][10].c_str());
+	int dType = value.devType;
+	int dSubType = value.devSubType;
+	int nValue = value.nValue;
+	const std::string &sValue = value.sValue;
+	std::string name = value.DeviceName;
+	int metertype = value.metertype;
+	stdreplace(name, " ", "-");
+	std::string szIdx = std::to_string(DeviceRowIdx);
 
 	time_t atime = mytime(nullptr);
-	for (const auto &sd : result)
+	for (const auto &link : links)
 	{
 		std::string sendValue;
-		int delpos = atoi(sd[1].c_str());
-		int targetType = atoi(sd[7].c_str());
-		int includeUnit = atoi(sd[8].c_str());
+		int delpos = link.DelimiterPos;
 
-		std::vector<std::string> strarray;
-		if (sValue.find(';') != std::string::npos)
+		if (!value.sValues.empty())
 		{
 			std::string rawsendValue("");
-			StringSplit(sValue, ";", strarray);
-			if (int(strarray.size()) >= delpos)
+			if (int(value.sValues.size()) >= delpos)
 			{
-				rawsendValue = strarray[delpos - 1];
+				rawsendValue = value.sValues[delpos - 1];
 			}
-			sendValue = ProcessSendValue(DeviceRowIdx, rawsendValue, delpos, nValue, sValue, includeUnit, dType, dSubType, metertype);
+			sendValue = ProcessSendValue(DeviceRowIdx, rawsendValue, delpos, nValue, sValue, link.includeUnit, dType, dSubType, metertype);
 		}
 		else
-			sendValue = ProcessSendValue(DeviceRowIdx, sValue, delpos, nValue, sValue, includeUnit, dType, dSubType, metertype);
+			sendValue = ProcessSendValue(DeviceRowIdx, sValue, delpos, nValue, sValue, link.includeUnit, dType, dSubType, metertype);
 
 		if (sendValue.empty())
 			continue;
 
-		std::string szKey;
-		std::string vType = CBasePush::DropdownOptionsValue(dType, dSubType, delpos);
+		std::string vType = link.vType;
 		stdreplace(vType, " ", "-");
-		stdreplace(name, " ", "-");
-		szKey = vType + ",idx=" + sd[0] + ",name=" + name;
+		std::string szKey = vType + ",idx=" + szIdx + ",name=" + name;
 
-		_tPushItem pItem;
-		pItem.skey = szKey;
-		pItem.stimestamp = atime;
-		pItem.svalue = sendValue;
+		std::string szLine = szKey + " value=";
+		if (szKey.find("Text,") == 0)
+			szLine += "\"" + sendValue + "\"";
+		else
+			szLine += sendValue;
+		if (m_bInfluxDebugActive)
+		{
+			_log.Log(LOG_NORM, "InfluxLink: value %s", szLine.c_str());
+		}
+		szLine += " " + std::to_string(atime);
 
-		if ((targetType == 0) && (!bForced))
+		std::lock_guard<std::mutex> l(m_background_task_mutex);
+		if ((link.targetType == 0) && (!bForced))
 		{
 			// Only send on change
 			auto itt = m_PushedItems.find(szKey);
@@ -180,94 +180,230 @@ void CInfluxPush::DoInfluxPush(const uint64_t DeviceRowIdx, const bool bForced)
 				if (sendValue == itt->second.svalue)
 					continue;
 			}
+			_tPushItem pItem;
+			pItem.skey = szKey;
+			pItem.stimestamp = atime;
+			pItem.svalue = sendValue;
 			m_PushedItems[szKey] = pItem;
 		}
 
+		if (m_background_task_queue.size() >= iInfluxMaxQueued)
+		{
+			m_statDropped++;
+			continue;
+		}
+		if (m_background_task_queue.empty())
+			m_tOldestQueued = atime;
+		m_background_task_queue.push_back(std::move(szLine));
+	}
+}
+
+void CInfluxPush::SpoolPending()
+{
+	std::vector<std::string> lines;
+	{
 		std::lock_guard<std::mutex> l(m_background_task_mutex);
-		if (m_background_task_queue.size() < 50)
-			m_background_task_queue.push_back(pItem);
+		if (m_background_task_queue.empty())
+			return;
+		lines.assign(std::make_move_iterator(m_background_task_queue.begin()), std::make_move_iterator(m_background_task_queue.end()));
+		m_background_task_queue.clear();
+	}
+	m_statDropped += m_spool.Push(lines);
+}
+
+namespace
+{
+	// status code of the last response status line, 0 when there was no response (transport error)
+	int GetHTTPStatus(const std::vector<std::string> &vHeaderData)
+	{
+		int iStatus = 0;
+		for (const auto &header : vHeaderData)
+		{
+			if (header.find("HTTP/") != 0)
+				continue;
+			size_t pos = header.find(' ');
+			if (pos == std::string::npos)
+				continue;
+			int iCode = atoi(header.c_str() + pos + 1);
+			// HTTPClient adds a status line with the curl error code when the request failed
+			iStatus = ((iCode >= 100) && (iCode <= 599)) ? iCode : 0;
+		}
+		return iStatus;
+	}
+} // namespace
+
+CInfluxPush::_eSendResult CInfluxPush::SendBatch(const std::vector<std::string> &lines)
+{
+	std::string sSendData;
+	for (const auto &line : lines)
+	{
+		if (!sSendData.empty())
+			sSendData += '\n';
+		sSendData += line;
+	}
+
+	std::vector<std::string> ExtraHeaders;
+	std::vector<std::string> vHeaderData;
+	std::string sResult;
+	if (m_bInfluxVersion2)
+	{
+		ExtraHeaders.push_back("Authorization: Token " + base64_decode(m_InfluxPassword));
+		ExtraHeaders.push_back("Content-type: text/plain");
+	}
+	CA2GZIP gzip((char *)sSendData.c_str(), (int)sSendData.size());
+	if ((gzip.Length > 0) && (gzip.Length < (int)sSendData.size()))
+	{
+		ExtraHeaders.push_back("Content-Encoding: gzip");
+		sSendData.assign((const char *)gzip.pgzip, gzip.Length);
+	}
+
+	auto tStart = std::chrono::steady_clock::now();
+	bool bRet = HTTPClient::POST(m_szURL, sSendData, ExtraHeaders, sResult, vHeaderData, true, true);
+	uint64_t postMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - tStart).count();
+	m_statPosts++;
+	m_statLastPostMs = postMs;
+	m_statTotalPostMs += postMs;
+	if (postMs > m_statMaxPostMs)
+		m_statMaxPostMs = postMs;
+
+	int iStatus = GetHTTPStatus(vHeaderData);
+	if ((!bRet) || (iStatus == 0) || (iStatus >= 500) || (iStatus == 429))
+	{
+		// unreachable, overloaded or failing, the batch is kept and sent again after a backoff
+		m_statFailedPosts++;
+		_log.Log(LOG_ERROR, "InfluxLink: Error sending data to InfluxDB server! (check address/port/database/username/password)");
+		return SEND_RETRY;
+	}
+	if (iStatus < 400)
+		return SEND_OK;
+
+	m_statFailedPosts++;
+	std::string szMessage = sResult;
+	Json::Value root;
+	if ((ParseJSon(sResult, root)) && (root.isObject()))
+	{
+		if (!root["message"].empty())
+			szMessage = root["message"].asString();
+		else if (!root["error"].empty())
+			szMessage = root["error"].asString();
+	}
+	if (iStatus == 413)
+	{
+		if (lines.size() > 1)
+			return SEND_TOO_LARGE;
+		_log.Log(LOG_ERROR, "InfluxLink: InfluxDB server refused a single point as too large, dropping it! (HTTP 413: %s)", szMessage.c_str());
+		return SEND_REJECTED;
 	}
+	if (iStatus == 400)
+	{
+		// bad line protocol, retrying the same batch would block everything behind it
+		_log.Log(LOG_ERROR, "InfluxLink: InfluxDB server rejected %d points, dropping them! (HTTP 400: %s)", static_cast<int>(lines.size()), szMessage.c_str());
+		return SEND_REJECTED;
+	}
+	// credentials, database/bucket or path are wrong. The points are fine, keep them until the settings are fixed
+	const char *szCheck = "check the InfluxDB settings";
+	if ((iStatus == 401) || (iStatus == 403))
+		szCheck = (m_bInfluxVersion2) ? "check the token and its write permission on the bucket" : "check the username/password and their write permission on the database";
+	else if (iStatus == 404)
+		szCheck = (m_bInfluxVersion2) ? "check the organization/bucket and the path" : "check the database name and the path";
+	_log.Log(LOG_ERROR, "InfluxLink: InfluxDB server refused the data, will retry! (HTTP %d: %s, %s)", iStatus, szMessage.c_str(), szCheck);
+	return SEND_RETRY;
 }
 
 void CInfluxPush::Do_Work()
 {
-	std::vector<_tPushItem> _items2do;
+	std::vector<std::string> lines;
+	int backoffSeconds = 0;
+	time_t tNextAttempt = 0;
 
-	while (!IsStopRequested(500))
+	while (!IsStopRequested(100))
 	{
-		{ // additional scope for lock (accessing size should be within lock too)
+		if (m_szURL.empty())
+		{
 			std::lock_guard<std::mutex> l(m_background_task_mutex);
-			if (m_background_task_queue.empty())
-				continue;
-			_items2do = m_background_task_queue;
 			m_background_task_queue.clear();
+			continue;
 		}
 
-		if (m_szURL.empty())
+		time_t atime = mytime(nullptr);
+		if (atime < tNextAttempt)
+		{
+			// server unreachable, move everything to the spool until it is back
+			SpoolPending();
 			continue;
+		}
 
-		std::string sSendData;
+		// while the spool is not empty everything goes through it, so points are sent in order
+		if (m_spool.Records() > 0)
+			SpoolPending();
 
-		for (const auto &item : _items2do)
+		size_t iBatchLines = (m_iBatchLines > 0) ? m_iBatchLines : iInfluxBatchSize;
+		uint64_t spoolEnd = 0;
+		bool bFromSpool = (m_spool.Peek(iBatchLines, lines, spoolEnd) > 0);
+		if (!bFromSpool)
 		{
-			if (!sSendData.empty())
-				sSendData += '\n';
-
-			std::stringstream sziData;
-			sziData << item.skey << " value=";
-			if (item.skey.find("Text,") == 0)
-				sziData << "\"" << item.svalue << "\"";
-			else
-				sziData << item.svalue;
-			if (m_bInfluxDebugActive)
-			{
-				_log.Log(LOG_NORM, "InfluxLink: value %s", sziData.str().c_str());
-			}
-			sziData << " " << item.stimestamp;
-			sSendData += sziData.str();
+			std::lock_guard<std::mutex> l(m_background_task_mutex);
+			if (m_background_task_queue.empty())
+				continue;
+			if ((m_background_task_queue.size() < iBatchLines) && (atime - m_tOldestQueued < iInfluxFlushSeconds))
+				continue;
+			size_t nLines = std::min(m_background_task_queue.size(), iBatchLines);
+			lines.assign(std::make_move_iterator(m_background_task_queue.begin()), std::make_move_iterator(m_background_task_queue.begin() + nLines));
+			m_background_task_queue.erase(m_background_task_queue.begin(), m_background_task_queue.begin() + nLines);
+			m_tOldestQueued = atime;
 		}
-		std::vector<std::string> ExtraHeaders;
-		std::string sResult;
-		if (m_bInfluxVersion2)
+
+		_eSendResult result = SendBatch(lines);
+		if (result == SEND_TOO_LARGE)
 		{
-			ExtraHeaders.push_back("Authorization: Token " + base64_decode(m_InfluxPassword));
-			ExtraHeaders.push_back("Content-type: text/plain");
+			// sent again right away from the spool, in batches of half the size
+			m_iBatchLines = std::max<size_t>(lines.size() / 2, 1);
+			_log.Log(LOG_STATUS, "InfluxLink: InfluxDB server refused %d points as too large, sending at most %d points per request", static_cast<int>(lines.size()),
+				 static_cast<int>(m_iBatchLines));
+			if (!bFromSpool)
+				m_statDropped += m_spool.Push(lines);
+			continue;
 		}
-
-		bool bRet = HTTPClient::POST(m_szURL, sSendData, ExtraHeaders, sResult, true, true);
-		if (!bRet)
+		if (result != SEND_RETRY)
 		{
-			_log.Log(LOG_ERROR, "InfluxLink: Error sending data to InfluxDB server! (check address/port/database/username/password)");
+			if (bFromSpool)
+				m_spool.Pop(spoolEnd);
+			if (result == SEND_OK)
+				m_statSent += lines.size();
+			else
+				m_statDropped += lines.size();
+			backoffSeconds = 0;
+			tNextAttempt = 0;
 		}
-		else if (!sResult.empty())
+		else
 		{
-			Json::Value root;
-			bool ret = ParseJSon(sResult, root);
-			if (root.isObject())
-			{
-				if (!root["code"].empty())
-				{
-					std::string szCode = root["code"].asString();
-					bool bHaveError = false;
-					std::string szMessage;
-
-					if (
-						(szCode == "unauthorized")
-						|| (szCode == "forbidden")
-						)
-					{
-						bHaveError = true;
-						szMessage = root["message"].asString();
-					}
-
-					if (bHaveError)
-					{
-						_log.Log(LOG_ERROR, "InfluxLink: Error sending data to InfluxDB server! (%s)", szMessage.c_str());
-					}
-				}
-			}
+			if (!bFromSpool)
+				m_statDropped += m_spool.Push(lines);
+			backoffSeconds = (backoffSeconds == 0) ? 1 : std::min(backoffSeconds * 2, iInfluxMaxBackoffSeconds);
+			tNextAttempt = atime + backoffSeconds;
 		}
 	}
+	// keep what was not sent yet for the next start
+	SpoolPending();
+}
+
+CInfluxPush::_tInfluxStats CInfluxPush::GetStats()
+{
+	_tInfluxStats stats;
+	{
+		std::lock_guard<std::mutex> l(m_background_task_mutex);
+		stats.queued = m_background_task_queue.size();
+	}
+	stats.spooled = m_spool.Records();
+	stats.sent = m_statSent;
+	stats.dropped = m_statDropped;
+	stats.failedPosts = m_statFailedPosts;
+	stats.lastPostMs = m_statLastPostMs;
+	stats.maxPostMs = m_statMaxPostMs;
+	uint64_t posts = m_statPosts;
+	if (posts > 0)
+		stats.avgPostMs = m_statTotalPostMs / posts;
+	return stats;
 }
 
 // Webserver helpers
@@ -371,6 +507,26 @@ namespace http
 			root["title"] = "GetInfluxLinkConfig";
 		}
 
+		void CWebServer::Cmd_GetInfluxLinkStats(WebEmSession &session, const request &req, Json::Value &root)
+		{
+			if (session.rights != 2)
+			{
+				session.reply_status = reply::forbidden;
+				return; // Only admin user allowed
+			}
+			CInfluxPush::_tInfluxStats stats = m_influxpush.GetStats();
+			root["queued"] = (Json::UInt64)stats.queued;
+			root["spooled"] = (Json::UInt64)stats.spooled;
+			root["sent"] = (Json::UInt64)stats.sent;
+			root["dropped"] = (Json::UInt64)stats.dropped;
+			root["failedposts"] = (Json::UInt64)stats.failedPosts;
+			root["post_last_ms"] = (Json::UInt64)stats.lastPostMs;
+			root["post_avg_ms"] = (Json::UInt64)stats.avgPostMs;
+			root["post_max_ms"] = (Json::UInt64)stats.maxPostMs;
+			root["status"] = "OK";
+			root["title"] = "GetInfluxLinkStats";
+		}
+
 		void CWebServer::Cmd_GetInfluxLinks(WebEmSession &session, const request &req, Json::Value &root)
 		{
 			if (session.rights != 2)
@@ -2,6 +2,9 @@
 #include "BasePush.h"
 
 #include "../main/StoppableTask.h"
+#include "PushSpool.h"
+#include <atomic>
+#include <deque>
 
 class CInfluxPush : public CBasePush, public StoppableTask
 {
@@ -10,7 +13,20 @@ public:
 	bool Start();
 	void Stop();
 	void UpdateSettings();
-	void DoInfluxPush(const uint64_t DeviceRowIdx, const bool bForced = false);
+
+	struct _tInfluxStats
+	{
+		uint64_t queued = 0;  // points waiting in memory
+		uint64_t spooled = 0; // points waiting in the disk spool
+		uint64_t sent = 0;
+		uint64_t dropped = 0;
+		uint64_t failedPosts = 0;
+		uint64_t lastPostMs = 0;
+		uint64_t avgPostMs = 0;
+		uint64_t maxPostMs = 0;
+	};
+	_tInfluxStats GetStats();
+
 private:
 	struct _tPushItem
 	{
@@ -18,14 +34,35 @@ private:
 		time_t stimestamp;
 		std::string svalue;
 	};
-	void OnDeviceReceived(int m_HwdID, uint64_t DeviceRowIdx, const std::string& DeviceName, const unsigned char* pRXCommand);
+	enum _eSendResult
+	{
+		SEND_OK,
+		SEND_RETRY,	// server unreachable, failing or refusing access, try again later
+		SEND_TOO_LARGE, // request too large, send it again in smaller batches
+		SEND_REJECTED	// bad line protocol, sending it again will not help
+	};
+	void OnPushValue(const _tPushDeviceValue &value, const std::vector<_tPushLinks> &links, const bool bForced) override;
 
 	std::shared_ptr<std::thread> m_thread;
 	std::mutex m_background_task_mutex;
 	void Do_Work();
+	_eSendResult SendBatch(const std::vector<std::string> &lines);
+	void SpoolPending();
 
 	std::map<std::string, _tPushItem> m_PushedItems;
-	std::vector<_tPushItem> m_background_task_queue;
+	std::deque<std::string> m_background_task_queue; // line protocol lines
+	time_t m_tOldestQueued = 0;
+	size_t m_iBatchLines = 0; // lines per POST, lowered when the server says a request is too large
+	CPushSpool m_spool;
+
+	std::atomic<uint64_t> m_statSent{ 0 };
+	std::atomic<uint64_t> m_statDropped{ 0 };
+	std::atomic<uint64_t> m_statFailedPosts{ 0 };
+	std::atomic<uint64_t> m_statPosts{ 0 };
+	std::atomic<uint64_t> m_statLastPostMs{ 0 };
+	std::atomic<uint64_t> m_statTotalPostMs{ 0 };
+	std::atomic<uint64_t> m_statMaxPostMs{ 0 };
+
 	std::string m_szURL;
 	std::string m_InfluxIP;
 	int m_InfluxPort{ 8086 };
@@ -37,15 +37,14 @@ bool CMQTTPush::Start()
 	m_thread = std::make_shared<std::thread>([this] { Do_Work(); });
 	SetThreadName(m_thread->native_handle(), "MQTTPush");
 
-	m_sConnection = m_mainworker.sOnDeviceReceived.connect([this](auto id, auto idx, const auto& name, auto rx) { OnDeviceReceived(id, idx, name, rx); });
+	RegisterPushTarget();
 
 	return (m_thread != nullptr);
 }
 
 void CMQTTPush::Stop()
 {
-	if (m_sConnection.connected())
-		m_sConnection.disconnect();
+	UnregisterPushTarget();
 
 	StopHardware();
 
@@ -143,52 +142,36 @@ void CMQTTPush::UpdateSettings()
 	}
 }
 
-void CMQTTPush::OnDeviceReceived(int m_HwdID, uint64_t DeviceRowIdx, const std::string& DeviceName, const unsigned char* pRXCommand)
+void CMQTTPush::OnPushValue(const _tPushDeviceValue &value, const std::vector<_tPushLinks> &links, const bool bForced)
 {
-	DoMQTTPush(DeviceRowIdx);
-}
-
-void CMQTTPush::DoMQTTPush(const uint64_t DeviceRowIdx, const bool bForced)
-{
-	if (!m_bLinkActive)
-		return;
-	if (!IsLinkInDatabase(DeviceRowIdx))
-		return;
-
-	std::vector<std::vector<std::string>> result;
-	result = m_sql.safe_query(
-		"SELECT A.DeviceRowID, A.DelimitedValue, B.ID, B.Type, B.SubType, B.nValue, B.sValue, A.TargetType, A.IncludeUnit, B.Name, B.SwitchType FROM PushLink as A, DeviceStatus as B "
-		"WHERE (A.PushType==%d AND A.DeviceRowID == '%" PRIu64 "' AND A.Enabled==1 AND A.DeviceRowID==B.ID)",
-		PushType::PUSHTYPE_MQTT, DeviceRowIdx);
-	if (result.empty())
-		return;
+	const uint64_t DeviceRowIdx = value.DeviceRowIdx;
 
 	Json::Value root;
 	bool bHaveChanges = false;
 
 	time_t atime = mytime(nullptr);
 
-	int dType = atoi(result[0][3].c_str());
-	int dSubType = atoi(result[0][4].c_str());
-	int nValue = atoi(result[0][5].c_str());
-	std::string sValue = result[0][6];
-	std::string name = result[0][9];
-	int metertype = atoi(result[0][10].c_str());
+	int dType = value.devType;
+	int dSubType = value.devSubType;
+	int nValue = value.nValue;
+	const std::string &sValue = value.sValue;
+	std::string name = value.DeviceName;
+	int metertype = value.metertype;
+	stdreplace(name, " ", "_");
+	std::string szIdx = std::to_string(DeviceRowIdx);
 
-	for (const auto& sd : result)
+	for (const auto& link : links)
 	{
 		std::string sendValue;
-		int delpos = atoi(sd[1].c_str());
-		int targetType = atoi(sd[7].c_str());
-		int includeUnit = atoi(sd[8].c_str());
+		int delpos = link.DelimiterPos;
+		int targetType = link.targetType;
+		int includeUnit = link.includeUnit;
 
-		std::vector<std::string> strarray;
-		if (sValue.find(';') != std::string::npos)
+		if (!value.sValues.empty())
 		{
-			StringSplit(sValue, ";", strarray);
-			if (int(strarray.size()) >= delpos)
+			if (int(value.sValues.size()) >= delpos)
 			{
-				std::string rawsendValue = strarray[delpos - 1];
+				const std::string &rawsendValue = value.sValues[delpos - 1];
 				sendValue = ProcessSendValue(DeviceRowIdx, rawsendValue, delpos, nValue, sValue, includeUnit, dType, dSubType, metertype);
 			}
 		}
@@ -198,12 +181,10 @@ void CMQTTPush::DoMQTTPush(const uint64_t DeviceRowIdx, const bool bForced)
 		if (sendValue.empty())
 			continue;
 
-		std::string szKey;
-		std::string vType = CBasePush::DropdownOptionsValue(dType, dSubType, delpos);
+		std::string vType = link.vType;
 		stdreplace(vType, " ", "_");
 		stdlower(vType);
-		stdreplace(name, " ", "_");
-		szKey = vType + ",idx=" + sd[0] + ",name=" + name;
+		std::string szKey = vType + ",idx=" + szIdx + ",name=" + name;
 
 		if (is_number(sendValue))
 		{
@@ -21,8 +21,7 @@ private:
 		std::string json;
 		time_t stimestamp;
 	};
-	void OnDeviceReceived(int m_HwdID, uint64_t DeviceRowIdx, const std::string& DeviceName, const unsigned char* pRXCommand);
-	void DoMQTTPush(const uint64_t DeviceRowIdx, const bool bForced = false);
+	void OnPushValue(const _tPushDeviceValue &value, const std::vector<_tPushLinks> &links, const bool bForced) override;
 
 	std::shared_ptr<std::thread> m_thread;
 	std::mutex m_background_task_mutex;
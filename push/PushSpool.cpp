@@ -0,0 +1,210 @@
+#include "stdafx.h"
+#include "PushSpool.h"
+#include "../main/Logger.h"
+
+namespace
+{
+	constexpr char szSpoolMagic[4] = { 'D', 'Z', 'S', 'P' };
+	constexpr uint32_t iSpoolVersion = 1;
+	// magic, version, capacity, head, tail, records
+	constexpr uint64_t iHeaderSize = 4 + 4 + 8 + 8 + 8 + 8;
+	constexpr uint64_t iRecordHeaderSize = 4;
+} // namespace
+
+CPushSpool::~CPushSpool()
+{
+	Close();
+}
+
+bool CPushSpool::Open(const std::string &szFileName, const uint64_t capacity)
+{
+	std::lock_guard<std::mutex> l(m_mutex);
+	if (m_file.is_open())
+		m_file.close();
+
+	m_capacity = capacity;
+	m_head = m_tail = m_records = 0;
+
+	m_file.open(szFileName, std::ios::in | std::ios::out | std::ios::binary);
+	if (m_file.is_open())
+	{
+		char header[iHeaderSize];
+		if (m_file.read(header, sizeof(header)) && (memcmp(header, szSpoolMagic, sizeof(szSpoolMagic)) == 0))
+		{
+			uint32_t version;
+			uint64_t fileCapacity;
+			memcpy(&version, header + 4, sizeof(version));
+			memcpy(&fileCapacity, header + 8, sizeof(fileCapacity));
+			if ((version == iSpoolVersion) && (fileCapacity == capacity))
+			{
+				memcpy(&m_head, header + 16, sizeof(m_head));
+				memcpy(&m_tail, header + 24, sizeof(m_tail));
+				memcpy(&m_records, header + 32, sizeof(m_records));
+				if ((m_tail >= m_head) && (m_tail - m_head <= m_capacity))
+					return true;
+			}
+			_log.Log(LOG_ERROR, "PushSpool: %s has a different layout, starting with an empty spool", szFileName.c_str());
+		}
+		m_file.close();
+		m_head = m_tail = m_records = 0;
+	}
+
+	// (re)create
+	m_file.open(szFileName, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!m_file.is_open())
+	{
+		_log.Log(LOG_ERROR, "PushSpool: cannot create spool file %s", szFileName.c_str());
+		return false;
+	}
+	WriteHeader();
+	return true;
+}
+
+void CPushSpool::Close()
+{
+	std::lock_guard<std::mutex> l(m_mutex);
+	if (m_file.is_open())
+		m_file.close();
+}
+
+bool CPushSpool::IsOpen()
+{
+	std::lock_guard<std::mutex> l(m_mutex);
+	return m_file.is_open();
+}
+
+uint64_t CPushSpool::Records()
+{
+	std::lock_guard<std::mutex> l(m_mutex);
+	return m_records;
+}
+
+uint64_t CPushSpool::UsedBytes()
+{
+	std::lock_guard<std::mutex> l(m_mutex);
+	return m_tail - m_head;
+}
+
+void CPushSpool::WriteHeader()
+{
+	char header[iHeaderSize];
+	memcpy(header, szSpoolMagic, sizeof(szSpoolMagic));
+	memcpy(header + 4, &iSpoolVersion, sizeof(iSpoolVersion));
+	memcpy(header + 8, &m_capacity, sizeof(m_capacity));
+	memcpy(header + 16, &m_head, sizeof(m_head));
+	memcpy(header + 24, &m_tail, sizeof(m_tail));
+	memcpy(header + 32, &m_records, sizeof(m_records));
+	m_file.clear();
+	m_file.seekp(0);
+	m_file.write(header, sizeof(header));
+	m_file.flush();
+}
+
+void CPushSpool::ReadAt(const uint64_t pos, char *pData, const uint64_t len)
+{
+	uint64_t offset = pos % m_capacity;
+	uint64_t first = std::min(len, m_capacity - offset);
+	m_file.clear();
+	m_file.seekg(iHeaderSize + offset);
+	m_file.read(pData, first);
+	if (first < len)
+	{
+		m_file.seekg(iHeaderSize);
+		m_file.read(pData + first, len - first);
+	}
+}
+
+void CPushSpool::WriteAt(const uint64_t pos, const char *pData, const uint64_t len)
+{
+	uint64_t offset = pos % m_capacity;
+	uint64_t first = std::min(len, m_capacity - offset);
+	m_file.clear();
+	m_file.seekp(iHeaderSize + offset);
+	m_file.write(pData, first);
+	if (first < len)
+	{
+		m_file.seekp(iHeaderSize);
+		m_file.write(pData + first, len - first);
+	}
+}
+
+uint32_t CPushSpool::ReadRecordLength(const uint64_t pos)
+{
+	uint32_t len = 0;
+	ReadAt(pos, reinterpret_cast<char *>(&len), sizeof(len));
+	return len;
+}
+
+uint64_t CPushSpool::Push(const std::vector<std::string> &records)
+{
+	std::lock_guard<std::mutex> l(m_mutex);
+	if (!m_file.is_open())
+		return records.size();
+
+	uint64_t dropped = 0;
+	for (const auto &record : records)
+	{
+		uint64_t needed = iRecordHeaderSize + record.size();
+		if (needed > m_capacity)
+		{
+			dropped++;
+			continue;
+		}
+		while (m_capacity - (m_tail - m_head) < needed)
+		{
+			// drop the oldest record
+			m_head += iRecordHeaderSize + ReadRecordLength(m_head);
+			m_records--;
+			dropped++;
+		}
+		uint32_t len = static_cast<uint32_t>(record.size());
+		WriteAt(m_tail, reinterpret_cast<const char *>(&len), sizeof(len));
+		WriteAt(m_tail + iRecordHeaderSize, record.data(), record.size());
+		m_tail += needed;
+		m_records++;
+	}
+	m_file.flush();
+	WriteHeader();
+	return dropped;
+}
+
+size_t CPushSpool::Peek(const size_t maxRecords, std::vector<std::string> &records, uint64_t &end)
+{
+	std::lock_guard<std::mutex> l(m_mutex);
+	records.clear();
+	end = m_head;
+	if (!m_file.is_open())
+		return 0;
+	uint64_t pos = m_head;
+	while ((records.size() < maxRecords) && (pos < m_tail))
+	{
+		uint32_t len = ReadRecordLength(pos);
+		if (pos + iRecordHeaderSize + len > m_tail)
+			break; // corrupt, should not happen
+		std::string record;
+		record.resize(len);
+		if (len > 0)
+			ReadAt(pos + iRecordHeaderSize, &record[0], len);
+		records.push_back(std::move(record));
+		pos += iRecordHeaderSize + len;
+	}
+	end = pos;
+	return records.size();
+}
+
+void CPushSpool::Pop(const uint64_t end)
+{
+	std::lock_guard<std::mutex> l(m_mutex);
+	if (!m_file.is_open())
+		return;
+	// positions only grow between Peek and Pop (the reset below is done here), so a head that Push
+	// moved past end means the peeked records were dropped already
+	while ((m_head < end) && (m_head < m_tail))
+	{
+		m_head += iRecordHeaderSize + ReadRecordLength(m_head);
+		m_records--;
+	}
+	if (m_head == m_tail)
+		m_head = m_tail = m_records = 0;
+	WriteHeader();
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Bounded on-disk FIFO of text records, stored as a ring inside a fixed size file.
+// When the ring is full the oldest records are dropped.
+class CPushSpool
+{
+public:
+	~CPushSpool();
+	bool Open(const std::string &szFileName, uint64_t capacity);
+	void Close();
+	bool IsOpen();
+
+	// appends records, returns the number of (older) records that had to be dropped to make room
+	uint64_t Push(const std::vector<std::string> &records);
+	// reads up to maxRecords from the front without removing them, end is the position after the last
+	// record read, to pass to Pop
+	size_t Peek(size_t maxRecords, std::vector<std::string> &records, uint64_t &end);
+	// removes the records before end. Records that Push dropped in the meantime are not removed twice,
+	// and records pushed after the Peek are kept
+	void Pop(uint64_t end);
+
+	uint64_t Records();
+	uint64_t UsedBytes();
+
+private:
+	void WriteHeader();
+	void ReadAt(uint64_t pos, char *pData, uint64_t len);
+	void WriteAt(uint64_t pos, const char *pData, uint64_t len);
+	uint32_t ReadRecordLength(uint64_t pos);
+
+	std::mutex m_mutex;
+	std::fstream m_file;
+	uint64_t m_capacity = 0;
+	uint64_t m_head = 0; // logical read position
+	uint64_t m_tail = 0; // logical write position
+	uint64_t m_records = 0;
+};
@@ -18,8 +18,8 @@ void CWebSocketPush::Start()
 	if (isStarted) {
 		return;
 	}
-	m_sConnection = m_mainworker.sOnDeviceReceived.connect([this](auto id, auto idx, auto &&name, auto rx) { OnDeviceReceived(id, idx, name, rx); });
-	m_sDeviceUpdate = m_mainworker.sOnDeviceUpdate.connect([this](auto id, auto idx) { OnDeviceUpdate(id, idx); });
+	// the browser reloads the device, so one queued notification per device is enough
+	m_sDeviceEvents = m_mainworker.m_deviceEventBus.Subscribe("Websocket", CDeviceEventBus::_eQueuePolicy::LATEST_PER_DEVICE, 1024, false, [this](const auto &event) { OnDeviceChanged(event.DeviceRowIdx); });
 	m_sNotification = sOnNotificationReceived.connect([this](auto &&s, auto &&t, auto &&e, auto p, auto &&sound, auto n) { OnNotificationReceived(s, t, e, p, sound, n); });
 	m_sSceneChanged = m_mainworker.sOnSwitchScene.connect([this](auto idx, auto &&name) { OnSceneChange(idx, name); });
 
@@ -35,13 +35,11 @@ void CWebSocketPush::Stop()
 
 	isStarted = false;
 
-	std::unique_lock<std::mutex> lock(handlerMutex);
-
-	if (m_sConnection.connected())
-		m_sConnection.disconnect();
+	// waits for a running handler, which takes handlerMutex
+	if (m_sDeviceEvents.connected())
+		m_sDeviceEvents.disconnect();
 
-	if (m_sDeviceUpdate.connected())
-		m_sDeviceUpdate.disconnect();
+	std::unique_lock<std::mutex> lock(handlerMutex);
 
 	if (m_sNotification.connected())
 		m_sNotification.disconnect();
@@ -52,17 +50,7 @@ void CWebSocketPush::Stop()
 	m_sLogMessage.disconnect();
 }
 
-void CWebSocketPush::OnDeviceReceived(const int m_HwdID, const uint64_t DeviceRowIdx, const std::string &DeviceName, const unsigned char *pRXCommand)
-{
-	std::unique_lock<std::mutex> lock(handlerMutex);
-	if (!isStarted) {
-		return;
-	}
-
-	m_sock->OnDeviceChanged(DeviceRowIdx);
-}
-
-void CWebSocketPush::OnDeviceUpdate(const int m_HwdID, const uint64_t DeviceRowIdx)
+void CWebSocketPush::OnDeviceChanged(const uint64_t DeviceRowIdx)
 {
 	std::unique_lock<std::mutex> lock(handlerMutex);
 	if (!isStarted) {
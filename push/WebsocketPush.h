@@ -1,5 +1,6 @@
 #pragma once
 #include "BasePush.h"
+#include "../main/DeviceEventBus.h"
 #include "../main/lsignal.h"
 
 enum _eLogLevel : uint32_t;
@@ -20,8 +21,7 @@ public:
 	void Stop();
 	void onDeviceTableChanged(); // device added, or deleted
 private:
-	void OnDeviceReceived(int m_HwdID, uint64_t DeviceRowIdx, const std::string &DeviceName, const unsigned char *pRXCommand);
-	void OnDeviceUpdate(int m_HwdID, uint64_t DeviceRowIdx);
+	void OnDeviceChanged(uint64_t DeviceRowIdx);
 	void OnNotificationReceived(const std::string &Subject, const std::string &Text, const std::string &ExtraData, int Priority, const std::string &Sound, bool bFromNotification);
 	void OnSceneChange(uint64_t SceneRowIdx, const std::string &SceneName);
 	void OnLogMessage(const _eLogLevel level, const std::string& sLogline);
@@ -32,6 +32,7 @@ private:
 	bool isStarted;
 
 	lsignal::slot m_sLogMessage;
+	CDeviceEventBus::subscription m_sDeviceEvents;
 
 };
 
@@ -11,7 +11,11 @@
 -- Retrieve the request content
 s = request['content'];
 
+-- Parse the content once and query it as often as needed
+-- (domoticz_applyJsonPath(s,'.id') also works, the string is only parsed on the first call)
+local doc = domoticz_parseJson(s)
+
 -- Update some devices (index are here for this example)
-local id = domoticz_applyJsonPath(s,'.id')
-local s = domoticz_applyJsonPath(s,'.temperature')
+local id = doc:path('.id')
+local s = doc:path('.temperature')
 domoticz_updateDevice(id,'',s)
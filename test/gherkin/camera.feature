@@ -0,0 +1,31 @@
+Feature: Camera snapshots
+    Snapshots are served from a cache while they are younger than the max age (default 1000 ms)
+    and concurrent requests for the same camera share one fetch, so a camera that is viewed by
+    several users at once is only asked for one snapshot. In relay mode one MJPEG stream is kept open
+    to the camera and its frames are handed to all viewers
+
+    Background:
+        Given Domoticz is running
+        And accessible on port 8080
+
+    Scenario: Concurrent snapshot requests share one camera fetch
+        Given a stand-in camera on port 8090 that takes 1 seconds for a snapshot
+        And the camera is added to Domoticz
+        When 5 viewers request a snapshot at the same time
+        Then every viewer receives the snapshot of the camera
+        And the camera was asked for 1 snapshots
+
+    Scenario: A snapshot older than the max age is fetched again
+        Given a stand-in camera on port 8091 that takes 0 seconds for a snapshot
+        And the camera is added to Domoticz
+        When 1 viewers request a snapshot at the same time
+        And 1 viewers request a snapshot after 2 seconds
+        Then every viewer receives the snapshot of the camera
+        And the camera was asked for 2 snapshots
+
+    Scenario: The relay shares one MJPEG stream between the viewers
+        Given a stand-in MJPEG camera on port 8092 that sends a frame every 100 ms
+        And Command domoticztester is available
+        When 5 viewers read 3 frames each through the relay
+        Then every viewer receives successive frames of the stream
+        And the camera opened 1 streams
@@ -0,0 +1,14 @@
+Feature: Meter store
+    With a meter write interval the values of a meter are held back in the meter store (main/MeterStore.cpp),
+    a DeviceStatus write by someone else makes the store read the row again
+
+    Background:
+        Given Command domoticztester is available
+        And can be executed on the commandline
+
+    Scenario: A held back value is only dropped when someone else changed the value
+        Given I am testing the "meterstore" module
+        When I test the function "pending"
+        And I provide the following input "100"
+        Then I expect the function to succeed
+        And have the following result "reads during the updates: 1, held back value kept after a rename: yes, value set by someone else kept: yes"
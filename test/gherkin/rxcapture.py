@@ -0,0 +1,57 @@
+#!/usr/bin/env python3
+# Writes RX capture files for domoticz -rxreplay (see main/RxCapture.h for the layout)
+#
+#   python3 test/gherkin/rxcapture.py [--interfaces N] [--frames N] [--interval-ms N] capture.dzrx
+#
+# The frames are P1 smart meter power readings, one meter per interface (hardware id 1..N), the
+# interfaces take turns so every RX thread gets work when the capture is replayed
+
+import argparse, struct
+
+HTYPE_P1SmartMeter = 4
+pTypeP1Power = 0xFA
+sTypeP1Power = 0x01
+
+
+def p1_power(usage1, usage2, deliv1, deliv2, usagecurrent, delivcurrent, id=1):
+    # _tP1Power, the three header bytes are followed by one pad byte
+    return struct.pack('<BBBxIIIIIIi', 31, pTypeP1Power, sTypeP1Power, usage1, usage2, deliv1, deliv2, usagecurrent, delivcurrent, id)
+
+
+def short_string(value):
+    data = value.encode('utf-8')[:255]
+    return struct.pack('<B', len(data)) + data
+
+
+def frame(delta_us, hardware_type, hardware_id, battery, name, username, rxcommand):
+    return struct.pack('<IHih', delta_us, hardware_type, hardware_id, battery) + short_string(name) + short_string(username) + rxcommand
+
+
+def p1_readings(interfaces, frames, interval_ms=1000):
+    # the values each meter reports, in capture order: (hardware id, usage1, usage2, deliv1, deliv2, usage, deliv)
+    readings = []
+    for ii in range(frames):
+        for hwid in range(1, interfaces + 1):
+            usage = 200 + (ii * 7 + hwid * 13) % 800
+            readings.append((hwid, 1000000 * hwid + ii * 3, 500000 * hwid + ii, 0, 0, usage, 0))
+    return readings
+
+
+def write_p1_capture(path, interfaces=1, frames=100, interval_ms=1000):
+    readings = p1_readings(interfaces, frames, interval_ms)
+    delta_us = (interval_ms * 1000) // interfaces
+    with open(path, 'wb') as f:
+        f.write(b'DZRX' + struct.pack('<B', 1))
+        for reading in readings:
+            f.write(frame(delta_us, HTYPE_P1SmartMeter, reading[0], 255, "Power", "", p1_power(*reading[1:])))
+    return readings
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description='Write a P1 meter capture for domoticz -rxreplay')
+    parser.add_argument('--interfaces', type=int, default=1)
+    parser.add_argument('--frames', type=int, default=100, help='frames per interface')
+    parser.add_argument('--interval-ms', type=int, default=1000, help='time between two frames of an interface')
+    parser.add_argument('file')
+    args = parser.parse_args()
+    write_p1_capture(args.file, args.interfaces, args.frames, args.interval_ms)
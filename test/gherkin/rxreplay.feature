@@ -0,0 +1,20 @@
+Feature: RX replay
+    domoticz -rxreplay feeds a capture of received frames through the RX queues, the replayed values
+    are decoded and stored like received ones and the queue/decode/db/event/push timings are logged
+
+    Background:
+        Given Command domoticz is available
+        And can be executed on the commandline
+
+    Scenario: Replay a P1 meter capture into an in-memory database
+        Given a capture of 2 P1 meters sending 100 frames each
+        When I replay the capture into an in-memory database
+        Then the replay reports 200 frames
+        And the replay reports the timings of the queue, decode, db, event and push stages
+
+    Scenario: Held back meter values end up in the database
+        Given a capture of 2 P1 meters sending 100 frames each
+        And a scratch database with a meter write interval of 60 seconds
+        When I replay the capture into the scratch database
+        Then the replay reports 200 frames
+        And every meter in the scratch database has the value of its last frame
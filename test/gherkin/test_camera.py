@@ -0,0 +1,136 @@
+from pytest_bdd import scenario, given, when, then, parsers
+from http.server import BaseHTTPRequestHandler, HTTPServer, ThreadingHTTPServer
+from concurrent.futures import ThreadPoolExecutor
+import requests, subprocess, threading, time, base64
+
+SNAPSHOT = b"\xff\xd8stand-in camera snapshot\xff\xd9"
+
+@scenario('camera.feature', 'Concurrent snapshot requests share one camera fetch')
+def test_snapshotcoalescing():
+    pass
+
+@scenario('camera.feature', 'A snapshot older than the max age is fetched again')
+def test_snapshotmaxage():
+    pass
+
+@scenario('camera.feature', 'The relay shares one MJPEG stream between the viewers')
+def test_relaymjpeg():
+    pass
+
+class StandInCamera(HTTPServer):
+    iRequests = 0
+    fDelay = 0
+
+class StandInCameraHandler(BaseHTTPRequestHandler):
+    def do_GET(self):
+        self.server.iRequests += 1
+        time.sleep(self.server.fDelay)
+        self.send_response(200)
+        self.send_header("Content-Type", "image/jpeg")
+        self.send_header("Content-Length", str(len(SNAPSHOT)))
+        self.end_headers()
+        self.wfile.write(SNAPSHOT)
+
+    def log_message(self, format, *args):
+        pass
+
+class StandInMJPEGCamera(ThreadingHTTPServer):
+    daemon_threads = True
+    iRequests = 0
+    fInterval = 0
+    bStopped = False
+
+class StandInMJPEGCameraHandler(BaseHTTPRequestHandler):
+    def do_GET(self):
+        self.server.iRequests += 1
+        self.send_response(200)
+        self.send_header("Content-Type", "multipart/x-mixed-replace; boundary=standinframe")
+        self.end_headers()
+        iFrame = 0
+        try:
+            while not self.server.bStopped:
+                iFrame += 1
+                frame = b"\xff\xd8frame " + str(iFrame).encode() + b"\xff\xd9"
+                self.wfile.write(b"--standinframe\r\nContent-Type: image/jpeg\r\nContent-Length: " + str(len(frame)).encode() + b"\r\n\r\n" + frame + b"\r\n")
+                self.wfile.flush()
+                time.sleep(self.server.fInterval)
+        except (BrokenPipeError, ConnectionResetError):
+            pass
+
+    def log_message(self, format, *args):
+        pass
+
+@given(parsers.parse('a stand-in camera on port {port:d} that takes {delay:d} seconds for a snapshot'))
+def standin_camera(test_domoticz, request, port, delay):
+    oCamera = StandInCamera(("127.0.0.1", port), StandInCameraHandler)
+    oCamera.fDelay = delay
+    threading.Thread(target=oCamera.serve_forever, daemon=True).start()
+    request.addfinalizer(oCamera.shutdown)
+    test_domoticz.oCamera = oCamera
+    test_domoticz.lSnapshots = []
+
+@given(parsers.parse('a stand-in MJPEG camera on port {port:d} that sends a frame every {interval:d} ms'))
+def standin_mjpeg_camera(test_domoticz, request, port, interval):
+    oCamera = StandInMJPEGCamera(("127.0.0.1", port), StandInMJPEGCameraHandler)
+    oCamera.fInterval = interval / 1000
+    threading.Thread(target=oCamera.serve_forever, daemon=True).start()
+    def stop_camera():
+        oCamera.bStopped = True
+        oCamera.shutdown()
+    request.addfinalizer(stop_camera)
+    test_domoticz.oCamera = oCamera
+
+@given('the camera is added to Domoticz')
+def add_camera(test_domoticz, request):
+    sName = "standin" + str(test_domoticz.oCamera.server_port)
+    requests.get(test_domoticz.sBaseURI + "/json.htm", params={"type": "command", "param": "addcamera", "name": sName, "enabled": "true",
+        "address": "127.0.0.1", "port": test_domoticz.oCamera.server_port, "username": "", "password": "",
+        "imageurl": base64.b64encode(b"snapshot.jpg").decode(), "protocol": 0, "aspectratio": 0})
+    oResult = requests.get(test_domoticz.sBaseURI + "/json.htm?type=command&param=getcameras")
+    sIdx = [camera["idx"] for camera in oResult.json()["result"] if camera["Name"] == sName][-1]
+    request.addfinalizer(lambda: requests.get(test_domoticz.sBaseURI + "/json.htm?type=command&param=deletecamera&idx=" + sIdx))
+    test_domoticz.sCameraIdx = sIdx
+
+def request_snapshots(test_domoticz, viewers):
+    uri = test_domoticz.sBaseURI + "/camsnapshot.jpg?idx=" + test_domoticz.sCameraIdx
+    with ThreadPoolExecutor(max_workers=viewers) as executor:
+        test_domoticz.lSnapshots += list(executor.map(lambda ii: requests.get(uri), range(viewers)))
+
+@when(parsers.parse('{viewers:d} viewers request a snapshot at the same time'))
+def request_concurrent(test_domoticz, viewers):
+    request_snapshots(test_domoticz, viewers)
+
+@when(parsers.parse('{viewers:d} viewers request a snapshot after {delay:d} seconds'))
+def request_later(test_domoticz, viewers, delay):
+    time.sleep(delay)
+    request_snapshots(test_domoticz, viewers)
+
+@then('every viewer receives the snapshot of the camera')
+def check_snapshots(test_domoticz):
+    for oResult in test_domoticz.lSnapshots:
+        assert oResult.status_code == 200
+        assert oResult.content == SNAPSHOT
+
+@then(parsers.parse('the camera was asked for {count:d} snapshots'))
+def check_camera_requests(test_domoticz, count):
+    assert test_domoticz.oCamera.iRequests == count
+
+@when(parsers.parse('{viewers:d} viewers read {frames:d} frames each through the relay'))
+def read_relay(test_domoticz, viewers, frames):
+    sURL = "http://127.0.0.1:" + str(test_domoticz.oCamera.server_port) + "/stream.mjpg"
+    sOut = subprocess.run([ test_domoticz.sCommand, "-quiet", "-module", "camerafeed", "-function", "relay", "-input", "|#|".join([ sURL, str(viewers), str(frames) ]) ],
+        stdout=subprocess.PIPE, stderr=subprocess.STDOUT, timeout=60)
+    test_domoticz.iTestReturnCode = sOut.returncode
+    test_domoticz.iRelayFrames = viewers * frames
+    sResult = sOut.stdout.decode("utf-8")
+    test_domoticz.sTestOutput = sResult[sResult.find("Result : .") + 10:sResult.rfind(".")] if sResult.find("Result : .") >= 0 else sResult
+
+@then('every viewer receives successive frames of the stream')
+def check_relay_frames(test_domoticz):
+    assert test_domoticz.iTestReturnCode == 0, test_domoticz.sTestOutput
+    iFrames = test_domoticz.iRelayFrames
+    assert test_domoticz.sTestOutput == "frames: %d, successive frames: %d, snapshot fetches: 0" % (iFrames, iFrames)
+
+@then(parsers.parse('the camera opened {count:d} streams'))
+def check_camera_streams(test_domoticz, count):
+    assert test_domoticz.oCamera.iRequests == count
@@ -61,10 +61,30 @@ def test_base32decode4():
 def test_base32encode1():
     pass
 
+@scenario('timeseriesstore.feature', 'Delete a point of a sealed block and read the day graph')
+def test_timeseriesstore_deletesealed():
+    pass
+
+@scenario('timeseriesstore.feature', 'Delete a point that is not sealed yet and read the day graph')
+def test_timeseriesstore_deletehead():
+    pass
+
+@scenario('timeseriesstore.feature', 'Delete a range across the sealed block and read the day graph')
+def test_timeseriesstore_deleteacross():
+    pass
+
+@scenario('timeseriesstore.feature', 'Points that were sealed before a crash are not read twice')
+def test_timeseriesstore_crashseal():
+    pass
+
+@scenario('meterstore.feature', 'A held back value is only dropped when someone else changed the value')
+def test_meterstore_pending():
+    pass
+
 @given(parsers.parse('I am testing the "{module}" module'))
 def setup_test_module(test_domoticz, module):
-    if module == "helper":
-        test_domoticz.sTestModule = "helper"
+    if module in ("helper", "timeseriesstore", "meterstore"):
+        test_domoticz.sTestModule = module
     else:
         assert False
 
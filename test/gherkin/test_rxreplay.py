@@ -0,0 +1,65 @@
+from pytest_bdd import scenario, given, when, then, parsers
+import re, sqlite3, subprocess
+import rxcapture
+
+@scenario('rxreplay.feature', 'Replay a P1 meter capture into an in-memory database')
+def test_rxreplay_memory():
+    pass
+
+@scenario('rxreplay.feature', 'Held back meter values end up in the database')
+def test_rxreplay_meterwriteinterval():
+    pass
+
+@given(parsers.parse('a capture of {interfaces:d} P1 meters sending {frames:d} frames each'))
+def p1_capture(test_domoticz, tmp_path, interfaces, frames):
+    test_domoticz.sCapture = str(tmp_path / "p1meter.dzrx")
+    test_domoticz.lReadings = rxcapture.write_p1_capture(test_domoticz.sCapture, interfaces, frames)
+
+def replay(test_domoticz, database):
+    # -www 0: the functional tests run next to a domoticz that already listens on 8080
+    lArgs = [test_domoticz.sCommand, "-www", "0", "-sslwww", "0", "-wwwroot", "www", "-rxreplay", test_domoticz.sCapture, "-rxreplayexit"]
+    lArgs += ["-dbase", ":memory:"] if database == ":memory:" else ["-rxreplaydbase", database]
+    oResult = subprocess.run(lArgs, stdout=subprocess.PIPE, stderr=subprocess.STDOUT, timeout=120)
+    test_domoticz.sReplayOutput = oResult.stdout.decode("utf-8")
+    assert "RxReplay: replaying" in test_domoticz.sReplayOutput
+
+@given(parsers.parse('a scratch database with a meter write interval of {interval:d} seconds'))
+def scratch_database(test_domoticz, tmp_path, interval):
+    # domoticz creates the other tables and keeps the preferences that are already there
+    test_domoticz.sDatabase = str(tmp_path / "scratch.db")
+    oDatabase = sqlite3.connect(test_domoticz.sDatabase)
+    oDatabase.execute("CREATE TABLE [Preferences] ([Key] VARCHAR(50) PRIMARY KEY, [nValue] INTEGER DEFAULT 0, [sValue] VARCHAR(200))")
+    oDatabase.execute("INSERT INTO Preferences (Key, nValue) VALUES ('MeterWriteInterval', ?)", (interval,))
+    oDatabase.commit()
+    oDatabase.close()
+
+@when('I replay the capture into an in-memory database')
+def replay_memory(test_domoticz):
+    replay(test_domoticz, ":memory:")
+
+@when('I replay the capture into the scratch database')
+def replay_scratch(test_domoticz):
+    replay(test_domoticz, test_domoticz.sDatabase)
+
+@then(parsers.parse('the replay reports {frames:d} frames'))
+def replay_frames(test_domoticz, frames):
+    oMatch = re.search(r"RxReplay: (\d+) frames in", test_domoticz.sReplayOutput)
+    assert oMatch is not None
+    assert int(oMatch.group(1)) == frames
+
+@then('the replay reports the timings of the queue, decode, db, event and push stages')
+def replay_stages(test_domoticz):
+    assert "RxReplay: queue wait: p50" in test_domoticz.sReplayOutput
+    assert "RxReplay: per frame: p50" in test_domoticz.sReplayOutput
+    for stage in ("queue", "decode", "db", "event", "push"):
+        assert re.search(r"RxReplay: stage " + stage + r"\s*: [0-9.]+ ms total", test_domoticz.sReplayOutput) is not None
+
+@then('every meter in the scratch database has the value of its last frame')
+def replay_last_values(test_domoticz):
+    dLast = {}
+    for reading in test_domoticz.lReadings:
+        dLast[reading[0]] = ";".join(str(value) for value in reading[1:])
+    oDatabase = sqlite3.connect(test_domoticz.sDatabase)
+    dStored = dict(oDatabase.execute("SELECT HardwareID, sValue FROM DeviceStatus WHERE (Type=250 AND SubType=1)").fetchall())
+    oDatabase.close()
+    assert dStored == dLast
@@ -0,0 +1,36 @@
+Feature: Short log series store
+    With -shortlogstore the day graphs of temperature, percentage and fan devices are read from
+    the series store (main/TimeSeriesStore.cpp) instead of the short log tables, so a data point
+    that is deleted from the graph has to be removed from the store as well
+
+    Background:
+        Given Command domoticztester is available
+        And can be executed on the commandline
+
+    Scenario: Delete a point of a sealed block and read the day graph
+        Given I am testing the "timeseriesstore" module
+        When I test the function "deleterange"
+        And I provide the following input "150|#|150"
+        Then I expect the function to succeed
+        And have the following result "points: 299, deleted points read: 0"
+
+    Scenario: Delete a point that is not sealed yet and read the day graph
+        Given I am testing the "timeseriesstore" module
+        When I test the function "deleterange"
+        And I provide the following input "295|#|295"
+        Then I expect the function to succeed
+        And have the following result "points: 299, deleted points read: 0"
+
+    Scenario: Delete a range across the sealed block and read the day graph
+        Given I am testing the "timeseriesstore" module
+        When I test the function "deleterange"
+        And I provide the following input "280|#|295"
+        Then I expect the function to succeed
+        And have the following result "points: 284, deleted points read: 0"
+
+    Scenario: Points that were sealed before a crash are not read twice
+        Given I am testing the "timeseriesstore" module
+        When I test the function "crashseal"
+        And I provide the following input "288"
+        Then I expect the function to succeed
+        And have the following result "points: 576, duplicates: 0"
@@ -2,6 +2,29 @@ define(['app'], function (app) {
 	app.controller('AboutController', ['$scope', '$rootScope', '$location', '$http', '$interval', function ($scope, $rootScope, $location, $http, $interval) {
 
 		$scope.strupptime = "-";
+		$scope.busstats = [];
+		var busprocessed = {};
+
+		// Device update subscribers (admin only, the list stays empty for other users)
+		$scope.RefreshBusStats = function () {
+			$http({
+				url: "json.htm?type=command&param=getdevicebusstats",
+				async: true,
+				dataType: 'json'
+			}).then(function successCallback(response) {
+				var data = response.data;
+				if (typeof data.result == 'undefined') {
+					return;
+				}
+				var now = Date.now();
+				data.result.forEach(function (item) {
+					var prev = busprocessed[item.name];
+					item.rate = (typeof prev != 'undefined' && now > prev.time) ? ((item.processed - prev.processed) * 1000 / (now - prev.time)).toFixed(1) : "-";
+					busprocessed[item.name] = { time: now, processed: item.processed };
+				});
+				$scope.busstats = data.result;
+			});
+		}
 
 		$scope.RefreshUptime = function () {
 			if (typeof $scope.mytimer != 'undefined') {
@@ -27,6 +50,7 @@ define(['app'], function (app) {
 					}
 					szUpdate += data.seconds + " " + $.t("Seconds");
 					$scope.strupptime = szUpdate;
+					$scope.RefreshBusStats();
 					$scope.mytimer = $interval(function () {
 						$scope.RefreshUptime();
 					}, 5000);
@@ -2,6 +2,7 @@ define(['app'], function (app) {
 	app.controller('LogController', ['$scope', '$rootScope', '$location', '$http', '$interval', '$sce', 'livesocket', function ($scope, $rootScope, $location, $http, $interval, $sce, livesocket) {
 
 		$scope.LastLogTime = 0;
+		$scope.LastLogId = "";
 		$scope.logitems = [];
 		$scope.logitems_status = [];
 		$scope.logitems_error = [];
@@ -82,7 +83,7 @@ define(['app'], function (app) {
 			var lastscrolltop = $("#logcontent #logdata").scrollTop();
 			var llogtime = $scope.LastLogTime;
 			$http({
-			    url: "json.htm?type=command&param=getlog&lastlogtime=" + $scope.LastLogTime + "&loglevel=" + LOG_ALL,
+			    url: "json.htm?type=command&param=getlog&lastlogid=" + $scope.LastLogId + "&lastlogtime=" + $scope.LastLogTime + "&loglevel=" + LOG_ALL,
 				async: false,
 				dataType: 'json'
 			}).then(function successCallback(response) {
@@ -91,6 +92,9 @@ define(['app'], function (app) {
 					if (typeof data.LastLogTime != 'undefined') {
 						$scope.LastLogTime = parseInt(data.LastLogTime);
 					}
+					if (typeof data.LastLogId != 'undefined') {
+						$scope.LastLogId = data.LastLogId;
+					}
 					$.each(data.result, function (i, item) {
 						$scope.addLogLine(item);
 					});
@@ -131,6 +135,7 @@ define(['app'], function (app) {
 		function init() {
 			$("#logcontent").i18n();
 			$scope.LastLogTime = 0;
+			$scope.LastLogId = "";
 			$scope.RefreshLog();
 			$(window).resize(function () { $scope.ResizeLogWindow(); });
 			$scope.ResizeLogWindow();
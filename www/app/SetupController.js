@@ -573,6 +573,9 @@ define(['app'], function (app) {
 					if (typeof data.ShortLogInterval != 'undefined') {
 						$("#shortlogtable #comboshortloginterval").val(data.ShortLogInterval);
 					}
+					if (typeof data.MeterWriteInterval != 'undefined') {
+						$("#shortlogtable #MeterWriteInterval").val(data.MeterWriteInterval);
+					}
 					if (typeof data.DashboardType != 'undefined') {
 						$("#settingscontent #combosdashtype").val(data.DashboardType);
 					}
@@ -723,6 +726,12 @@ define(['app'], function (app) {
 					if (typeof data.UVCParams != 'undefined') {
 						$("#uvctable #UVCParams").val(data.UVCParams);
 					}
+					if (typeof data.CameraSnapshotMaxAge != 'undefined') {
+						$("#camerasnapshottable #CameraSnapshotMaxAge").val(data.CameraSnapshotMaxAge);
+					}
+					if (typeof data.CameraRelay != 'undefined') {
+						$("#camerasnapshottable #CameraRelay").prop('checked', data.CameraRelay == 1);
+					}
 					if (typeof data.AcceptNewHardware != 'undefined') {
 						$("#acceptnewhardwaretable #AcceptNewHardware").prop('checked', data.AcceptNewHardware == 1);
 					}